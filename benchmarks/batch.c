@@ -0,0 +1,130 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "cfg.h"
+#include "batch.h"
+#include "generators.h"
+
+// Times drawing a directory of host snapshots with --batch-input on 1, 2,
+// 4... threads up to the number of CPUs. Prints one JSON object per line:
+// {"benchmark":"batch","nodes":500,"hosts":200,"jobs":4,
+//  "hosts_per_s":...,"hosts_per_s_per_core":...}
+//
+// Usage: bench_batch [nodes] [hosts]
+
+#define NODES 500
+#define HOSTS 200
+
+double
+now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void
+write_hosts(const char *dir, size_t n, size_t hosts)
+{
+	pnode_t *processes = calloc(n, sizeof(pnode_t));
+	if (!processes) {
+		perror("calloc");
+		exit(EXIT_FAILURE);
+	}
+
+	char path[PATH_MAX];
+
+	for (size_t h = 0; h < hosts; ++h) {
+		gen_tree(GEN_REALISTIC, n, h, processes);
+
+		snprintf(path, sizeof(path), "%s/host%05zu", dir, h);
+
+		FILE *fp = fopen(path, "w");
+		if (!fp) {
+			perror(path);
+			exit(EXIT_FAILURE);
+		}
+
+		gen_write_stream(fp, processes, n);
+		fclose(fp);
+	}
+
+	free(processes);
+}
+
+void
+bench(size_t n, size_t hosts, size_t jobs, size_t ncpu)
+{
+	config.jobs = jobs;
+
+	double t0 = now();
+	batch_run();
+	double t = now() - t0;
+
+	double rate = hosts / t;
+	size_t cores = jobs < ncpu ? jobs : ncpu;
+
+	printf("{\"benchmark\":\"batch\",\"nodes\":%zu,\"hosts\":%zu,"
+			"\"jobs\":%zu,\"hosts_per_s\":%.2f,\"hosts_per_s_per_core\":%.2f}\n",
+			n, hosts, jobs, rate, rate / cores);
+	fflush(stdout);
+}
+
+int main(int argc, const char *argv[])
+{
+	size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : NODES;
+	size_t hosts = argc > 2 ? strtoul(argv[2], NULL, 10) : HOSTS;
+
+	char dir[] = "/tmp/pscircle-batch-XXXXXX";
+	if (!mkdtemp(dir)) {
+		perror("mkdtemp");
+		return EXIT_FAILURE;
+	}
+
+	char input[64], output[64];
+	snprintf(input, sizeof(input), "%s/in", dir);
+	snprintf(output, sizeof(output), "%s/out", dir);
+
+	if (mkdir(input, 0755) != 0) {
+		perror(input);
+		return EXIT_FAILURE;
+	}
+
+	write_hosts(input, n, hosts);
+
+	config.batch_input = input;
+	config.batch_output = output;
+
+	long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+	if (ncpu < 1)
+		ncpu = 1;
+
+	for (size_t jobs = 1; ; jobs *= 2) {
+		if (jobs > (size_t) ncpu)
+			jobs = ncpu;
+
+		bench(n, hosts, jobs, ncpu);
+
+		if (jobs == (size_t) ncpu)
+			break;
+	}
+
+	char path[PATH_MAX];
+	for (size_t h = 0; h < hosts; ++h) {
+		snprintf(path, sizeof(path), "%s/host%05zu", input, h);
+		unlink(path);
+		snprintf(path, sizeof(path), "%s/host%05zu.png", output, h);
+		unlink(path);
+	}
+
+	rmdir(input);
+	rmdir(output);
+	rmdir(dir);
+
+	return 0;
+}
@@ -0,0 +1,111 @@
+#define _XOPEN_SOURCE 700
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <ftw.h>
+
+#include "cfg.h"
+#include "procs.h"
+#include "generators.h"
+
+// Reads synthetic /proc trees through --procfs-root and prints one JSON
+// object per line:
+// {"benchmark":"collect","shape":"realistic","nodes":1000,"runs":5,
+//  "min_s":...,"median_s":...}
+//
+// Usage: bench_collect [max nodes]
+
+#define MAX_NODES 50000
+#define RUNS 5
+
+double
+now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int
+double_comp(const void *a, const void *b)
+{
+	double da = *(const double *) a;
+	double db = *(const double *) b;
+	return (da > db) - (da < db);
+}
+
+int
+remove_entry(const char *path, const struct stat *st, int flag, struct FTW *ftw)
+{
+	(void) st;
+	(void) flag;
+	(void) ftw;
+	return remove(path);
+}
+
+void
+bench(gen_shape_t shape, size_t n)
+{
+	char dir[] = "/tmp/pscircle-procfs-XXXXXX";
+	if (!mkdtemp(dir)) {
+		perror(dir);
+		exit(EXIT_FAILURE);
+	}
+
+	pnode_t *processes = calloc(n, sizeof(pnode_t));
+	if (!processes) {
+		perror("calloc");
+		exit(EXIT_FAILURE);
+	}
+
+	gen_tree(shape, n, 1, processes);
+
+	if (!gen_write_procfs(dir, processes, n)) {
+		perror(dir);
+		exit(EXIT_FAILURE);
+	}
+
+	config.procfs_root = dir;
+
+	psc_ctx_t ctx;
+	psc_ctx_init(&ctx, &config);
+
+	double t[RUNS];
+
+	for (size_t r = 0; r < RUNS; ++r) {
+		procs_t *procs = calloc(1, sizeof(procs_t));
+
+		double t0 = now();
+		procs_init(&ctx, procs, NULL);
+		t[r] = now() - t0;
+
+		procs_dinit(procs);
+		free(procs);
+	}
+
+	psc_ctx_dinit(&ctx);
+
+	qsort(t, RUNS, sizeof(double), double_comp);
+
+	printf("{\"benchmark\":\"collect\",\"shape\":\"%s\",\"nodes\":%zu,"
+			"\"runs\":%d,\"min_s\":%.6f,\"median_s\":%.6f}\n",
+			gen_shape_name(shape), n, RUNS, t[0], t[RUNS / 2]);
+	fflush(stdout);
+
+	nftw(dir, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+	free(processes);
+}
+
+int main(int argc, const char *argv[])
+{
+	size_t max_nodes = argc > 1 ? strtoul(argv[1], NULL, 10) : MAX_NODES;
+
+	config.read_stdin = false;
+	config.interval = 0;
+
+	for (size_t n = 500; n <= max_nodes; n *= 10)
+		bench(GEN_REALISTIC, n);
+
+	return 0;
+}
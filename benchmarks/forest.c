@@ -0,0 +1,162 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "cfg.h"
+#include "ctx.h"
+#include "hosts.h"
+#include "procs.h"
+#include "painter.h"
+#include "pipeline.h"
+#include "generators.h"
+
+// Times collecting and drawing the processes of many hosts as one tree with
+// --hosts, without folding and with --max-nodes. Prints one JSON object per
+// line:
+// {"benchmark":"forest","nodes":2000,"hosts":50,"max_nodes":2000,
+//  "drawn":...,"collect_ms":...,"render_ms":...}
+//
+// Usage: bench_forest [nodes] [hosts]
+
+#define NODES 2000
+#define HOSTS 50
+#define RUNS 5
+
+double
+now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void
+write_hosts(const char *dir, size_t n, size_t hosts)
+{
+	pnode_t *processes = calloc(n, sizeof(pnode_t));
+	if (!processes) {
+		perror("calloc");
+		exit(EXIT_FAILURE);
+	}
+
+	char path[PATH_MAX];
+
+	for (size_t h = 0; h < hosts; ++h) {
+		gen_tree(GEN_REALISTIC, n, h, processes);
+
+		snprintf(path, sizeof(path), "%s/host%05zu", dir, h);
+
+		FILE *fp = fopen(path, "w");
+		if (!fp) {
+			perror(path);
+			exit(EXIT_FAILURE);
+		}
+
+		gen_write_stream(fp, processes, n);
+		fclose(fp);
+	}
+
+	free(processes);
+}
+
+size_t
+count_nodes(const node_t *node)
+{
+	size_t n = 1;
+	for (const node_t *c = node->first; c != NULL; c = c->next)
+		n += count_nodes(c);
+	return n;
+}
+
+void
+bench(psc_ctx_t *ctx, painter_t *painter, const hosts_t *hosts, size_t n,
+		size_t max_nodes)
+{
+	config.max_nodes = max_nodes;
+
+	procs_io_t io = {
+		.hosts = hosts,
+	};
+
+	double collect = 0;
+	double render = 0;
+	size_t drawn = 0;
+
+	for (size_t r = 0; r < RUNS; ++r) {
+		procs_t procs = {0};
+
+		double t0 = now();
+		pipeline_collect(ctx, &procs, &io);
+		double t1 = now();
+		pipeline_render(ctx, painter, &procs);
+		double t2 = now();
+
+		collect += t1 - t0;
+		render += t2 - t1;
+		// Without the root
+		drawn = count_nodes(&procs.root->node) - 1;
+
+		procs_dinit(&procs);
+	}
+
+	printf("{\"benchmark\":\"forest\",\"nodes\":%zu,\"hosts\":%zu,"
+			"\"max_nodes\":%zu,\"drawn\":%zu,"
+			"\"collect_ms\":%.3f,\"render_ms\":%.3f}\n",
+			n, hosts->n, max_nodes, drawn,
+			collect / RUNS * 1e3, render / RUNS * 1e3);
+	fflush(stdout);
+}
+
+int main(int argc, const char *argv[])
+{
+	size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : NODES;
+	size_t nhosts = argc > 2 ? strtoul(argv[2], NULL, 10) : HOSTS;
+
+	char dir[] = "/tmp/pscircle-forest-XXXXXX";
+	if (!mkdtemp(dir)) {
+		perror("mkdtemp");
+		return EXIT_FAILURE;
+	}
+
+	write_hosts(dir, n, nhosts);
+
+	char output[64];
+	snprintf(output, sizeof(output), "%s.png", dir);
+
+	config.output = output;
+	config.output_format = ENCODER_PNG;
+	config.background_image = NULL;
+	config.root_pid = 1;
+
+	hosts_t hosts;
+	hosts_init(&hosts);
+	hosts_add(&hosts, dir);
+
+	psc_ctx_t ctx;
+	psc_ctx_init(&ctx, &config);
+
+	painter_t *painter = calloc(1, sizeof(painter_t));
+	painter_init(&ctx, painter);
+
+	bench(&ctx, painter, &hosts, n, 0);
+	bench(&ctx, painter, &hosts, n, 2000);
+	bench(&ctx, painter, &hosts, n, 500);
+
+	painter_dinit(painter);
+	free(painter);
+	psc_ctx_dinit(&ctx);
+
+	for (size_t h = 0; h < hosts.n; ++h)
+		unlink(hosts.paths[h]);
+
+	hosts_dinit(&hosts);
+
+	rmdir(dir);
+	remove(output);
+
+	return 0;
+}
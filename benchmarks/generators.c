@@ -0,0 +1,354 @@
+#include <assert.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "generators.h"
+
+static const char *shape_names[GEN_NSHAPES] = {
+	"wide",
+	"deep",
+	"realistic",
+	"containers",
+};
+
+static const char *names[] = {
+	"bash", "sshd", "systemd", "kworker/0:1", "firefox", "Web Content",
+	"chrome", "code", "python3", "node", "postgres", "nginx", "dbus-daemon",
+	"pulseaudio", "Xorg", "zsh", "tmux: server", "vim", "java", "gcc",
+};
+
+#define NNAMES (sizeof(names) / sizeof(names[0]))
+
+// Number of children per process, approximating a desktop session:
+// most processes are leaves, a few shells and supervisors have many
+static const struct {
+	double probability;
+	size_t min;
+	size_t max;
+} fanout[] = {
+	{0.70,  0,  0},
+	{0.14,  1,  1},
+	{0.06,  2,  2},
+	{0.05,  3,  5},
+	{0.035, 6, 15},
+	{0.015, 16, 60},
+};
+
+#define NFANOUT (sizeof(fanout) / sizeof(fanout[0]))
+
+// Share of processes changing between two frames
+#define GEN_CPU_CHANGES 0.05
+#define GEN_MEM_CHANGES 0.10
+#define GEN_SPAWNS 5
+
+typedef struct {
+	uint64_t s;
+} rng_t;
+
+// xorshift64*
+static uint64_t
+rng_next(rng_t *rng)
+{
+	rng->s ^= rng->s >> 12;
+	rng->s ^= rng->s << 25;
+	rng->s ^= rng->s >> 27;
+	return rng->s * 2685821657736338717ULL;
+}
+
+static double
+rng_uniform(rng_t *rng)
+{
+	return (rng_next(rng) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static size_t
+rng_range(rng_t *rng, size_t min, size_t max)
+{
+	return min + rng_next(rng) % (max - min + 1);
+}
+
+static void
+fill_stats(rng_t *rng, pnode_t *p, const char *name)
+{
+	// Most processes are idle
+	double u = rng_uniform(rng);
+	p->cpu = u < 0.9 ? 0 : 50 * (u - 0.9) * 10;
+
+	// Log-uniform from 1M to 2G
+	p->mem = (uint64_t) (exp(log(1 << 20) + rng_uniform(rng) * log(2048)));
+
+	strncpy(p->name, name, PSC_MAX_NAME_LENGHT - 1);
+}
+
+static void
+add(rng_t *rng, pnode_t *processes, size_t i, int ppid, const char *name)
+{
+	pnode_t *p = processes + i;
+
+	memset(p, 0, sizeof(pnode_t));
+	p->pid = i + 1;
+	p->ppid = ppid;
+
+	fill_stats(rng, p, name ? name : names[rng_next(rng) % NNAMES]);
+}
+
+static void
+gen_realistic(rng_t *rng, size_t n, pnode_t *processes)
+{
+	size_t next = 1;
+
+	// Breadth first, so that every process gets its fan-out
+	for (size_t parent = 0; parent < next && next < n; ++parent) {
+		double u = rng_uniform(rng);
+		size_t k = 0;
+
+		for (size_t i = 0; i < NFANOUT; ++i) {
+			u -= fanout[i].probability;
+			if (u < 0 || i == NFANOUT - 1) {
+				k = rng_range(rng, fanout[i].min, fanout[i].max);
+				break;
+			}
+		}
+
+		// The tree must not die out before n processes
+		if (parent == next - 1 && k == 0)
+			k = 1;
+
+		for (size_t j = 0; j < k && next < n; ++j, ++next)
+			add(rng, processes, next, parent + 1, NULL);
+	}
+}
+
+static void
+gen_containers(rng_t *rng, size_t n, pnode_t *processes)
+{
+	static const char *apps[] = {"nginx", "postgres", "redis-server", "java", "node"};
+
+	if (n > 1)
+		add(rng, processes, 1, 1, "containerd");
+
+	size_t next = 2;
+	while (next < n) {
+		int shim = next + 1;
+		add(rng, processes, next++, 2, "containerd-shim");
+
+		if (next == n)
+			break;
+
+		int app = next + 1;
+		add(rng, processes, next++, shim, apps[rng_next(rng) % 5]);
+
+		size_t workers = rng_range(rng, 0, 30);
+		for (size_t j = 0; j < workers && next < n; ++j)
+			add(rng, processes, next++, app, NULL);
+	}
+}
+
+void
+gen_tree(gen_shape_t shape, size_t n, uint64_t seed, pnode_t *processes)
+{
+	assert(shape < GEN_NSHAPES);
+	assert(processes);
+
+	if (n == 0)
+		return;
+
+	rng_t rng = {seed * 2 + 1};
+
+	add(&rng, processes, 0, 0, "systemd");
+
+	switch (shape) {
+	case GEN_WIDE:
+		for (size_t i = 1; i < n; ++i)
+			add(&rng, processes, i, 1, NULL);
+		break;
+	case GEN_DEEP:
+		for (size_t i = 1; i < n; ++i)
+			add(&rng, processes, i, (i - 1) % GEN_CHAIN_LENGTH == 0 ? 1 : (int) i, NULL);
+		break;
+	case GEN_REALISTIC:
+		gen_realistic(&rng, n, processes);
+		break;
+	case GEN_CONTAINERS:
+		gen_containers(&rng, n, processes);
+		break;
+	default:
+		break;
+	}
+}
+
+void
+gen_churn(pnode_t *processes, size_t n, uint64_t seed, int *next_pid)
+{
+	assert(processes);
+	assert(next_pid);
+
+	rng_t rng = {seed * 2 + 1};
+
+	for (size_t i = 0; i < n; ++i) {
+		pnode_t *p = processes + i;
+		double u = rng_uniform(&rng);
+
+		if (u < GEN_CPU_CHANGES)
+			p->cpu = rng_range(&rng, 0, 999) / 10.;
+
+		if (u < GEN_MEM_CHANGES) {
+			memunit_t d = rng_range(&rng, 1, 32) * 4096;
+			if (rng_next(&rng) & 1)
+				p->mem += d;
+			else if (p->mem > d)
+				p->mem -= d;
+		}
+	}
+
+	// init stays
+	for (size_t i = 0; i < GEN_SPAWNS && n > 1; ++i) {
+		pnode_t *p = processes + rng_range(&rng, 1, n - 1);
+		p->pid = (*next_pid)++;
+		p->cpu = 0;
+		strcpy(p->name, "spawned");
+	}
+}
+
+const char *
+gen_shape_name(gen_shape_t shape)
+{
+	assert(shape < GEN_NSHAPES);
+	return shape_names[shape];
+}
+
+bool
+gen_shape_from_str(const char *str, gen_shape_t *shape)
+{
+	for (size_t i = 0; i < GEN_NSHAPES; ++i) {
+		if (strcasecmp(str, shape_names[i]) == 0) {
+			*shape = i;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void
+gen_write_stream(FILE *fp, const pnode_t *processes, size_t n)
+{
+	for (size_t i = 0; i < n; ++i) {
+		const pnode_t *p = processes + i;
+		fprintf(fp, "%d %d %.2f %llu ", p->pid, p->ppid, (double) p->cpu,
+				(unsigned long long) p->mem);
+
+		// Names are single words in the stream format
+		for (const char *c = p->name; *c; ++c)
+			fputc(*c == ' ' ? '_' : *c, fp);
+
+		fputc('\n', fp);
+	}
+}
+
+// Synthetic system has been up for GEN_UPTIME seconds and all processes
+// were started at boot
+#define GEN_UPTIME 100000
+
+static bool
+write_file(const char *dir, const char *name, const char *content)
+{
+	char path[PATH_MAX];
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+
+	FILE *fp = fopen(path, "w");
+	if (!fp)
+		return false;
+
+	fputs(content, fp);
+
+	return fclose(fp) == 0;
+}
+
+static bool
+write_stat(const char *dir, const pnode_t *p, long hertz, long pagesize)
+{
+	char path[PATH_MAX];
+	snprintf(path, sizeof(path), "%s/%d", dir, p->pid);
+
+	if (mkdir(path, 0755) != 0 && errno != EEXIST)
+		return false;
+
+	snprintf(path, sizeof(path), "%s/%d/stat", dir, p->pid);
+
+	FILE *fp = fopen(path, "w");
+	if (!fp)
+		return false;
+
+	// Average utilization since boot gives back p->cpu
+	unsigned long ticks = p->cpu / 100 * GEN_UPTIME * hertz;
+	unsigned long utime = ticks / 2;
+	unsigned long stime = ticks - utime;
+	long rss = p->mem / pagesize;
+
+	// 52 fields, see proc(5)
+	fprintf(fp, "%d (%s) S %d %d %d 0 -1 4194560 100 0 0 0 %lu %lu 0 0 "
+			"20 0 1 0 0 %lu %ld 18446744073709551615 1 1 0 0 0 0 0 0 0 "
+			"0 0 0 17 0 0 0 0 0 0 0 0 0 0 0 0 0 0\n",
+			p->pid, p->name, p->ppid, p->pid, p->pid,
+			utime, stime, (unsigned long) rss * pagesize * 4, rss);
+
+	return fclose(fp) == 0;
+}
+
+bool
+gen_write_procfs(const char *dir, const pnode_t *processes, size_t n)
+{
+	assert(dir);
+
+	if (mkdir(dir, 0755) != 0 && errno != EEXIST)
+		return false;
+
+	long hertz = sysconf(_SC_CLK_TCK);
+	long pagesize = sysconf(_SC_PAGESIZE);
+
+	uint64_t mem = 0;
+	for (size_t i = 0; i < n; ++i)
+		mem += processes[i].mem;
+
+	char buf[512];
+
+	// The machine is 25% busy, 4 CPUs
+	unsigned long long total = 4ULL * GEN_UPTIME * hertz;
+	snprintf(buf, sizeof(buf), "cpu  %llu 0 %llu %llu 0 0 0 0 0 0\n",
+			total / 8, total / 8, total * 3 / 4);
+	if (!write_file(dir, "stat", buf))
+		return false;
+
+	snprintf(buf, sizeof(buf), "%d.00 %d.00\n", GEN_UPTIME, 3 * GEN_UPTIME);
+	if (!write_file(dir, "uptime", buf))
+		return false;
+
+	// Twice as much memory as the processes use
+	unsigned long long kb = mem / 1024;
+	snprintf(buf, sizeof(buf),
+			"MemTotal:       %llu kB\n"
+			"MemFree:        %llu kB\n"
+			"MemAvailable:   %llu kB\n"
+			"Buffers:        %llu kB\n"
+			"Cached:         %llu kB\n",
+			2 * kb, kb / 2, kb, kb / 8, kb * 3 / 8);
+	if (!write_file(dir, "meminfo", buf))
+		return false;
+
+	snprintf(buf, sizeof(buf), "1.00 0.75 0.50 1/%zu %zu\n", n, n);
+	if (!write_file(dir, "loadavg", buf))
+		return false;
+
+	for (size_t i = 0; i < n; ++i) {
+		if (!write_stat(dir, processes + i, hertz, pagesize))
+			return false;
+	}
+
+	return true;
+}
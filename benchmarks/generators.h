@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "pnode.h"
+
+// Synthetic process trees for the benchmarks. Processes get pids 1..n,
+// pid 1 is the init process.
+typedef enum {
+	// All processes are children of init
+	GEN_WIDE = 0,
+	// Chains of GEN_CHAIN_LENGTH processes hanging from init
+	GEN_DEEP,
+	// Fan-out of every process follows the distribution of a desktop session
+	GEN_REALISTIC,
+	// Container runtime with many small process trees
+	GEN_CONTAINERS,
+	GEN_NSHAPES
+} gen_shape_t;
+
+#define GEN_CHAIN_LENGTH 256
+
+const char *
+gen_shape_name(gen_shape_t shape);
+
+bool
+gen_shape_from_str(const char *str, gen_shape_t *shape);
+
+// Fills pid, ppid, cpu, mem and name of n processes. The result depends
+// only on the arguments.
+void
+gen_tree(gen_shape_t shape, size_t n, uint64_t seed, pnode_t *processes);
+
+// Changes the usage of some processes and replaces a few of them with new
+// ones (pids from next_pid), as between two frames a second apart
+void
+gen_churn(pnode_t *processes, size_t n, uint64_t seed, int *next_pid);
+
+// Writes the processes in --stdin format
+void
+gen_write_stream(FILE *fp, const pnode_t *processes, size_t n);
+
+// Writes the processes as a /proc tree (see --procfs-root): dir/<pid>/stat,
+// stat, uptime, meminfo and loadavg. Creates dir if needed.
+bool
+gen_write_procfs(const char *dir, const pnode_t *processes, size_t n);
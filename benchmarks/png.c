@@ -0,0 +1,163 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <math.h>
+
+#include <cairo.h>
+
+#include "encoder.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define WIDTH 3200
+#define HEIGHT 1800
+#define REPEAT 5
+
+typedef struct {
+	const char *name;
+	encoder_opts_t opts;
+} variant_t;
+
+double
+now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void
+draw_frame(cairo_surface_t *sf)
+{
+	cairo_t *cr = cairo_create(sf);
+
+	cairo_set_source_rgba(cr, 42/255., 42/255., 42/255., 1);
+	cairo_paint(cr);
+
+	srand(1);
+
+	cairo_translate(cr, WIDTH / 2, HEIGHT / 2);
+
+	for (int i = 0; i < 500; ++i) {
+		double a = 2 * M_PI * rand() / RAND_MAX;
+		double r = 210 * (1 + rand() % 4);
+
+		cairo_set_source_rgba(cr, 0.24, 0.36, 0.39, 1);
+		cairo_set_line_width(cr, 2.5);
+		cairo_move_to(cr, (r - 210) * cos(a), (r - 210) * sin(a));
+		cairo_line_to(cr, r * cos(a), r * sin(a));
+		cairo_stroke(cr);
+
+		cairo_arc(cr, r * cos(a), r * sin(a), 6, 0, 2 * M_PI);
+		cairo_set_source_rgba(cr, 0.15, 0.52, 0.32, 1);
+		cairo_fill(cr);
+
+		cairo_save(cr);
+		cairo_move_to(cr, (r + 12) * cos(a), (r + 12) * sin(a));
+		cairo_rotate(cr, a);
+		cairo_set_source_rgba(cr, 0.93, 0.93, 0.93, 0.7);
+		cairo_set_font_size(cr, 20);
+		cairo_show_text(cr, "process");
+		cairo_restore(cr);
+	}
+
+	cairo_destroy(cr);
+	cairo_surface_flush(sf);
+}
+
+double
+bench_cairo(cairo_surface_t *sf, const char *path)
+{
+	double best = INFINITY;
+
+	for (int i = 0; i < REPEAT; ++i) {
+		double t = now();
+		cairo_surface_write_to_png(sf, path);
+		t = now() - t;
+		if (t < best)
+			best = t;
+	}
+
+	return best;
+}
+
+double
+bench_encoder(const image_t *img, const encoder_opts_t *opts, const char *path)
+{
+	double best = INFINITY;
+
+	for (int i = 0; i < REPEAT; ++i) {
+		double t = now();
+		FILE *fp = fopen(path, "wb");
+		if (!fp || !encoder_write(fp, img, opts)) {
+			perror(path);
+			exit(EXIT_FAILURE);
+		}
+		fclose(fp);
+		t = now() - t;
+		if (t < best)
+			best = t;
+	}
+
+	return best;
+}
+
+long
+file_size(const char *path)
+{
+	FILE *fp = fopen(path, "rb");
+	if (!fp)
+		return -1;
+	fseek(fp, 0, SEEK_END);
+	long sz = ftell(fp);
+	fclose(fp);
+	return sz;
+}
+
+void
+report(const char *name, double t, const char *path)
+{
+	printf("{\"benchmark\":\"png\",\"variant\":\"%s\",\"runs\":%d,"
+			"\"min_s\":%.6f,\"bytes\":%ld}\n",
+			name, REPEAT, t, file_size(path));
+}
+
+int main(int argc, const char *argv[])
+{
+	const char *path = argc > 1 ? argv[1] : "pscircle-bench.out";
+
+	cairo_surface_t *sf = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, WIDTH, HEIGHT);
+	draw_frame(sf);
+
+	image_t img = {
+		.data   = cairo_image_surface_get_data(sf),
+		.width  = WIDTH,
+		.height = HEIGHT,
+		.stride = cairo_image_surface_get_stride(sf),
+	};
+
+	double t = bench_cairo(sf, path);
+	report("cairo_write_to_png", t, path);
+
+	variant_t variants[] = {
+		{"png-6-all-1thread",   {ENCODER_PNG, 6, ENCODER_FILTER_ALL, 1}},
+		{"png-6-all-parallel",  {ENCODER_PNG, 6, ENCODER_FILTER_ALL, 0}},
+		{"png-1-none-1thread",  {ENCODER_PNG, 1, ENCODER_FILTER_NONE, 1}},
+		{"png-1-none-parallel", {ENCODER_PNG, 1, ENCODER_FILTER_NONE, 0}},
+		{"qoi",                 {ENCODER_QOI}},
+		{"ppm",                 {ENCODER_PPM}},
+		{"bmp",                 {ENCODER_BMP}},
+	};
+
+	for (size_t i = 0; i < sizeof(variants)/sizeof(*variants); ++i) {
+		t = bench_encoder(&img, &variants[i].opts, path);
+		report(variants[i].name, t, path);
+	}
+
+	remove(path);
+	cairo_surface_destroy(sf);
+
+	return 0;
+}
@@ -0,0 +1,152 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "generators.h"
+
+// Creates directory trees for --procfs-root:
+//
+//   procfs-fixture snapshot DIR [PROC]
+//       copies the files pscircle reads from PROC (/proc by default)
+//   procfs-fixture synth DIR N [SHAPE] [SEED]
+//       writes N synthetic processes (see bench_tree for the shapes)
+
+#define DEFAULT_SHAPE GEN_REALISTIC
+
+void
+usage()
+{
+	fprintf(stderr,
+			"Usage: procfs-fixture snapshot DIR [PROC]\n"
+			"       procfs-fixture synth DIR N [wide|deep|realistic|containers] [SEED]\n");
+	exit(EXIT_FAILURE);
+}
+
+// Files in /proc report zero size, so they are copied until EOF
+bool
+copy_file(const char *from, const char *to)
+{
+	FILE *in = fopen(from, "r");
+	if (!in)
+		return false;
+
+	FILE *out = fopen(to, "w");
+	if (!out) {
+		fclose(in);
+		return false;
+	}
+
+	char buf[4096];
+	size_t n;
+	while ((n = fread(buf, 1, sizeof(buf), in)) > 0)
+		fwrite(buf, 1, n, out);
+
+	fclose(in);
+	return fclose(out) == 0;
+}
+
+int
+snapshot(const char *dir, const char *proc)
+{
+	if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+		perror(dir);
+		return EXIT_FAILURE;
+	}
+
+	char from[PATH_MAX];
+	char to[PATH_MAX];
+
+	const char *files[] = {"stat", "uptime", "meminfo", "loadavg"};
+	for (size_t i = 0; i < sizeof(files) / sizeof(*files); ++i) {
+		snprintf(from, sizeof(from), "%s/%s", proc, files[i]);
+		snprintf(to, sizeof(to), "%s/%s", dir, files[i]);
+		if (!copy_file(from, to)) {
+			perror(from);
+			return EXIT_FAILURE;
+		}
+	}
+
+	DIR *d = opendir(proc);
+	if (!d) {
+		perror(proc);
+		return EXIT_FAILURE;
+	}
+
+	size_t n = 0;
+	struct dirent *de;
+	while ((de = readdir(d)) != NULL) {
+		char *e = NULL;
+		strtol(de->d_name, &e, 10);
+		if (*e != '\0' || e == de->d_name)
+			continue;
+
+		snprintf(to, sizeof(to), "%s/%s", dir, de->d_name);
+		if (mkdir(to, 0755) != 0 && errno != EEXIST) {
+			perror(to);
+			return EXIT_FAILURE;
+		}
+
+		snprintf(from, sizeof(from), "%s/%s/stat", proc, de->d_name);
+		snprintf(to, sizeof(to), "%s/%s/stat", dir, de->d_name);
+
+		// The process may have exited since readdir
+		if (copy_file(from, to))
+			n++;
+		else
+			remove(to);
+	}
+
+	closedir(d);
+
+	fprintf(stderr, "%zu processes copied to %s\n", n, dir);
+
+	return EXIT_SUCCESS;
+}
+
+int
+synth(const char *dir, size_t n, gen_shape_t shape, uint64_t seed)
+{
+	pnode_t *processes = calloc(n, sizeof(pnode_t));
+	if (!processes) {
+		perror("calloc");
+		return EXIT_FAILURE;
+	}
+
+	gen_tree(shape, n, seed, processes);
+
+	bool ok = gen_write_procfs(dir, processes, n);
+	if (!ok)
+		perror(dir);
+
+	free(processes);
+
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int main(int argc, const char *argv[])
+{
+	if (argc < 3)
+		usage();
+
+	if (strcmp(argv[1], "snapshot") == 0 && argc <= 4)
+		return snapshot(argv[2], argc > 3 ? argv[3] : "/proc");
+
+	if (strcmp(argv[1], "synth") != 0 || argc < 4 || argc > 6)
+		usage();
+
+	size_t n = strtoul(argv[3], NULL, 10);
+	if (n == 0)
+		usage();
+
+	gen_shape_t shape = DEFAULT_SHAPE;
+	if (argc > 4 && !gen_shape_from_str(argv[4], &shape))
+		usage();
+
+	uint64_t seed = argc > 5 ? strtoull(argv[5], NULL, 10) : 1;
+
+	return synth(argv[2], n, shape, seed);
+}
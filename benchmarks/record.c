@@ -0,0 +1,99 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cfg.h"
+#include "procs.h"
+#include "snapshot.h"
+#include "delta.h"
+#include "generators.h"
+
+// Compares the size and the capture time of recordings made of full
+// snapshots with delta-encoded ones (see delta.h). Prints one JSON object
+// per line:
+// {"benchmark":"record","format":"delta","nodes":10000,"frames":300,
+//  "bytes":...,"bytes_per_frame":...,"us_per_frame":...}
+//
+// Usage: bench_record [nodes] [frames]
+
+#define NODES 10000
+#define FRAMES 300
+
+double
+now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void
+bench(const char *format, const pnode_t *processes, size_t n, size_t frames)
+{
+	procs_t procs = {0};
+	procs_alloc(&procs, n + 1);
+	for (size_t i = 0; i < n; ++i)
+		memcpy(procs_add(&procs), processes + i, sizeof(pnode_t));
+
+	FILE *fp = tmpfile();
+	if (!fp) {
+		perror("tmpfile");
+		exit(EXIT_FAILURE);
+	}
+
+	bool delta = strcmp(format, "delta") == 0;
+
+	delta_writer_t writer;
+	delta_writer_init(&writer, fp, PSC_KEYFRAME_INTERVAL);
+
+	int next_pid = n + 1;
+	double t = 0;
+
+	for (size_t f = 0; f < frames; ++f) {
+		gen_churn(procs.processes + 1, procs.nprocesses - 1, f, &next_pid);
+
+		double t0 = now();
+		bool ok = delta ? delta_writer_add(&writer, &procs) : snapshot_write(fp, &procs, t0 * 1e9);
+		t += now() - t0;
+
+		if (!ok) {
+			perror(format);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	fflush(fp);
+	long bytes = ftell(fp);
+
+	printf("{\"benchmark\":\"record\",\"format\":\"%s\",\"nodes\":%zu,"
+			"\"frames\":%zu,\"bytes\":%ld,\"bytes_per_frame\":%.0f,"
+			"\"us_per_frame\":%.1f}\n",
+			format, n, frames, bytes, (double) bytes / frames, t / frames * 1e6);
+	fflush(stdout);
+
+	delta_writer_dinit(&writer);
+	fclose(fp);
+	procs_dinit(&procs);
+}
+
+int main(int argc, const char *argv[])
+{
+	size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : NODES;
+	size_t frames = argc > 2 ? strtoul(argv[2], NULL, 10) : FRAMES;
+
+	pnode_t *processes = calloc(n, sizeof(pnode_t));
+	if (!processes) {
+		perror("calloc");
+		return EXIT_FAILURE;
+	}
+
+	gen_tree(GEN_REALISTIC, n, 1, processes);
+
+	bench("snapshot", processes, n, frames);
+	bench("delta", processes, n, frames);
+
+	free(processes);
+
+	return 0;
+}
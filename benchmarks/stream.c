@@ -0,0 +1,149 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "cfg.h"
+#include "proc_stream.h"
+#include "generators.h"
+
+// Compares the --stdin parser with the fscanf/fgetc reader it replaced.
+// Prints one JSON object per line:
+// {"benchmark":"stream","reader":"buffered","lines":100000,"runs":5,
+//  "min_s":...,"mb_per_s":...}
+//
+// Usage: bench_stream [lines]
+
+#define LINES 100000
+#define RUNS 5
+
+double
+now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void
+legacy_read_word_and_skip_to_lf(FILE *procs, char *buf, size_t len)
+{
+	int c = 0;
+	for (size_t i = 0; i < len - 1; ++i) {
+		c = fgetc(procs);
+		if (c == ' ' || c == '\n' || c == EOF) {
+			buf[i] = '\0';
+			if (c == ' ')
+				break;
+			return;
+		}
+		buf[i] = c;
+	}
+
+	buf[len - 1] = '\0';
+
+	do {
+		c = fgetc(procs);
+	} while (c != '\n' && c != EOF);
+}
+
+pnode_t *
+legacy_get_next_proc(FILE *procs, pnode_t *pnode)
+{
+	pnode_t p;
+	while (!feof(procs)) {
+		double cpu;
+		unsigned long mem;
+		int rc = fscanf(procs, "%d %d %lf %lu ", &p.pid, &p.ppid, &cpu, &mem);
+		if (rc == EOF)
+			return NULL;
+
+		legacy_read_word_and_skip_to_lf(procs, pnode->name, PSC_MAX_NAME_LENGHT);
+
+		pnode->pid = p.pid;
+		pnode->ppid = p.ppid;
+		pnode->cpu = cpu;
+		pnode->mem = mem;
+
+		return pnode;
+	}
+
+	return NULL;
+}
+
+size_t
+read_legacy(FILE *fp)
+{
+	pnode_t p = {0};
+	size_t n = 0;
+	while (legacy_get_next_proc(fp, &p))
+		n++;
+	return n;
+}
+
+size_t
+read_buffered(FILE *fp)
+{
+	in_stream_t stream;
+	stream_init(&stream, fp);
+
+	pnode_t p = {0};
+	size_t n = 0;
+	while (stream_get_next_proc(&stream, &p))
+		n++;
+
+	stream_dinit(&stream);
+	return n;
+}
+
+void
+bench(const char *name, size_t (*reader)(FILE *), FILE *fp, size_t lines)
+{
+	fseek(fp, 0, SEEK_END);
+	double mb = ftell(fp) / 1e6;
+
+	double best = 1e9;
+
+	for (int r = 0; r < RUNS; ++r) {
+		rewind(fp);
+
+		double t = now();
+		size_t n = reader(fp);
+		t = now() - t;
+
+		if (n != lines) {
+			fprintf(stderr, "%s: %zu lines read instead of %zu\n", name, n, lines);
+			exit(EXIT_FAILURE);
+		}
+
+		if (t < best)
+			best = t;
+	}
+
+	printf("{\"benchmark\":\"stream\",\"reader\":\"%s\",\"lines\":%zu,"
+			"\"runs\":%d,\"min_s\":%.6f,\"mb_per_s\":%.1f}\n",
+			name, lines, RUNS, best, mb / best);
+	fflush(stdout);
+}
+
+int main(int argc, const char *argv[])
+{
+	size_t lines = argc > 1 ? strtoul(argv[1], NULL, 10) : LINES;
+
+	pnode_t *processes = calloc(lines, sizeof(pnode_t));
+	FILE *fp = tmpfile();
+	if (!processes || !fp) {
+		perror("bench_stream");
+		return EXIT_FAILURE;
+	}
+
+	gen_tree(GEN_REALISTIC, lines, 1, processes);
+	gen_write_stream(fp, processes, lines);
+	free(processes);
+
+	bench("fscanf", read_legacy, fp, lines);
+	bench("buffered", read_buffered, fp, lines);
+
+	fclose(fp);
+
+	return 0;
+}
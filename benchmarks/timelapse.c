@@ -0,0 +1,140 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <limits.h>
+#include <unistd.h>
+
+#include "cfg.h"
+#include "procs.h"
+#include "delta.h"
+#include "pipeline.h"
+#include "generators.h"
+
+// Times drawing a recording with --frames on 1, 2, 4... threads up to the
+// number of CPUs. Prints one JSON object per line:
+// {"benchmark":"timelapse","nodes":2000,"frames":120,"jobs":4,
+//  "fps":...,"fps_per_core":...}
+//
+// Usage: bench_timelapse [nodes] [frames]
+
+#define NODES 2000
+#define FRAMES 120
+
+double
+now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void
+record(const char *path, size_t n, size_t frames)
+{
+	pnode_t *processes = calloc(n, sizeof(pnode_t));
+	if (!processes) {
+		perror("calloc");
+		exit(EXIT_FAILURE);
+	}
+
+	gen_tree(GEN_REALISTIC, n, 1, processes);
+
+	procs_t procs = {0};
+	procs_alloc(&procs, n + 1);
+	for (size_t i = 0; i < n; ++i)
+		memcpy(procs_add(&procs), processes + i, sizeof(pnode_t));
+
+	FILE *fp = fopen(path, "wb");
+	if (!fp) {
+		perror(path);
+		exit(EXIT_FAILURE);
+	}
+
+	delta_writer_t writer;
+	delta_writer_init(&writer, fp, PSC_KEYFRAME_INTERVAL);
+
+	int next_pid = n + 1;
+	for (size_t f = 0; f < frames; ++f) {
+		gen_churn(procs.processes + 1, n, f, &next_pid);
+
+		if (!delta_writer_add(&writer, &procs)) {
+			perror(path);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	delta_writer_finish(&writer);
+	delta_writer_dinit(&writer);
+	fclose(fp);
+
+	procs_dinit(&procs);
+	free(processes);
+}
+
+void
+bench(const char *dir, size_t n, size_t frames, size_t jobs, size_t ncpu)
+{
+	char output[PATH_MAX];
+	snprintf(output, sizeof(output), "%s/%%05d.png", dir);
+
+	config.output = output;
+	config.jobs = jobs;
+
+	double t0 = now();
+	pipeline_timelapse();
+	double t = now() - t0;
+
+	double fps = frames / t;
+	size_t cores = jobs < ncpu ? jobs : ncpu;
+
+	printf("{\"benchmark\":\"timelapse\",\"nodes\":%zu,\"frames\":%zu,"
+			"\"jobs\":%zu,\"fps\":%.2f,\"fps_per_core\":%.2f}\n",
+			n, frames, jobs, fps, fps / cores);
+	fflush(stdout);
+
+	char path[PATH_MAX];
+	for (size_t f = 0; f < frames; ++f) {
+		snprintf(path, sizeof(path), output, (int) f);
+		unlink(path);
+	}
+}
+
+int main(int argc, const char *argv[])
+{
+	size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : NODES;
+	size_t frames = argc > 2 ? strtoul(argv[2], NULL, 10) : FRAMES;
+
+	char dir[] = "/tmp/pscircle-timelapse-XXXXXX";
+	if (!mkdtemp(dir)) {
+		perror("mkdtemp");
+		return EXIT_FAILURE;
+	}
+
+	char path[PATH_MAX];
+	snprintf(path, sizeof(path), "%s/recording.pscs", dir);
+
+	record(path, n, frames);
+
+	config.replay = path;
+	config.frames = "0-";
+
+	long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+	if (ncpu < 1)
+		ncpu = 1;
+
+	for (size_t jobs = 1; ; jobs *= 2) {
+		if (jobs > (size_t) ncpu)
+			jobs = ncpu;
+
+		bench(dir, n, frames, jobs, ncpu);
+
+		if (jobs == (size_t) ncpu)
+			break;
+	}
+
+	unlink(path);
+	rmdir(dir);
+
+	return 0;
+}
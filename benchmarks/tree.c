@@ -0,0 +1,169 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "cfg.h"
+#include "procs.h"
+#include "painter.h"
+#include "tree_visualizer.h"
+#include "generators.h"
+
+// Prints one JSON object per line:
+// {"benchmark":"tree","shape":"wide","nodes":1000,"stage":"link","runs":5,
+//  "min_s":...,"median_s":...}
+//
+// Usage: bench_tree [max nodes] [shape]
+
+#define MAX_NODES 1000000
+#define MAX_RUNS 5
+
+typedef enum {
+	STAGE_LINK = 0,
+	STAGE_REORDER,
+	STAGE_ARRANGE,
+	STAGE_DRAW_TREE,
+	STAGE_WRITE_PNG,
+	NSTAGES
+} stage_t;
+
+static const char *stage_names[NSTAGES] = {
+	"link",
+	"reorder",
+	"arrange",
+	"draw_tree",
+	"write_png",
+};
+
+double
+now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int
+double_comp(const void *a, const void *b)
+{
+	double da = *(const double *) a;
+	double db = *(const double *) b;
+	return (da > db) - (da < db);
+}
+
+void
+report(gen_shape_t shape, size_t n, stage_t stage, double *t, size_t runs)
+{
+	qsort(t, runs, sizeof(double), double_comp);
+
+	printf("{\"benchmark\":\"tree\",\"shape\":\"%s\",\"nodes\":%zu,"
+			"\"stage\":\"%s\",\"runs\":%zu,\"min_s\":%.6f,\"median_s\":%.6f}\n",
+			gen_shape_name(shape), n, stage_names[stage], runs, t[0], t[runs / 2]);
+	fflush(stdout);
+}
+
+void
+load(procs_t *procs, const pnode_t *processes, size_t n)
+{
+	procs_dinit(procs);
+	memset(procs, 0, sizeof(procs_t));
+
+	procs_alloc(procs, n + 1);
+
+	for (size_t i = 0; i < n; ++i) {
+		pnode_t *p = procs_add(procs);
+		memcpy(p, processes + i, sizeof(pnode_t));
+	}
+}
+
+void
+bench(psc_ctx_t *ctx, painter_t *painter, gen_shape_t shape, size_t n)
+{
+	pnode_t *processes = calloc(n, sizeof(pnode_t));
+	procs_t *procs = calloc(1, sizeof(procs_t));
+	if (!processes || !procs) {
+		perror("calloc");
+		exit(EXIT_FAILURE);
+	}
+
+	gen_tree(shape, n, 1, processes);
+
+	size_t runs = n >= 100000 ? 1 : MAX_RUNS;
+	double t[NSTAGES][MAX_RUNS];
+
+	for (size_t r = 0; r < runs; ++r) {
+		load(procs, processes, n);
+
+		double t0 = now();
+		procs_link(ctx, procs);
+		double t1 = now();
+		node_reorder_by_leaves((node_t *) procs->root);
+		double t2 = now();
+		node_arrange((node_t *) procs->root);
+		double t3 = now();
+		painter_clear(painter);
+		draw_tree(ctx, painter, procs);
+		double t4 = now();
+		painter_write(painter);
+		double t5 = now();
+
+		t[STAGE_LINK][r] = t1 - t0;
+		t[STAGE_REORDER][r] = t2 - t1;
+		t[STAGE_ARRANGE][r] = t3 - t2;
+		t[STAGE_DRAW_TREE][r] = t4 - t3;
+		t[STAGE_WRITE_PNG][r] = t5 - t4;
+	}
+
+	for (size_t s = 0; s < NSTAGES; ++s)
+		report(shape, n, s, t[s], runs);
+
+	procs_dinit(procs);
+	free(procs);
+	free(processes);
+}
+
+int main(int argc, const char *argv[])
+{
+	size_t max_nodes = argc > 1 ? strtoul(argv[1], NULL, 10) : MAX_NODES;
+
+	gen_shape_t only = GEN_NSHAPES;
+	if (argc > 2 && !gen_shape_from_str(argv[2], &only)) {
+		fprintf(stderr, "Unknown shape: %s\n", argv[2]);
+		return EXIT_FAILURE;
+	}
+
+	char path[] = "/tmp/pscircle-bench-XXXXXX.png";
+	int fd = mkstemps(path, 4);
+	if (fd < 0) {
+		perror(path);
+		return EXIT_FAILURE;
+	}
+	close(fd);
+
+	config.output = path;
+	config.output_format = ENCODER_PNG;
+	config.background_image = NULL;
+
+	psc_ctx_t ctx;
+	psc_ctx_init(&ctx, &config);
+
+	painter_t *painter = calloc(1, sizeof(painter_t));
+	painter_init(&ctx, painter);
+
+	for (size_t s = 0; s < GEN_NSHAPES; ++s) {
+		if (only != GEN_NSHAPES && s != only)
+			continue;
+
+		for (size_t n = 1000; n <= max_nodes; n *= 10)
+			bench(&ctx, painter, s, n);
+	}
+
+	painter_dinit(painter);
+	free(painter);
+	psc_ctx_dinit(&ctx);
+	remove(path);
+
+	return 0;
+}
@@ -0,0 +1,152 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "cfg.h"
+#include "procs.h"
+#include "painter.h"
+#include "pipeline.h"
+#include "proc_stream.h"
+#include "generators.h"
+
+// Times --loop frames of an idle system, of one where memory usage drifts
+// by a few pages, and of a busy one, with --skip-unchanged. Frames which
+// look the same are compared and not drawn. Prints one JSON object per
+// line:
+// {"benchmark":"unchanged","nodes":500,"load":"idle","frames":20,
+//  "skipped":19,"compare_ms":...,"frame_ms":...}
+//
+// Usage: bench_unchanged [nodes]
+
+#define NODES 500
+#define FRAMES 20
+
+typedef enum {
+	LOAD_IDLE = 0,
+	LOAD_DRIFT,
+	LOAD_BUSY,
+	LOAD_N
+} load_t;
+
+static const char *load_names[LOAD_N] = {"idle", "drift", "busy"};
+
+double
+now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Processes are not replaced as in gen_churn, which leaves their
+// children out of the tree
+void
+change(pnode_t *processes, size_t n, load_t load, uint64_t seed)
+{
+	if (load == LOAD_DRIFT) {
+		for (size_t i = seed % 7; i < n; i += 7)
+			processes[i].mem += (seed & 1) ? 4096 : -4096;
+	} else if (load == LOAD_BUSY) {
+		for (size_t i = seed % 5; i < n; i += 5)
+			processes[i].cpu = (i * 7 + seed * 13) % 1000 / 10.;
+	}
+}
+
+void
+bench(pipeline_output_t *output, size_t n, load_t load)
+{
+	pnode_t *processes = calloc(n, sizeof(pnode_t));
+	if (!processes) {
+		perror("calloc");
+		exit(EXIT_FAILURE);
+	}
+
+	gen_tree(GEN_REALISTIC, n, 1, processes);
+
+	size_t skipped = 0;
+	double compare = 0;
+	double total = 0;
+
+	output->drawn = false;
+
+	for (size_t f = 0; f < FRAMES; ++f) {
+		if (f > 0)
+			change(processes, n, load, f);
+
+		FILE *fp = tmpfile();
+		gen_write_stream(fp, processes, n);
+		rewind(fp);
+
+		in_stream_t stream;
+		stream_init(&stream, fp);
+
+		procs_io_t io = {
+			.stream = &stream,
+		};
+
+		procs_t procs = {0};
+		pipeline_collect(&output->ctx, &procs, &io);
+
+		stream_dinit(&stream);
+		fclose(fp);
+
+		double t0 = now();
+		bool unchanged = pipeline_unchanged(output, &procs);
+		double t1 = now();
+
+		if (unchanged) {
+			skipped++;
+		} else {
+			pipeline_render(&output->ctx, &output->painter, &procs);
+			painter_write(&output->painter);
+		}
+
+		double t2 = now();
+
+		compare += t1 - t0;
+		total += t2 - t0;
+
+		procs_dinit(&procs);
+	}
+
+	printf("{\"benchmark\":\"unchanged\",\"nodes\":%zu,\"load\":\"%s\","
+			"\"frames\":%d,\"skipped\":%zu,\"compare_ms\":%.3f,\"frame_ms\":%.3f}\n",
+			n, load_names[load], FRAMES, skipped,
+			compare / FRAMES * 1e3, total / FRAMES * 1e3);
+	fflush(stdout);
+
+	free(processes);
+}
+
+int main(int argc, const char *argv[])
+{
+	size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : NODES;
+
+	char output[] = "/tmp/pscircle-unchanged-XXXXXX.png";
+	int fd = mkstemps(output, 4);
+	if (fd < 0) {
+		perror("mkstemps");
+		return EXIT_FAILURE;
+	}
+	close(fd);
+
+	config.output = output;
+	config.output_format = ENCODER_PNG;
+	config.background_image = NULL;
+	config.root_pid = 1;
+	config.loop = true;
+	config.skip_unchanged = true;
+
+	size_t noutputs;
+	pipeline_output_t *outputs = pipeline_outputs_init(&noutputs);
+
+	for (load_t load = 0; load < LOAD_N; ++load)
+		bench(outputs, n, load);
+
+	pipeline_outputs_dinit(outputs, noutputs);
+
+	remove(output);
+
+	return 0;
+}
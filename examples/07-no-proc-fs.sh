@@ -1,5 +1,10 @@
 #!/bin/bash
 
+# Usage: 07-no-proc-fs.sh [--loop]
+#
+# With --loop, a new frame is sent to the same pscircle process every
+# second. Frames are separated by empty lines.
+
 set -e
 
 lmem=$(free -h | awk '/^Mem/ {print $3" / "$2}')
@@ -15,9 +20,26 @@ else
 	pcpu=0.42
 fi
 
-ps -e -o pid,ppid,pcpu,rss,comm --no-headers | pscircle \
+frames() {
+	while true; do
+		ps -e -o pid,ppid,pcpu,rss,comm --no-headers
+		echo
+		sleep 1
+	done
+}
+
+if [ "$1" = "--loop" ]; then
+	input=frames
+	loop=true
+else
+	input="ps -e -o pid,ppid,pcpu,rss,comm --no-headers"
+	loop=false
+fi
+
+$input | pscircle \
 	--stdin=true \
+	--loop=$loop \
 	--memlist-bar-value="$pmem" \
 	--memlist-label="$lmem" \
 	--cpulist-bar-value="$pcpu" \
-	--cpulist-label="$lcpu" 
+	--cpulist-label="$lcpu"
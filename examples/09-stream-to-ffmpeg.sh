@@ -0,0 +1,11 @@
+#!/bin/bash
+
+set -e
+
+width=1920
+height=1080
+
+pscircle --output=- --output-format=bgra --loop=true --interval=1 \
+	--output-width=$width --output-height=$height |
+	ffmpeg -f rawvideo -pixel_format bgra -video_size ${width}x${height} \
+	-framerate 1 -skip_initial_bytes 16 -i - -c:v libx264 pscircle.mp4
@@ -27,6 +27,8 @@ typedef struct {
 typedef struct {
 	arg_t args[PSC_MAX_ARGS];
 	size_t nargs;
+	// Printed by --help before the options, the one of pscircle if NULL
+	const char *usage;
 } argparser_t;
 
 void
@@ -38,6 +40,11 @@ argparser_add(argparser_t *argparser, arg_t opt);
 void
 argparser_parse(argparser_t *argparser, int argc, char const * argv[]);
 
+// Parses one --key=value argument. Unlike argparser_parse, it returns
+// false for unknown keys and invalid values instead of exiting.
+bool
+argparser_set(argparser_t *argparser, const char *arg);
+
 bool
 parser_bool(const char *value, void *output);
 
@@ -64,3 +71,18 @@ parser_memory(const char *value, void *output);
 
 bool
 parser_memory_unit(const char *value, void *output);
+
+bool
+parser_output_format(const char *value, void *output);
+
+bool
+parser_png_filter(const char *value, void *output);
+
+// zlib compression level, 0-9
+bool
+parser_png_compression(const char *value, void *output);
+
+// Number of threads, e.g. --jobs, 0 for one per CPU. Negative numbers are
+// rejected.
+bool
+parser_threads(const char *value, void *output);
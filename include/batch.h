@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "encoder.h"
+
+// Draws an image of every file in --batch-input, each holding the processes
+// of one host in --stdin format, into --batch-output on --jobs threads.
+// Hidden files and subdirectories are skipped. Returns false if some files
+// could not be read or have no processes; the other ones are drawn anyway.
+bool
+batch_run();
+
+// Writes "dir/name.ext" to buf, with the extension of format. Returns false
+// if it does not fit.
+bool
+batch_output_path(char *buf, size_t size, const char *dir, const char *name,
+		encoder_format_t format);
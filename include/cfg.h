@@ -6,6 +6,8 @@
 #include "types.h"
 #include "color.h"
 #include "point.h"
+#include "encoder.h"
+#include "argparser.h"
 
 typedef struct {
 	const char *font_face;
@@ -71,15 +73,36 @@ typedef struct {
 
 typedef struct {
 	bool read_stdin;
+	const char *procfs_root;
+	const char *record;
+	const char *replay;
+	const char *hosts;
+	const char *at;
+	const char *frames;
+	long jobs;
+	const char *batch_input;
+	const char *batch_output;
 	real_t interval;
+	bool loop;
+	bool skip_unchanged;
+	bool profile;
+	const char *trace;
+	const char *metrics_file;
+	const char *control;
 
 	const char *output;
 	const char *output_display;
+	const char *outputs;
+	encoder_format_t output_format;
+	long png_compression;
+	encoder_filter_t png_filter;
+	long png_threads;
 	size_t output_width;
 	size_t output_height;
 
 	pid_t root_pid;
 	nnodes_t max_children;
+	size_t max_nodes;
 	memunit_t memory_unit;
 
 	size_t max_mem;
@@ -97,9 +120,16 @@ typedef struct {
 
 } cfg_t;
 
+// Set by parse_cmdline and check_config and read-only afterwards, threads
+// read it without locking. Options changed by --control are applied to
+// copies (see control_apply).
 extern cfg_t config;
 
 
 void
 parse_cmdline(int argc, char const * argv[]);
 
+// Adds the command line options which are parsed into cfg
+void
+cfg_args(argparser_t *argp, cfg_t *cfg);
+
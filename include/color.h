@@ -17,3 +17,8 @@ color_between(color_t a, color_t b, real_t k);
 
 char *
 color_to_hex(color_t col);
+
+// Packs the color into 8 bits per channel as it is stored in the image, so
+// that colors which look the same compare equal
+uint32_t
+color_pack(color_t col);
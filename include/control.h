@@ -0,0 +1,99 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "cfg.h"
+#include "ctx.h"
+#include "procs.h"
+
+// Control socket of a running pscircle (see --control). A client sends one
+// command per line and gets one line back for each, starting with "ok" or
+// "error:":
+//
+//   --key=value         sets an option from the next frame on. Options
+//                       which are set up once (the input, the output file,
+//                       its size and format...) are rejected.
+//   render-now          collects and draws a frame without waiting for the
+//                       rest of --interval
+//   stats               "ok frames=... skipped=... processes=... render_ms=..."
+//   dump-snapshot PATH  writes the processes of a frame collected at once
+//                       to PATH as a snapshot (see snapshot.h)
+//
+// Clients are served on a thread of their own one at a time, the pipeline
+// only picks up the changes between the frames.
+typedef struct {
+	char **items;
+	size_t n;
+	size_t capacity;
+} control_list_t;
+
+typedef struct control_t {
+	char *path;
+	int fd;
+	// Written to by control_dinit to stop the thread
+	int stop[2];
+	pthread_t thread;
+
+	// Woken by render-now and dump-snapshot
+	psc_ctx_t *ctx;
+	// Configuration of the command line with the options set since,
+	// which new options are checked against
+	cfg_t current;
+
+	pthread_mutex_t mutex;
+	pthread_cond_t dumped;
+
+	// --key=value arguments which are not applied yet, of the input and
+	// of the processes (shared) and of the outputs. They point into
+	// strings, which keeps every argument as the options point into them.
+	control_list_t shared;
+	control_list_t output;
+	control_list_t strings;
+
+	// Set by dump-snapshot until the next frame is collected
+	char *dump_path;
+	int dump_errno;
+	bool dump_done;
+
+	struct timespec start;
+	size_t nframes;
+	// Frames not drawn as they looked the same (see pipeline_unchanged)
+	size_t nskipped;
+	size_t nprocesses;
+	double render_seconds;
+	size_t noptions;
+} control_t;
+
+// Creates the socket at path, replacing a socket left by a previous run,
+// and starts serving it. Returns false with errno set on failure.
+bool
+control_init(control_t *control, const char *path, psc_ctx_t *ctx);
+
+// Stops serving and removes the socket
+void
+control_dinit(control_t *control);
+
+// Applies the options received since the previous call to every one of
+// cfgs: the options of the input and of the processes if shared (see
+// pipeline_output_option), the ones of the outputs otherwise. A cfg whose
+// minimum and maximum values would cross, e.g. an output of --outputs
+// with its own, is left as it was.
+void
+control_apply(control_t *control, cfg_t **cfgs, size_t ncfgs, bool shared);
+
+// Called once the processes of a frame are read, before they are linked
+void
+control_collected(control_t *control, const procs_t *procs);
+
+// Called once a frame is drawn and written in 'seconds', or skipped
+void
+control_rendered(control_t *control, const procs_t *procs, double seconds,
+		bool skipped);
+
+// Handles one command and writes the reply (without a newline) to reply,
+// of size bytes
+void
+control_execute(control_t *control, char *command, char *reply, size_t size);
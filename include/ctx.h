@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "cfg.h"
+
+// Everything collecting and drawing a frame depends on besides the input.
+// The core reads the options only from here, so that independent contexts
+// can be used on different threads at the same time.
+typedef struct {
+	const cfg_t *config;
+
+	// Line buffer of the /proc reader, kept between the frames
+	char *line;
+	size_t linesize;
+
+	// Cuts psc_ctx_sleep short (see psc_ctx_wake)
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	bool woken;
+} psc_ctx_t;
+
+void
+psc_ctx_init(psc_ctx_t *ctx, const cfg_t *config);
+
+void
+psc_ctx_dinit(psc_ctx_t *ctx);
+
+// Waits for the next frame. Returns true if the wait was cut short by
+// psc_ctx_wake.
+bool
+psc_ctx_sleep(psc_ctx_t *ctx, double seconds);
+
+// Wakes psc_ctx_sleep on another thread, or makes the next one return at
+// once, e.g. to draw a frame on render-now of --control
+void
+psc_ctx_wake(psc_ctx_t *ctx);
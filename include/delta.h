@@ -0,0 +1,209 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "procs.h"
+#include "snapshot.h"
+
+// "PSCD", "PSCI" and "PSCX" in little-endian
+#define DELTA_MAGIC 0x44435350
+#define DELTA_INDEX_MAGIC 0x49435350
+#define DELTA_TRAILER_MAGIC 0x58435350
+#define DELTA_VERSION 1
+
+// A recording is a sequence of frames, each padded to 8 bytes. Every
+// PSC_KEYFRAME_INTERVAL-th frame (and the first one) is a keyframe, which
+// is a snapshot (see snapshot.h). The frames in between start with this
+// header and contain the changes since the previous frame as LEB128
+// varints (signed values are zigzag-encoded):
+//
+//   labels changed (0/1)
+//     [cpu label length, bytes, mem label length, bytes]
+//   number of exited processes
+//     pid (difference with the previous pid in the list)...
+//   number of spawned processes
+//     pid (difference), ppid, cpu (bits of the float), mem, name length,
+//     name bytes...
+//   number of changed processes
+//     pid (difference), mask of changed fields (DELTA_*),
+//     [ppid] [cpu bits] [mem difference] [name length, name bytes]...
+//
+// Processes are identified by pid, all lists are sorted by it.
+//
+// Recordings are only appended to. Every frame is followed by a trailer,
+// so the file ends with one even if the capture was killed. Before every
+// keyframe, an index block with the frames since the previous block is
+// written; delta_writer_finish writes a last block with all of them. The
+// trailer points to the latest block and each block to the previous one,
+// so the frames are found without reading the whole recording.
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	// Of the whole frame, including the header and the padding
+	uint64_t size;
+	// CLOCK_REALTIME in nanoseconds
+	int64_t time;
+	double cpu_value;
+	double mem_value;
+} delta_header_t;
+
+enum {
+	DELTA_PPID = 1 << 0,
+	DELTA_CPU  = 1 << 1,
+	DELTA_MEM  = 1 << 2,
+	DELTA_NAME = 1 << 3,
+};
+
+enum {
+	DELTA_KEYFRAME = 1 << 0,
+};
+
+typedef struct {
+	// Of the capture, CLOCK_REALTIME in nanoseconds
+	int64_t time;
+	// Of the frame from the start of the recording
+	uint64_t offset;
+	uint32_t flags;
+	uint32_t reserved;
+} delta_index_entry_t;
+
+// Followed by nentries entries sorted by time
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t size;
+	// Of the previous index block, 0 if this one has all the frames
+	uint64_t prev;
+	uint64_t nentries;
+} delta_index_header_t;
+
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	// Of the latest index block, 0 if none is written yet
+	uint64_t index;
+} delta_trailer_t;
+
+typedef struct {
+	delta_index_entry_t *entries;
+	size_t nentries;
+	size_t capacity;
+} delta_index_t;
+
+typedef struct {
+	int32_t pid;
+	int32_t ppid;
+	float cpu;
+	uint64_t mem;
+	char name[PSC_MAX_NAME_LENGHT];
+} delta_proc_t;
+
+// Processes of a frame sorted by pid, without duplicates
+typedef struct {
+	delta_proc_t *procs;
+	size_t nprocs;
+	size_t capacity;
+
+	int64_t time;
+	double cpu_value;
+	double mem_value;
+	char cpu_label[PSC_LABEL_BUFSIZE + 1];
+	char mem_label[PSC_LABEL_BUFSIZE + 1];
+} delta_state_t;
+
+typedef struct delta_writer_t {
+	FILE *fp;
+	size_t keyframe_interval;
+	size_t nframes;
+
+	delta_state_t prev;
+	delta_state_t next;
+
+	// Bytes written so far
+	uint64_t offset;
+	delta_index_t index;
+	// Entries written to the index blocks
+	size_t nindexed;
+	uint64_t last_index;
+
+	uint8_t *buf;
+	size_t bufsize;
+	size_t buflen;
+} delta_writer_t;
+
+typedef struct delta_reader_t {
+	const uint8_t *data;
+	size_t size;
+	// Of the next frame
+	size_t offset;
+	size_t nframes;
+
+	delta_state_t state;
+	delta_state_t scratch;
+
+	// Loaded by delta_reader_index
+	delta_index_t index;
+	bool indexed;
+
+	bool mapped;
+} delta_reader_t;
+
+void
+delta_writer_init(delta_writer_t *writer, FILE *fp, size_t keyframe_interval);
+
+// Appends the processes read by procs_init (before they are linked)
+bool
+delta_writer_add(delta_writer_t *writer, const procs_t *procs);
+
+// Writes the index of all frames, the recording stays seekable without it
+bool
+delta_writer_finish(delta_writer_t *writer);
+
+// Does not close the file
+void
+delta_writer_dinit(delta_writer_t *writer);
+
+bool
+delta_reader_open(delta_reader_t *reader, const char *path);
+
+// Reads a recording of 'size' bytes at data, which must stay valid
+void
+delta_reader_init(delta_reader_t *reader, const void *data, size_t size);
+
+void
+delta_reader_close(delta_reader_t *reader);
+
+// Applies the next frame. Returns false at the end of the recording or
+// if the frame is corrupted (errno is EINVAL then).
+bool
+delta_reader_next(delta_reader_t *reader);
+
+// Reads the index blocks and the frames after the latest one. Returns false
+// if the recording has no frames.
+bool
+delta_reader_index(delta_reader_t *reader);
+
+// Positions the reader so that delta_reader_next applies the last frame
+// captured at or before time (in nanoseconds). Only the frames since the
+// preceding keyframe are decoded. Fails with ERANGE if time is before the
+// first frame.
+bool
+delta_reader_seek(delta_reader_t *reader, int64_t time);
+
+// Same as delta_reader_seek for the n-th frame (counting from 0) of the
+// recording
+bool
+delta_reader_seek_frame(delta_reader_t *reader, size_t n);
+
+// Parses a --at time: seconds since the epoch, "YYYY-MM-DD HH:MM[:SS]" or
+// "HH:MM[:SS]" in local time. The latter is the first such time at or
+// after start (in nanoseconds, e.g. of the first recorded frame).
+bool
+delta_parse_time(const char *str, int64_t start, int64_t *time);
+
+// Adds the processes of the current frame to procs (see procs_add)
+void
+delta_reader_load(const delta_reader_t *reader, procs_t *procs);
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef enum {
+	ENCODER_AUTO = 0,
+	ENCODER_PNG,
+	ENCODER_QOI,
+	ENCODER_PPM,
+	ENCODER_PAM,
+	ENCODER_BMP,
+	ENCODER_BGRA,
+	ENCODER_RGB24,
+} encoder_format_t;
+
+typedef enum {
+	ENCODER_FILTER_NONE  = 1 << 0,
+	ENCODER_FILTER_SUB   = 1 << 1,
+	ENCODER_FILTER_UP    = 1 << 2,
+	ENCODER_FILTER_AVG   = 1 << 3,
+	ENCODER_FILTER_PAETH = 1 << 4,
+	ENCODER_FILTER_ALL   = (1 << 5) - 1,
+} encoder_filter_t;
+
+// Pixels in cairo's CAIRO_FORMAT_ARGB32 layout: native-endian 32-bit words
+// with premultiplied alpha.
+typedef struct {
+	const uint8_t *data;
+	size_t width;
+	size_t height;
+	size_t stride;
+} image_t;
+
+typedef struct {
+	encoder_format_t format;
+	int png_compression;
+	encoder_filter_t png_filter;
+	// Number of threads deflating PNG stripes, 0 means one per CPU
+	int png_threads;
+} encoder_opts_t;
+
+bool
+encoder_write(FILE *fp, const image_t *img, const encoder_opts_t *opts);
+
+// Raw formats (bgra, rgb24) are written without any per-frame header.
+// This 16 byte header starts a stream of raw frames: "PSCF", width and
+// height as 32-bit little-endian integers and "BGRA" or "RGB3".
+bool
+encoder_write_stream_header(FILE *fp, const image_t *img, encoder_format_t format);
+
+bool
+encoder_is_raw(encoder_format_t format);
+
+encoder_format_t
+encoder_format_from_path(const char *path);
+
+bool
+encoder_format_from_str(const char *str, encoder_format_t *format);
+
+// Name of the format, which is also the extension of its files. Auto is
+// png.
+const char *
+encoder_format_name(encoder_format_t format);
+
+bool
+encoder_png_filter_from_str(const char *str, encoder_filter_t *filter);
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Files with the processes of one host each, in --stdin format (see
+// --hosts and --batch-input). Labels are the names of the files.
+typedef struct hosts_t {
+	char **paths;
+	char **labels;
+	size_t n;
+	size_t capacity;
+} hosts_t;
+
+void
+hosts_init(hosts_t *hosts);
+
+void
+hosts_dinit(hosts_t *hosts);
+
+// Adds a file, or every file of a directory except the hidden ones and the
+// subdirectories. Returns false with errno set if path can not be read.
+bool
+hosts_add(hosts_t *hosts, const char *path);
+
+// Adds every path of a comma separated list. On failure, the path which
+// can not be read is copied to failed (of size bytes).
+bool
+hosts_add_list(hosts_t *hosts, const char *list, char *failed, size_t size);
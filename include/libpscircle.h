@@ -0,0 +1,92 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <cairo.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Renders process trees inside the calling process:
+//
+//   psc_t *psc = NULL;
+//   psc_create(&psc);
+//   psc_set_option(psc, "--max-children=20");
+//
+//   // every frame
+//   psc_collect(psc);
+//   psc_layout(psc);
+//   psc_render(psc, pixels, width, height, stride);
+//
+//   psc_destroy(psc);
+//
+// A psc_t keeps the options, the last snapshot and the caches of the
+// painter (fonts, text extents, the background image), so it is meant to
+// live as long as the frames are drawn. A psc_t is used by one thread at a
+// time; distinct ones are independent and may be used concurrently.
+//
+// Functions return PSC_OK or an error code and never exit. Allocation
+// failures abort.
+
+#define PSC_API __attribute__((visibility("default")))
+
+typedef enum {
+	PSC_OK = 0,
+	// An invalid argument, option or pixel buffer
+	PSC_EINVAL,
+	// --procfs-root or the --background-image can not be read
+	PSC_EIO,
+	// There are no processes in the input
+	PSC_ENODATA,
+	// Called out of order, e.g. psc_render before psc_layout
+	PSC_ESTATE,
+} psc_status_t;
+
+typedef struct psc_t psc_t;
+
+PSC_API const char *
+psc_strerror(psc_status_t status);
+
+// Creates a context with the default options
+PSC_API psc_status_t
+psc_create(psc_t **psc);
+
+PSC_API void
+psc_destroy(psc_t *psc);
+
+// Sets an option in the form of the command line, e.g. "--max-cpu=50".
+// Options of the input and of the output (--stdin, --replay, --output,
+// --output-width...) have no effect. Options of the collection apply from
+// the next psc_collect or psc_feed.
+PSC_API psc_status_t
+psc_set_option(psc_t *psc, const char *arg);
+
+// Reads the processes from --procfs-root (/proc). CPU usage is sampled
+// over --interval seconds, which this call blocks for.
+PSC_API psc_status_t
+psc_collect(psc_t *psc);
+
+// Reads the processes from size bytes at data: either the output of
+// `ps -e -o pid,ppid,pcpu,rss,comm --no-headers` (see --stdin) or a
+// binary snapshot (see --record).
+PSC_API psc_status_t
+psc_feed(psc_t *psc, const void *data, size_t size);
+
+// Arranges the tree of the last collected or fed processes
+PSC_API psc_status_t
+psc_layout(psc_t *psc);
+
+// Draws the arranged tree into the caller's pixels: width x height in
+// cairo's CAIRO_FORMAT_ARGB32 layout, stride bytes per row
+PSC_API psc_status_t
+psc_render(psc_t *psc, uint8_t *pixels, size_t width, size_t height, size_t stride);
+
+// Draws the arranged tree on a cairo image surface
+PSC_API psc_status_t
+psc_render_surface(psc_t *psc, cairo_surface_t *surface);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "procs.h"
+#include "painter.h"
+
+// Everything below does nothing unless --metrics-file is set
+
+// Records process counts of the frame being drawn
+void
+metrics_collected(const procs_t *procs);
+
+// Records the painter's counters once a frame is drawn
+void
+metrics_rendered(const painter_t *painter);
+
+// Rewrites the metrics file once a frame is written
+void
+metrics_written(const painter_t *painter);
+
+// Rewrites the metrics file when a frame is not drawn on any output as it
+// looks the same as the previous one (see --skip-unchanged)
+void
+metrics_unchanged(const painter_t *painter);
@@ -1,10 +1,13 @@
 #pragma once
 
 #include <stddef.h>
+#include <stdbool.h>
 
 #include "types.h"
 #include "point.h"
 #include "color.h"
+#include "shmring.h"
+#include "ctx.h"
 
 #include <cairo.h>
 
@@ -12,13 +15,47 @@
 #include <cairo-xlib.h>
 #endif
 
+#ifdef HAVE_XSHM
+#include <X11/extensions/XShm.h>
+#endif
+
 typedef struct {
+	char str[PSC_LABEL_BUFSIZE];
+	const char *font_face;
+	real_t font_size;
+	point_t size;
+} text_cache_entry_t;
+
+typedef struct {
+	const cfg_t *_config;
 	cairo_t *_cr;
 	cairo_surface_t *_surface;
+	cairo_surface_t *_background;
+	// Second buffer of painter_swap
+	cairo_surface_t *_back;
+	size_t _nframes;
+	size_t _nprimitives;
+	// Process names repeat from frame to frame, so their extents are cached
+	text_cache_entry_t *_text_cache;
+	size_t _text_cache_hits;
+	size_t _text_cache_lookups;
+	// Size of the last written image, if it's known
+	size_t _output_bytes;
+	const char *_font_face;
+	real_t _font_size;
+	shmring_t *_ring;
 #ifdef HAVE_X11
 	Display *_display;
 	Window _window;
-	Pixmap _pixmap;
+	// Frames are uploaded to the pixmaps in turns; the second one is
+	// only used when the frame is rendered into _image
+	Pixmap _pixmaps[2];
+	GC _gc;
+	XImage *_image;
+	Atom _rootpmap_atoms[2];
+#endif
+#ifdef HAVE_XSHM
+	XShmSegmentInfo _shminfo;
 #endif
 } painter_t;
 
@@ -54,11 +91,31 @@ typedef struct {
 } text_t;
 
 void
-painter_init(painter_t *painter);
+painter_init(const psc_ctx_t *ctx, painter_t *painter);
+
+// Draws on the caller's image surface instead of the --output. The painter
+// holds a reference to it until it is replaced or the painter is
+// destroyed. The surface must be of --output-width x --output-height.
+void
+painter_init_surface(const psc_ctx_t *ctx, painter_t *painter, cairo_surface_t *surface);
+
+// Continues drawing on another surface of a painter_init_surface painter,
+// keeping the caches
+void
+painter_set_surface(painter_t *painter, cairo_surface_t *surface);
+
+// Draws image as the --background-image instead of loading the file, so
+// that painters on several threads share one decoded copy. The painter
+// holds a reference to it.
+void
+painter_set_background(painter_t *painter, cairo_surface_t *image);
 
 void
 painter_dinit(painter_t *painter);
 
+void
+painter_clear(painter_t *painter);
+
 void
 painter_save(painter_t *painter);
 
@@ -68,6 +125,23 @@ painter_restore(painter_t *painter);
 void
 painter_write(painter_t *painter);
 
+// Only image outputs (files and stdout) are double buffered
+bool
+painter_can_swap(painter_t *painter);
+
+// Returns the surface with the finished frame and continues drawing on the
+// other buffer. The returned surface is written by painter_write_surface,
+// possibly on another thread, and it is drawn on again after the next swap.
+cairo_surface_t *
+painter_swap(painter_t *painter);
+
+void
+painter_write_surface(painter_t *painter, cairo_surface_t *surface);
+
+// Writes the frame to an image file at path instead of --output
+void
+painter_write_to(painter_t *painter, const char *path);
+
 point_t
 painter_text_size(painter_t *painter, const char *str);
 
@@ -86,6 +160,11 @@ painter_fill_backgound_color(painter_t *painter, color_t background);
 void
 painter_fill_backgound_image(painter_t *painter, const char *imgpath);
 
+// Loads the background image painter_fill_backgound_image draws, returns
+// false if it is not a readable PNG
+bool
+painter_load_background(painter_t *painter, const char *imgpath);
+
 void
 painter_set_font_face(painter_t *painter, const char *fontface);
 
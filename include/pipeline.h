@@ -0,0 +1,94 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "procs.h"
+#include "painter.h"
+#include "cfg.h"
+
+// Reads the processes and arranges the tree
+void
+pipeline_collect(psc_ctx_t *ctx, procs_t *procs, const procs_io_t *io);
+
+// Draws the tree and the toplists
+void
+pipeline_render(const psc_ctx_t *ctx, painter_t *painter, procs_t *procs);
+
+// One of the --outputs: its options and the painter drawing them
+typedef struct {
+	cfg_t config;
+	psc_ctx_t ctx;
+	painter_t painter;
+
+	// Of the last frame drawn, if any (see pipeline_unchanged)
+	uint64_t hash;
+	bool drawn;
+	// The last frame was skipped
+	bool unchanged;
+} pipeline_output_t;
+
+// Creates the --outputs, or a single output with the options of the
+// command line if it's not set. Exits if an output is invalid.
+pipeline_output_t *
+pipeline_outputs_init(size_t *noutputs);
+
+void
+pipeline_outputs_dinit(pipeline_output_t *outputs, size_t noutputs);
+
+// Parses --outputs into one copy of base per output, with the options of
+// the output applied on top. Returns false if an option is unknown,
+// invalid or one of the input (see pipeline_output_option).
+bool
+pipeline_parse_outputs(const char *str, const cfg_t *base, cfg_t **configs, size_t *nconfigs);
+
+// Hashes what pipeline_render would draw with the options of ctx: the
+// options themselves, the shape of the tree, the names, the colors as they
+// are stored in the image and the toplists
+uint64_t
+pipeline_frame_hash(const psc_ctx_t *ctx, const procs_t *procs);
+
+// Checks whether the frame would look the same on the output as the last
+// one drawn on it, so that it can be skipped (see --skip-unchanged).
+// Otherwise the frame is remembered as the last one drawn.
+bool
+pipeline_unchanged(pipeline_output_t *output, const procs_t *procs);
+
+// Checks whether an option (without the dashes) may differ between outputs.
+// Options of the input and of the processes are shared by all of them.
+bool
+pipeline_output_option(const char *name);
+
+// Draws one frame, or keeps drawing them in --loop mode. In --loop mode
+// collecting, rendering and writing run on separate threads, so that a
+// frame is written while the next one is rendered and the one after it
+// is collected. With --stdin, frames are drawn as they arrive until the
+// end of stdin. Each frame is collected and arranged once and drawn on
+// every output; several outputs are drawn and written on a thread each.
+void
+pipeline_run(psc_ctx_t *ctx, pipeline_output_t *outputs, size_t noutputs);
+
+// Draws the --frames of the --replay recording on --jobs threads, each with
+// its own painter. Frames are written to numbered files by the threads that
+// draw them, or to stdout in order with --output=-.
+void
+pipeline_timelapse();
+
+// Returns the number of --jobs threads which draw nitems images, one per
+// CPU if --jobs is 0, and sets cfg to the config they draw with. Images
+// are encoded in parallel, so each is compressed by one thread unless
+// --png-threads is set.
+size_t
+pipeline_jobs(size_t nitems, cfg_t *cfg);
+
+// Checks that a time-lapse --output has one integer conversion for the
+// frame number, e.g. frames/%06d.png
+bool
+pipeline_frame_pattern(const char *pattern);
+
+// Parses --frames: "first-last", "first-" or "n". The last frame is
+// clipped to the number of frames in the recording.
+bool
+pipeline_frame_range(const char *str, size_t nframes, size_t *first, size_t *last);
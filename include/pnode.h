@@ -5,6 +5,7 @@
 
 #include "node.h"
 #include "ppoint.h"
+#include "ctx.h"
 
 typedef struct pnode_t pnode_t;
 
@@ -20,11 +21,14 @@ struct pnode_t {
 	
 	pnode_t *stub;
 	nnodes_t nstubs;
-	ppoint_t position;
+
+	// Pids are unique within a host, counting from 1 (see --hosts). 0 is
+	// the only host otherwise.
+	uint32_t host;
 };
 
 real_t
-pnode_mem_percentage(pnode_t *pnode);
+pnode_mem_percentage(const psc_ctx_t *ctx, const pnode_t *pnode);
 
 real_t
-pnode_cpu_percentage(pnode_t *pnode);
+pnode_cpu_percentage(const psc_ctx_t *ctx, const pnode_t *pnode);
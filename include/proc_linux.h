@@ -1,8 +1,10 @@
 #pragma once
 
 #include <dirent.h>
+#include <stdbool.h>
 
 #include "pnode.h"
+#include "ctx.h"
 
 typedef int pid_t;
 typedef unsigned long ticks_t;
@@ -12,6 +14,8 @@ typedef long rss_t;
 typedef struct {
 	double r;
 	DIR *procdir;
+	// Descriptor of procdir, files are opened relative to it
+	int rootfd;
 	ctime_t cputime_st;
 	ctime_t cputime_en;
 	ctime_t idletime_st;
@@ -19,14 +23,23 @@ typedef struct {
 	long hertz;
 	long uptime;
 	int pagesize;
+	psc_ctx_t *psc;
+	char loadavg[PSC_LABEL_BUFSIZE + 1];
 } linux_procs_t;
 
+// Reads processes from psc->config->procfs_root, which is /proc or a
+// snapshot of it. Lines are read into the buffer of psc.
 void
-linux_init(linux_procs_t *linux_procs);
+linux_init(linux_procs_t *linux_procs, psc_ctx_t *psc);
 
 void
 linux_dinit(linux_procs_t *linux_procs);
 
+// Checks that root and the files linux_init and the statistics are read
+// from can be opened. linux_init exits when they can not.
+bool
+linux_available(const char *root);
+
 pnode_t *
 linux_get_next_proc(linux_procs_t *linux_procs, pnode_t *pnode);
 
@@ -40,7 +53,8 @@ real_t
 linux_cpu_utilization(linux_procs_t *linux_procs);
 
 const char *
-linux_loadavg();
+linux_loadavg(linux_procs_t *linux_procs);
 
 void
-linux_meminfo(unsigned long *mtotal, unsigned long *mused, unsigned long *mfree);
+linux_meminfo(linux_procs_t *linux_procs,
+		unsigned long *mtotal, unsigned long *mused, unsigned long *mfree);
@@ -1,12 +1,47 @@
 #pragma once
 
 #include <stdio.h>
+#include <stdbool.h>
 
 #include "pnode.h"
 
+// Reads `ps -e -o pid,ppid,pcpu,rss,comm --no-headers` output in blocks of
+// up to PSC_STREAM_BUFSIZE bytes. A line which does not fit is read into a
+// larger buffer. Unless the file is in memory, its descriptor is read
+// directly, so bytes already buffered by stdio are not seen.
+//
+// If frames is set, the stream is a sequence of frames separated by empty
+// lines, otherwise empty lines are skipped.
 typedef struct {
 	FILE *procs;
+	int fd;
+	bool frames;
+
+	char *buf;
+	size_t capacity;
+	size_t begin;
+	size_t end;
+	bool eof;
 } in_stream_t;
 
+void
+stream_init(in_stream_t *stream, FILE *procs);
+
+void
+stream_dinit(in_stream_t *stream);
+
+// Puts back the first byte of the input, which was read to detect its
+// format. Must be called before anything is read.
+void
+stream_unget(in_stream_t *stream, char c);
+
+// Skips empty lines and returns true if there is nothing more to read.
+// Blocks until the next frame starts.
+bool
+stream_at_end(in_stream_t *stream);
+
+// Returns NULL at the end of the stream or of the frame. Lines which can
+// not be parsed are skipped. Names are truncated to the first word of at
+// most PSC_MAX_NAME_LENGHT - 1 characters.
 pnode_t *
-stream_get_next_proc(FILE *procs, pnode_t *pnode_t);
+stream_get_next_proc(in_stream_t *stream, pnode_t *pnode);
@@ -9,18 +9,85 @@
 #include "proc_linux.h"
 #include "proc_stream.h"
 
+#include "ctx.h"
+
+struct delta_reader_t;
+struct delta_writer_t;
+struct snapshot_t;
+struct snapshot_stream_t;
+struct hosts_t;
+
+// Inputs and outputs of procs_init which live across frames. Processes
+// are read from replay, snapshot, the current snapshot of snapshots,
+// stream, hosts or /proc (if all of them are NULL), and are appended to
+// record if it's set.
+typedef struct {
+	in_stream_t *stream;
+	struct delta_reader_t *replay;
+	struct delta_writer_t *record;
+	const struct snapshot_t *snapshot;
+	struct snapshot_stream_t *snapshots;
+	const struct hosts_t *hosts;
+} procs_io_t;
+
 typedef struct {
 	pnode_t *root;
 
 	size_t nprocesses;
-	pnode_t processes[PSC_MAX_PROCS_COUNT];
+	size_t capacity;
+	pnode_t *processes;
+
+	// Open addressing table of indices in processes (+1, 0 is empty) by
+	// pid and host, built by procs_link
+	size_t *pid_index;
+	size_t pid_index_size;
+
+	// Nodes of the hosts hang from the root, which is not a process (see
+	// --hosts)
+	size_t nhosts;
+
+	// Nodes which stand for the folded levels of the tree (see --max-nodes)
+	pnode_t *folds;
+	size_t nfolds;
+
+	// Processes folded into "<N omitted>" stubs (see --max-children and
+	// --max-nodes)
+	size_t nstubs;
+	// Processes over the capacity, they are not shown at all
+	size_t nskipped;
 
 	pnode_t *cpu_toplist[PSC_TOPLIST_MAX_ROWS];
 	pnode_t *mem_toplist[PSC_TOPLIST_MAX_ROWS];
+
+	real_t cpu_value;
+	real_t mem_value;
+	char cpu_label[PSC_LABEL_BUFSIZE + 1];
+	char mem_label[PSC_LABEL_BUFSIZE + 1];
 } procs_t;
 
+// Reads up to PSC_MAX_PROCS_COUNT processes (from /proc if io is NULL),
+// or PSC_MAX_HOST_PROCS_COUNT per host of io->hosts, and links them into
+// the tree
+void
+procs_init(psc_ctx_t *ctx, procs_t *procs, const procs_io_t *io);
+
+// Reads the processes as procs_init does, without linking them (see
+// snapshot_write)
+void
+procs_read(psc_ctx_t *ctx, procs_t *procs, const procs_io_t *io);
+
+// Reserves memory for 'capacity' processes, the first one is reserved
+// for the root
+void
+procs_alloc(procs_t *procs, size_t capacity);
+
+// Returns NULL when the capacity is reached
+pnode_t *
+procs_add(procs_t *procs);
+
+// Builds the tree and the toplists from the added processes
 void
-procs_init(procs_t *procs, FILE *fp);
+procs_link(psc_ctx_t *ctx, procs_t *procs);
 
 void
 procs_dinit(procs_t *procs);
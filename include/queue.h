@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stddef.h>
+#include <pthread.h>
+
+// Number of frames in flight between two neighbouring stages
+#define PIPELINE_DEPTH 2
+
+// Bounded FIFO which hands frames from one thread of the pipeline to the
+// next. NULL is pushed as the end of the stream.
+typedef struct {
+	void *items[PIPELINE_DEPTH];
+	size_t head;
+	size_t count;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+} queue_t;
+
+void
+queue_init(queue_t *q);
+
+void
+queue_dinit(queue_t *q);
+
+// Blocks while the queue holds PIPELINE_DEPTH items
+void
+queue_push(queue_t *q, void *item);
+
+// Blocks while the queue is empty
+void *
+queue_pop(queue_t *q);
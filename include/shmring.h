@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// "PSCR" in little-endian
+#define SHMRING_MAGIC 0x52435350
+// "PSCX", the magic of a ring replaced by a newer one
+#define SHMRING_CLOSED 0x58435350
+#define SHMRING_VERSION 1
+#define SHMRING_BUFFERS 3
+
+// Layout of the shared memory object. It is followed by nbuffers frames of
+// height * stride bytes each, starting at buffer_offset. Frames are stored
+// in cairo's CAIRO_FORMAT_ARGB32 layout (see image_t).
+//
+// Frame n (counting from 1) is rendered into buffer n % nbuffers. Fields
+// below seq are only updated while seq is odd.
+//
+// When the writer restarts, it sets the magic of the old ring to
+// SHMRING_CLOSED before the object is unlinked and replaced. Readers map
+// the object once, so they should check shmring_closed() (e.g. when no new
+// frame arrives) and reopen the name to follow the new ring.
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t nbuffers;
+	uint32_t width;
+	uint32_t height;
+	uint32_t stride;
+	uint64_t buffer_offset;
+	uint64_t buffer_size;
+
+	uint32_t seq;
+	uint32_t current;
+	uint64_t frame;
+} shmring_header_t;
+
+typedef struct {
+	shmring_header_t *header;
+	uint8_t *data;
+	size_t size;
+	bool writer;
+} shmring_t;
+
+// Creates the shared memory object 'name' (see shm_open(3)). An existing
+// ring is marked as closed and unlinked first, readers which still map it
+// keep the old ring and see no more frames.
+bool
+shmring_create(shmring_t *ring, const char *name,
+		size_t width, size_t height, size_t nbuffers);
+
+bool
+shmring_open(shmring_t *ring, const char *name);
+
+void
+shmring_close(shmring_t *ring);
+
+// Buffer the writer renders the next frame into
+uint8_t *
+shmring_next(shmring_t *ring);
+
+// Makes the frame in shmring_next() buffer visible to the readers
+void
+shmring_publish(shmring_t *ring);
+
+// Returns the latest published frame (NULL if there is none yet) and its
+// number. The pixels are read in place; the frame stays intact as long as
+// shmring_valid() returns true for its number.
+const uint8_t *
+shmring_latest(const shmring_t *ring, uint64_t *frame);
+
+bool
+shmring_valid(const shmring_t *ring, uint64_t frame);
+
+// Whether the ring was replaced by a newer one, see shmring_create()
+bool
+shmring_closed(const shmring_t *ring);
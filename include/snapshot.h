@@ -0,0 +1,99 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "procs.h"
+
+// "PSCS" in little-endian
+#define SNAPSHOT_MAGIC 0x53435350
+#define SNAPSHOT_VERSION 1
+
+// A snapshot is the header followed by nprocesses records and a string
+// table of names_size bytes, padded to 8 bytes. All fields are in native
+// byte order, so a mapped snapshot is used without any parsing.
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	// Of the whole snapshot, including the header
+	uint64_t size;
+	// CLOCK_REALTIME in nanoseconds
+	int64_t time;
+	uint32_t nprocesses;
+	uint32_t names_size;
+	// Offsets in the string table
+	uint32_t cpu_label;
+	uint32_t mem_label;
+	double cpu_value;
+	double mem_value;
+} snapshot_header_t;
+
+typedef struct {
+	int32_t pid;
+	int32_t ppid;
+	// Offset of the NUL-terminated name in the string table
+	uint32_t name;
+	float cpu;
+	uint64_t mem;
+} snapshot_proc_t;
+
+typedef struct snapshot_t {
+	const snapshot_header_t *header;
+	const snapshot_proc_t *procs;
+	const char *names;
+
+	void *data;
+	size_t size;
+} snapshot_t;
+
+// Snapshots read one after another from a pipe or a socket, e.g. the
+// output of pscircle-collect
+typedef struct snapshot_stream_t {
+	FILE *fp;
+	// The current snapshot, points to buf
+	snapshot_t snapshot;
+
+	uint64_t *buf;
+	size_t capacity;
+} snapshot_stream_t;
+
+// Writes the processes read by procs_init (before they are linked),
+// captured at time (CLOCK_REALTIME in nanoseconds)
+bool
+snapshot_write(FILE *fp, const procs_t *procs, int64_t time);
+
+// Number of bytes snapshot_write writes
+size_t
+snapshot_size(const procs_t *procs);
+
+bool
+snapshot_map(snapshot_t *snapshot, const char *path);
+
+void
+snapshot_unmap(snapshot_t *snapshot);
+
+// Checks that a snapshot of 'size' bytes at data is consistent
+bool
+snapshot_valid(const void *data, size_t size);
+
+// Points the snapshot to the one at data (e.g. in a mapped stream), which
+// must stay valid while the snapshot is used
+bool
+snapshot_view(snapshot_t *snapshot, const void *data, size_t size);
+
+// Adds the processes of the snapshot to procs (see procs_add)
+void
+snapshot_load(const snapshot_t *snapshot, procs_t *procs);
+
+void
+snapshot_stream_init(snapshot_stream_t *stream, FILE *fp);
+
+void
+snapshot_stream_dinit(snapshot_stream_t *stream);
+
+// Reads the next snapshot. Returns false at the end of the stream, with
+// errno set to EINVAL if the snapshot is corrupted or truncated.
+bool
+snapshot_stream_next(snapshot_stream_t *stream);
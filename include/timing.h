@@ -1,21 +1,76 @@
 #pragma once
 
 #include <stdbool.h>
-#include <time.h>
+#include <stddef.h>
+#include <stdio.h>
 
-typedef struct {
-	clock_t cputime;
-	struct timespec walltime;
+typedef enum {
+	TM_COLLECT = 0,
+	// Sleeping for --interval while collecting /proc, see tm_nested_tick
+	TM_WAIT,
+	TM_LINK,
+	TM_REORDER,
+	TM_ARRANGE,
+	TM_COMPARE,
+	TM_DRAW_TREE,
+	TM_DRAW_LISTS,
+	TM_ENCODE,
+	TM_WRITE,
+	TM_NSTAGES
+} tm_stage_t;
 
-	double ctotal;
-	double wtotal;
-} timing_t;
+typedef enum {
+	TM_NODES = 0,
+	TM_PRIMITIVES,
+	TM_SYSCALLS,
+	TM_CACHE_HITS,
+	// Frames not drawn as they look the same as the previous one, see
+	// --skip-unchanged. Reported after the stages.
+	TM_SKIPPED,
+	TM_NCOUNTERS
+} tm_counter_t;
 
+// Nothing is recorded unless --profile, --trace or --metrics-file is set.
+// With --profile, SIGUSR1 makes the next tm_tick print the report to stderr.
 void
-tm_start(timing_t *tm);
+tm_init();
 
+// Terminates the --trace file
 void
-tm_tick(timing_t *tm, const char *message);
+tm_dinit();
 
+// Names the calling thread in the --trace file
 void
-tm_total(timing_t *tm);
+tm_thread_name(const char *name);
+
+// Stages are measured on the thread that runs them: tm_tick attributes
+// the monotonic wall time, the thread's CPU time and its read/write
+// syscalls since the previous tm_start or tm_tick on this thread to the
+// stage.
+void
+tm_start();
+
+void
+tm_tick(tm_stage_t stage);
+
+// Measures a stage which runs in the middle of the one ticked next on this
+// thread, e.g. a wait while collecting. Its time is left out of the outer
+// stage, whose trace event contains the nested one.
+void
+tm_nested_start();
+
+void
+tm_nested_tick(tm_stage_t stage);
+
+void
+tm_count(tm_stage_t stage, tm_counter_t counter, size_t n);
+
+// Wall and CPU time of the latest run of the stage in seconds, false if
+// it hasn't run yet
+bool
+tm_last(tm_stage_t stage, double *wall, double *cpu);
+
+// Prints min/median/p99 times over the last PSC_PROFILE_WINDOW runs of
+// each stage and the average counters per run
+void
+tm_report(FILE *fp);
@@ -5,4 +5,9 @@
 #include "procs.h"
 
 void
-draw_toplists(painter_t *painter, procs_t *procs);
+draw_toplists(const psc_ctx_t *ctx, painter_t *painter, procs_t *procs);
+
+// Continues h with what draw_toplists draws: the labels, the bars and the
+// rows of the lists which are shown
+uint64_t
+hash_toplists(const psc_ctx_t *ctx, const procs_t *procs, uint64_t h);
@@ -5,4 +5,9 @@
 #include "procs.h"
 
 void
-draw_tree(painter_t *painter, procs_t *procs);
+draw_tree(const psc_ctx_t *ctx, painter_t *painter, procs_t *procs);
+
+// Continues h with what draw_tree draws: the shape of the tree, the names
+// and the colors of the dots and links as they are stored in the image
+uint64_t
+hash_tree(const psc_ctx_t *ctx, const procs_t *procs, uint64_t h);
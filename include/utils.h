@@ -5,3 +5,15 @@
 
 void
 bytes_to_human(double *n, const char **u);
+
+// Offset basis of FNV-1a, the first h of hash_bytes
+#define HASH_SEED 14695981039346656037ULL
+
+// Continues the FNV-1a hash h with size bytes of data
+uint64_t
+hash_bytes(uint64_t h, const void *data, size_t size);
+
+// Hashes the string with its terminating zero, so that consecutive strings
+// are told apart
+uint64_t
+hash_string(uint64_t h, const char *str);
@@ -8,6 +8,7 @@
 #include "types.h"
 #include "color.h"
 #include "point.h"
+#include "encoder.h"
 
 void
 print_help_and_exit(argparser_t *argparser);
@@ -82,6 +83,32 @@ argparser_parse(argparser_t *argparser, int argc, char const * argv[])
 	}
 }
 
+bool
+argparser_set(argparser_t *argparser, const char *arg)
+{
+	assert(argparser);
+	assert(arg);
+
+	char key[PSC_ARG_KEY_BUFSIZE + 1] = {0};
+
+	const char *eq = strchr(arg, '=');
+	if (!eq || eq == arg)
+		return false;
+
+	size_t l = eq - arg;
+	if (l > PSC_ARG_KEY_BUFSIZE)
+		return false;
+
+	strncpy(key, arg, l);
+	key[l] = '\0';
+
+	arg_t *a = find_by_key(argparser, key);
+	if (!a)
+		return false;
+
+	return a->parser(eq + 1, a->output);
+}
+
 void
 wrap(char *str, size_t width)
 {
@@ -125,14 +152,18 @@ wrap(char *str, size_t width)
 void
 print_help_and_exit(argparser_t *argparser)
 {
-	puts(
-		"pscircle -- visualizes Linux processes in a radial tree\n"
-		"\n"
-		"Usage:\n"
-		"   pscircle [OPTION]...\n"
-		"\n"
-		"Options:\n"
-	);
+	if (argparser->usage) {
+		puts(argparser->usage);
+	} else {
+		puts(
+			"pscircle -- visualizes Linux processes in a radial tree\n"
+			"\n"
+			"Usage:\n"
+			"   pscircle [OPTION]...\n"
+			"\n"
+			"Options:\n"
+		);
+	}
 
 	char buf[PSC_ARG_DESCRIPTION_BUFSIZE + 1] = {0};
 
@@ -375,6 +406,52 @@ parser_memory_unit(const char *value, void *output)
 	return false;
 }
 
+bool
+parser_output_format(const char *value, void *output)
+{
+	assert(value);
+	assert(output);
+
+	return encoder_format_from_str(value, (encoder_format_t *) output);
+}
+
+bool
+parser_png_filter(const char *value, void *output)
+{
+	assert(value);
+	assert(output);
+
+	return encoder_png_filter_from_str(value, (encoder_filter_t *) output);
+}
+
+bool
+parser_threads(const char *value, void *output)
+{
+	assert(value);
+	assert(output);
+
+	long n;
+	if (!parser_long(value, &n) || n < 0)
+		return false;
+
+	*(long *) output = n;
+	return true;
+}
+
+bool
+parser_png_compression(const char *value, void *output)
+{
+	assert(value);
+	assert(output);
+
+	long level;
+	if (!parser_long(value, &level) || level < 0 || level > 9)
+		return false;
+
+	*(long *) output = level;
+	return true;
+}
+
 arg_t *
 find_by_key(argparser_t *argparser, const char *key)
 {
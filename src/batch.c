@@ -0,0 +1,227 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <limits.h>
+#include <assert.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "batch.h"
+#include "hosts.h"
+#include "cfg.h"
+#include "ctx.h"
+#include "procs.h"
+#include "painter.h"
+#include "pipeline.h"
+#include "timing.h"
+#include "metrics.h"
+
+#define CHECK(x) do { \
+	if (x) break; \
+	fprintf(stderr, "%s:%d error: %s\n", \
+			__FILE__, __LINE__, strerror(errno)); \
+	exit(EXIT_FAILURE); \
+} while (0)
+
+typedef struct {
+	hosts_t hosts;
+	// Index of the next file to draw, files are handed out one at a time
+	// as they differ in size
+	size_t next;
+	size_t nfailed;
+} batch_t;
+
+typedef struct {
+	batch_t *batch;
+	psc_ctx_t ctx;
+	painter_t painter;
+	pthread_t thread;
+} batch_worker_t;
+
+void
+init_worker(batch_worker_t *w, batch_t *b, const cfg_t *cfg);
+
+void *
+batch_worker(void *arg);
+
+bool
+draw_file(batch_worker_t *w, const char *path, const char *output);
+
+bool
+batch_output_path(char *buf, size_t size, const char *dir, const char *name,
+		encoder_format_t format)
+{
+	assert(buf);
+	assert(dir);
+	assert(name);
+
+	int l = snprintf(buf, size, "%s/%s.%s", dir, name, encoder_format_name(format));
+
+	return l >= 0 && (size_t) l < size;
+}
+
+bool
+batch_run()
+{
+	assert(config.batch_input);
+	assert(config.batch_output);
+
+	batch_t batch = {0};
+	hosts_init(&batch.hosts);
+
+	if (!hosts_add(&batch.hosts, config.batch_input)) {
+		fprintf(stderr, "Can not read %s: %s\n", config.batch_input, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	if (batch.hosts.n == 0) {
+		fprintf(stderr, "%s has no files to draw\n", config.batch_input);
+		exit(EXIT_FAILURE);
+	}
+
+	if (mkdir(config.batch_output, 0755) != 0 && errno != EEXIST) {
+		fprintf(stderr, "Can not create %s: %s\n", config.batch_output, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	cfg_t cfg;
+	size_t nworkers = pipeline_jobs(batch.hosts.n, &cfg);
+
+	// Images are written with painter_write_to, whatever the --output is,
+	// but painters without one draw on the X11 root window
+	cfg.output = cfg.batch_output;
+
+	batch_worker_t *workers = calloc(nworkers, sizeof(batch_worker_t));
+	CHECK(workers);
+
+	for (size_t i = 0; i < nworkers; ++i)
+		init_worker(workers + i, &batch, &cfg);
+
+	// The background image is decoded once and drawn by all the workers
+	if (cfg.background_image) {
+		painter_t *first = &workers[0].painter;
+
+		if (!painter_load_background(first, cfg.background_image)) {
+			fprintf(stderr, "Can not open image %s. (Only PNG is supported)\n",
+					cfg.background_image);
+			exit(EXIT_FAILURE);
+		}
+
+		for (size_t i = 1; i < nworkers; ++i)
+			painter_set_background(&workers[i].painter, first->_background);
+	}
+
+	for (size_t i = 0; i < nworkers; ++i)
+		CHECK(pthread_create(&workers[i].thread, NULL, batch_worker, workers + i) == 0);
+
+	for (size_t i = 0; i < nworkers; ++i)
+		pthread_join(workers[i].thread, NULL);
+
+	for (size_t i = 0; i < nworkers; ++i) {
+		painter_dinit(&workers[i].painter);
+		psc_ctx_dinit(&workers[i].ctx);
+	}
+
+	free(workers);
+
+	size_t nfiles = batch.hosts.n;
+
+	hosts_dinit(&batch.hosts);
+
+	if (batch.nfailed > 0)
+		fprintf(stderr, "%zu of %zu files were not drawn\n", batch.nfailed, nfiles);
+
+	return batch.nfailed == 0;
+}
+
+void
+init_worker(batch_worker_t *w, batch_t *b, const cfg_t *cfg)
+{
+	w->batch = b;
+
+	psc_ctx_init(&w->ctx, cfg);
+
+	cairo_surface_t *surface = cairo_image_surface_create(
+			CAIRO_FORMAT_ARGB32, cfg->output_width, cfg->output_height);
+	CHECK(cairo_surface_status(surface) == CAIRO_STATUS_SUCCESS);
+
+	painter_init_surface(&w->ctx, &w->painter, surface);
+
+	cairo_surface_destroy(surface);
+}
+
+void *
+batch_worker(void *arg)
+{
+	batch_worker_t *w = arg;
+	batch_t *b = w->batch;
+	const cfg_t *cfg = w->ctx.config;
+
+	tm_thread_name("batch");
+
+	char output[PATH_MAX];
+
+	while (true) {
+		size_t i = __atomic_fetch_add(&b->next, 1, __ATOMIC_RELAXED);
+		if (i >= b->hosts.n)
+			break;
+
+		const char *name = b->hosts.labels[i];
+		bool ok;
+
+		if (!batch_output_path(output, sizeof(output), cfg->batch_output, name, cfg->output_format)) {
+			fprintf(stderr, "Path of %s is too long\n", name);
+			ok = false;
+		} else {
+			ok = draw_file(w, b->hosts.paths[i], output);
+		}
+
+		if (!ok)
+			__atomic_fetch_add(&b->nfailed, 1, __ATOMIC_RELAXED);
+	}
+
+	return NULL;
+}
+
+bool
+draw_file(batch_worker_t *w, const char *path, const char *output)
+{
+	FILE *fp = fopen(path, "r");
+	if (!fp) {
+		fprintf(stderr, "Can not read %s: %s\n", path, strerror(errno));
+		return false;
+	}
+
+	tm_start();
+
+	in_stream_t stream;
+	stream_init(&stream, fp);
+
+	procs_io_t io = {
+		.stream = &stream,
+	};
+
+	procs_t procs = {0};
+	pipeline_collect(&w->ctx, &procs, &io);
+
+	stream_dinit(&stream);
+	fclose(fp);
+
+	// The first one is the reserved root
+	bool ok = procs.nprocesses > 1;
+
+	if (ok) {
+		pipeline_render(&w->ctx, &w->painter, &procs);
+
+		painter_write_to(&w->painter, output);
+
+		metrics_written(&w->painter);
+	} else {
+		fprintf(stderr, "%s has no processes\n", path);
+	}
+
+	procs_dinit(&procs);
+
+	return ok;
+}
@@ -15,16 +15,37 @@
 #include "config.h"
 
 cfg_t config = {
-	.read_stdin = PSC_STDIN,
-	.interval   = PSC_INTERVAL,
+	.read_stdin     = PSC_STDIN,
+	.procfs_root    = PSC_PROCFS_ROOT,
+	.record         = PSC_RECORD,
+	.replay         = PSC_REPLAY,
+	.hosts          = PSC_HOSTS,
+	.at             = PSC_AT,
+	.frames         = PSC_FRAMES,
+	.jobs           = PSC_JOBS,
+	.batch_input    = PSC_BATCH_INPUT,
+	.batch_output   = PSC_BATCH_OUTPUT,
+	.interval       = PSC_INTERVAL,
+	.loop           = PSC_LOOP,
+	.skip_unchanged = PSC_SKIP_UNCHANGED,
+	.profile        = PSC_PROFILE,
+	.trace          = PSC_TRACE,
+	.metrics_file   = PSC_METRICS_FILE,
+	.control        = PSC_CONTROL,
 
 	.output           = PSC_OUTPUT,
 	.output_width     = PSC_OUTPUT_WIDTH,
 	.output_height    = PSC_OUTPUT_HEIGHT,
 	.output_display   = PSC_OUTPUT_DISPLAY,
+	.outputs          = PSC_OUTPUTS,
+	.output_format    = PSC_OUTPUT_FORMAT,
+	.png_compression  = PSC_PNG_COMPRESSION,
+	.png_filter       = PSC_PNG_FILTER,
+	.png_threads      = PSC_PNG_THREADS,
 	.memory_unit      = PSC_MEMORY_UNIT,
 	.root_pid         = PSC_ROOT_PID,
 	.max_children     = PSC_MAX_CHILDREN,
+	.max_nodes        = PSC_MAX_NODES,
 	.background       = PSC_BACKGROUND_COLOR,
 	.background_image = PSC_BACKGROUND_IMAGE,
 
@@ -112,152 +133,254 @@ parse_cmdline(int argc, char const * argv[])
 	argparser_t argp = {0};
 	argparser_init(&argp);
 
-	ARGQ(&argp, "--stdin", config.read_stdin, parser_bool, PSC_STDIN,
+	cfg_args(&argp, &config);
+
+	argparser_parse(&argp, argc, argv);
+}
+
+void
+cfg_args(argparser_t *argp, cfg_t *cfg)
+{
+	assert(argp);
+	assert(cfg);
+
+	ARGQ(argp, "--stdin", cfg->read_stdin, parser_bool, PSC_STDIN,
 		"If set to true, process data will be read from stdin in form of"
 		"`ps -e -o pid,ppid,pcpu,rss,comm --no-headers` output. Otherwise, "
 		"/proc file system will be read to obtain the list of processes and information "
 		"on memory usage, load average and CPU utilization");
-	ARGQ(&argp, "--interval", config.interval, parser_real, PSC_INTERVAL,
+	ARG(argp, "--procfs-root", cfg->procfs_root, parser_string, PSC_PROCFS_ROOT,
+		"Directory which is read instead of /proc: per-process stat files, "
+		"stat, uptime, meminfo and loadavg. Snapshots of /proc made with "
+		"procfs-fixture can be used to reproduce collection on other machines");
+	ARG(argp, "--record", cfg->record, parser_string, PSC_RECORD,
+		"Path to a file where the collected processes, CPU and memory usage "
+		"and load average of every frame are appended: a full snapshot "
+		"from time to time and the changes since the previous frame "
+		"otherwise");
+	ARG(argp, "--replay", cfg->replay, parser_string, PSC_REPLAY,
+		"Path to a recording saved with --record, which is drawn instead of "
+		"the processes read from /proc or stdin. With --loop, the recorded "
+		"frames are drawn every --interval seconds until the end of the file");
+	ARG(argp, "--hosts", cfg->hosts, parser_string, PSC_HOSTS,
+		"Comma separated list of files with the processes of one host each, "
+		"in --stdin format, or of directories of such files. The hosts are "
+		"drawn as one tree: the processes below --root-pid of every host hang "
+		"from a node named after its file. The files are read every frame");
+	ARG(argp, "--at", cfg->at, parser_string, PSC_AT,
+		"Draw the last frame of the --replay recording captured at or before "
+		"this time (or start from it with --loop): seconds since the epoch, "
+		"'YYYY-MM-DD HH:MM[:SS]' or 'HH:MM[:SS]' in local time, the latter "
+		"being the first such time since the start of the recording");
+	ARG(argp, "--frames", cfg->frames, parser_string, PSC_FRAMES,
+		"Range of frames of the --replay recording to draw, e.g. 0-3599 or "
+		"100- (counting from 0), for a time-lapse. Each frame is written to "
+		"--output with the frame number substituted for a printf integer "
+		"conversion, e.g. frames/%06d.png, or to stdout in order with "
+		"--output=-");
+	ARGQ(argp, "--jobs", cfg->jobs, parser_threads, PSC_JOBS,
+		"Number of threads drawing --frames or --batch-input files in "
+		"parallel, each with its own surface. 0 means one per CPU");
+	ARG(argp, "--batch-input", cfg->batch_input, parser_string, PSC_BATCH_INPUT,
+		"Directory of files with the processes of one host each, in --stdin "
+		"format. An image of every file is drawn into --batch-output on "
+		"--jobs threads");
+	ARG(argp, "--batch-output", cfg->batch_output, parser_string, PSC_BATCH_OUTPUT,
+		"Directory where the images of --batch-input are written, named after "
+		"the input files with the extension of --output-format (png by "
+		"default), e.g. web01.txt.png");
+	ARGQ(argp, "--interval", cfg->interval, parser_real, PSC_INTERVAL,
 		"If set to 0 (default), CPU utilization and processes PCPU values will be calculate "
 		"from system start time and proceess start time. Otherwise, these values will be calculated "
 		"over specified interval (in seconds, with fractions). This also implies that program exection "
 		"will be suspended to the specified interval.");
+	ARGQ(argp, "--loop", cfg->loop, parser_bool, PSC_LOOP,
+		"If set to true, the program keeps running and draws a new image every "
+		"--interval seconds (which must be positive). With --stdin, frames are "
+		"separated by empty lines and each one is drawn as soon as it is read, "
+		"until the end of stdin. Fonts, background image and "
+		"output surface are reused between the frames");
+	ARGQ(argp, "--skip-unchanged", cfg->skip_unchanged, parser_bool, PSC_SKIP_UNCHANGED,
+		"With --loop, frames which would look the same as the previous one "
+		"are not drawn, encoded or written, e.g. when the system is idle. "
+		"Frames written to stdout are never skipped");
+	ARGQ(argp, "--profile", cfg->profile, parser_bool, PSC_PROFILE,
+		"If set to true, wall time, CPU time, and the numbers of nodes, drawn "
+		"primitives and read/write syscalls are recorded for every stage. "
+		"The report is printed to stderr on exit or when SIGUSR1 is received");
+	ARG(argp, "--trace", cfg->trace, parser_string, PSC_TRACE,
+		"Path to a file where the stages of every frame are written as Chrome "
+		"trace events (JSON array format), e.g. for ui.perfetto.dev");
+	ARG(argp, "--metrics-file", cfg->metrics_file, parser_string, PSC_METRICS_FILE,
+		"Path to a Prometheus textfile (see node_exporter's textfile collector) "
+		"which is rewritten after every frame with stage durations, process "
+		"counts, output size and memory usage");
+	ARG(argp, "--control", cfg->control, parser_string, PSC_CONTROL,
+		"Path to a unix socket created with --loop, which accepts one "
+		"command per line: --key=value options applied from the next frame, "
+		"render-now, stats and dump-snapshot PATH (see README)");
 #ifdef HAVE_X11
-	ARG(&argp, "--output", config.output, parser_string, PSC_OUTPUT,
-		"Path to the output image. If it's not set, X11 root window is used");
-	ARG(&argp, "--output-display", config.output_display, parser_string, PSC_OUTPUT_DISPLAY,
+	ARG(argp, "--output", cfg->output, parser_string, PSC_OUTPUT,
+		"Path to the output image. If it's not set, X11 root window is used. "
+		"If set to -, frames are written to stdout (see --output-format). "
+		"If set to shm:/name, frames are published to a POSIX shared memory ring");
+	ARG(argp, "--output-display", cfg->output_display, parser_string, PSC_OUTPUT_DISPLAY,
 		"Name of X11 display to draw the image to");
 #else
-	ARG(&argp, "--output", config.output, parser_string, PSC_OUTPUT,
-		"Path to the output image");
+	ARG(argp, "--output", cfg->output, parser_string, PSC_OUTPUT,
+		"Path to the output image. If set to -, frames are written to stdout "
+		"(see --output-format). If set to shm:/name, frames are published "
+		"to a POSIX shared memory ring");
 #endif
-	ARGQ(&argp, "--output-width", config.output_width, parser_ulong, PSC_OUTPUT_WIDTH,
+	ARG(argp, "--output-format", cfg->output_format, parser_output_format, "auto",
+		"Format of the output image: png, qoi, ppm, pam, bmp, or raw pixels: "
+		"bgra, rgb24. If set to auto, the format is chosen by the extension "
+		"of --output (png if unknown, bgra for stdout). A stream of raw frames "
+		"starts with a 16 byte header: PSCF, width, height, BGRA or RGB3");
+	ARGQ(argp, "--png-compression", cfg->png_compression, parser_png_compression, PSC_PNG_COMPRESSION,
+		"zlib compression level (0-9) of PNG output. Lower levels are faster "
+		"but produce larger files");
+	ARG(argp, "--png-filter", cfg->png_filter, parser_png_filter, "all",
+		"Comma separated list of PNG row filters to choose from: none, sub, up, "
+		"avg, paeth or all. Fewer filters make encoding faster");
+	ARGQ(argp, "--png-threads", cfg->png_threads, parser_threads, PSC_PNG_THREADS,
+		"Number of threads compressing PNG output. The image is split into "
+		"horizontal stripes which are compressed independently. If set to 0, "
+		"one thread per CPU is used");
+	ARG(argp, "--outputs", cfg->outputs, parser_string, PSC_OUTPUTS,
+		"Semicolon separated list of outputs drawn from the same processes, "
+		"each a comma separated list of options without the dashes, e.g. "
+		"output=a.png,output-width=800;output=b.png. Options not set for an "
+		"output are taken from the command line");
+	ARGQ(argp, "--output-width", cfg->output_width, parser_ulong, PSC_OUTPUT_WIDTH,
 		"Width(px) of output image or X11 root window");
-	ARGQ(&argp, "--output-height", config.output_height, parser_ulong, PSC_OUTPUT_HEIGHT,
+	ARGQ(argp, "--output-height", cfg->output_height, parser_ulong, PSC_OUTPUT_HEIGHT,
 		"Height(px) of output image or X11 root window");
 
-	ARGQ(&argp, "--root-pid", config.root_pid, parser_long, PSC_ROOT_PID,
+	ARGQ(argp, "--root-pid", cfg->root_pid, parser_long, PSC_ROOT_PID,
 		"PID of the root process");
-	ARGQ(&argp, "--max-children", config.max_children, parser_long, PSC_MAX_CHILDREN,
+	ARGQ(argp, "--max-children", cfg->max_children, parser_long, PSC_MAX_CHILDREN,
 		"Maximum number of child proceceses.");
+	ARGQ(argp, "--max-nodes", cfg->max_nodes, parser_ulong, PSC_MAX_NODES,
+		"If set, the deepest levels of the tree are folded into one "
+		"\"<N omitted>\" node per parent, so that at most this many nodes "
+		"are drawn, e.g. for large --hosts trees. 0 means no limit");
 
-	ARGQ(&argp, "--memory-unit", config.memory_unit, parser_memory_unit, PSC_MEMORY_UNIT,
+	ARGQ(argp, "--memory-unit", cfg->memory_unit, parser_memory_unit, PSC_MEMORY_UNIT,
 		"Unit of memeory (B, K, M, G, T) used in RSS memory column");
-	ARGQ(&argp, "--memory-min-value", config.min_mem, parser_memory, PSC_MEM_MIN,
+	ARGQ(argp, "--memory-min-value", cfg->min_mem, parser_memory, PSC_MEM_MIN,
 			"Processes with RSS below specified value will have --dot-border-color-min "
 			"and --link-color-min color");
-	ARGQ(&argp, "--memory-max-value", config.max_mem, parser_memory, PSC_MEM_MAX,
+	ARGQ(argp, "--memory-max-value", cfg->max_mem, parser_memory, PSC_MEM_MAX,
 			"Processes with RSS above specified value will have --dot-border-color-max "
 			"and --link-color-max color");
-	ARGQ(&argp, "--cpu-min-value", config.min_cpu, parser_real, PSC_CPU_MIN,
+	ARGQ(argp, "--cpu-min-value", cfg->min_cpu, parser_real, PSC_CPU_MIN,
 			"Processes with PCPU below specified value will have --dot-color-min color");
-	ARGQ(&argp, "--cpu-max-value", config.max_cpu, parser_real, PSC_CPU_MAX,
+	ARGQ(argp, "--cpu-max-value", cfg->max_cpu, parser_real, PSC_CPU_MAX,
 			"Processes with PCPU above specified value will have --dot-color-max color");
 
-	ARG(&argp, "--background-color", config.background, parser_color, color_to_hex((color_t) PSC_BACKGROUND_COLOR),
+	ARG(argp, "--background-color", cfg->background, parser_color, color_to_hex((color_t) PSC_BACKGROUND_COLOR),
 			"Image backgound color");
-	ARG(&argp, "--background-image", config.background_image, parser_string, PSC_BACKGROUND_IMAGE,
+	ARG(argp, "--background-image", cfg->background_image, parser_string, PSC_BACKGROUND_IMAGE,
 			"Path to background image. Image will be drawn at the top left corner without scaling");
 
-	ARG(&argp, "--tree-center", config.tree.center, parser_point, point_to_str((point_t) PSC_TREE_CENTER),
+	ARG(argp, "--tree-center", cfg->tree.center, parser_point, point_to_str((point_t) PSC_TREE_CENTER),
 			"X:Y Position of a tree center from the center of image");
-	ARGQ(&argp, "--tree-radius-increment", config.tree.radius_inc, parser_real, PSC_TREE_RADIUS_INCREMENT,
+	ARGQ(argp, "--tree-radius-increment", cfg->tree.radius_inc, parser_real, PSC_TREE_RADIUS_INCREMENT,
 			"The diffrence between radii of concentric circiles of the tree");
-	ARGQ(&argp, "--tree-sector-angle", config.tree.sector, parser_real, PSC_TREE_SECTOR,
+	ARGQ(argp, "--tree-sector-angle", cfg->tree.sector, parser_real, PSC_TREE_SECTOR,
 			"Tree vertices will be displayed inside the sector with specified angle");
-	ARGQ(&argp, "--tree-rotate", config.tree.rotate, parser_bool, PSC_TREE_ROTATE,
+	ARGQ(argp, "--tree-rotate", cfg->tree.rotate, parser_bool, PSC_TREE_ROTATE,
 			"Tree will be rotated to the angle specified in --tree-rotation-angle"
 			"If this option and --tree-anchor-proc-name are not set, "
 			"then the tree will be rotated to so that its widest node is at 0 rad");
-	ARGQ(&argp, "--tree-rotation-angle", config.tree.rotation, parser_real, PSC_TREE_ROTATION,
+	ARGQ(argp, "--tree-rotation-angle", cfg->tree.rotation, parser_real, PSC_TREE_ROTATION,
 			"Rotation angle of a tree (radians). If --tree-rotate is not set, the tree will "
 			"be rotated to --tree-anchor-proc-angle (if --tree-anchor-proc-name is set) or to "
 			"the angle of the widest child");
-	ARG(&argp, "--tree-anchor-proc-name", config.tree.anchor_proc_name, parser_string, PSC_ANCHOR_PROC_NAME,
+	ARG(argp, "--tree-anchor-proc-name", cfg->tree.anchor_proc_name, parser_string, PSC_ANCHOR_PROC_NAME,
 			"Tree will be rotated so that specified process is positioned at --tree-anchor-proc-angle angle"
 			", unless --tree-rotate is set. If this option and --tree-rotate are not set or the process is not found, "
 			"then the tree will be rotated to so that its widest node is at 0 rad");
-	ARGQ(&argp, "--tree-anchor-proc-angle", config.tree.anchor_proc_angle, parser_real, PSC_ANCHOR_PROC_ANGLE,
+	ARGQ(argp, "--tree-anchor-proc-angle", cfg->tree.anchor_proc_angle, parser_real, PSC_ANCHOR_PROC_ANGLE,
 			"Tree will be rotated so that proccess specified by --tree-anchor-proc-name is positioned "
 			"the specified angle, unless --tree-rotate is set.");
-	ARGQ(&argp, "--tree-font-size", config.tree.font_size, parser_real, PSC_TREE_FONT_SIZE,
+	ARGQ(argp, "--tree-font-size", cfg->tree.font_size, parser_real, PSC_TREE_FONT_SIZE,
 			"Font size of the tree process names");
-	ARG(&argp, "--tree-font-face", config.tree.font_face, parser_string, PSC_TREE_FONT_FACE,
+	ARG(argp, "--tree-font-face", cfg->tree.font_face, parser_string, PSC_TREE_FONT_FACE,
 			"Font face of the tree process names");
-	ARG(&argp, "--tree-font-color", config.tree.font_color, parser_color, color_to_hex((color_t) PSC_TREE_FONT_COLOR),
+	ARG(argp, "--tree-font-color", cfg->tree.font_color, parser_color, color_to_hex((color_t) PSC_TREE_FONT_COLOR),
 			"The color of the tree process names");
 
-	ARGQ(&argp, "--dot-radius", config.dot.radius, parser_real, PSC_DOT_RADIUS,
+	ARGQ(argp, "--dot-radius", cfg->dot.radius, parser_real, PSC_DOT_RADIUS,
 			"Radius of the dots (px)");
-	ARGQ(&argp, "--dot-border-width", config.dot.border, parser_real, PSC_DOT_BORDER,
+	ARGQ(argp, "--dot-border-width", cfg->dot.border, parser_real, PSC_DOT_BORDER,
 			"Width of dots borders (px)");
-	ARG(&argp, "--dot-color-min", config.dot.bg_min, parser_color, color_to_hex((color_t) PSC_DOT_BACKGROUND_COLOR_MIN),
+	ARG(argp, "--dot-color-min", cfg->dot.bg_min, parser_color, color_to_hex((color_t) PSC_DOT_BACKGROUND_COLOR_MIN),
 			"Backgound color of the dots. This value corresponds to --cpu-max-value");
-	ARG(&argp, "--dot-color-max", config.dot.bg_max, parser_color, color_to_hex((color_t) PSC_DOT_BACKGROUND_COLOR_MAX),
+	ARG(argp, "--dot-color-max", cfg->dot.bg_max, parser_color, color_to_hex((color_t) PSC_DOT_BACKGROUND_COLOR_MAX),
 			"Backgound color of the dots. This value corresponds to --cpu-max-value");
-	ARG(&argp, "--dot-border-color-min", config.dot.fg_min, parser_color, color_to_hex((color_t) PSC_DOT_BORDER_COLOR_MIN),
+	ARG(argp, "--dot-border-color-min", cfg->dot.fg_min, parser_color, color_to_hex((color_t) PSC_DOT_BORDER_COLOR_MIN),
 			"Border color of the dots. This value corresponds to --memory-min-value");
-	ARG(&argp, "--dot-border-color-max", config.dot.fg_max, parser_color, color_to_hex((color_t) PSC_DOT_BORDER_COLOR_MAX),
+	ARG(argp, "--dot-border-color-max", cfg->dot.fg_max, parser_color, color_to_hex((color_t) PSC_DOT_BORDER_COLOR_MAX),
 			"Border color of the dots. This value corresponds to --memory-max-value");
 
-	ARGQ(&argp, "--link-width", config.link.width, parser_real, PSC_LINK_WIDTH,
+	ARGQ(argp, "--link-width", cfg->link.width, parser_real, PSC_LINK_WIDTH,
 			"Width of the curves between dots");
-	ARGQ(&argp, "--link-convexity", config.link.convexity, parser_real, PSC_LINK_CONVIXITY,
+	ARGQ(argp, "--link-convexity", cfg->link.convexity, parser_real, PSC_LINK_CONVIXITY,
 			"Convexity of links curves. Curve control points are offset from the "
 			"centers of the dots to the distance of --tree-radius-increment times "
 			"this value");
-	ARG(&argp, "--link-color-min", config.link.color_min, parser_color, color_to_hex((color_t) PSC_LINK_COLOR_MIN),
+	ARG(argp, "--link-color-min", cfg->link.color_min, parser_color, color_to_hex((color_t) PSC_LINK_COLOR_MIN),
 			"Color of the curves betwwen dots. this value corresponds to --memory-min-value");
-	ARG(&argp, "--link-color-max", config.link.color_max, parser_color, color_to_hex((color_t) PSC_LINK_COLOR_MAX),
+	ARG(argp, "--link-color-max", cfg->link.color_max, parser_color, color_to_hex((color_t) PSC_LINK_COLOR_MAX),
 			"Color of the curves betwwen dots. this value corresponds to --memory-max-value");
 
-	ARGQ(&argp, "--toplists-row-height", config.toplists.row_height, parser_real, PSC_TOPLISTS_ROW_HEIGHT,
+	ARGQ(argp, "--toplists-row-height", cfg->toplists.row_height, parser_real, PSC_TOPLISTS_ROW_HEIGHT,
 			"Hight of each row in toplist (px)");
-	ARGQ(&argp, "--toplists-font-size", config.toplists.font_size, parser_real, PSC_TOPLISTS_FONT_SIZE,
+	ARGQ(argp, "--toplists-font-size", cfg->toplists.font_size, parser_real, PSC_TOPLISTS_FONT_SIZE,
 			"Font size of the text in toplists");
-	ARG(&argp, "--toplists-font-color", config.toplists.font_color, parser_color, color_to_hex((color_t) PSC_TOPLISTS_FONT_COLOR),
+	ARG(argp, "--toplists-font-color", cfg->toplists.font_color, parser_color, color_to_hex((color_t) PSC_TOPLISTS_FONT_COLOR),
 			"Font color of the text in toplists");
-	ARG(&argp, "--toplists-pid-font-color", config.toplists.pid_font_color, parser_color, color_to_hex((color_t) PSC_TOPLISTS_PID_FONT_COLOR),
+	ARG(argp, "--toplists-pid-font-color", cfg->toplists.pid_font_color, parser_color, color_to_hex((color_t) PSC_TOPLISTS_PID_FONT_COLOR),
 			"Font of processes PIDs in toplists");
-	ARG(&argp, "--toplists-font-face", config.toplists.font_face, parser_string, PSC_TOPLISTS_FONT_FACE,
+	ARG(argp, "--toplists-font-face", cfg->toplists.font_face, parser_string, PSC_TOPLISTS_FONT_FACE,
 			"Font of the text in toplists");
-	ARGQ(&argp, "--toplists-column-padding", config.toplists.column_padding, parser_real, PSC_TOPLISTS_COLUMN_PADDING,
+	ARGQ(argp, "--toplists-column-padding", cfg->toplists.column_padding, parser_real, PSC_TOPLISTS_COLUMN_PADDING,
 			"Font of the text in toplists");
 
-	ARGQ(&argp, "--toplists-bar-width", config.toplists.bar.width, parser_real, PSC_TOPLISTS_BAR_WIDTH,
+	ARGQ(argp, "--toplists-bar-width", cfg->toplists.bar.width, parser_real, PSC_TOPLISTS_BAR_WIDTH,
 			"Width of the percentage bar and legend markers in each row");
-	ARGQ(&argp, "--toplists-bar-height", config.toplists.bar.height, parser_real, PSC_TOPLISTS_BAR_HEIGHT,
+	ARGQ(argp, "--toplists-bar-height", cfg->toplists.bar.height, parser_real, PSC_TOPLISTS_BAR_HEIGHT,
 			"Height of the percentage bar");
-	ARG(&argp, "--toplists-bar-background", config.toplists.bar.background, parser_color, color_to_hex((color_t) PSC_TOPLISTS_BAR_BG),
+	ARG(argp, "--toplists-bar-background", cfg->toplists.bar.background, parser_color, color_to_hex((color_t) PSC_TOPLISTS_BAR_BG),
 			"Backgound color of the percentage bar");
-	ARG(&argp, "--toplists-bar-color", config.toplists.bar.color, parser_color, color_to_hex((color_t) PSC_TOPLISTS_BAR_COLOR),
+	ARG(argp, "--toplists-bar-color", cfg->toplists.bar.color, parser_color, color_to_hex((color_t) PSC_TOPLISTS_BAR_COLOR),
 			"Foreground color of the percentage bar");
 
-	ARGQ(&argp, "--cpulist-show", config.toplists.cpulist.show, parser_bool, PSC_CPULIST_SHOW,
+	ARGQ(argp, "--cpulist-show", cfg->toplists.cpulist.show, parser_bool, PSC_CPULIST_SHOW,
 			"Shows the list of porcesses with max CPU utilization");
-	ARG(&argp, "--cpulist-center", config.toplists.cpulist.center, parser_point, point_to_str((point_t) PSC_CPULIST_CENTER),
+	ARG(argp, "--cpulist-center", cfg->toplists.cpulist.center, parser_point, point_to_str((point_t) PSC_CPULIST_CENTER),
 			"Position of the center of CPU list");
-	ARGQ(&argp, "--cpulist-show-header", config.toplists.cpulist.show_header, parser_bool, PSC_CPULIST_SHOW_HEADER,
+	ARGQ(argp, "--cpulist-show-header", cfg->toplists.cpulist.show_header, parser_bool, PSC_CPULIST_SHOW_HEADER,
 			"Show the header of the CPU toplist");
-	ARG(&argp, "--cpulist-name", config.toplists.cpulist.name, parser_string, PSC_CPULIST_NAME,
+	ARG(argp, "--cpulist-name", cfg->toplists.cpulist.name, parser_string, PSC_CPULIST_NAME,
 			"The string to the left of the progress bar of CPU toplist");
-	ARG(&argp, "--cpulist-label", config.toplists.cpulist.label, parser_string, PSC_CPULIST_LABEL,
+	ARG(argp, "--cpulist-label", cfg->toplists.cpulist.label, parser_string, PSC_CPULIST_LABEL,
 			"The string to the right of the progress bar of CPU toplist");
-	ARGQ(&argp, "--cpulist-bar-value", config.toplists.cpulist.value, parser_real, PSC_CPULIST_BAR_VALUE,
+	ARGQ(argp, "--cpulist-bar-value", cfg->toplists.cpulist.value, parser_real, PSC_CPULIST_BAR_VALUE,
 			"The value (0<=x<=1) of percentage bar of CPU toplist");
 
-	ARGQ(&argp, "--memlist-show", config.toplists.memlist.show, parser_bool, PSC_MEMLIST_SHOW,
+	ARGQ(argp, "--memlist-show", cfg->toplists.memlist.show, parser_bool, PSC_MEMLIST_SHOW,
 			"Shows the list of porcesses with max memory utilization");
-	ARG(&argp, "--memlist-center", config.toplists.memlist.center, parser_point, point_to_str((point_t) PSC_MEMLIST_CENTER),
+	ARG(argp, "--memlist-center", cfg->toplists.memlist.center, parser_point, point_to_str((point_t) PSC_MEMLIST_CENTER),
 			"Position of the center of MEM list");
-	ARGQ(&argp, "--memlist-show-header", config.toplists.memlist.show_header, parser_bool, PSC_MEMLIST_SHOW_HEADER,
+	ARGQ(argp, "--memlist-show-header", cfg->toplists.memlist.show_header, parser_bool, PSC_MEMLIST_SHOW_HEADER,
 			"Show the header of the MEM toplist");
-	ARG(&argp, "--memlist-name", config.toplists.memlist.name, parser_string, PSC_MEMLIST_NAME,
+	ARG(argp, "--memlist-name", cfg->toplists.memlist.name, parser_string, PSC_MEMLIST_NAME,
 			"The string to the left of the progress bar of MEM toplist");
-	ARG(&argp, "--memlist-label", config.toplists.memlist.label, parser_string, PSC_MEMLIST_LABEL,
+	ARG(argp, "--memlist-label", cfg->toplists.memlist.label, parser_string, PSC_MEMLIST_LABEL,
 			"The string to the right of the progress bar of MEM toplist");
-	ARGQ(&argp, "--memlist-bar-value", config.toplists.memlist.value, parser_real, PSC_MEMLIST_BAR_VALUE,
+	ARGQ(argp, "--memlist-bar-value", cfg->toplists.memlist.value, parser_real, PSC_MEMLIST_BAR_VALUE,
 			"The value (0<=x<=1) of percentage bar of MEM toplist");
-
-	argparser_parse(&argp, argc, argv);
 }
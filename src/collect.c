@@ -0,0 +1,282 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "cfg.h"
+#include "ctx.h"
+#include "procs.h"
+#include "snapshot.h"
+#include "argparser.h"
+
+#define CHECK(x) do { \
+	if (x) break; \
+	fprintf(stderr, "%s:%d error: %s\n", \
+			__FILE__, __LINE__, strerror(errno)); \
+	exit(EXIT_FAILURE); \
+} while (0)
+
+// pscircle-collect reads the processes from /proc every --interval seconds
+// and writes them as snapshots (see snapshot.h) to stdout or to a unix
+// socket, to be drawn elsewhere by `pscircle --stdin=true --loop=true` or
+// libpscircle. It is linked without cairo, libpng and X11.
+
+typedef struct {
+	const char *socket;
+	size_t count;
+	real_t max_overhead;
+} collect_cfg_t;
+
+typedef struct {
+	size_t nsnapshots;
+	// Not written while the socket is not connected
+	size_t ndropped;
+	// Frames after which the collector slept to stay under --max-overhead
+	size_t nthrottled;
+	uint64_t bytes;
+	// Seconds spent by the collector, CPU time and wall clock
+	double cpu;
+	double wall;
+} collect_stats_t;
+
+collect_cfg_t collect = {
+	.socket       = PSC_COLLECT_SOCKET,
+	.count        = PSC_COLLECT_COUNT,
+	.max_overhead = PSC_COLLECT_MAX_OVERHEAD,
+};
+
+static volatile sig_atomic_t stop_requested = 0;
+static volatile sig_atomic_t report_requested = 0;
+
+void
+parse_args(int argc, const char *argv[]);
+
+void
+on_signal(int sig);
+
+double
+clock_seconds(clockid_t clock);
+
+void
+sleep_seconds(double seconds);
+
+FILE *
+connect_socket(const char *path, bool *warned);
+
+void
+report(const collect_stats_t *stats);
+
+int main(int argc, const char *argv[])
+{
+	parse_args(argc, argv);
+
+	if (config.interval <= 0) {
+		fprintf(stderr, "--interval must be positive\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if (collect.max_overhead <= 0) {
+		fprintf(stderr, "--max-overhead must be positive\n");
+		exit(EXIT_FAILURE);
+	}
+
+	// Write errors are handled where they happen
+	signal(SIGPIPE, SIG_IGN);
+
+	struct sigaction sa = {0};
+	sa.sa_handler = on_signal;
+	CHECK(sigaction(SIGINT, &sa, NULL) == 0);
+	CHECK(sigaction(SIGTERM, &sa, NULL) == 0);
+	CHECK(sigaction(SIGUSR1, &sa, NULL) == 0);
+
+	psc_ctx_t ctx;
+	psc_ctx_init(&ctx, &config);
+
+	FILE *out = collect.socket ? NULL : stdout;
+	bool warned = false;
+	int status = EXIT_SUCCESS;
+
+	collect_stats_t stats = {0};
+
+	for (size_t i = 0; !stop_requested && (collect.count == 0 || i < collect.count); ++i) {
+		double cpu0 = clock_seconds(CLOCK_PROCESS_CPUTIME_ID);
+		double wall0 = clock_seconds(CLOCK_MONOTONIC);
+
+		// Sleeps --interval seconds to measure the CPU usage
+		procs_t procs = {0};
+		procs_read(&ctx, &procs, NULL);
+
+		struct timespec ts;
+		clock_gettime(CLOCK_REALTIME, &ts);
+		int64_t time = (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+
+		if (!out)
+			out = connect_socket(collect.socket, &warned);
+
+		if (!out) {
+			stats.ndropped++;
+		} else if (snapshot_write(out, &procs, time) && fflush(out) == 0) {
+			stats.nsnapshots++;
+			stats.bytes += snapshot_size(&procs);
+		} else if (out == stdout) {
+			fprintf(stderr, "Can not write to stdout: %s\n", strerror(errno));
+			status = EXIT_FAILURE;
+			stop_requested = 1;
+		} else {
+			// The renderer is gone, the next frame reconnects
+			fprintf(stderr, "Can not write to %s: %s\n", collect.socket, strerror(errno));
+			fclose(out);
+			out = NULL;
+			warned = true;
+			stats.ndropped++;
+		}
+
+		procs_dinit(&procs);
+
+		double cpu = clock_seconds(CLOCK_PROCESS_CPUTIME_ID) - cpu0;
+		double wall = clock_seconds(CLOCK_MONOTONIC) - wall0;
+
+		// Frames are spread out so that the collector takes at most
+		// --max-overhead of a CPU, e.g. on hosts with many processes
+		double min_wall = cpu / collect.max_overhead;
+		if (wall < min_wall && !stop_requested) {
+			sleep_seconds(min_wall - wall);
+			wall = clock_seconds(CLOCK_MONOTONIC) - wall0;
+			stats.nthrottled++;
+		}
+
+		stats.cpu += cpu;
+		stats.wall += wall;
+
+		if (report_requested) {
+			report_requested = 0;
+			report(&stats);
+		}
+	}
+
+	if (out && out != stdout)
+		fclose(out);
+
+	psc_ctx_dinit(&ctx);
+
+	report(&stats);
+
+	return status;
+}
+
+void
+parse_args(int argc, const char *argv[])
+{
+	argparser_t argp = {0};
+	argparser_init(&argp);
+
+	argp.usage =
+		"pscircle-collect -- writes snapshots of Linux processes for pscircle\n"
+		"\n"
+		"Usage:\n"
+		"   pscircle-collect [OPTION]... | pscircle --stdin=true --loop=true\n"
+		"\n"
+		"Options:\n";
+
+	ARG(&argp, "--procfs-root", config.procfs_root, parser_string, PSC_PROCFS_ROOT,
+		"Directory which is read instead of /proc");
+	ARGQ(&argp, "--interval", config.interval, parser_real, PSC_INTERVAL,
+		"Seconds between the snapshots, over which the CPU usage is measured");
+	ARG(&argp, "--socket", collect.socket, parser_string, PSC_COLLECT_SOCKET,
+		"Unix socket to write the snapshots to instead of stdout. The "
+		"collector reconnects if the socket is closed, snapshots taken "
+		"while it is not connected are dropped");
+	ARGQ(&argp, "--count", collect.count, parser_ulong, PSC_COLLECT_COUNT,
+		"Number of snapshots to take, 0 means until SIGINT or SIGTERM");
+	ARGQ(&argp, "--max-overhead", collect.max_overhead, parser_real, PSC_COLLECT_MAX_OVERHEAD,
+		"Share of one CPU the collector may use. If reading /proc takes "
+		"longer, the snapshots are taken less often than --interval. CPU "
+		"time and the size of the snapshots are reported on exit and on "
+		"SIGUSR1");
+
+	argparser_parse(&argp, argc, argv);
+}
+
+void
+on_signal(int sig)
+{
+	if (sig == SIGUSR1)
+		report_requested = 1;
+	else
+		stop_requested = 1;
+}
+
+double
+clock_seconds(clockid_t clock)
+{
+	struct timespec ts;
+	clock_gettime(clock, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void
+sleep_seconds(double seconds)
+{
+	struct timespec ts = {
+		.tv_sec = seconds,
+		.tv_nsec = (seconds - (time_t) seconds) * 1e9,
+	};
+
+	while (nanosleep(&ts, &ts) != 0 && errno == EINTR && !stop_requested)
+		;
+}
+
+// Returns NULL if the socket can not be connected, which is reported once
+// until it is connected again
+FILE *
+connect_socket(const char *path, bool *warned)
+{
+	struct sockaddr_un addr = {0};
+	addr.sun_family = AF_UNIX;
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "--socket path is too long: %s\n", path);
+		exit(EXIT_FAILURE);
+	}
+
+	strcpy(addr.sun_path, path);
+
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	CHECK(fd >= 0);
+
+	if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+		if (!*warned)
+			fprintf(stderr, "Can not connect to %s: %s\n", path, strerror(errno));
+		*warned = true;
+		close(fd);
+		return NULL;
+	}
+
+	FILE *fp = fdopen(fd, "w");
+	CHECK(fp);
+
+	*warned = false;
+
+	return fp;
+}
+
+void
+report(const collect_stats_t *stats)
+{
+	size_t n = stats->nsnapshots + stats->ndropped;
+
+	double cpu_ms = n > 0 ? stats->cpu / n * 1e3 : 0;
+	double bytes = stats->nsnapshots > 0 ? (double) stats->bytes / stats->nsnapshots : 0;
+	double overhead = stats->wall > 0 ? stats->cpu / stats->wall * 100 : 0;
+
+	fprintf(stderr, "%zu snapshots, %zu dropped, %.0f bytes and %.2f ms of CPU "
+			"per snapshot, %.2f%% of a CPU, throttled %zu times\n",
+			stats->nsnapshots, stats->ndropped, bytes, cpu_ms, overhead,
+			stats->nthrottled);
+}
@@ -97,3 +97,16 @@ color_to_hex(color_t col)
 
 	return buf;
 }
+
+uint32_t
+color_pack(color_t col)
+{
+	assert(color_is_valid(col));
+
+	uint32_t r = col.r * 255 + R(0.5);
+	uint32_t g = col.g * 255 + R(0.5);
+	uint32_t b = col.b * 255 + R(0.5);
+	uint32_t a = col.a * 255 + R(0.5);
+
+	return r << 24 | g << 16 | b << 8 | a;
+}
@@ -0,0 +1,539 @@
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "control.h"
+#include "argparser.h"
+#include "pipeline.h"
+#include "snapshot.h"
+
+#define CHECK(x) do { \
+	if (x) break; \
+	fprintf(stderr, "%s:%d error: %s\n", \
+			__FILE__, __LINE__, strerror(errno)); \
+	exit(EXIT_FAILURE); \
+} while (0)
+
+// Longest command, longer ones close the connection
+#define CONTROL_BUFSIZE 4096
+
+// Seconds a client may stay silent, and dump-snapshot waits for a frame
+#define CONTROL_TIMEOUT 10
+
+// Options which are read once when pscircle starts
+static const char *fixed_options[] = {
+	"stdin", "procfs-root", "record", "replay", "at", "frames", "jobs",
+	"batch-input", "batch-output", "hosts", "loop", "profile", "trace",
+	"metrics-file", "outputs", "control",
+	"output", "output-display", "output-format", "output-width",
+	"output-height", "png-compression", "png-filter", "png-threads",
+	"background-image",
+};
+
+void
+list_push(control_list_t *list, char *item);
+
+void
+list_free(control_list_t *list, bool items);
+
+void *
+control_thread(void *arg);
+
+void
+serve_client(control_t *control, int fd);
+
+void
+set_option(control_t *control, const char *arg, char *reply, size_t size);
+
+void
+dump_snapshot(control_t *control, const char *path, char *reply, size_t size);
+
+void
+print_stats(control_t *control, char *reply, size_t size);
+
+const char *
+check_ranges(const cfg_t *cfg);
+
+bool
+control_init(control_t *control, const char *path, psc_ctx_t *ctx)
+{
+	assert(control);
+	assert(path);
+	assert(ctx);
+
+	memset(control, 0, sizeof(control_t));
+	control->fd = -1;
+	control->ctx = ctx;
+	control->current = *ctx->config;
+
+	struct sockaddr_un addr = {0};
+	addr.sun_family = AF_UNIX;
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		errno = ENAMETOOLONG;
+		return false;
+	}
+
+	strcpy(addr.sun_path, path);
+
+	// A socket is left behind if pscircle is killed, other files are kept
+	struct stat st;
+	if (lstat(path, &st) == 0) {
+		if (!S_ISSOCK(st.st_mode)) {
+			errno = EEXIST;
+			return false;
+		}
+
+		unlink(path);
+	}
+
+	control->fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (control->fd < 0)
+		return false;
+
+	// Only the user may connect, as dump-snapshot writes files
+	mode_t mask = umask(077);
+	int rc = bind(control->fd, (struct sockaddr *) &addr, sizeof(addr));
+	umask(mask);
+
+	if (rc != 0 || listen(control->fd, 4) != 0) {
+		int e = errno;
+		close(control->fd);
+		errno = e;
+		return false;
+	}
+
+	control->path = strdup(path);
+	CHECK(control->path);
+
+	CHECK(pipe2(control->stop, O_CLOEXEC) == 0);
+
+	CHECK(pthread_mutex_init(&control->mutex, NULL) == 0);
+	CHECK(pthread_cond_init(&control->dumped, NULL) == 0);
+
+	clock_gettime(CLOCK_MONOTONIC, &control->start);
+
+	CHECK(pthread_create(&control->thread, NULL, control_thread, control) == 0);
+
+	return true;
+}
+
+void
+control_dinit(control_t *control)
+{
+	assert(control);
+
+	CHECK(write(control->stop[1], "", 1) == 1);
+	pthread_join(control->thread, NULL);
+
+	close(control->stop[0]);
+	close(control->stop[1]);
+	close(control->fd);
+
+	unlink(control->path);
+	free(control->path);
+
+	list_free(&control->shared, false);
+	list_free(&control->output, false);
+	list_free(&control->strings, true);
+	free(control->dump_path);
+
+	pthread_mutex_destroy(&control->mutex);
+	pthread_cond_destroy(&control->dumped);
+
+	memset(control, 0, sizeof(control_t));
+}
+
+void
+control_apply(control_t *control, cfg_t **cfgs, size_t ncfgs, bool shared)
+{
+	assert(control);
+	assert(cfgs);
+
+	control_list_t *pending = shared ? &control->shared : &control->output;
+
+	pthread_mutex_lock(&control->mutex);
+
+	if (pending->n == 0) {
+		pthread_mutex_unlock(&control->mutex);
+		return;
+	}
+
+	argparser_t *argp = malloc(sizeof(argparser_t));
+	CHECK(argp);
+
+	cfg_t *prev = malloc(sizeof(cfg_t));
+	CHECK(prev);
+
+	for (size_t i = 0; i < ncfgs; ++i) {
+		*prev = *cfgs[i];
+
+		memset(argp, 0, sizeof(argparser_t));
+		argparser_init(argp);
+		cfg_args(argp, cfgs[i]);
+
+		// The arguments are checked when they are received, against the
+		// configuration of the command line
+		for (size_t j = 0; j < pending->n; ++j)
+			argparser_set(argp, pending->items[j]);
+
+		const char *e = check_ranges(cfgs[i]);
+		if (e) {
+			fprintf(stderr, "Options set on %s are not applied to an output: %s\n",
+					control->path, e);
+			*cfgs[i] = *prev;
+		}
+	}
+
+	free(prev);
+	free(argp);
+
+	pending->n = 0;
+
+	pthread_mutex_unlock(&control->mutex);
+}
+
+void
+control_collected(control_t *control, const procs_t *procs)
+{
+	assert(control);
+	assert(procs);
+
+	pthread_mutex_lock(&control->mutex);
+
+	if (control->dump_path) {
+		struct timespec ts;
+		clock_gettime(CLOCK_REALTIME, &ts);
+		int64_t time = (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+
+		FILE *fp = fopen(control->dump_path, "wb");
+		bool ok = fp && snapshot_write(fp, procs, time);
+		if (fp && fclose(fp) != 0)
+			ok = false;
+
+		control->dump_errno = ok ? 0 : errno;
+		control->dump_done = true;
+
+		free(control->dump_path);
+		control->dump_path = NULL;
+
+		pthread_cond_broadcast(&control->dumped);
+	}
+
+	pthread_mutex_unlock(&control->mutex);
+}
+
+void
+control_rendered(control_t *control, const procs_t *procs, double seconds,
+		bool skipped)
+{
+	assert(control);
+	assert(procs);
+
+	pthread_mutex_lock(&control->mutex);
+
+	control->nframes++;
+	control->nprocesses = procs->nprocesses - 1;
+
+	// Of the last frame drawn
+	if (skipped)
+		control->nskipped++;
+	else
+		control->render_seconds = seconds;
+
+	pthread_mutex_unlock(&control->mutex);
+}
+
+void
+control_execute(control_t *control, char *command, char *reply, size_t size)
+{
+	assert(control);
+	assert(command);
+	assert(reply);
+
+	size_t l = strlen(command);
+	while (l > 0 && (command[l - 1] == '\r' || command[l - 1] == ' '))
+		command[--l] = '\0';
+
+	if (strncmp(command, "--", 2) == 0) {
+		set_option(control, command, reply, size);
+	} else if (strcmp(command, "render-now") == 0) {
+		psc_ctx_wake(control->ctx);
+		snprintf(reply, size, "ok");
+	} else if (strcmp(command, "stats") == 0) {
+		print_stats(control, reply, size);
+	} else if (strncmp(command, "dump-snapshot ", 14) == 0 && command[14]) {
+		dump_snapshot(control, command + 14, reply, size);
+	} else {
+		snprintf(reply, size, "error: unknown command: %s", command);
+	}
+}
+
+void
+list_push(control_list_t *list, char *item)
+{
+	if (list->n == list->capacity) {
+		list->capacity = list->capacity ? list->capacity * 2 : 16;
+		list->items = realloc(list->items, list->capacity * sizeof(char *));
+		CHECK(list->items);
+	}
+
+	list->items[list->n++] = item;
+}
+
+void
+list_free(control_list_t *list, bool items)
+{
+	if (items) {
+		for (size_t i = 0; i < list->n; ++i)
+			free(list->items[i]);
+	}
+
+	free(list->items);
+	memset(list, 0, sizeof(control_list_t));
+}
+
+void *
+control_thread(void *arg)
+{
+	control_t *control = arg;
+
+	while (true) {
+		struct pollfd fds[2] = {
+			{.fd = control->fd, .events = POLLIN},
+			{.fd = control->stop[0], .events = POLLIN},
+		};
+
+		if (poll(fds, 2, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+
+		if (fds[1].revents)
+			break;
+
+		int fd = accept4(control->fd, NULL, NULL, SOCK_CLOEXEC);
+		if (fd < 0)
+			continue;
+
+		serve_client(control, fd);
+
+		close(fd);
+	}
+
+	return NULL;
+}
+
+// Executes the commands of a connection until it is closed. The last line
+// may have no newline.
+void
+serve_client(control_t *control, int fd)
+{
+	struct timeval tv = {.tv_sec = CONTROL_TIMEOUT};
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+	char buf[CONTROL_BUFSIZE + 1];
+	char reply[CONTROL_BUFSIZE + 2];
+	size_t len = 0;
+	bool eof = false;
+
+	while (!eof) {
+		ssize_t n = recv(fd, buf + len, CONTROL_BUFSIZE - len, 0);
+		if (n < 0 && errno == EINTR)
+			continue;
+
+		if (n <= 0) {
+			eof = true;
+			if (len == 0)
+				break;
+			buf[len++] = '\n';
+		} else {
+			len += n;
+		}
+
+		char *begin = buf;
+		char *end;
+		while ((end = memchr(begin, '\n', buf + len - begin)) != NULL) {
+			*end = '\0';
+
+			if (*begin) {
+				control_execute(control, begin, reply, CONTROL_BUFSIZE);
+				strcat(reply, "\n");
+				send(fd, reply, strlen(reply), MSG_NOSIGNAL);
+			}
+
+			begin = end + 1;
+		}
+
+		len -= begin - buf;
+		memmove(buf, begin, len);
+
+		if (len == CONTROL_BUFSIZE) {
+			const char *e = "error: command is too long\n";
+			send(fd, e, strlen(e), MSG_NOSIGNAL);
+			break;
+		}
+	}
+}
+
+void
+set_option(control_t *control, const char *arg, char *reply, size_t size)
+{
+	const char *eq = strchr(arg, '=');
+	if (!eq || eq - arg < 3 || (size_t) (eq - arg) > PSC_ARG_KEY_BUFSIZE + 2) {
+		snprintf(reply, size, "error: expected --key=value: %s", arg);
+		return;
+	}
+
+	char name[PSC_ARG_KEY_BUFSIZE + 1];
+	size_t l = eq - arg - 2;
+	memcpy(name, arg + 2, l);
+	name[l] = '\0';
+
+	size_t n = sizeof(fixed_options) / sizeof(fixed_options[0]);
+	for (size_t i = 0; i < n; ++i) {
+		if (strcmp(name, fixed_options[i]) == 0) {
+			snprintf(reply, size, "error: --%s can not be changed while "
+					"pscircle is running", name);
+			return;
+		}
+	}
+
+	// Parsed into a scratch configuration on top of the options set
+	// before, the pipeline applies it to its own between the frames
+	cfg_t *scratch = malloc(sizeof(cfg_t));
+	argparser_t *argp = calloc(1, sizeof(argparser_t));
+	CHECK(scratch && argp);
+
+	*scratch = control->current;
+
+	argparser_init(argp);
+	cfg_args(argp, scratch);
+
+	bool ok = argparser_set(argp, arg);
+	bool interval = ok && strcmp(name, "interval") == 0 && scratch->interval <= 0;
+	const char *range = ok ? check_ranges(scratch) : NULL;
+
+	// Only this thread sets options
+	if (ok && !interval && !range)
+		control->current = *scratch;
+
+	free(argp);
+	free(scratch);
+
+	if (!ok) {
+		snprintf(reply, size, "error: invalid option: %s", arg);
+		return;
+	}
+
+	if (interval) {
+		snprintf(reply, size, "error: --interval must be positive");
+		return;
+	}
+
+	if (range) {
+		snprintf(reply, size, "error: %s", range);
+		return;
+	}
+
+	char *s = strdup(arg);
+	CHECK(s);
+
+	pthread_mutex_lock(&control->mutex);
+
+	list_push(&control->strings, s);
+	list_push(pipeline_output_option(name) ? &control->output : &control->shared, s);
+	control->noptions++;
+
+	pthread_mutex_unlock(&control->mutex);
+
+	snprintf(reply, size, "ok");
+}
+
+void
+dump_snapshot(control_t *control, const char *path, char *reply, size_t size)
+{
+	pthread_mutex_lock(&control->mutex);
+
+	if (control->dump_path) {
+		pthread_mutex_unlock(&control->mutex);
+		snprintf(reply, size, "error: another snapshot is being dumped");
+		return;
+	}
+
+	control->dump_path = strdup(path);
+	CHECK(control->dump_path);
+	control->dump_done = false;
+
+	pthread_mutex_unlock(&control->mutex);
+
+	psc_ctx_wake(control->ctx);
+
+	struct timespec until;
+	clock_gettime(CLOCK_REALTIME, &until);
+	until.tv_sec += CONTROL_TIMEOUT;
+
+	pthread_mutex_lock(&control->mutex);
+
+	int rc = 0;
+	while (!control->dump_done && rc != ETIMEDOUT)
+		rc = pthread_cond_timedwait(&control->dumped, &control->mutex, &until);
+
+	if (!control->dump_done) {
+		// E.g. stdin has no frames, the request is dropped
+		free(control->dump_path);
+		control->dump_path = NULL;
+		snprintf(reply, size, "error: no frame was collected in %d seconds",
+				CONTROL_TIMEOUT);
+	} else if (control->dump_errno) {
+		snprintf(reply, size, "error: can not write %s: %s", path,
+				strerror(control->dump_errno));
+	} else {
+		snprintf(reply, size, "ok");
+	}
+
+	pthread_mutex_unlock(&control->mutex);
+}
+
+void
+print_stats(control_t *control, char *reply, size_t size)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	double uptime = (now.tv_sec - control->start.tv_sec) +
+		(now.tv_nsec - control->start.tv_nsec) * 1e-9;
+
+	pthread_mutex_lock(&control->mutex);
+
+	snprintf(reply, size, "ok frames=%zu skipped=%zu processes=%zu "
+			"render_ms=%.2f options=%zu uptime_s=%.0f",
+			control->nframes, control->nskipped, control->nprocesses,
+			control->render_seconds * 1e3, control->noptions, uptime);
+
+	pthread_mutex_unlock(&control->mutex);
+}
+
+// Options which depend on each other. Returns an error or NULL.
+const char *
+check_ranges(const cfg_t *cfg)
+{
+	if (cfg->min_cpu > cfg->max_cpu)
+		return "--cpu-min-value is above --cpu-max-value";
+
+	if (cfg->min_mem > cfg->max_mem)
+		return "--memory-min-value is above --memory-max-value";
+
+	return NULL;
+}
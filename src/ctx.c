@@ -0,0 +1,93 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <time.h>
+
+#include "ctx.h"
+
+#define CHECK(x) do { \
+	if (x) break; \
+	fprintf(stderr, "%s:%d error: %s\n", \
+			__FILE__, __LINE__, strerror(errno)); \
+	exit(EXIT_FAILURE); \
+} while (0)
+
+void
+psc_ctx_init(psc_ctx_t *ctx, const cfg_t *config)
+{
+	assert(ctx);
+	assert(config);
+
+	memset(ctx, 0, sizeof(psc_ctx_t));
+	ctx->config = config;
+
+	// Sleeps are not affected by changes of the wall clock
+	pthread_condattr_t attr;
+	CHECK(pthread_condattr_init(&attr) == 0);
+	CHECK(pthread_condattr_setclock(&attr, CLOCK_MONOTONIC) == 0);
+
+	CHECK(pthread_mutex_init(&ctx->mutex, NULL) == 0);
+	CHECK(pthread_cond_init(&ctx->cond, &attr) == 0);
+
+	pthread_condattr_destroy(&attr);
+}
+
+void
+psc_ctx_dinit(psc_ctx_t *ctx)
+{
+	assert(ctx);
+
+	free(ctx->line);
+
+	pthread_mutex_destroy(&ctx->mutex);
+	pthread_cond_destroy(&ctx->cond);
+
+	memset(ctx, 0, sizeof(psc_ctx_t));
+}
+
+bool
+psc_ctx_sleep(psc_ctx_t *ctx, double seconds)
+{
+	assert(ctx);
+
+	struct timespec until;
+	clock_gettime(CLOCK_MONOTONIC, &until);
+
+	if (seconds > 0) {
+		time_t s = seconds;
+		until.tv_sec += s;
+		until.tv_nsec += (seconds - s) * 1e9;
+		if (until.tv_nsec >= 1000000000) {
+			until.tv_sec++;
+			until.tv_nsec -= 1000000000;
+		}
+	}
+
+	pthread_mutex_lock(&ctx->mutex);
+
+	int rc = 0;
+	while (!ctx->woken && rc != ETIMEDOUT)
+		rc = pthread_cond_timedwait(&ctx->cond, &ctx->mutex, &until);
+
+	bool woken = ctx->woken;
+	ctx->woken = false;
+
+	pthread_mutex_unlock(&ctx->mutex);
+
+	return woken;
+}
+
+void
+psc_ctx_wake(psc_ctx_t *ctx)
+{
+	assert(ctx);
+
+	pthread_mutex_lock(&ctx->mutex);
+
+	ctx->woken = true;
+	pthread_cond_broadcast(&ctx->cond);
+
+	pthread_mutex_unlock(&ctx->mutex);
+}
@@ -0,0 +1,1133 @@
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <assert.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "delta.h"
+
+#define CHECK(x) do { \
+	if (x) break; \
+	fprintf(stderr, "%s:%d error: %s\n", \
+			__FILE__, __LINE__, strerror(errno)); \
+	exit(EXIT_FAILURE); \
+} while (0)
+
+#define DELTA_ALIGN 8
+
+// Longest LEB128 encoding of a 64-bit value
+#define VARINT_MAX 10
+
+typedef struct {
+	const uint8_t *p;
+	const uint8_t *end;
+} cursor_t;
+
+static size_t
+align_up(size_t n)
+{
+	return (n + DELTA_ALIGN - 1) / DELTA_ALIGN * DELTA_ALIGN;
+}
+
+static int64_t
+now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static uint64_t
+zigzag(int64_t v)
+{
+	return ((uint64_t) v << 1) ^ (uint64_t) (v >> 63);
+}
+
+static int64_t
+unzigzag(uint64_t v)
+{
+	return (int64_t) (v >> 1) ^ -(int64_t) (v & 1);
+}
+
+static uint32_t
+float_bits(float f)
+{
+	uint32_t u;
+	memcpy(&u, &f, sizeof(u));
+	return u;
+}
+
+static float
+bits_float(uint32_t u)
+{
+	float f;
+	memcpy(&f, &u, sizeof(f));
+	return f;
+}
+
+static void
+state_reserve(delta_state_t *state, size_t n)
+{
+	if (n <= state->capacity)
+		return;
+
+	size_t capacity = state->capacity ? state->capacity : 64;
+	while (capacity < n)
+		capacity *= 2;
+
+	state->procs = realloc(state->procs, capacity * sizeof(delta_proc_t));
+	CHECK(state->procs);
+	state->capacity = capacity;
+}
+
+static void
+state_dinit(delta_state_t *state)
+{
+	free(state->procs);
+	memset(state, 0, sizeof(delta_state_t));
+}
+
+static void
+merge(delta_proc_t *dst, const delta_proc_t *a, size_t na,
+		const delta_proc_t *b, size_t nb)
+{
+	size_t i = 0, j = 0;
+	while (i < na && j < nb)
+		*dst++ = b[j].pid < a[i].pid ? b[j++] : a[i++];
+	while (i < na)
+		*dst++ = a[i++];
+	while (j < nb)
+		*dst++ = b[j++];
+}
+
+// Stable sort by pid, then only the first process with each pid is kept
+// (as in procs_link)
+static void
+state_normalize(delta_state_t *state)
+{
+	size_t n = state->nprocs;
+	if (n < 2)
+		return;
+
+	delta_proc_t *tmp = malloc(n * sizeof(delta_proc_t));
+	CHECK(tmp);
+
+	delta_proc_t *src = state->procs;
+	delta_proc_t *dst = tmp;
+
+	for (size_t width = 1; width < n; width *= 2) {
+		for (size_t i = 0; i < n; i += 2 * width) {
+			size_t m = i + width < n ? i + width : n;
+			size_t e = i + 2 * width < n ? i + 2 * width : n;
+			merge(dst + i, src + i, m - i, src + m, e - m);
+		}
+
+		delta_proc_t *t = src;
+		src = dst;
+		dst = t;
+	}
+
+	if (src != state->procs)
+		memcpy(state->procs, src, n * sizeof(delta_proc_t));
+
+	free(tmp);
+
+	size_t k = 1;
+	for (size_t i = 1; i < n; ++i) {
+		if (state->procs[i].pid != state->procs[k - 1].pid)
+			state->procs[k++] = state->procs[i];
+	}
+
+	state->nprocs = k;
+}
+
+static void
+state_from_procs(delta_state_t *state, const procs_t *procs)
+{
+	// The first process is reserved for the root (see procs_alloc)
+	size_t n = procs->nprocesses - 1;
+
+	state_reserve(state, n);
+
+	for (size_t i = 0; i < n; ++i) {
+		const pnode_t *p = procs->processes + i + 1;
+		delta_proc_t *d = state->procs + i;
+
+		d->pid = p->pid;
+		d->ppid = p->ppid;
+		d->cpu = p->cpu;
+		d->mem = p->mem;
+		strncpy(d->name, p->name, PSC_MAX_NAME_LENGHT - 1);
+		d->name[PSC_MAX_NAME_LENGHT - 1] = '\0';
+	}
+
+	state->nprocs = n;
+	state_normalize(state);
+
+	state->time = now_ns();
+	state->cpu_value = procs->cpu_value;
+	state->mem_value = procs->mem_value;
+	snprintf(state->cpu_label, sizeof(state->cpu_label), "%s", procs->cpu_label);
+	snprintf(state->mem_label, sizeof(state->mem_label), "%s", procs->mem_label);
+}
+
+static void
+state_from_snapshot(delta_state_t *state, const snapshot_t *snapshot)
+{
+	const snapshot_header_t *h = snapshot->header;
+
+	state_reserve(state, h->nprocesses);
+
+	for (size_t i = 0; i < h->nprocesses; ++i) {
+		const snapshot_proc_t *r = snapshot->procs + i;
+		delta_proc_t *d = state->procs + i;
+
+		d->pid = r->pid;
+		d->ppid = r->ppid;
+		d->cpu = r->cpu;
+		d->mem = r->mem;
+		strncpy(d->name, snapshot->names + r->name, PSC_MAX_NAME_LENGHT - 1);
+		d->name[PSC_MAX_NAME_LENGHT - 1] = '\0';
+	}
+
+	state->nprocs = h->nprocesses;
+	state_normalize(state);
+
+	state->time = h->time;
+	state->cpu_value = h->cpu_value;
+	state->mem_value = h->mem_value;
+	snprintf(state->cpu_label, sizeof(state->cpu_label), "%s", snapshot->names + h->cpu_label);
+	snprintf(state->mem_label, sizeof(state->mem_label), "%s", snapshot->names + h->mem_label);
+}
+
+static void
+index_push(delta_index_t *index, const delta_index_entry_t *entry)
+{
+	if (index->nentries == index->capacity) {
+		index->capacity = index->capacity ? index->capacity * 2 : 64;
+		index->entries = realloc(index->entries,
+				index->capacity * sizeof(delta_index_entry_t));
+		CHECK(index->entries);
+	}
+
+	index->entries[index->nentries++] = *entry;
+}
+
+// Writer
+
+static void
+buf_reserve(delta_writer_t *w, size_t n)
+{
+	if (w->buflen + n <= w->bufsize)
+		return;
+
+	size_t size = w->bufsize ? w->bufsize : 4096;
+	while (size < w->buflen + n)
+		size *= 2;
+
+	w->buf = realloc(w->buf, size);
+	CHECK(w->buf);
+	w->bufsize = size;
+}
+
+static void
+put_varint(delta_writer_t *w, uint64_t v)
+{
+	buf_reserve(w, VARINT_MAX);
+
+	while (v >= 0x80) {
+		w->buf[w->buflen++] = (v & 0x7f) | 0x80;
+		v >>= 7;
+	}
+	w->buf[w->buflen++] = v;
+}
+
+static void
+put_string(delta_writer_t *w, const char *s, size_t max)
+{
+	size_t l = strnlen(s, max);
+	put_varint(w, l);
+
+	buf_reserve(w, l);
+	memcpy(w->buf + w->buflen, s, l);
+	w->buflen += l;
+}
+
+static void
+encode_delta(delta_writer_t *w, const delta_state_t *prev, const delta_state_t *next)
+{
+	bool labels = strcmp(prev->cpu_label, next->cpu_label) != 0 ||
+		strcmp(prev->mem_label, next->mem_label) != 0;
+
+	put_varint(w, labels);
+	if (labels) {
+		put_string(w, next->cpu_label, PSC_LABEL_BUFSIZE);
+		put_string(w, next->mem_label, PSC_LABEL_BUFSIZE);
+	}
+
+	const delta_proc_t *a = prev->procs, *b = next->procs;
+	size_t na = prev->nprocs, nb = next->nprocs;
+
+	// Indices of exited processes in a, of spawned ones in b and of the
+	// changed ones in both
+	size_t *exited = malloc((na + 1) * sizeof(size_t));
+	size_t *spawned = malloc((nb + 1) * sizeof(size_t));
+	size_t *changed = malloc((nb + 1) * 2 * sizeof(size_t));
+	unsigned *masks = malloc((nb + 1) * sizeof(unsigned));
+	CHECK(exited && spawned && changed && masks);
+
+	size_t nexited = 0, nspawned = 0, nchanged = 0;
+
+	for (size_t i = 0, j = 0; i < na || j < nb; ) {
+		if (j == nb || (i < na && a[i].pid < b[j].pid)) {
+			exited[nexited++] = i++;
+			continue;
+		}
+
+		if (i == na || b[j].pid < a[i].pid) {
+			spawned[nspawned++] = j++;
+			continue;
+		}
+
+		unsigned mask = 0;
+		if (a[i].ppid != b[j].ppid)
+			mask |= DELTA_PPID;
+		if (float_bits(a[i].cpu) != float_bits(b[j].cpu))
+			mask |= DELTA_CPU;
+		if (a[i].mem != b[j].mem)
+			mask |= DELTA_MEM;
+		if (strcmp(a[i].name, b[j].name) != 0)
+			mask |= DELTA_NAME;
+
+		if (mask) {
+			changed[2 * nchanged] = i;
+			changed[2 * nchanged + 1] = j;
+			masks[nchanged++] = mask;
+		}
+
+		i++;
+		j++;
+	}
+
+	int64_t pid = 0;
+	put_varint(w, nexited);
+	for (size_t k = 0; k < nexited; ++k) {
+		const delta_proc_t *p = a + exited[k];
+		put_varint(w, zigzag((int64_t) p->pid - pid));
+		pid = p->pid;
+	}
+
+	pid = 0;
+	put_varint(w, nspawned);
+	for (size_t k = 0; k < nspawned; ++k) {
+		const delta_proc_t *p = b + spawned[k];
+		put_varint(w, zigzag((int64_t) p->pid - pid));
+		put_varint(w, zigzag(p->ppid));
+		put_varint(w, float_bits(p->cpu));
+		put_varint(w, p->mem);
+		put_string(w, p->name, PSC_MAX_NAME_LENGHT);
+		pid = p->pid;
+	}
+
+	pid = 0;
+	put_varint(w, nchanged);
+	for (size_t k = 0; k < nchanged; ++k) {
+		const delta_proc_t *o = a + changed[2 * k];
+		const delta_proc_t *p = b + changed[2 * k + 1];
+		unsigned mask = masks[k];
+
+		put_varint(w, zigzag((int64_t) p->pid - pid));
+		put_varint(w, mask);
+		if (mask & DELTA_PPID)
+			put_varint(w, zigzag(p->ppid));
+		if (mask & DELTA_CPU)
+			put_varint(w, float_bits(p->cpu));
+		if (mask & DELTA_MEM)
+			put_varint(w, zigzag((int64_t) (p->mem - o->mem)));
+		if (mask & DELTA_NAME)
+			put_string(w, p->name, PSC_MAX_NAME_LENGHT);
+		pid = p->pid;
+	}
+
+	free(exited);
+	free(spawned);
+	free(changed);
+	free(masks);
+}
+
+void
+delta_writer_init(delta_writer_t *writer, FILE *fp, size_t keyframe_interval)
+{
+	assert(writer);
+	assert(fp);
+	assert(keyframe_interval > 0);
+
+	memset(writer, 0, sizeof(delta_writer_t));
+	writer->fp = fp;
+	writer->keyframe_interval = keyframe_interval;
+}
+
+void
+delta_writer_dinit(delta_writer_t *writer)
+{
+	assert(writer);
+
+	state_dinit(&writer->prev);
+	state_dinit(&writer->next);
+	free(writer->index.entries);
+	free(writer->buf);
+
+	memset(writer, 0, sizeof(delta_writer_t));
+}
+
+static bool
+write_trailer(delta_writer_t *w)
+{
+	delta_trailer_t t = {
+		.magic   = DELTA_TRAILER_MAGIC,
+		.version = DELTA_VERSION,
+		.index   = w->last_index,
+	};
+
+	w->offset += sizeof(t);
+
+	return fwrite(&t, sizeof(t), 1, w->fp) == 1;
+}
+
+// Writes the entries starting from 'first', chained to the previous block
+// unless these are all of them
+static bool
+write_index(delta_writer_t *w, size_t first)
+{
+	size_t n = w->index.nentries - first;
+
+	delta_index_header_t h = {
+		.magic    = DELTA_INDEX_MAGIC,
+		.version  = DELTA_VERSION,
+		.size     = sizeof(h) + n * sizeof(delta_index_entry_t),
+		.prev     = first > 0 ? w->last_index : 0,
+		.nentries = n,
+	};
+
+	w->last_index = w->offset;
+	w->offset += h.size;
+	w->nindexed = w->index.nentries;
+
+	return fwrite(&h, sizeof(h), 1, w->fp) == 1 &&
+		fwrite(w->index.entries + first, sizeof(delta_index_entry_t), n, w->fp) == n;
+}
+
+bool
+delta_writer_add(delta_writer_t *writer, const procs_t *procs)
+{
+	assert(writer);
+	assert(procs);
+	assert(procs->nprocesses > 0);
+
+	delta_writer_t *w = writer;
+
+	state_from_procs(&w->next, procs);
+
+	bool keyframe = w->nframes % w->keyframe_interval == 0;
+	bool ok = true;
+
+	if (keyframe && w->nindexed < w->index.nentries)
+		ok = write_index(w, w->nindexed);
+
+	delta_index_entry_t entry = {
+		.time   = w->next.time,
+		.offset = w->offset,
+		.flags  = keyframe ? DELTA_KEYFRAME : 0,
+	};
+
+	if (keyframe) {
+		ok = ok && snapshot_write(w->fp, procs, w->next.time);
+		w->offset += snapshot_size(procs);
+	} else {
+		w->buflen = 0;
+		buf_reserve(w, sizeof(delta_header_t));
+		w->buflen = sizeof(delta_header_t);
+
+		encode_delta(w, &w->prev, &w->next);
+
+		size_t size = align_up(w->buflen);
+		buf_reserve(w, size - w->buflen);
+		memset(w->buf + w->buflen, 0, size - w->buflen);
+
+		delta_header_t h = {
+			.magic     = DELTA_MAGIC,
+			.version   = DELTA_VERSION,
+			.size      = size,
+			.time      = w->next.time,
+			.cpu_value = w->next.cpu_value,
+			.mem_value = w->next.mem_value,
+		};
+		memcpy(w->buf, &h, sizeof(h));
+
+		ok = ok && fwrite(w->buf, 1, size, w->fp) == size;
+		w->offset += size;
+	}
+
+	index_push(&w->index, &entry);
+	ok = ok && write_trailer(w);
+
+	delta_state_t t = w->prev;
+	w->prev = w->next;
+	w->next = t;
+
+	w->nframes++;
+
+	// Recordings are usually stopped by a signal
+	return ok && fflush(w->fp) == 0;
+}
+
+bool
+delta_writer_finish(delta_writer_t *writer)
+{
+	assert(writer);
+
+	if (writer->nframes == 0)
+		return true;
+
+	return write_index(writer, 0) && write_trailer(writer) &&
+		fflush(writer->fp) == 0;
+}
+
+// Reader
+
+static bool
+get_varint(cursor_t *c, uint64_t *v)
+{
+	uint64_t r = 0;
+	for (size_t shift = 0; c->p < c->end && shift < 7 * VARINT_MAX; shift += 7) {
+		uint8_t b = *c->p++;
+		r |= (uint64_t) (b & 0x7f) << shift;
+		if (!(b & 0x80)) {
+			*v = r;
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool
+get_string(cursor_t *c, char *s, size_t max)
+{
+	uint64_t l;
+	if (!get_varint(c, &l) || l > max || l > (size_t) (c->end - c->p))
+		return false;
+
+	memcpy(s, c->p, l);
+	s[l] = '\0';
+	c->p += l;
+	return true;
+}
+
+static bool
+get_pid(cursor_t *c, int64_t *pid)
+{
+	uint64_t v;
+	if (!get_varint(c, &v))
+		return false;
+	*pid += unzigzag(v);
+	return true;
+}
+
+static bool
+apply_delta(delta_reader_t *reader, const delta_header_t *h)
+{
+	delta_state_t *old = &reader->state;
+	delta_state_t *out = &reader->scratch;
+
+	cursor_t c = {
+		.p = (const uint8_t *) (h + 1),
+		.end = (const uint8_t *) h + h->size,
+	};
+
+	int32_t *exited = NULL;
+	delta_proc_t *spawned = NULL;
+	delta_proc_t *changed = NULL;
+	unsigned *masks = NULL;
+	bool ok = false;
+
+	memcpy(out->cpu_label, old->cpu_label, sizeof(out->cpu_label));
+	memcpy(out->mem_label, old->mem_label, sizeof(out->mem_label));
+
+	uint64_t labels;
+	if (!get_varint(&c, &labels))
+		goto out;
+
+	if (labels && (!get_string(&c, out->cpu_label, PSC_LABEL_BUFSIZE) ||
+			!get_string(&c, out->mem_label, PSC_LABEL_BUFSIZE)))
+		goto out;
+
+	// Every entry takes at least one byte, which bounds the allocations
+	uint64_t nexited, nspawned, nchanged;
+	int64_t pid = 0;
+
+	if (!get_varint(&c, &nexited) || nexited > (size_t) (c.end - c.p))
+		goto out;
+
+	exited = malloc(nexited * sizeof(int32_t) + 1);
+	CHECK(exited);
+	for (size_t i = 0; i < nexited; ++i) {
+		if (!get_pid(&c, &pid))
+			goto out;
+		exited[i] = pid;
+	}
+
+	pid = 0;
+	if (!get_varint(&c, &nspawned) || nspawned > (size_t) (c.end - c.p))
+		goto out;
+
+	spawned = malloc(nspawned * sizeof(delta_proc_t) + 1);
+	CHECK(spawned);
+	for (size_t i = 0; i < nspawned; ++i) {
+		delta_proc_t *d = spawned + i;
+		uint64_t ppid, cpu, mem;
+		if (!get_pid(&c, &pid) || !get_varint(&c, &ppid) ||
+				!get_varint(&c, &cpu) || !get_varint(&c, &mem) ||
+				!get_string(&c, d->name, PSC_MAX_NAME_LENGHT - 1))
+			goto out;
+		d->pid = pid;
+		d->ppid = unzigzag(ppid);
+		d->cpu = bits_float(cpu);
+		d->mem = mem;
+	}
+
+	pid = 0;
+	if (!get_varint(&c, &nchanged) || nchanged > (size_t) (c.end - c.p))
+		goto out;
+
+	changed = malloc(nchanged * sizeof(delta_proc_t) + 1);
+	masks = malloc(nchanged * sizeof(unsigned) + 1);
+	CHECK(changed && masks);
+	for (size_t i = 0; i < nchanged; ++i) {
+		delta_proc_t *d = changed + i;
+		uint64_t mask, v = 0;
+		if (!get_pid(&c, &pid) || !get_varint(&c, &mask))
+			goto out;
+		d->pid = pid;
+		masks[i] = mask;
+
+		if ((mask & DELTA_PPID) && !get_varint(&c, &v))
+			goto out;
+		d->ppid = unzigzag(v);
+		if ((mask & DELTA_CPU) && !get_varint(&c, &v))
+			goto out;
+		d->cpu = bits_float(v);
+		if ((mask & DELTA_MEM) && !get_varint(&c, &v))
+			goto out;
+		d->mem = unzigzag(v);
+		if ((mask & DELTA_NAME) && !get_string(&c, d->name, PSC_MAX_NAME_LENGHT - 1))
+			goto out;
+	}
+
+	state_reserve(out, old->nprocs + nspawned);
+	out->nprocs = 0;
+
+	size_t e = 0, s = 0, k = 0;
+	for (size_t i = 0; i < old->nprocs || s < nspawned; ) {
+		if (s < nspawned && (i == old->nprocs || spawned[s].pid < old->procs[i].pid)) {
+			out->procs[out->nprocs++] = spawned[s++];
+			continue;
+		}
+
+		const delta_proc_t *p = old->procs + i++;
+
+		if (e < nexited && exited[e] == p->pid) {
+			e++;
+			continue;
+		}
+
+		// A spawned process must not be running already
+		if (s < nspawned && spawned[s].pid == p->pid)
+			goto out;
+
+		delta_proc_t *d = out->procs + out->nprocs++;
+		*d = *p;
+
+		if (k < nchanged && changed[k].pid == p->pid) {
+			if (masks[k] & DELTA_PPID)
+				d->ppid = changed[k].ppid;
+			if (masks[k] & DELTA_CPU)
+				d->cpu = changed[k].cpu;
+			if (masks[k] & DELTA_MEM)
+				d->mem += changed[k].mem;
+			if (masks[k] & DELTA_NAME)
+				memcpy(d->name, changed[k].name, PSC_MAX_NAME_LENGHT);
+			k++;
+		}
+	}
+
+	// Every exited and changed process must have been found
+	if (e != nexited || k != nchanged)
+		goto out;
+
+	out->time = h->time;
+	out->cpu_value = h->cpu_value;
+	out->mem_value = h->mem_value;
+
+	delta_state_t t = reader->state;
+	reader->state = reader->scratch;
+	reader->scratch = t;
+
+	ok = true;
+
+out:
+	free(exited);
+	free(spawned);
+	free(changed);
+	free(masks);
+	return ok;
+}
+
+void
+delta_reader_init(delta_reader_t *reader, const void *data, size_t size)
+{
+	assert(reader);
+
+	memset(reader, 0, sizeof(delta_reader_t));
+	reader->data = data;
+	reader->size = size;
+}
+
+bool
+delta_reader_open(delta_reader_t *reader, const char *path)
+{
+	assert(reader);
+	assert(path);
+
+	memset(reader, 0, sizeof(delta_reader_t));
+
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		close(fd);
+		return false;
+	}
+
+	if (st.st_size == 0) {
+		close(fd);
+		errno = EINVAL;
+		return false;
+	}
+
+	void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (data == MAP_FAILED)
+		return false;
+
+	delta_reader_init(reader, data, st.st_size);
+	reader->mapped = true;
+
+	return true;
+}
+
+void
+delta_reader_close(delta_reader_t *reader)
+{
+	assert(reader);
+
+	if (reader->mapped)
+		munmap((void *) reader->data, reader->size);
+
+	state_dinit(&reader->state);
+	state_dinit(&reader->scratch);
+	free(reader->index.entries);
+
+	memset(reader, 0, sizeof(delta_reader_t));
+}
+
+// Reads the type and the size of the frame at offset without validating
+// its contents
+static bool
+peek_frame(const delta_reader_t *reader, size_t offset, uint32_t *magic, uint64_t *size)
+{
+	size_t left = reader->size - offset;
+	const uint8_t *data = reader->data + offset;
+
+	if (left < sizeof(uint32_t))
+		return false;
+
+	memcpy(magic, data, sizeof(uint32_t));
+
+	size_t min;
+	switch (*magic) {
+	case SNAPSHOT_MAGIC:
+		min = sizeof(snapshot_header_t);
+		break;
+	case DELTA_MAGIC:
+		min = sizeof(delta_header_t);
+		break;
+	case DELTA_INDEX_MAGIC:
+		min = sizeof(delta_index_header_t);
+		break;
+	case DELTA_TRAILER_MAGIC:
+		*size = sizeof(delta_trailer_t);
+		return left >= *size;
+	default:
+		return false;
+	}
+
+	// All headers start with magic, version and size
+	if (left < min)
+		return false;
+
+	memcpy(size, data + 2 * sizeof(uint32_t), sizeof(uint64_t));
+
+	return *size >= min && *size <= left;
+}
+
+static int64_t
+frame_time(const delta_reader_t *reader, size_t offset, uint32_t magic)
+{
+	const uint8_t *data = reader->data + offset;
+	int64_t time;
+
+	if (magic == SNAPSHOT_MAGIC)
+		memcpy(&time, data + offsetof(snapshot_header_t, time), sizeof(time));
+	else
+		memcpy(&time, data + offsetof(delta_header_t, time), sizeof(time));
+
+	return time;
+}
+
+// Reads the chain of index blocks ending with the one at offset. Returns
+// the offset right after it or 0 if the chain is broken.
+static size_t
+read_index_chain(delta_reader_t *reader, size_t offset)
+{
+	delta_index_t *index = &reader->index;
+	size_t total = 0;
+
+	for (size_t o = offset; ; ) {
+		uint32_t magic;
+		uint64_t size;
+		delta_index_header_t h;
+
+		if (o >= reader->size || !peek_frame(reader, o, &magic, &size) ||
+				magic != DELTA_INDEX_MAGIC)
+			return 0;
+
+		memcpy(&h, reader->data + o, sizeof(h));
+
+		if (h.version != DELTA_VERSION || h.prev >= o ||
+				h.nentries > (h.size - sizeof(h)) / sizeof(delta_index_entry_t))
+			return 0;
+
+		total += h.nentries;
+
+		if (h.prev == 0)
+			break;
+		o = h.prev;
+	}
+
+	index->entries = realloc(index->entries, (total + 1) * sizeof(delta_index_entry_t));
+	CHECK(index->entries);
+	index->capacity = total + 1;
+	index->nentries = total;
+
+	// The blocks are visited from the latest one
+	size_t end = total;
+	size_t next = 0;
+
+	for (size_t o = offset; ; ) {
+		delta_index_header_t h;
+		memcpy(&h, reader->data + o, sizeof(h));
+
+		end -= h.nentries;
+		memcpy(index->entries + end, reader->data + o + sizeof(h),
+				h.nentries * sizeof(delta_index_entry_t));
+
+		if (o == offset)
+			next = o + align_up(h.size);
+
+		if (h.prev == 0)
+			break;
+		o = h.prev;
+	}
+
+	return next;
+}
+
+bool
+delta_reader_index(delta_reader_t *reader)
+{
+	assert(reader);
+
+	if (reader->indexed)
+		return reader->index.nentries > 0;
+
+	reader->indexed = true;
+	reader->index.nentries = 0;
+
+	size_t offset = 0;
+
+	delta_trailer_t t;
+	if (reader->size >= sizeof(t)) {
+		memcpy(&t, reader->data + reader->size - sizeof(t), sizeof(t));
+
+		// Without a valid trailer, e.g. if the last frame is not
+		// written completely, all frames are scanned
+		if (t.magic == DELTA_TRAILER_MAGIC && t.version == DELTA_VERSION && t.index > 0)
+			offset = read_index_chain(reader, t.index);
+	}
+
+	// Frames after the latest index block
+	uint32_t magic;
+	uint64_t size;
+
+	while (offset < reader->size && peek_frame(reader, offset, &magic, &size)) {
+		if (magic == SNAPSHOT_MAGIC || magic == DELTA_MAGIC) {
+			delta_index_entry_t e = {
+				.time   = frame_time(reader, offset, magic),
+				.offset = offset,
+				.flags  = magic == SNAPSHOT_MAGIC ? DELTA_KEYFRAME : 0,
+			};
+			index_push(&reader->index, &e);
+		}
+
+		offset += align_up(size);
+	}
+
+	return reader->index.nentries > 0;
+}
+
+// Decodes the frames from the keyframe preceding frame n, so that
+// delta_reader_next applies frame n
+static bool
+seek_entry(delta_reader_t *reader, size_t n)
+{
+	const delta_index_entry_t *e = reader->index.entries;
+
+	size_t k = n;
+	while (k > 0 && !(e[k].flags & DELTA_KEYFRAME))
+		--k;
+
+	if (!(e[k].flags & DELTA_KEYFRAME) || e[k].offset >= reader->size) {
+		errno = EINVAL;
+		return false;
+	}
+
+	reader->offset = e[k].offset;
+	reader->nframes = 0;
+
+	for (size_t i = k; i < n; ++i) {
+		if (!delta_reader_next(reader)) {
+			// The index promised more frames
+			errno = EINVAL;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool
+delta_reader_seek(delta_reader_t *reader, int64_t time)
+{
+	assert(reader);
+
+	if (!delta_reader_index(reader)) {
+		errno = EINVAL;
+		return false;
+	}
+
+	const delta_index_entry_t *e = reader->index.entries;
+
+	// The first frame captured after time
+	size_t lo = 0;
+	size_t hi = reader->index.nentries;
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (e[mid].time <= time)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (lo == 0) {
+		errno = ERANGE;
+		return false;
+	}
+
+	return seek_entry(reader, lo - 1);
+}
+
+bool
+delta_reader_seek_frame(delta_reader_t *reader, size_t n)
+{
+	assert(reader);
+
+	if (!delta_reader_index(reader)) {
+		errno = EINVAL;
+		return false;
+	}
+
+	if (n >= reader->index.nentries) {
+		errno = ERANGE;
+		return false;
+	}
+
+	return seek_entry(reader, n);
+}
+
+bool
+delta_parse_time(const char *str, int64_t start, int64_t *time)
+{
+	assert(str);
+	assert(time);
+
+	char *end;
+	double seconds = strtod(str, &end);
+
+	if (isdigit((unsigned char) *str) && *end == '\0' && seconds < INT64_MAX / 1e9) {
+		*time = seconds * 1e9;
+		return true;
+	}
+
+	struct tm tm = {0};
+	int n = 0;
+	bool date = false;
+
+	if (sscanf(str, "%4d-%2d-%2d%*1[ T]%2d:%2d%n", &tm.tm_year, &tm.tm_mon,
+				&tm.tm_mday, &tm.tm_hour, &tm.tm_min, &n) == 5) {
+		date = true;
+	} else if (sscanf(str, "%2d:%2d%n", &tm.tm_hour, &tm.tm_min, &n) != 2) {
+		return false;
+	}
+
+	str += n;
+	if (*str == ':' && sscanf(str, ":%2d%n", &tm.tm_sec, &n) == 1)
+		str += n;
+
+	if (*str != '\0' || tm.tm_hour > 23 || tm.tm_min > 59 || tm.tm_sec > 60)
+		return false;
+
+	if (date) {
+		if (tm.tm_mon < 1 || tm.tm_mon > 12 || tm.tm_mday < 1 || tm.tm_mday > 31)
+			return false;
+
+		tm.tm_year -= 1900;
+		tm.tm_mon -= 1;
+	} else {
+		time_t s = start / 1000000000;
+		struct tm day;
+		localtime_r(&s, &day);
+		tm.tm_year = day.tm_year;
+		tm.tm_mon = day.tm_mon;
+		tm.tm_mday = day.tm_mday;
+	}
+
+	tm.tm_isdst = -1;
+	time_t t = mktime(&tm);
+
+	if (!date && t < start / 1000000000) {
+		tm.tm_mday++;
+		tm.tm_isdst = -1;
+		t = mktime(&tm);
+	}
+
+	if (t == (time_t) -1)
+		return false;
+
+	*time = (int64_t) t * 1000000000;
+	return true;
+}
+
+bool
+delta_reader_next(delta_reader_t *reader)
+{
+	assert(reader);
+
+	errno = 0;
+
+	uint32_t magic;
+	uint64_t size;
+
+	// Index blocks and trailers are skipped
+	while (reader->offset < reader->size &&
+			peek_frame(reader, reader->offset, &magic, &size) &&
+			(magic == DELTA_INDEX_MAGIC || magic == DELTA_TRAILER_MAGIC))
+		reader->offset += align_up(size);
+
+	if (reader->offset > reader->size)
+		reader->offset = reader->size;
+
+	size_t left = reader->size - reader->offset;
+	if (left == 0)
+		return false;
+
+	const uint8_t *data = reader->data + reader->offset;
+	magic = left >= sizeof(uint32_t) ? *(const uint32_t *) data : 0;
+
+	if (magic == SNAPSHOT_MAGIC) {
+		snapshot_t snapshot;
+		if (!snapshot_view(&snapshot, data, left))
+			goto corrupted;
+
+		state_from_snapshot(&reader->state, &snapshot);
+		size = snapshot.header->size;
+	} else if (magic == DELTA_MAGIC && left >= sizeof(delta_header_t)) {
+		const delta_header_t *h = (const delta_header_t *) data;
+
+		if (h->version != DELTA_VERSION || h->size > left ||
+				h->size < sizeof(delta_header_t) || reader->nframes == 0)
+			goto corrupted;
+
+		if (!apply_delta(reader, h))
+			goto corrupted;
+
+		size = h->size;
+	} else {
+		goto corrupted;
+	}
+
+	reader->offset += align_up(size);
+	if (reader->offset > reader->size)
+		reader->offset = reader->size;
+
+	reader->nframes++;
+
+	return true;
+
+corrupted:
+	errno = EINVAL;
+	return false;
+}
+
+void
+delta_reader_load(const delta_reader_t *reader, procs_t *procs)
+{
+	assert(reader);
+	assert(procs);
+
+	const delta_state_t *state = &reader->state;
+
+	for (size_t i = 0; i < state->nprocs; ++i) {
+		const delta_proc_t *d = state->procs + i;
+
+		pnode_t *p = procs_add(procs);
+		if (!p) {
+			procs->nskipped += state->nprocs - i;
+			return;
+		}
+
+		p->pid = d->pid;
+		p->ppid = d->ppid;
+		p->cpu = d->cpu;
+		p->mem = d->mem;
+		snprintf(p->name, sizeof(p->name), "%s", d->name);
+	}
+}
@@ -0,0 +1,818 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include <pthread.h>
+#include <unistd.h>
+#include <png.h>
+#include <zlib.h>
+
+#include "encoder.h"
+
+#define QOI_OP_INDEX 0x00
+#define QOI_OP_DIFF  0x40
+#define QOI_OP_LUMA  0x80
+#define QOI_OP_RUN   0xc0
+#define QOI_OP_RGB   0xfe
+#define QOI_OP_RGBA  0xff
+
+#define QOI_HASH(p) (((p)[0] * 3 + (p)[1] * 5 + (p)[2] * 7 + (p)[3] * 11) % 64)
+
+#define OUT_BUFSIZE (64 * 1024)
+
+typedef struct {
+	const image_t *img;
+	const encoder_opts_t *opts;
+	size_t channels;
+	size_t y0;
+	size_t y1;
+	bool last;
+
+	uint8_t *out;
+	size_t len;
+	size_t cap;
+	uLong adler;
+	size_t rawlen;
+	bool ok;
+} png_stripe_t;
+
+typedef struct {
+	FILE *fp;
+	size_t len;
+	bool failed;
+	uint8_t buf[OUT_BUFSIZE];
+} out_t;
+
+bool
+write_png(FILE *fp, const image_t *img, const encoder_opts_t *opts);
+
+bool
+write_png_parallel(FILE *fp, const image_t *img, const encoder_opts_t *opts);
+
+bool
+write_qoi(FILE *fp, const image_t *img);
+
+bool
+write_ppm(FILE *fp, const image_t *img);
+
+bool
+write_pam(FILE *fp, const image_t *img);
+
+bool
+write_bmp(FILE *fp, const image_t *img);
+
+bool
+write_bgra(FILE *fp, const image_t *img);
+
+bool
+write_rows(FILE *fp, const image_t *img, size_t channels);
+
+bool
+encoder_write(FILE *fp, const image_t *img, const encoder_opts_t *opts)
+{
+	assert(fp);
+	assert(img);
+	assert(img->data);
+	assert(opts);
+
+	switch (opts->format) {
+		case ENCODER_QOI:
+			return write_qoi(fp, img);
+		case ENCODER_PPM:
+			return write_ppm(fp, img);
+		case ENCODER_PAM:
+			return write_pam(fp, img);
+		case ENCODER_BMP:
+			return write_bmp(fp, img);
+		case ENCODER_BGRA:
+			return write_bgra(fp, img);
+		case ENCODER_RGB24:
+			return write_rows(fp, img, 3);
+		case ENCODER_AUTO:
+		case ENCODER_PNG:
+		default:
+			return write_png(fp, img, opts);
+	}
+}
+
+bool
+encoder_is_raw(encoder_format_t format)
+{
+	return format == ENCODER_BGRA || format == ENCODER_RGB24;
+}
+
+bool
+encoder_write_stream_header(FILE *fp, const image_t *img, encoder_format_t format)
+{
+	assert(fp);
+	assert(img);
+
+	if (!encoder_is_raw(format))
+		return true;
+
+	uint8_t hdr[16] = {'P', 'S', 'C', 'F'};
+
+	for (size_t i = 0; i < 4; ++i) {
+		hdr[4 + i] = img->width >> (8 * i);
+		hdr[8 + i] = img->height >> (8 * i);
+	}
+
+	memcpy(hdr + 12, format == ENCODER_BGRA ? "BGRA" : "RGB3", 4);
+
+	return fwrite(hdr, 1, sizeof(hdr), fp) == sizeof(hdr);
+}
+
+static inline uint32_t
+pixel_at(const image_t *img, size_t x, size_t y)
+{
+	const uint32_t *row = (const uint32_t *) (img->data + y * img->stride);
+	return row[x];
+}
+
+static inline void
+unpremultiply(uint32_t p, uint8_t *rgba)
+{
+	uint32_t a = p >> 24;
+	uint32_t r = (p >> 16) & 0xff;
+	uint32_t g = (p >> 8) & 0xff;
+	uint32_t b = p & 0xff;
+
+	if (a == 0xff) {
+		rgba[0] = r;
+		rgba[1] = g;
+		rgba[2] = b;
+	} else if (a == 0) {
+		rgba[0] = rgba[1] = rgba[2] = 0;
+	} else {
+		rgba[0] = (r * 255 + a / 2) / a;
+		rgba[1] = (g * 255 + a / 2) / a;
+		rgba[2] = (b * 255 + a / 2) / a;
+	}
+
+	rgba[3] = a;
+}
+
+bool
+image_is_opaque(const image_t *img)
+{
+	for (size_t y = 0; y < img->height; ++y) {
+		for (size_t x = 0; x < img->width; ++x) {
+			if ((pixel_at(img, x, y) >> 24) != 0xff)
+				return false;
+		}
+	}
+
+	return true;
+}
+
+// Converts a row into RGB (channels = 3) or RGBA (channels = 4) bytes
+void
+convert_row(const image_t *img, size_t y, uint8_t *out, size_t channels)
+{
+	uint8_t rgba[4];
+
+	for (size_t x = 0; x < img->width; ++x) {
+		unpremultiply(pixel_at(img, x, y), rgba);
+		memcpy(out, rgba, channels);
+		out += channels;
+	}
+}
+
+void
+out_flush(out_t *out)
+{
+	if (out->len > 0 && !out->failed &&
+			fwrite(out->buf, 1, out->len, out->fp) != out->len)
+		out->failed = true;
+
+	out->len = 0;
+}
+
+static inline void
+out_byte(out_t *out, uint8_t b)
+{
+	if (out->len == OUT_BUFSIZE)
+		out_flush(out);
+	out->buf[out->len++] = b;
+}
+
+static inline void
+out_be32(out_t *out, uint32_t v)
+{
+	out_byte(out, v >> 24);
+	out_byte(out, v >> 16);
+	out_byte(out, v >> 8);
+	out_byte(out, v);
+}
+
+static inline void
+out_le32(out_t *out, uint32_t v)
+{
+	out_byte(out, v);
+	out_byte(out, v >> 8);
+	out_byte(out, v >> 16);
+	out_byte(out, v >> 24);
+}
+
+static inline void
+out_le16(out_t *out, uint16_t v)
+{
+	out_byte(out, v);
+	out_byte(out, v >> 8);
+}
+
+bool
+write_png(FILE *fp, const image_t *img, const encoder_opts_t *opts)
+{
+	if (opts->png_threads != 1 && img->height > 1)
+		return write_png_parallel(fp, img, opts);
+
+	bool opaque = image_is_opaque(img);
+	size_t channels = opaque ? 3 : 4;
+
+	uint8_t *row = malloc(img->width * channels);
+	if (!row)
+		return false;
+
+	png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+	png_infop info = png ? png_create_info_struct(png) : NULL;
+
+	if (!png || !info || setjmp(png_jmpbuf(png))) {
+		png_destroy_write_struct(&png, &info);
+		free(row);
+		return false;
+	}
+
+	png_init_io(png, fp);
+
+	png_set_compression_level(png, opts->png_compression);
+
+	int f = 0;
+	if (opts->png_filter & ENCODER_FILTER_NONE)
+		f |= PNG_FILTER_NONE;
+	if (opts->png_filter & ENCODER_FILTER_SUB)
+		f |= PNG_FILTER_SUB;
+	if (opts->png_filter & ENCODER_FILTER_UP)
+		f |= PNG_FILTER_UP;
+	if (opts->png_filter & ENCODER_FILTER_AVG)
+		f |= PNG_FILTER_AVG;
+	if (opts->png_filter & ENCODER_FILTER_PAETH)
+		f |= PNG_FILTER_PAETH;
+
+	png_set_filter(png, PNG_FILTER_TYPE_BASE, f);
+
+	png_set_IHDR(png, info, img->width, img->height, 8,
+			opaque ? PNG_COLOR_TYPE_RGB : PNG_COLOR_TYPE_RGB_ALPHA,
+			PNG_INTERLACE_NONE,
+			PNG_COMPRESSION_TYPE_BASE,
+			PNG_FILTER_TYPE_BASE);
+
+	png_write_info(png, info);
+
+	for (size_t y = 0; y < img->height; ++y) {
+		convert_row(img, y, row, channels);
+		png_write_row(png, row);
+	}
+
+	png_write_end(png, info);
+	png_destroy_write_struct(&png, &info);
+
+	free(row);
+
+	return true;
+}
+
+static inline uint8_t
+paeth(uint8_t a, uint8_t b, uint8_t c)
+{
+	int pa = b - c;
+	int pb = a - c;
+	int pc = abs(pa + pb);
+	pa = abs(pa);
+	pb = abs(pb);
+
+	if (pb < pa) {
+		pa = pb;
+		a = b;
+	}
+
+	return pc < pa ? c : a;
+}
+
+// Writes filter type followed by the filtered row into out
+void
+filter_row(int type, const uint8_t *row, const uint8_t *prev,
+		size_t len, size_t bpp, uint8_t *out)
+{
+	*out++ = type;
+
+	size_t i = 0;
+
+	switch (type) {
+		case 0:
+			memcpy(out, row, len);
+			break;
+		case 1:
+			memcpy(out, row, bpp);
+			for (i = bpp; i < len; ++i)
+				out[i] = row[i] - row[i - bpp];
+			break;
+		case 2:
+			for (i = 0; i < len; ++i)
+				out[i] = row[i] - prev[i];
+			break;
+		case 3:
+			for (i = 0; i < bpp; ++i)
+				out[i] = row[i] - (prev[i] >> 1);
+			for (; i < len; ++i)
+				out[i] = row[i] - ((row[i - bpp] + prev[i]) >> 1);
+			break;
+		default:
+			for (i = 0; i < bpp; ++i)
+				out[i] = row[i] - prev[i];
+			for (; i < len; ++i)
+				out[i] = row[i] - paeth(row[i - bpp], prev[i], prev[i - bpp]);
+			break;
+	}
+}
+
+// Minimum sum of absolute differences heuristic, as libpng does
+uint8_t *
+filter_row_adaptive(encoder_filter_t filters, const uint8_t *row,
+		const uint8_t *prev, size_t len, size_t bpp, uint8_t *cand, uint8_t *best)
+{
+	uint64_t min = UINT64_MAX;
+
+	for (int type = 0; type < 5; ++type) {
+		if (!(filters & (1 << type)))
+			continue;
+
+		filter_row(type, row, prev, len, bpp, cand);
+
+		if (filters == (encoder_filter_t) (1 << type))
+			return cand;
+
+		uint64_t sum = 0;
+		for (size_t i = 1; i <= len && sum < min; i += 64) {
+			size_t n = len + 1 - i < 64 ? len + 1 - i : 64;
+			for (size_t j = 0; j < n; ++j)
+				sum += abs((int8_t) cand[i + j]);
+		}
+
+		if (sum < min) {
+			min = sum;
+			uint8_t *t = best;
+			best = cand;
+			cand = t;
+		}
+	}
+
+	return best;
+}
+
+bool
+stripe_deflate(png_stripe_t *st, z_stream *zs, int flush)
+{
+	do {
+		if (st->cap - st->len < 16 * 1024) {
+			size_t cap = st->cap ? 2 * st->cap : 64 * 1024;
+			uint8_t *out = realloc(st->out, cap);
+			if (!out)
+				return false;
+			st->out = out;
+			st->cap = cap;
+		}
+
+		zs->next_out = st->out + st->len;
+		zs->avail_out = st->cap - st->len;
+
+		if (deflate(zs, flush) == Z_STREAM_ERROR)
+			return false;
+
+		st->len = st->cap - zs->avail_out;
+	} while (zs->avail_out == 0);
+
+	return true;
+}
+
+// Filters and deflates rows [y0, y1) as a raw deflate stream. Every stripe
+// but the last ends with a sync flush, so the stripes can be concatenated
+// into a single zlib stream.
+void *
+png_stripe_worker(void *arg)
+{
+	png_stripe_t *st = (png_stripe_t *) arg;
+	const image_t *img = st->img;
+
+	size_t rowlen = img->width * st->channels;
+
+	uint8_t *rows = calloc(2, rowlen);
+	uint8_t *filtered = malloc(2 * (rowlen + 1));
+
+	st->adler = adler32(0, NULL, 0);
+
+	z_stream zs = {0};
+	int strategy = st->opts->png_filter == ENCODER_FILTER_NONE ?
+		Z_DEFAULT_STRATEGY : Z_FILTERED;
+
+	if (!rows || !filtered || deflateInit2(&zs, st->opts->png_compression,
+				Z_DEFLATED, -15, 8, strategy) != Z_OK) {
+		free(rows);
+		free(filtered);
+		return NULL;
+	}
+
+	uint8_t *row = rows;
+	uint8_t *prev = rows + rowlen;
+
+	if (st->y0 > 0)
+		convert_row(img, st->y0 - 1, prev, st->channels);
+
+	bool ok = true;
+
+	for (size_t y = st->y0; y < st->y1 && ok; ++y) {
+		convert_row(img, y, row, st->channels);
+
+		uint8_t *f = filter_row_adaptive(st->opts->png_filter, row, prev,
+				rowlen, st->channels, filtered, filtered + rowlen + 1);
+
+		st->adler = adler32(st->adler, f, rowlen + 1);
+		st->rawlen += rowlen + 1;
+
+		zs.next_in = f;
+		zs.avail_in = rowlen + 1;
+		ok = stripe_deflate(st, &zs, Z_NO_FLUSH);
+
+		uint8_t *t = prev;
+		prev = row;
+		row = t;
+	}
+
+	if (ok)
+		ok = stripe_deflate(st, &zs, st->last ? Z_FINISH : Z_SYNC_FLUSH);
+
+	deflateEnd(&zs);
+	free(rows);
+	free(filtered);
+
+	st->ok = ok;
+
+	return NULL;
+}
+
+static inline void
+put_be32(uint8_t *p, uint32_t v)
+{
+	p[0] = v >> 24;
+	p[1] = v >> 16;
+	p[2] = v >> 8;
+	p[3] = v;
+}
+
+bool
+write_png_chunk(FILE *fp, const char *type, const uint8_t *data, size_t len)
+{
+	uint8_t hdr[8];
+	put_be32(hdr, len);
+	memcpy(hdr + 4, type, 4);
+
+	uLong crc = crc32(0, hdr + 4, 4);
+	if (len > 0)
+		crc = crc32(crc, data, len);
+
+	uint8_t tail[4];
+	put_be32(tail, crc);
+
+	return fwrite(hdr, 1, 8, fp) == 8
+		&& fwrite(data, 1, len, fp) == len
+		&& fwrite(tail, 1, 4, fp) == 4;
+}
+
+// Each stripe of rows is deflated on its own thread and written as a
+// separate IDAT chunk (similar to pigz)
+bool
+write_png_parallel(FILE *fp, const image_t *img, const encoder_opts_t *opts)
+{
+	size_t nthreads = opts->png_threads;
+	if (nthreads == 0) {
+		long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+		nthreads = ncpu > 0 ? ncpu : 1;
+	}
+
+	if (nthreads > img->height)
+		nthreads = img->height;
+
+	bool opaque = image_is_opaque(img);
+
+	png_stripe_t *stripes = calloc(nthreads, sizeof(png_stripe_t));
+	pthread_t *threads = calloc(nthreads, sizeof(pthread_t));
+	if (!stripes || !threads) {
+		free(stripes);
+		free(threads);
+		return false;
+	}
+
+	for (size_t i = 0; i < nthreads; ++i) {
+		png_stripe_t *st = stripes + i;
+		st->img = img;
+		st->opts = opts;
+		st->channels = opaque ? 3 : 4;
+		st->y0 = img->height * i / nthreads;
+		st->y1 = img->height * (i + 1) / nthreads;
+		st->last = i + 1 == nthreads;
+	}
+
+	size_t nstarted = 1;
+	for (size_t i = 1; i < nthreads; ++i) {
+		if (pthread_create(threads + i, NULL, png_stripe_worker, stripes + i) != 0)
+			break;
+		nstarted++;
+	}
+
+	// The rest is done on the calling thread if pthread_create fails
+	png_stripe_worker(stripes);
+	for (size_t i = nstarted; i < nthreads; ++i)
+		png_stripe_worker(stripes + i);
+
+	for (size_t i = 1; i < nstarted; ++i)
+		pthread_join(threads[i], NULL);
+
+	bool ok = true;
+	uLong adler = stripes[0].adler;
+
+	for (size_t i = 0; i < nthreads; ++i) {
+		ok = ok && stripes[i].ok;
+		if (i > 0)
+			adler = adler32_combine(adler, stripes[i].adler, stripes[i].rawlen);
+	}
+
+	if (ok) {
+		static const uint8_t sig[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+
+		uint8_t ihdr[13];
+		put_be32(ihdr, img->width);
+		put_be32(ihdr + 4, img->height);
+		ihdr[8] = 8;
+		ihdr[9] = opaque ? 2 : 6;
+		ihdr[10] = 0;
+		ihdr[11] = 0;
+		ihdr[12] = 0;
+
+		int level = opts->png_compression;
+		uint8_t cmf = 0x78;
+		uint8_t flevel = level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3;
+		uint8_t flg = flevel << 6;
+		flg += 31 - (cmf * 256 + flg) % 31;
+
+		uint8_t zhdr[2] = {cmf, flg};
+		uint8_t ztail[4];
+		put_be32(ztail, adler);
+
+		ok = fwrite(sig, 1, sizeof(sig), fp) == sizeof(sig)
+			&& write_png_chunk(fp, "IHDR", ihdr, sizeof(ihdr))
+			&& write_png_chunk(fp, "IDAT", zhdr, sizeof(zhdr));
+
+		for (size_t i = 0; i < nthreads && ok; ++i)
+			ok = write_png_chunk(fp, "IDAT", stripes[i].out, stripes[i].len);
+
+		ok = ok && write_png_chunk(fp, "IDAT", ztail, sizeof(ztail))
+			&& write_png_chunk(fp, "IEND", NULL, 0);
+	}
+
+	for (size_t i = 0; i < nthreads; ++i)
+		free(stripes[i].out);
+
+	free(stripes);
+	free(threads);
+
+	return ok;
+}
+
+bool
+write_qoi(FILE *fp, const image_t *img)
+{
+	out_t *out = calloc(1, sizeof(out_t));
+	if (!out)
+		return false;
+
+	out->fp = fp;
+
+	bool opaque = image_is_opaque(img);
+
+	out_byte(out, 'q');
+	out_byte(out, 'o');
+	out_byte(out, 'i');
+	out_byte(out, 'f');
+	out_be32(out, img->width);
+	out_be32(out, img->height);
+	out_byte(out, opaque ? 3 : 4);
+	out_byte(out, 0);
+
+	uint8_t index[64][4];
+	memset(index, 0, sizeof(index));
+
+	uint8_t prev[4] = {0, 0, 0, 255};
+	uint8_t px[4];
+	size_t run = 0;
+
+	for (size_t y = 0; y < img->height; ++y) {
+		for (size_t x = 0; x < img->width; ++x) {
+			unpremultiply(pixel_at(img, x, y), px);
+
+			if (memcmp(px, prev, 4) == 0) {
+				run++;
+				if (run == 62) {
+					out_byte(out, QOI_OP_RUN | (run - 1));
+					run = 0;
+				}
+				continue;
+			}
+
+			if (run > 0) {
+				out_byte(out, QOI_OP_RUN | (run - 1));
+				run = 0;
+			}
+
+			uint8_t h = QOI_HASH(px);
+
+			if (memcmp(index[h], px, 4) == 0) {
+				out_byte(out, QOI_OP_INDEX | h);
+			} else if (px[3] == prev[3]) {
+				int8_t dr = px[0] - prev[0];
+				int8_t dg = px[1] - prev[1];
+				int8_t db = px[2] - prev[2];
+				int8_t dr_dg = dr - dg;
+				int8_t db_dg = db - dg;
+
+				if (dr > -3 && dr < 2 && dg > -3 && dg < 2 && db > -3 && db < 2) {
+					out_byte(out, QOI_OP_DIFF | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2));
+				} else if (dr_dg > -9 && dr_dg < 8 && dg > -33 && dg < 32 && db_dg > -9 && db_dg < 8) {
+					out_byte(out, QOI_OP_LUMA | (dg + 32));
+					out_byte(out, (dr_dg + 8) << 4 | (db_dg + 8));
+				} else {
+					out_byte(out, QOI_OP_RGB);
+					out_byte(out, px[0]);
+					out_byte(out, px[1]);
+					out_byte(out, px[2]);
+				}
+			} else {
+				out_byte(out, QOI_OP_RGBA);
+				out_byte(out, px[0]);
+				out_byte(out, px[1]);
+				out_byte(out, px[2]);
+				out_byte(out, px[3]);
+			}
+
+			memcpy(index[h], px, 4);
+			memcpy(prev, px, 4);
+		}
+	}
+
+	if (run > 0)
+		out_byte(out, QOI_OP_RUN | (run - 1));
+
+	for (size_t i = 0; i < 7; ++i)
+		out_byte(out, 0);
+	out_byte(out, 1);
+
+	out_flush(out);
+
+	bool ok = !out->failed;
+	free(out);
+
+	return ok;
+}
+
+bool
+write_rows(FILE *fp, const image_t *img, size_t channels)
+{
+	uint8_t *row = malloc(img->width * channels);
+	if (!row)
+		return false;
+
+	bool ok = true;
+	for (size_t y = 0; y < img->height && ok; ++y) {
+		convert_row(img, y, row, channels);
+		ok = fwrite(row, channels, img->width, fp) == img->width;
+	}
+
+	free(row);
+
+	return ok;
+}
+
+bool
+write_ppm(FILE *fp, const image_t *img)
+{
+	if (fprintf(fp, "P6\n%zu %zu\n255\n", img->width, img->height) < 0)
+		return false;
+
+	return write_rows(fp, img, 3);
+}
+
+bool
+write_pam(FILE *fp, const image_t *img)
+{
+	int rc = fprintf(fp,
+			"P7\nWIDTH %zu\nHEIGHT %zu\nDEPTH 4\nMAXVAL 255\n"
+			"TUPLTYPE RGB_ALPHA\nENDHDR\n",
+			img->width, img->height);
+
+	if (rc < 0)
+		return false;
+
+	return write_rows(fp, img, 4);
+}
+
+// 32-bit BI_RGB bitmap. Its BGRX byte order is the in-memory layout of
+// ARGB32 on little-endian hosts, so rows are written without conversion.
+bool
+write_bmp(FILE *fp, const image_t *img)
+{
+	out_t *out = calloc(1, sizeof(out_t));
+	if (!out)
+		return false;
+
+	out->fp = fp;
+
+	const uint32_t hdrsize = 14 + 40;
+	const uint32_t rowsize = img->width * 4;
+
+	out_byte(out, 'B');
+	out_byte(out, 'M');
+	out_le32(out, hdrsize + rowsize * img->height);
+	out_le32(out, 0);
+	out_le32(out, hdrsize);
+
+	out_le32(out, 40);
+	out_le32(out, img->width);
+	out_le32(out, img->height);
+	out_le16(out, 1);
+	out_le16(out, 32);
+	out_le32(out, 0);
+	out_le32(out, rowsize * img->height);
+	out_le32(out, 2835);
+	out_le32(out, 2835);
+	out_le32(out, 0);
+	out_le32(out, 0);
+
+	out_flush(out);
+
+	bool ok = !out->failed;
+	free(out);
+
+	const uint16_t probe = 1;
+	bool little_endian = *(const uint8_t *) &probe == 1;
+
+	// Bottom-up row order
+	for (size_t y = img->height; y > 0 && ok; --y) {
+		const uint8_t *src = img->data + (y - 1) * img->stride;
+
+		if (little_endian) {
+			ok = fwrite(src, 4, img->width, fp) == img->width;
+			continue;
+		}
+
+		for (size_t x = 0; x < img->width && ok; ++x) {
+			uint32_t p = pixel_at(img, x, y - 1);
+			uint8_t bgra[4] = {p, p >> 8, p >> 16, p >> 24};
+			ok = fwrite(bgra, 4, 1, fp) == 1;
+		}
+	}
+
+	return ok;
+}
+
+// Premultiplied BGRA bytes. This is how cairo keeps ARGB32 in memory on
+// little-endian hosts, so frames are usually written with a single fwrite.
+bool
+write_bgra(FILE *fp, const image_t *img)
+{
+	const uint16_t probe = 1;
+	bool little_endian = *(const uint8_t *) &probe == 1;
+
+	size_t rowlen = img->width * 4;
+
+	if (little_endian && img->stride == rowlen) {
+		size_t n = rowlen * img->height;
+		return fwrite(img->data, 1, n, fp) == n;
+	}
+
+	bool ok = true;
+
+	for (size_t y = 0; y < img->height && ok; ++y) {
+		if (little_endian) {
+			ok = fwrite(img->data + y * img->stride, 1, rowlen, fp) == rowlen;
+			continue;
+		}
+
+		for (size_t x = 0; x < img->width && ok; ++x) {
+			uint32_t p = pixel_at(img, x, y);
+			uint8_t bgra[4] = {p, p >> 8, p >> 16, p >> 24};
+			ok = fwrite(bgra, 4, 1, fp) == 1;
+		}
+	}
+
+	return ok;
+}
@@ -0,0 +1,122 @@
+#include <assert.h>
+#include <string.h>
+#include <strings.h>
+
+#include "encoder.h"
+
+// Names of the formats and of the PNG filters, kept apart from the encoders
+// so that programs which only parse the options (see pscircle-collect) do
+// not depend on libpng and zlib
+
+static const struct {
+	const char *name;
+	encoder_format_t format;
+} formats[] = {
+	{"auto",  ENCODER_AUTO},
+	{"png",   ENCODER_PNG},
+	{"qoi",   ENCODER_QOI},
+	{"ppm",   ENCODER_PPM},
+	{"pam",   ENCODER_PAM},
+	{"bmp",   ENCODER_BMP},
+	{"bgra",  ENCODER_BGRA},
+	{"rgb24", ENCODER_RGB24},
+};
+
+static const struct {
+	const char *name;
+	encoder_filter_t filter;
+} filters[] = {
+	{"none",  ENCODER_FILTER_NONE},
+	{"sub",   ENCODER_FILTER_SUB},
+	{"up",    ENCODER_FILTER_UP},
+	{"avg",   ENCODER_FILTER_AVG},
+	{"paeth", ENCODER_FILTER_PAETH},
+	{"all",   ENCODER_FILTER_ALL},
+};
+
+encoder_format_t
+encoder_format_from_path(const char *path)
+{
+	if (!path)
+		return ENCODER_PNG;
+
+	const char *ext = strrchr(path, '.');
+	if (!ext || strchr(ext, '/'))
+		return ENCODER_PNG;
+
+	ext++;
+
+	for (size_t i = 1; i < sizeof(formats)/sizeof(*formats); ++i) {
+		if (strcasecmp(formats[i].name, ext) == 0)
+			return formats[i].format;
+	}
+
+	return ENCODER_PNG;
+}
+
+bool
+encoder_format_from_str(const char *str, encoder_format_t *format)
+{
+	assert(str);
+	assert(format);
+
+	for (size_t i = 0; i < sizeof(formats)/sizeof(*formats); ++i) {
+		if (strcmp(formats[i].name, str) == 0) {
+			*format = formats[i].format;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+const char *
+encoder_format_name(encoder_format_t format)
+{
+	// Images are PNG unless the format is chosen
+	if (format == ENCODER_AUTO)
+		format = ENCODER_PNG;
+
+	for (size_t i = 1; i < sizeof(formats)/sizeof(*formats); ++i) {
+		if (formats[i].format == format)
+			return formats[i].name;
+	}
+
+	return "png";
+}
+
+bool
+encoder_png_filter_from_str(const char *str, encoder_filter_t *filter)
+{
+	assert(str);
+	assert(filter);
+
+	encoder_filter_t f = 0;
+
+	// Comma separated list, e.g. "sub,up"
+	while (*str) {
+		size_t l = strcspn(str, ",");
+		bool found = false;
+
+		for (size_t i = 0; i < sizeof(filters)/sizeof(*filters); ++i) {
+			if (strlen(filters[i].name) == l && strncmp(filters[i].name, str, l) == 0) {
+				f |= filters[i].filter;
+				found = true;
+				break;
+			}
+		}
+
+		if (!found)
+			return false;
+
+		str += l;
+		if (*str == ',')
+			str++;
+	}
+
+	if (!f)
+		return false;
+
+	*filter = f;
+	return true;
+}
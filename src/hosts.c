@@ -0,0 +1,202 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "hosts.h"
+
+#define CHECK(x) do { \
+	if (x) break; \
+	fprintf(stderr, "%s:%d error: %s\n", \
+			__FILE__, __LINE__, strerror(errno)); \
+	exit(EXIT_FAILURE); \
+} while (0)
+
+void
+add_file(hosts_t *hosts, const char *dir, const char *name);
+
+int
+name_comp(const void *a, const void *b);
+
+bool
+add_dir(hosts_t *hosts, const char *path);
+
+void
+hosts_init(hosts_t *hosts)
+{
+	assert(hosts);
+
+	memset(hosts, 0, sizeof(hosts_t));
+}
+
+void
+hosts_dinit(hosts_t *hosts)
+{
+	assert(hosts);
+
+	for (size_t i = 0; i < hosts->n; ++i) {
+		free(hosts->paths[i]);
+		free(hosts->labels[i]);
+	}
+
+	free(hosts->paths);
+	free(hosts->labels);
+
+	memset(hosts, 0, sizeof(hosts_t));
+}
+
+bool
+hosts_add(hosts_t *hosts, const char *path)
+{
+	assert(hosts);
+	assert(path);
+
+	struct stat st;
+	if (stat(path, &st) != 0)
+		return false;
+
+	if (S_ISDIR(st.st_mode))
+		return add_dir(hosts, path);
+
+	const char *slash = strrchr(path, '/');
+	if (!slash) {
+		add_file(hosts, NULL, path);
+		return true;
+	}
+
+	char *dir = strndup(path, slash - path);
+	CHECK(dir);
+
+	add_file(hosts, dir, slash + 1);
+
+	free(dir);
+
+	return true;
+}
+
+bool
+hosts_add_list(hosts_t *hosts, const char *list, char *failed, size_t size)
+{
+	assert(hosts);
+	assert(list);
+	assert(failed);
+
+	const char *p = list;
+
+	while (true) {
+		const char *comma = strchr(p, ',');
+		size_t l = comma ? (size_t) (comma - p) : strlen(p);
+
+		char *path = strndup(p, l);
+		CHECK(path);
+
+		bool ok = l > 0 && hosts_add(hosts, path);
+
+		if (!ok) {
+			if (l == 0)
+				errno = ENOENT;
+			snprintf(failed, size, "%s", path);
+		}
+
+		free(path);
+
+		if (!ok)
+			return false;
+
+		if (!comma)
+			return true;
+
+		p = comma + 1;
+	}
+}
+
+void
+add_file(hosts_t *hosts, const char *dir, const char *name)
+{
+	if (hosts->n == hosts->capacity) {
+		hosts->capacity = hosts->capacity ? hosts->capacity * 2 : 64;
+
+		hosts->paths = realloc(hosts->paths, hosts->capacity * sizeof(char *));
+		CHECK(hosts->paths);
+
+		hosts->labels = realloc(hosts->labels, hosts->capacity * sizeof(char *));
+		CHECK(hosts->labels);
+	}
+
+	char *path = NULL;
+	if (dir) {
+		size_t l = strlen(dir) + strlen(name) + 2;
+		path = malloc(l);
+		CHECK(path);
+		snprintf(path, l, "%s/%s", dir, name);
+	} else {
+		path = strdup(name);
+		CHECK(path);
+	}
+
+	char *label = strdup(name);
+	CHECK(label);
+
+	hosts->paths[hosts->n] = path;
+	hosts->labels[hosts->n] = label;
+	hosts->n++;
+}
+
+int
+name_comp(const void *a, const void *b)
+{
+	return strcmp(*(char * const *) a, *(char * const *) b);
+}
+
+// Files are added in the order of their names, so that the hosts keep
+// their places in the tree from frame to frame
+bool
+add_dir(hosts_t *hosts, const char *path)
+{
+	DIR *d = opendir(path);
+	if (!d)
+		return false;
+
+	size_t n = 0;
+	size_t capacity = 64;
+	char **names = malloc(capacity * sizeof(char *));
+	CHECK(names);
+
+	struct dirent *e;
+	while ((e = readdir(d)) != NULL) {
+		// Also skips files which are being written, e.g. by rsync
+		if (e->d_name[0] == '.')
+			continue;
+
+		struct stat st;
+		if (fstatat(dirfd(d), e->d_name, &st, 0) != 0 || !S_ISREG(st.st_mode))
+			continue;
+
+		if (n == capacity) {
+			capacity *= 2;
+			names = realloc(names, capacity * sizeof(char *));
+			CHECK(names);
+		}
+
+		names[n] = strdup(e->d_name);
+		CHECK(names[n]);
+		n++;
+	}
+
+	closedir(d);
+
+	qsort(names, n, sizeof(char *), name_comp);
+
+	for (size_t i = 0; i < n; ++i) {
+		add_file(hosts, path, names[i]);
+		free(names[i]);
+	}
+
+	free(names);
+
+	return true;
+}
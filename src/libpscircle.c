@@ -0,0 +1,330 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <assert.h>
+
+#include "libpscircle.h"
+#include "cfg.h"
+#include "ctx.h"
+#include "argparser.h"
+#include "procs.h"
+#include "painter.h"
+#include "snapshot.h"
+#include "tree_visualizer.h"
+#include "toplist_visualizer.h"
+
+#define CHECK(x) do { \
+	if (x) break; \
+	fprintf(stderr, "%s:%d error: %s\n", \
+			__FILE__, __LINE__, strerror(errno)); \
+	abort(); \
+} while (0)
+
+typedef enum {
+	STATE_EMPTY,
+	STATE_LOADED,
+	STATE_ARRANGED,
+} state_t;
+
+struct psc_t {
+	cfg_t config;
+	psc_ctx_t ctx;
+	argparser_t argp;
+
+	procs_t procs;
+	state_t state;
+
+	painter_t painter;
+	bool painter_ready;
+};
+
+void
+reset_procs(psc_t *psc);
+
+psc_status_t
+load_procs(psc_t *psc, const procs_io_t *io);
+
+psc_status_t
+feed_snapshot(psc_t *psc, const void *data, size_t size);
+
+psc_status_t
+feed_text(psc_t *psc, const void *data, size_t size);
+
+const char *
+psc_strerror(psc_status_t status)
+{
+	switch (status) {
+	case PSC_OK:
+		return "Success";
+	case PSC_EINVAL:
+		return "Invalid argument";
+	case PSC_EIO:
+		return "Input can not be read";
+	case PSC_ENODATA:
+		return "No processes in the input";
+	case PSC_ESTATE:
+		return "No arranged processes to draw";
+	}
+
+	return "Unknown error";
+}
+
+psc_status_t
+psc_create(psc_t **psc)
+{
+	if (!psc)
+		return PSC_EINVAL;
+
+	psc_t *p = calloc(1, sizeof(psc_t));
+	CHECK(p);
+
+	// The command line is not parsed in the library, so the global
+	// holds the defaults
+	p->config = config;
+
+	psc_ctx_init(&p->ctx, &p->config);
+
+	argparser_init(&p->argp);
+	cfg_args(&p->argp, &p->config);
+
+	*psc = p;
+
+	return PSC_OK;
+}
+
+void
+psc_destroy(psc_t *psc)
+{
+	if (!psc)
+		return;
+
+	reset_procs(psc);
+
+	if (psc->painter_ready)
+		painter_dinit(&psc->painter);
+
+	psc_ctx_dinit(&psc->ctx);
+
+	free(psc);
+}
+
+psc_status_t
+psc_set_option(psc_t *psc, const char *arg)
+{
+	if (!psc || !arg)
+		return PSC_EINVAL;
+
+	// Parsed into a copy, so that a rejected value leaves the option as it was
+	cfg_t saved = psc->config;
+
+	if (!argparser_set(&psc->argp, arg)) {
+		psc->config = saved;
+		return PSC_EINVAL;
+	}
+
+	return PSC_OK;
+}
+
+psc_status_t
+psc_collect(psc_t *psc)
+{
+	if (!psc)
+		return PSC_EINVAL;
+
+	if (!linux_available(psc->config.procfs_root))
+		return PSC_EIO;
+
+	return load_procs(psc, NULL);
+}
+
+psc_status_t
+psc_feed(psc_t *psc, const void *data, size_t size)
+{
+	if (!psc || (!data && size > 0))
+		return PSC_EINVAL;
+
+	if (size >= sizeof(uint32_t)) {
+		uint32_t magic;
+		memcpy(&magic, data, sizeof(magic));
+
+		if (magic == SNAPSHOT_MAGIC)
+			return feed_snapshot(psc, data, size);
+	}
+
+	return feed_text(psc, data, size);
+}
+
+psc_status_t
+psc_layout(psc_t *psc)
+{
+	if (!psc)
+		return PSC_EINVAL;
+
+	if (psc->state == STATE_EMPTY)
+		return PSC_ESTATE;
+
+	if (psc->state == STATE_ARRANGED)
+		return PSC_OK;
+
+	node_reorder_by_leaves((node_t *)psc->procs.root);
+
+	node_arrange((node_t *)psc->procs.root);
+
+	psc->state = STATE_ARRANGED;
+
+	return PSC_OK;
+}
+
+psc_status_t
+psc_render(psc_t *psc, uint8_t *pixels, size_t width, size_t height, size_t stride)
+{
+	if (!psc || !pixels || width == 0 || height == 0)
+		return PSC_EINVAL;
+
+	if (width > INT32_MAX || height > INT32_MAX || stride > INT32_MAX)
+		return PSC_EINVAL;
+
+	if (stride < width * 4 || stride % 4 != 0)
+		return PSC_EINVAL;
+
+	cairo_surface_t *surface = cairo_image_surface_create_for_data(
+			pixels, CAIRO_FORMAT_ARGB32, width, height, stride);
+
+	if (cairo_surface_status(surface) != CAIRO_STATUS_SUCCESS) {
+		cairo_surface_destroy(surface);
+		return PSC_EINVAL;
+	}
+
+	psc_status_t status = psc_render_surface(psc, surface);
+
+	cairo_surface_destroy(surface);
+
+	return status;
+}
+
+psc_status_t
+psc_render_surface(psc_t *psc, cairo_surface_t *surface)
+{
+	if (!psc || !surface)
+		return PSC_EINVAL;
+
+	if (cairo_surface_status(surface) != CAIRO_STATUS_SUCCESS ||
+			cairo_surface_get_type(surface) != CAIRO_SURFACE_TYPE_IMAGE)
+		return PSC_EINVAL;
+
+	if (psc->state != STATE_ARRANGED)
+		return PSC_ESTATE;
+
+	cfg_t *c = &psc->config;
+
+	// The painter reads the size of the image from the options
+	c->output_width = cairo_image_surface_get_width(surface);
+	c->output_height = cairo_image_surface_get_height(surface);
+
+	painter_t *painter = &psc->painter;
+
+	if (!psc->painter_ready) {
+		painter_init_surface(&psc->ctx, painter, surface);
+		psc->painter_ready = true;
+	} else {
+		painter_set_surface(painter, surface);
+	}
+
+	if (c->background_image && !painter_load_background(painter, c->background_image))
+		return PSC_EIO;
+
+	painter_clear(painter);
+
+	draw_tree(&psc->ctx, painter, &psc->procs);
+
+	if (c->toplists.cpulist.show || c->toplists.memlist.show)
+		draw_toplists(&psc->ctx, painter, &psc->procs);
+
+	cairo_surface_flush(surface);
+
+	return PSC_OK;
+}
+
+void
+reset_procs(psc_t *psc)
+{
+	if (psc->procs.processes)
+		procs_dinit(&psc->procs);
+
+	memset(&psc->procs, 0, sizeof(procs_t));
+
+	psc->state = STATE_EMPTY;
+}
+
+psc_status_t
+load_procs(psc_t *psc, const procs_io_t *io)
+{
+	reset_procs(psc);
+
+	procs_init(&psc->ctx, &psc->procs, io);
+
+	// The first one is the reserved root
+	if (psc->procs.nprocesses < 2) {
+		reset_procs(psc);
+		return PSC_ENODATA;
+	}
+
+	psc->state = STATE_LOADED;
+
+	return PSC_OK;
+}
+
+psc_status_t
+feed_snapshot(psc_t *psc, const void *data, size_t size)
+{
+	// Snapshots are read in place, which needs their alignment
+	void *copy = NULL;
+	if ((uintptr_t) data % sizeof(uint64_t) != 0) {
+		copy = malloc(size);
+		CHECK(copy);
+		memcpy(copy, data, size);
+		data = copy;
+	}
+
+	snapshot_t snapshot;
+	psc_status_t status = PSC_EINVAL;
+
+	if (snapshot_view(&snapshot, data, size)) {
+		procs_io_t io = {
+			.snapshot = &snapshot,
+		};
+
+		status = load_procs(psc, &io);
+	}
+
+	free(copy);
+
+	return status;
+}
+
+psc_status_t
+feed_text(psc_t *psc, const void *data, size_t size)
+{
+	if (size == 0) {
+		reset_procs(psc);
+		return PSC_ENODATA;
+	}
+
+	FILE *fp = fmemopen((void *) data, size, "r");
+	CHECK(fp);
+
+	in_stream_t stream;
+	stream_init(&stream, fp);
+
+	procs_io_t io = {
+		.stream = &stream,
+	};
+
+	psc_status_t status = load_procs(psc, &io);
+
+	stream_dinit(&stream);
+	fclose(fp);
+
+	return status;
+}
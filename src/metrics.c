@@ -0,0 +1,210 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "metrics.h"
+#include "cfg.h"
+#include "timing.h"
+
+#define CHECK(x) do { \
+	if (x) break; \
+	fprintf(stderr, "%s:%d error: %s\n", \
+			__FILE__, __LINE__, strerror(errno)); \
+	exit(EXIT_FAILURE); \
+} while (0)
+
+typedef struct {
+	size_t nframes;
+	size_t nunchanged;
+	time_t written;
+	size_t nprocesses;
+	size_t nstubs;
+	size_t nskipped;
+	size_t text_cache_hits;
+	size_t text_cache_lookups;
+} metrics_t;
+
+// The stages run on different threads
+static metrics_t metrics;
+static pthread_mutex_t metrics_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static const struct {
+	tm_stage_t stage;
+	const char *name;
+} stages[] = {
+	{TM_COLLECT,    "collect"},
+	{TM_WAIT,       "wait"},
+	{TM_LINK,       "link"},
+	{TM_REORDER,    "reorder"},
+	{TM_ARRANGE,    "arrange"},
+	{TM_COMPARE,    "compare"},
+	{TM_DRAW_TREE,  "draw_tree"},
+	{TM_DRAW_LISTS, "draw_lists"},
+	{TM_ENCODE,     "encode"},
+	{TM_WRITE,      "write"},
+};
+
+void
+metrics_collected(const procs_t *procs)
+{
+	assert(procs);
+
+	if (!config.metrics_file)
+		return;
+
+	pthread_mutex_lock(&metrics_mutex);
+	metrics.nprocesses = procs->nprocesses - 1;
+	metrics.nstubs = procs->nstubs;
+	metrics.nskipped = procs->nskipped;
+	pthread_mutex_unlock(&metrics_mutex);
+}
+
+void
+metrics_rendered(const painter_t *painter)
+{
+	assert(painter);
+
+	if (!config.metrics_file)
+		return;
+
+	pthread_mutex_lock(&metrics_mutex);
+	metrics.text_cache_hits = painter->_text_cache_hits;
+	metrics.text_cache_lookups = painter->_text_cache_lookups;
+	pthread_mutex_unlock(&metrics_mutex);
+}
+
+size_t
+resident_memory()
+{
+	FILE *fp = fopen("/proc/self/statm", "r");
+	if (!fp)
+		return 0;
+
+	unsigned long size = 0, resident = 0;
+	if (fscanf(fp, "%lu %lu", &size, &resident) != 2)
+		resident = 0;
+
+	fclose(fp);
+
+	return resident * sysconf(_SC_PAGESIZE);
+}
+
+void
+write_metric(FILE *fp, const char *name, const char *type, const char *help, double value)
+{
+	fprintf(fp, "# HELP pscircle_%s %s\n", name, help);
+	fprintf(fp, "# TYPE pscircle_%s %s\n", name, type);
+	fprintf(fp, "pscircle_%s %.17g\n", name, value);
+}
+
+void
+write_stages(FILE *fp)
+{
+	const size_t n = sizeof(stages) / sizeof(stages[0]);
+	double wall[n], cpu[n];
+	bool found[n];
+
+	for (size_t i = 0; i < n; ++i)
+		found[i] = tm_last(stages[i].stage, &wall[i], &cpu[i]);
+
+	fprintf(fp, "# HELP pscircle_stage_duration_seconds Wall time of the stage in the last frame.\n");
+	fprintf(fp, "# TYPE pscircle_stage_duration_seconds gauge\n");
+	for (size_t i = 0; i < n; ++i) {
+		if (found[i])
+			fprintf(fp, "pscircle_stage_duration_seconds{stage=\"%s\"} %.9f\n",
+					stages[i].name, wall[i]);
+	}
+
+	fprintf(fp, "# HELP pscircle_stage_cpu_seconds CPU time of the stage in the last frame.\n");
+	fprintf(fp, "# TYPE pscircle_stage_cpu_seconds gauge\n");
+	for (size_t i = 0; i < n; ++i) {
+		if (found[i])
+			fprintf(fp, "pscircle_stage_cpu_seconds{stage=\"%s\"} %.9f\n",
+					stages[i].name, cpu[i]);
+	}
+}
+
+// Expects metrics_mutex to be locked
+void
+write_file(const metrics_t *m, const painter_t *painter)
+{
+	// The file is replaced atomically, so that the collector never reads
+	// a partially written one
+	size_t l = strlen(config.metrics_file) + sizeof(".tmp");
+	char *tmp = malloc(l);
+	CHECK(tmp);
+	snprintf(tmp, l, "%s.tmp", config.metrics_file);
+
+	FILE *fp = fopen(tmp, "w");
+	if (!fp) {
+		fprintf(stderr, "Can not open %s: %s\n", tmp, strerror(errno));
+		free(tmp);
+		return;
+	}
+
+	write_metric(fp, "frames_total", "counter",
+			"Number of frames drawn.", m->nframes);
+	write_metric(fp, "unchanged_frames_total", "counter",
+			"Frames not drawn, because they look the same as the previous one.",
+			m->nunchanged);
+	write_metric(fp, "last_frame_timestamp_seconds", "gauge",
+			"Time when the last frame was written.", (double) m->written);
+
+	write_stages(fp);
+
+	write_metric(fp, "processes", "gauge",
+			"Number of processes read in the last frame.", m->nprocesses);
+	write_metric(fp, "omitted_processes", "gauge",
+			"Processes folded into \"<N omitted>\" nodes (see --max-children).", m->nstubs);
+	write_metric(fp, "skipped_processes", "gauge",
+			"Processes not shown, because PSC_MAX_PROCS_COUNT was reached.", m->nskipped);
+	write_metric(fp, "output_bytes", "gauge",
+			"Size of the last written image.", painter->_output_bytes);
+	write_metric(fp, "text_cache_hits_total", "counter",
+			"Text extents served from the cache.", m->text_cache_hits);
+	write_metric(fp, "text_cache_lookups_total", "counter",
+			"Text extents looked up in the cache.", m->text_cache_lookups);
+	write_metric(fp, "resident_memory_bytes", "gauge",
+			"Resident set size of pscircle.", resident_memory());
+
+	if (fclose(fp) != 0 || rename(tmp, config.metrics_file) != 0)
+		fprintf(stderr, "Can not write %s: %s\n", config.metrics_file, strerror(errno));
+
+	free(tmp);
+}
+
+void
+metrics_written(const painter_t *painter)
+{
+	assert(painter);
+
+	if (!config.metrics_file)
+		return;
+
+	// Workers of --jobs write at the same time, the temporary file is
+	// shared and a newer frame must not be replaced by an older one
+	pthread_mutex_lock(&metrics_mutex);
+	metrics.nframes++;
+	metrics.written = time(NULL);
+	write_file(&metrics, painter);
+	pthread_mutex_unlock(&metrics_mutex);
+}
+
+void
+metrics_unchanged(const painter_t *painter)
+{
+	assert(painter);
+
+	if (!config.metrics_file)
+		return;
+
+	pthread_mutex_lock(&metrics_mutex);
+	metrics.nunchanged++;
+	write_file(&metrics, painter);
+	pthread_mutex_unlock(&metrics_mutex);
+}
@@ -3,9 +3,21 @@
 #include <errno.h>
 #include <string.h>
 #include <assert.h>
+#include <sys/stat.h>
 
 #include "painter.h"
-#include "cfg.h"
+#include "encoder.h"
+#include "timing.h"
+
+#ifdef HAVE_X11
+#include <X11/Xatom.h>
+#include <X11/Xutil.h>
+#endif
+
+#ifdef HAVE_XSHM
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#endif
 
 #ifndef M_PI
 #define M_PI R(3.14159265358979323846)
@@ -22,13 +34,25 @@ void
 create_image_surface(painter_t *painter);
 
 void
-create_image_surface_from_png(painter_t *painter);
+destroy_image_surface(painter_t *painter);
 
 void
-destroy_image_surface(painter_t *painter);
+write_image_surface(painter_t *painter, cairo_surface_t *surface, const char *output);
+
+const char *
+shm_output_name(painter_t *painter);
 
 void
-write_image_surface(painter_t *painter);
+create_shm_frame(painter_t *painter);
+
+void
+create_shm_surface(painter_t *painter);
+
+void
+destroy_shm_surface(painter_t *painter);
+
+void
+write_shm_surface(painter_t *painter);
 
 #ifdef HAVE_X11
 void
@@ -42,7 +66,7 @@ write_xlib_surface(painter_t *painter);
 #endif
 
 void
-painter_init(painter_t *painter)
+painter_init(const psc_ctx_t *ctx, painter_t *painter)
 {
 #ifndef NDEBUG
 	uint8_t zeros[sizeof(painter_t)];
@@ -50,27 +74,66 @@ painter_init(painter_t *painter)
 	assert(memcmp(zeros, painter, sizeof(painter_t)) == 0);
 #endif
 
-	assert(config.output_width > 0);
-	assert(config.output_height > 0);
+	assert(ctx);
+
+	painter->_config = ctx->config;
+
+	assert(painter->_config->output_width > 0);
+	assert(painter->_config->output_height > 0);
 
 #ifdef HAVE_X11
-	if (config.output == NULL) {
+	if (painter->_config->output == NULL) {
 		create_xlib_surface(painter);
 	} else
 #endif
-	{
+	if (shm_output_name(painter)) {
+		create_shm_surface(painter);
+	} else {
 		create_image_surface(painter);
 	}
 
 	painter->_cr = cairo_create(painter->_surface);
 	CHECK(painter->_cr);
 
-	painter_fill_backgound_color(painter, config.background);
+	painter_clear(painter);
+}
+
+void
+painter_init_surface(const psc_ctx_t *ctx, painter_t *painter, cairo_surface_t *surface)
+{
+#ifndef NDEBUG
+	uint8_t zeros[sizeof(painter_t)];
+	memset(zeros, 0, sizeof(zeros));
+	assert(memcmp(zeros, painter, sizeof(painter_t)) == 0);
+#endif
 
-	if (config.background_image)
-		painter_fill_backgound_image(painter, config.background_image);
+	assert(ctx);
 
-	painter_center(painter);
+	painter->_config = ctx->config;
+
+	painter_set_surface(painter, surface);
+}
+
+void
+painter_set_surface(painter_t *painter, cairo_surface_t *surface)
+{
+	assert(painter);
+	assert(surface);
+	assert(!painter->_ring);
+	assert(!painter->_back);
+
+	cairo_surface_reference(surface);
+
+	if (painter->_cr)
+		cairo_destroy(painter->_cr);
+
+	if (painter->_surface)
+		cairo_surface_destroy(painter->_surface);
+
+	painter->_surface = surface;
+
+	painter->_cr = cairo_create(surface);
+	CHECK(painter->_cr);
 }
 
 void
@@ -81,100 +144,427 @@ painter_dinit(painter_t *painter)
 	assert(painter->_surface);
 
 #ifdef HAVE_X11
-	if (config.output == NULL) {
+	if (painter->_display) {
 		destroy_xlib_surface(painter);
 	} else
 #endif
-	{
+	if (painter->_ring) {
+		destroy_shm_surface(painter);
+	} else {
 		destroy_image_surface(painter);
 	}
 
+	if (painter->_background)
+		cairo_surface_destroy(painter->_background);
+
+	free(painter->_text_cache);
+
 	cairo_destroy(painter->_cr);
 }
 
 void
-create_image_surface_from_png(painter_t *painter)
+create_image_surface(painter_t *painter)
 {
-	assert(painter);
-	assert(config.background_image);
+	painter->_surface = cairo_image_surface_create(
+			CAIRO_FORMAT_ARGB32, painter->_config->output_width,
+			painter->_config->output_height);
+	CHECK(painter->_surface);
+}
+
+void
+destroy_image_surface(painter_t *painter)
+{
+	cairo_surface_destroy(painter->_surface);
+
+	if (painter->_back)
+		cairo_surface_destroy(painter->_back);
+}
+
+void
+write_image_stream(painter_t *painter, FILE *fp, image_t *img, encoder_opts_t *opts)
+{
+	bool ok = true;
+	long pos = ftell(fp);
+
+	if (painter->_nframes == 0)
+		ok = encoder_write_stream_header(fp, img, opts->format);
 
-	cairo_surface_t *sf = cairo_image_surface_create_from_png(config.background_image); 
+	ok = ok && encoder_write(fp, img, opts);
 
-	if (!sf) {
-		fprintf(stderr,
-				"Can not create surface from %s. (Only PNG is supported)\n", 
-				config.background_image);
+	tm_tick(TM_ENCODE);
+
+	if (pos >= 0) {
+		painter->_output_bytes = ftell(fp) - pos;
+	} else if (encoder_is_raw(opts->format)) {
+		// Pipes are not seekable, but raw frames have a known size
+		size_t channels = opts->format == ENCODER_BGRA ? 4 : 3;
+		painter->_output_bytes = img->width * img->height * channels;
+	}
+
+	if (fflush(fp) != 0 || !ok) {
+		fprintf(stderr, "Can not write image to stdout: %s\n", strerror(errno));
 		exit(EXIT_FAILURE);
 	}
+}
 
-	painter->_surface = sf;
+void
+write_image_file(painter_t *painter, FILE *fp, const char *path, image_t *img, encoder_opts_t *opts)
+{
+	bool ok = encoder_write(fp, img, opts);
+
+	tm_tick(TM_ENCODE);
+
+	long size = ftell(fp);
+	if (size >= 0)
+		painter->_output_bytes = size;
 
-	config.output_width = cairo_image_surface_get_width(sf);
-	config.output_height = cairo_image_surface_get_height(sf);
+	if (fclose(fp) != 0 || !ok) {
+		fprintf(stderr, "Can not write image to %s\n", path);
+		exit(EXIT_FAILURE);
+	}
 }
 
 void
-create_image_surface(painter_t *painter)
+write_image_surface(painter_t *painter, cairo_surface_t *surface, const char *output)
 {
-	painter->_surface = cairo_image_surface_create(
-			CAIRO_FORMAT_ARGB32, config.output_width, config.output_height); 
+	if (!output)
+		output = "pscircle.png";
+
+	cairo_surface_flush(surface);
+
+	image_t img = {
+		.data   = cairo_image_surface_get_data(surface),
+		.width  = cairo_image_surface_get_width(surface),
+		.height = cairo_image_surface_get_height(surface),
+		.stride = cairo_image_surface_get_stride(surface),
+	};
+
+	encoder_opts_t opts = {
+		.format          = painter->_config->output_format,
+		.png_compression = painter->_config->png_compression,
+		.png_filter      = painter->_config->png_filter,
+		.png_threads     = painter->_config->png_threads,
+	};
+
+	bool to_stdout = strcmp(output, "-") == 0;
+
+	if (opts.format == ENCODER_AUTO)
+		opts.format = to_stdout ? ENCODER_BGRA : encoder_format_from_path(output);
+
+	if (to_stdout) {
+		write_image_stream(painter, stdout, &img, &opts);
+		return;
+	}
+
+	// Regular files are replaced atomically, so that the readers never see
+	// a partially written image
+	struct stat st;
+	if (stat(output, &st) == 0 && !S_ISREG(st.st_mode)) {
+		FILE *fp = fopen(output, "wb");
+		if (!fp) {
+			fprintf(stderr, "Can not open %s: %s\n", output, strerror(errno));
+			exit(EXIT_FAILURE);
+		}
+
+		write_image_file(painter, fp, output, &img, &opts);
+		return;
+	}
+
+	size_t l = strlen(output) + sizeof(".tmp");
+	char *tmp = malloc(l);
+	CHECK(tmp);
+	snprintf(tmp, l, "%s.tmp", output);
+
+	FILE *fp = fopen(tmp, "wb");
+	if (!fp) {
+		fprintf(stderr, "Can not open %s: %s\n", tmp, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	write_image_file(painter, fp, tmp, &img, &opts);
+
+	if (rename(tmp, output) != 0) {
+		fprintf(stderr, "Can not rename %s to %s: %s\n", tmp, output, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	free(tmp);
+}
+
+const char *
+shm_output_name(painter_t *painter)
+{
+	const char prefix[] = "shm:";
+	const char *output = painter->_config->output;
+
+	if (!output || strncmp(output, prefix, sizeof(prefix) - 1) != 0)
+		return NULL;
+
+	return output + sizeof(prefix) - 1;
+}
+
+void
+create_shm_frame(painter_t *painter)
+{
+	shmring_header_t *h = painter->_ring->header;
+
+	painter->_surface = cairo_image_surface_create_for_data(
+			shmring_next(painter->_ring), CAIRO_FORMAT_ARGB32,
+			h->width, h->height, h->stride);
 	CHECK(painter->_surface);
 }
 
 void
-destroy_image_surface(painter_t *painter)
+create_shm_surface(painter_t *painter)
+{
+	const char *name = shm_output_name(painter);
+
+	painter->_ring = calloc(1, sizeof(shmring_t));
+	CHECK(painter->_ring);
+
+	if (!shmring_create(painter->_ring, name,
+				painter->_config->output_width, painter->_config->output_height,
+				SHMRING_BUFFERS)) {
+		fprintf(stderr, "Can not create shared memory %s: %s\n", name, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	create_shm_frame(painter);
+}
+
+void
+destroy_shm_surface(painter_t *painter)
 {
 	cairo_surface_destroy(painter->_surface);
+
+	shmring_close(painter->_ring);
+	free(painter->_ring);
+	painter->_ring = NULL;
 }
 
+// The surface renders directly into the ring buffer; after the frame is
+// published, drawing moves on to the next buffer of the ring
 void
-write_image_surface(painter_t *painter)
+write_shm_surface(painter_t *painter)
 {
-	const char *output = config.output;
-	if (!output)
-		output = "pscircle.png";
+	cairo_surface_flush(painter->_surface);
 
-	cairo_surface_write_to_png(painter->_surface, output);
+	shmring_publish(painter->_ring);
+
+	shmring_header_t *h = painter->_ring->header;
+	painter->_output_bytes = (size_t) h->stride * h->height;
+
+	cairo_destroy(painter->_cr);
+	cairo_surface_destroy(painter->_surface);
+
+	create_shm_frame(painter);
+
+	painter->_cr = cairo_create(painter->_surface);
+	CHECK(painter->_cr);
 }
 
 #ifdef HAVE_X11
 
+Pixmap
+xlib_current_pixmap(painter_t *painter)
+{
+	if (!painter->_image)
+		return painter->_pixmaps[0];
+
+	return painter->_pixmaps[painter->_nframes % 2];
+}
+
+// Pixels of the image are laid out exactly as cairo's RGB24/ARGB32
+bool
+xlib_image_matches_cairo(XImage *img)
+{
+	int order = 1;
+	int host = *(uint8_t *) &order ? LSBFirst : MSBFirst;
+
+	return img->bits_per_pixel == 32 &&
+		img->byte_order == host &&
+		img->red_mask == 0xff0000 &&
+		img->green_mask == 0xff00 &&
+		img->blue_mask == 0xff &&
+		img->bytes_per_line == cairo_format_stride_for_width(
+				CAIRO_FORMAT_ARGB32, img->width);
+}
+
+#ifdef HAVE_XSHM
+static bool xshm_failed = false;
+
+int
+xshm_error_handler(Display *display, XErrorEvent *event)
+{
+	xshm_failed = true;
+	return 0;
+}
+
+bool
+create_xshm_image(painter_t *painter, Visual *visual, int depth)
+{
+	Display *d = painter->_display;
+	XShmSegmentInfo *info = &painter->_shminfo;
+
+	if (!XShmQueryExtension(d))
+		return false;
+
+	XImage *img = XShmCreateImage(d, visual, depth, ZPixmap, NULL, info,
+			painter->_config->output_width, painter->_config->output_height);
+	if (!img)
+		return false;
+
+	info->shmid = shmget(IPC_PRIVATE, img->bytes_per_line * img->height,
+			IPC_CREAT | 0600);
+	if (info->shmid < 0) {
+		XDestroyImage(img);
+		return false;
+	}
+
+	info->shmaddr = img->data = shmat(info->shmid, NULL, 0);
+	info->readOnly = False;
+
+	// Fails with BadAccess if the server runs on another machine
+	xshm_failed = false;
+	int (*handler)(Display *, XErrorEvent *) = XSetErrorHandler(xshm_error_handler);
+	if (info->shmaddr != (char *) -1)
+		XShmAttach(d, info);
+	XSync(d, False);
+	XSetErrorHandler(handler);
+
+	// The segment is freed once both sides detach from it
+	shmctl(info->shmid, IPC_RMID, NULL);
+
+	if (info->shmaddr == (char *) -1 || xshm_failed) {
+		if (info->shmaddr != (char *) -1)
+			shmdt(info->shmaddr);
+		info->shmaddr = NULL;
+		img->data = NULL;
+		XDestroyImage(img);
+		return false;
+	}
+
+	painter->_image = img;
+	return true;
+}
+#endif
+
 void
-xlib_pixmap_destroy(painter_t *painter)
+create_ximage(painter_t *painter, Visual *visual, int depth)
 {
-	assert(painter);
-	assert(painter->_display);
-	assert(painter->_pixmap);
+#ifdef HAVE_XSHM
+	if (create_xshm_image(painter, visual, depth))
+		return;
+#endif
+
+	size_t stride = cairo_format_stride_for_width(
+			CAIRO_FORMAT_ARGB32, painter->_config->output_width);
+
+	char *data = malloc(stride * painter->_config->output_height);
+	CHECK(data);
 
-	if (!painter)
+	painter->_image = XCreateImage(painter->_display, visual, depth, ZPixmap,
+			0, data, painter->_config->output_width, painter->_config->output_height, 32, stride);
+	if (!painter->_image)
+		free(data);
+}
+
+void
+destroy_ximage(painter_t *painter)
+{
+	if (!painter->_image)
 		return;
+
+#ifdef HAVE_XSHM
+	if (painter->_shminfo.shmaddr) {
+		XShmDetach(painter->_display, &painter->_shminfo);
+		XSync(painter->_display, False);
+		shmdt(painter->_shminfo.shmaddr);
+		painter->_image->data = NULL;
+		painter->_shminfo.shmaddr = NULL;
+	}
+#endif
+
+	XDestroyImage(painter->_image);
+	painter->_image = NULL;
+}
+
+// Frees the pixmap retained by the previous run (see destroy_xlib_surface)
+// or by another program that set the background in the same way
+void
+kill_root_pixmap(painter_t *painter)
+{
+	Display *d = painter->_display;
+	Pixmap ids[2] = {0};
+
+	for (int i = 0; i < 2; ++i) {
+		Atom type;
+		int format;
+		unsigned long n, after;
+		unsigned char *data = NULL;
+
+		if (XGetWindowProperty(d, painter->_window, painter->_rootpmap_atoms[i],
+					0, 1, False, AnyPropertyType, &type, &format, &n,
+					&after, &data) == Success && type == XA_PIXMAP && n == 1)
+			ids[i] = *(Pixmap *) data;
+
+		if (data)
+			XFree(data);
+	}
+
+	if (ids[0] && ids[0] == ids[1])
+		XKillClient(d, ids[0]);
 }
 
 void
 create_xlib_surface(painter_t *painter)
 {
-	painter->_display = XOpenDisplay(config.output_display);
+	painter->_display = XOpenDisplay(painter->_config->output_display);
 	if (!painter->_display) {
-		fprintf(stderr, "Unable to open display: '%s'\n", XDisplayName(config.output_display));
+		fprintf(stderr, "Unable to open display: '%s'\n",
+				XDisplayName(painter->_config->output_display));
 		exit(EXIT_FAILURE);
 	}
 
-	int screen = DefaultScreen(painter->_display);
-	painter->_window = RootWindow(painter->_display, screen);
-
-	int depth = DefaultDepth(painter->_display, screen);
-	painter->_pixmap = XCreatePixmap(painter->_display, painter->_window,
-			config.output_width, config.output_height, depth);
-
-	Visual *visual = DefaultVisual(painter->_display, screen);
-	painter->_surface = cairo_xlib_surface_create(painter->_display,
-			painter->_pixmap, visual, config.output_width,
-			config.output_height);
-
-	cairo_surface_set_user_data(painter->_surface, NULL, NULL, NULL);
+	Display *d = painter->_display;
+	int screen = DefaultScreen(d);
+	painter->_window = RootWindow(d, screen);
+
+	painter->_rootpmap_atoms[0] = XInternAtom(d, "_XROOTPMAP_ID", False);
+	painter->_rootpmap_atoms[1] = XInternAtom(d, "ESETROOT_PMAP_ID", False);
+
+	int depth = DefaultDepth(d, screen);
+	Visual *visual = DefaultVisual(d, screen);
+
+	// The frame is rendered locally and uploaded at once (through shared
+	// memory if the server supports it), instead of sending every
+	// primitive over the wire
+	if (visual->class == TrueColor && (depth == 24 || depth == 32))
+		create_ximage(painter, visual, depth);
+
+	if (painter->_image && !xlib_image_matches_cairo(painter->_image))
+		destroy_ximage(painter);
+
+	size_t npixmaps = painter->_image ? 2 : 1;
+	for (size_t i = 0; i < npixmaps; ++i)
+		painter->_pixmaps[i] = XCreatePixmap(d, painter->_window,
+				painter->_config->output_width, painter->_config->output_height, depth);
+
+	if (painter->_image) {
+		painter->_gc = XCreateGC(d, painter->_pixmaps[0], 0, NULL);
+
+		painter->_surface = cairo_image_surface_create_for_data(
+				(unsigned char *) painter->_image->data,
+				depth == 32 ? CAIRO_FORMAT_ARGB32 : CAIRO_FORMAT_RGB24,
+				painter->_config->output_width, painter->_config->output_height,
+				painter->_image->bytes_per_line);
+	} else {
+		painter->_surface = cairo_xlib_surface_create(d,
+				painter->_pixmaps[0], visual, painter->_config->output_width,
+				painter->_config->output_height);
+	}
 
-	cairo_xlib_surface_set_size(painter->_surface,
-			config.output_width, config.output_height);
+	CHECK(painter->_surface);
 }
 
 void
@@ -185,12 +575,31 @@ destroy_xlib_surface(painter_t *painter)
 	assert(painter->_window);
 	assert(painter->_surface);
 
-	XFreePixmap(painter->_display, painter->_pixmap);
+	Display *d = painter->_display;
 
-	XClearWindow(painter->_display, painter->_window);
+	// The pixmap shown on the root window outlives the process, so that
+	// compositors reading _XROOTPMAP_ID still find it. It is freed by
+	// kill_root_pixmap when the background is set next time.
+	Pixmap shown = 0;
+	if (painter->_nframes > 0)
+		shown = painter->_pixmaps[painter->_image ? (painter->_nframes - 1) % 2 : 0];
 
 	cairo_surface_destroy(painter->_surface);
-	XCloseDisplay(painter->_display);
+
+	destroy_ximage(painter);
+
+	if (painter->_gc)
+		XFreeGC(d, painter->_gc);
+
+	for (size_t i = 0; i < 2; ++i) {
+		if (painter->_pixmaps[i] && painter->_pixmaps[i] != shown)
+			XFreePixmap(d, painter->_pixmaps[i]);
+	}
+
+	if (shown)
+		XSetCloseDownMode(d, RetainPermanent);
+
+	XCloseDisplay(d);
 }
 
 void
@@ -199,13 +608,57 @@ write_xlib_surface(painter_t *painter)
 	assert(painter);
 	assert(painter->_display);
 	assert(painter->_window);
-	assert(painter->_pixmap);
 
-	XSetWindowBackgroundPixmap(painter->_display, painter->_window, painter->_pixmap);
+	Display *d = painter->_display;
+	Pixmap pixmap = xlib_current_pixmap(painter);
+
+	if (painter->_nframes == 0)
+		kill_root_pixmap(painter);
+
+	cairo_surface_flush(painter->_surface);
+
+	if (painter->_image) {
+		XImage *img = painter->_image;
+#ifdef HAVE_XSHM
+		if (painter->_shminfo.shmaddr)
+			XShmPutImage(d, pixmap, painter->_gc, img, 0, 0, 0, 0,
+					img->width, img->height, False);
+		else
+#endif
+			XPutImage(d, pixmap, painter->_gc, img, 0, 0, 0, 0,
+					img->width, img->height);
+
+		painter->_output_bytes = (size_t) img->bytes_per_line * img->height;
+	}
+
+	for (size_t i = 0; i < 2; ++i)
+		XChangeProperty(d, painter->_window, painter->_rootpmap_atoms[i],
+				XA_PIXMAP, 32, PropModeReplace, (unsigned char *) &pixmap, 1);
+
+	XSetWindowBackgroundPixmap(d, painter->_window, pixmap);
+	XClearWindow(d, painter->_window);
+
+	// The image is drawn over again only after the server has copied it
+	XSync(d, False);
 }
 #endif
 
 
+void
+painter_clear(painter_t *painter)
+{
+	assert(painter);
+
+	cairo_identity_matrix(painter->_cr);
+
+	painter_fill_backgound_color(painter, painter->_config->background);
+
+	if (painter->_config->background_image)
+		painter_fill_backgound_image(painter, painter->_config->background_image);
+
+	painter_center(painter);
+}
+
 void
 painter_save(painter_t *painter)
 {
@@ -228,14 +681,101 @@ painter_write(painter_t *painter)
 	assert(painter);
 
 #ifdef HAVE_X11
-	if (config.output == NULL) {
+	if (painter->_config->output == NULL) {
 		write_xlib_surface(painter);
 	} else
 #endif
+	if (painter->_ring) {
+		write_shm_surface(painter);
+	} else {
+		write_image_surface(painter, painter->_surface, painter->_config->output);
+	}
+
+	tm_tick(TM_WRITE);
+
+	painter->_nframes++;
+}
+
+bool
+painter_can_swap(painter_t *painter)
+{
+	assert(painter);
+
+#ifdef HAVE_X11
+	if (painter->_config->output == NULL)
+		return false;
+#endif
 
-	{
-		write_image_surface(painter);
+	return painter->_ring == NULL;
+}
+
+cairo_surface_t *
+painter_swap(painter_t *painter)
+{
+	assert(painter);
+	assert(painter_can_swap(painter));
+
+	if (!painter->_back) {
+		painter->_back = cairo_image_surface_create(CAIRO_FORMAT_ARGB32,
+				painter->_config->output_width, painter->_config->output_height);
+		CHECK(painter->_back);
 	}
+
+	cairo_surface_t *done = painter->_surface;
+	cairo_surface_flush(done);
+
+	painter->_surface = painter->_back;
+	painter->_back = done;
+
+	cairo_destroy(painter->_cr);
+	painter->_cr = cairo_create(painter->_surface);
+	CHECK(painter->_cr);
+
+	return done;
+}
+
+void
+painter_write_surface(painter_t *painter, cairo_surface_t *surface)
+{
+	assert(painter);
+	assert(surface);
+
+	write_image_surface(painter, surface, painter->_config->output);
+
+	tm_tick(TM_WRITE);
+
+	painter->_nframes++;
+}
+
+void
+painter_write_to(painter_t *painter, const char *path)
+{
+	assert(painter);
+	assert(path);
+	assert(painter_can_swap(painter));
+
+	write_image_surface(painter, painter->_surface, path);
+
+	tm_tick(TM_WRITE);
+
+	painter->_nframes++;
+}
+
+size_t
+text_cache_index(const char *str, real_t font_size)
+{
+	// FNV-1a
+	uint64_t h = 14695981039346656037ULL;
+
+	for (const char *c = str; *c; ++c) {
+		h ^= (uint8_t) *c;
+		h *= 1099511628211ULL;
+	}
+
+	h ^= (uint64_t) (font_size * 64);
+	h *= 1099511628211ULL;
+
+	return h % PSC_TEXT_CACHE_SIZE;
 }
 
 point_t
@@ -244,6 +784,25 @@ painter_text_size(painter_t *painter, const char *str)
 	assert(painter);
 	assert(str);
 
+	text_cache_entry_t *e = NULL;
+
+	if (painter->_font_face && strlen(str) < PSC_LABEL_BUFSIZE) {
+		if (!painter->_text_cache) {
+			painter->_text_cache = calloc(PSC_TEXT_CACHE_SIZE, sizeof(text_cache_entry_t));
+			CHECK(painter->_text_cache);
+		}
+
+		e = painter->_text_cache + text_cache_index(str, painter->_font_size);
+		painter->_text_cache_lookups++;
+
+		if (e->font_face == painter->_font_face &&
+				e->font_size == painter->_font_size &&
+				strcmp(e->str, str) == 0) {
+			painter->_text_cache_hits++;
+			return e->size;
+		}
+	}
+
 	cairo_text_extents_t extents;
 	cairo_text_extents(painter->_cr, str, &extents);
 
@@ -252,6 +811,13 @@ painter_text_size(painter_t *painter, const char *str)
 		.y = -extents.y_bearing
 	};
 
+	if (e) {
+		strcpy(e->str, str);
+		e->font_face = painter->_font_face;
+		e->font_size = painter->_font_size;
+		e->size = p;
+	}
+
 	return p;
 }
 
@@ -260,7 +826,7 @@ painter_text_int_size(painter_t *painter, int n)
 {
 	assert(painter);
 
-	static char buf[PSC_LABEL_BUFSIZE] = {0};
+	char buf[PSC_LABEL_BUFSIZE];
 	snprintf(buf, PSC_LABEL_BUFSIZE, "%d", n);
 
 	return painter_text_size(painter, buf);
@@ -272,7 +838,7 @@ painter_center(painter_t *painter)
 	assert(painter);
 
 	cairo_translate(painter->_cr,
-			config.output_width/2, config.output_height/2);
+			painter->_config->output_width/2, painter->_config->output_height/2);
 }
 
 void
@@ -286,7 +852,8 @@ painter_translate(painter_t *painter, point_t position)
 void
 painter_fill_backgound_color(painter_t *painter, color_t background)
 {
-	cairo_rectangle(painter->_cr, 0, 0, config.output_width, config.output_height);
+	cairo_rectangle(painter->_cr, 0, 0,
+			painter->_config->output_width, painter->_config->output_height);
 
 	cairo_set_source_rgba(painter->_cr,
 		background.r,
@@ -296,6 +863,8 @@ painter_fill_backgound_color(painter_t *painter, color_t background)
 	);
 
 	cairo_fill(painter->_cr);
+
+	painter->_nprimitives++;
 }
 
 void
@@ -304,17 +873,54 @@ painter_fill_backgound_image(painter_t *painter, const char *imgpah)
 	assert(painter);
 	assert(imgpah);
 
-	cairo_surface_t *img = cairo_image_surface_create_from_png(imgpah); 
-	if (!img) {
+	if (!painter_load_background(painter, imgpah)) {
 		fprintf(stderr, "Can not open image %s. (Only PNG is supported)\n", imgpah);
 		exit(EXIT_FAILURE);
 	}
 
 	// XXX: Can not draw at 0:0 on Xlib surfaces for some reasons
-	cairo_set_source_surface(painter->_cr, img, 0.05, 0.05);
+	cairo_set_source_surface(painter->_cr, painter->_background, 0.05, 0.05);
 	cairo_paint(painter->_cr);
 
-	cairo_surface_destroy(img);
+	painter->_nprimitives++;
+}
+
+void
+painter_set_background(painter_t *painter, cairo_surface_t *image)
+{
+	assert(painter);
+	assert(image);
+
+	cairo_surface_reference(image);
+
+	if (painter->_background)
+		cairo_surface_destroy(painter->_background);
+
+	painter->_background = image;
+}
+
+bool
+painter_load_background(painter_t *painter, const char *imgpath)
+{
+	assert(painter);
+	assert(imgpath);
+
+	// Loaded once and reused for every frame
+	if (painter->_background)
+		return true;
+
+	cairo_surface_t *img = cairo_image_surface_create_from_png(imgpath);
+	if (!img)
+		return false;
+
+	if (cairo_surface_status(img) != CAIRO_STATUS_SUCCESS) {
+		cairo_surface_destroy(img);
+		return false;
+	}
+
+	painter->_background = img;
+
+	return true;
 }
 
 void
@@ -326,12 +932,16 @@ painter_set_font_face(painter_t *painter, const char *fontface)
 		CAIRO_FONT_SLANT_NORMAL,
 		CAIRO_FONT_WEIGHT_NORMAL
 	);
+
+	painter->_font_face = fontface;
 }
 
 void
 painter_set_font_size(painter_t *painter, real_t fontsize)
 {
 	cairo_set_font_size(painter->_cr, fontsize);
+
+	painter->_font_size = fontsize;
 }
 
 void
@@ -371,6 +981,8 @@ painter_draw_circle(painter_t *painter, circle_t circle)
 
 	cairo_stroke(painter->_cr);
 
+
+	painter->_nprimitives++;
 }
 
 void
@@ -391,6 +1003,8 @@ painter_draw_line(painter_t *painter, line_t line)
 		cairo_set_line_width(painter->_cr, line.width);
 
 	cairo_stroke(painter->_cr);
+
+	painter->_nprimitives++;
 }
 
 void
@@ -417,6 +1031,8 @@ painter_draw_curve(painter_t *painter, curve_t curve)
 		cairo_set_line_width(painter->_cr, curve.width);
 
 	cairo_stroke(painter->_cr);
+
+	painter->_nprimitives++;
 }
 
 void
@@ -441,4 +1057,6 @@ painter_draw_text(painter_t *painter, text_t text)
 	cairo_stroke(painter->_cr);
 
 	cairo_restore(painter->_cr);
+
+	painter->_nprimitives++;
 }
@@ -0,0 +1,1165 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <ctype.h>
+#include <limits.h>
+#include <assert.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "pipeline.h"
+#include "cfg.h"
+#include "timing.h"
+#include "metrics.h"
+#include "delta.h"
+#include "snapshot.h"
+#include "hosts.h"
+#include "control.h"
+#include "queue.h"
+#include "utils.h"
+#include "tree_visualizer.h"
+#include "toplist_visualizer.h"
+
+#define CHECK(x) do { \
+	if (x) break; \
+	fprintf(stderr, "%s:%d error: %s\n", \
+			__FILE__, __LINE__, strerror(errno)); \
+	exit(EXIT_FAILURE); \
+} while (0)
+
+// Draws and writes one of several outputs on its own thread
+typedef struct {
+	pipeline_output_t *output;
+	pthread_t thread;
+
+	// procs_t: todo -> done
+	queue_t todo;
+	queue_t done;
+} output_worker_t;
+
+typedef struct {
+	psc_ctx_t *ctx;
+	pipeline_output_t *outputs;
+	size_t noutputs;
+	output_worker_t *workers;
+	const procs_io_t *io;
+	// NULL without --control
+	control_t *control;
+	// Options of the collector, --control applies the shared options
+	// to this copy, the global config is not written after startup
+	cfg_t shared;
+
+	// procs_t: free -> collected -> free
+	queue_t free_procs;
+	queue_t collected;
+
+	// Surfaces of the painter: rendered -> written (see painter_swap)
+	queue_t rendered;
+	queue_t written;
+} pipeline_t;
+
+// Draws every nworkers-th frame of a time-lapse starting from 'first'
+typedef struct {
+	const psc_ctx_t *ctx;
+	painter_t painter;
+	pthread_t thread;
+	size_t first;
+	size_t nworkers;
+	bool stream;
+
+	procs_t procs[PIPELINE_DEPTH];
+
+	// procs: free -> collected -> free
+	queue_t free_procs;
+	queue_t collected;
+
+	// Surfaces of the painter with --output=-: rendered -> written
+	queue_t rendered;
+	queue_t written;
+} worker_t;
+
+typedef struct {
+	worker_t *workers;
+	size_t nworkers;
+} timelapse_t;
+
+// Options of the input and of the processes, which are collected once
+// for all the outputs
+static const char *shared_options[] = {
+	"stdin", "procfs-root", "record", "replay", "at", "frames", "jobs",
+	"batch-input", "batch-output", "hosts", "max-nodes",
+	"interval", "loop", "profile", "trace", "metrics-file", "outputs", "control",
+	"root-pid", "max-children", "memory-unit",
+	"cpulist-label", "cpulist-bar-value", "memlist-label", "memlist-bar-value",
+};
+
+bool
+pipeline_output_option(const char *name)
+{
+	assert(name);
+
+	size_t n = sizeof(shared_options) / sizeof(shared_options[0]);
+	for (size_t i = 0; i < n; ++i) {
+		if (strcmp(name, shared_options[i]) == 0)
+			return false;
+	}
+
+	return true;
+}
+
+// Applies "name=value" to the options parsed by argp
+bool
+set_output_option(argparser_t *argp, const char *option, size_t length)
+{
+	char name[PSC_ARG_KEY_BUFSIZE + 1];
+
+	const char *eq = memchr(option, '=', length);
+	if (!eq || eq == option || (size_t) (eq - option) > PSC_ARG_KEY_BUFSIZE - 2)
+		return false;
+
+	size_t l = eq - option;
+	memcpy(name, option, l);
+	name[l] = '\0';
+
+	if (!pipeline_output_option(name))
+		return false;
+
+	char *arg = malloc(length + 3);
+	CHECK(arg);
+
+	snprintf(arg, length + 3, "--%.*s", (int) length, option);
+
+	bool ok = argparser_set(argp, arg);
+
+	free(arg);
+
+	return ok;
+}
+
+bool
+pipeline_parse_outputs(const char *str, const cfg_t *base, cfg_t **configs, size_t *nconfigs)
+{
+	assert(str);
+	assert(base);
+	assert(configs);
+	assert(nconfigs);
+
+	size_t n = 1;
+	for (const char *p = str; *p; ++p) {
+		if (*p == ';')
+			n++;
+	}
+
+	cfg_t *cfgs = calloc(n, sizeof(cfg_t));
+	CHECK(cfgs);
+
+	argparser_t *argp = malloc(sizeof(argparser_t));
+	CHECK(argp);
+
+	const char *p = str;
+	size_t nstdout = 0;
+	bool ok = true;
+
+	for (size_t i = 0; i < n && ok; ++i) {
+		cfg_t *cfg = cfgs + i;
+		*cfg = *base;
+
+		memset(argp, 0, sizeof(argparser_t));
+		argparser_init(argp);
+		cfg_args(argp, cfg);
+
+		const char *end = strchr(p, ';');
+		if (!end)
+			end = p + strlen(p);
+
+		// Empty options (and outputs) are rejected as they have no '='
+		while (ok) {
+			const char *comma = memchr(p, ',', end - p);
+			if (!comma)
+				comma = end;
+
+			ok = set_output_option(argp, p, comma - p);
+
+			if (comma == end)
+				break;
+
+			p = comma + 1;
+		}
+
+		p = end + 1;
+
+		// output= draws on the X11 root window of --output-display
+		if (cfg->output && *cfg->output == '\0')
+			cfg->output = NULL;
+
+		if (cfg->output && strcmp(cfg->output, "-") == 0)
+			nstdout++;
+	}
+
+	free(argp);
+
+	// Frames of several outputs can not be told apart on stdout
+	if (!ok || nstdout > 1) {
+		free(cfgs);
+		return false;
+	}
+
+	*configs = cfgs;
+	*nconfigs = n;
+
+	return true;
+}
+
+pipeline_output_t *
+pipeline_outputs_init(size_t *noutputs)
+{
+	assert(noutputs);
+
+	cfg_t *configs = NULL;
+	size_t n = 1;
+
+	if (config.outputs) {
+		if (!pipeline_parse_outputs(config.outputs, &config, &configs, &n)) {
+			fprintf(stderr, "Invalid --outputs: %s\n"
+					"Options of the input and of the processes are set for "
+					"all the outputs, and at most one output is -\n",
+					config.outputs);
+			exit(EXIT_FAILURE);
+		}
+	} else {
+		configs = malloc(sizeof(cfg_t));
+		CHECK(configs);
+		configs[0] = config;
+	}
+
+	pipeline_output_t *outputs = calloc(n, sizeof(pipeline_output_t));
+	CHECK(outputs);
+
+	for (size_t i = 0; i < n; ++i) {
+		pipeline_output_t *o = outputs + i;
+
+		o->config = configs[i];
+		psc_ctx_init(&o->ctx, &o->config);
+		painter_init(&o->ctx, &o->painter);
+	}
+
+	free(configs);
+
+	*noutputs = n;
+
+	return outputs;
+}
+
+void
+pipeline_outputs_dinit(pipeline_output_t *outputs, size_t noutputs)
+{
+	assert(outputs);
+
+	for (size_t i = 0; i < noutputs; ++i) {
+		painter_dinit(&outputs[i].painter);
+		psc_ctx_dinit(&outputs[i].ctx);
+	}
+
+	free(outputs);
+}
+
+// Same as pipeline_collect, snapshots requested on the control socket are
+// written before the processes are linked
+void
+collect_frame(psc_ctx_t *ctx, procs_t *procs, const procs_io_t *io, control_t *control)
+{
+	procs_read(ctx, procs, io);
+
+	if (control)
+		control_collected(control, procs);
+
+	procs_link(ctx, procs);
+
+	tm_count(TM_LINK, TM_NODES, procs->nprocesses);
+	tm_tick(TM_LINK);
+
+	node_reorder_by_leaves((node_t *)procs->root);
+
+	tm_count(TM_REORDER, TM_NODES, procs->nprocesses);
+	tm_tick(TM_REORDER);
+
+	node_arrange((node_t *)procs->root);
+
+	tm_count(TM_ARRANGE, TM_NODES, procs->nprocesses);
+	tm_tick(TM_ARRANGE);
+
+	metrics_collected(procs);
+}
+
+void
+pipeline_collect(psc_ctx_t *ctx, procs_t *procs, const procs_io_t *io)
+{
+	assert(ctx);
+	assert(procs);
+
+	collect_frame(ctx, procs, io, NULL);
+}
+
+void
+pipeline_render(const psc_ctx_t *ctx, painter_t *painter, procs_t *procs)
+{
+	assert(ctx);
+	assert(painter);
+	assert(procs);
+
+	size_t nprimitives = painter->_nprimitives;
+	size_t nhits = painter->_text_cache_hits;
+
+	painter_clear(painter);
+
+	draw_tree(ctx, painter, procs);
+
+	tm_count(TM_DRAW_TREE, TM_NODES, procs->nprocesses);
+	tm_count(TM_DRAW_TREE, TM_PRIMITIVES, painter->_nprimitives - nprimitives);
+	tm_count(TM_DRAW_TREE, TM_CACHE_HITS, painter->_text_cache_hits - nhits);
+	tm_tick(TM_DRAW_TREE);
+
+	const toplists_t *toplists = &ctx->config->toplists;
+	if (toplists->cpulist.show || toplists->memlist.show) {
+		nprimitives = painter->_nprimitives;
+		nhits = painter->_text_cache_hits;
+
+		draw_toplists(ctx, painter, procs);
+
+		tm_count(TM_DRAW_LISTS, TM_PRIMITIVES, painter->_nprimitives - nprimitives);
+		tm_count(TM_DRAW_LISTS, TM_CACHE_HITS, painter->_text_cache_hits - nhits);
+		tm_tick(TM_DRAW_LISTS);
+	}
+
+	metrics_rendered(painter);
+}
+
+uint64_t
+pipeline_frame_hash(const psc_ctx_t *ctx, const procs_t *procs)
+{
+	assert(ctx);
+	assert(procs);
+
+	// Options set on the control socket change the frame as well. Strings
+	// are hashed by their pointers, which are not reused (see control.h).
+	uint64_t h = hash_bytes(HASH_SEED, ctx->config, sizeof(cfg_t));
+
+	h = hash_tree(ctx, procs, h);
+
+	const toplists_t *toplists = &ctx->config->toplists;
+	if (toplists->cpulist.show || toplists->memlist.show)
+		h = hash_toplists(ctx, procs, h);
+
+	return h;
+}
+
+bool
+pipeline_unchanged(pipeline_output_t *output, const procs_t *procs)
+{
+	assert(output);
+	assert(procs);
+
+	const cfg_t *cfg = &output->config;
+
+	// Consumers of stdout count on a frame per --interval
+	if (!cfg->loop || !cfg->skip_unchanged ||
+			(cfg->output && strcmp(cfg->output, "-") == 0)) {
+		output->drawn = false;
+		output->unchanged = false;
+		return false;
+	}
+
+	uint64_t h = pipeline_frame_hash(&output->ctx, procs);
+
+	output->unchanged = output->drawn && h == output->hash;
+	output->hash = h;
+	output->drawn = true;
+
+	tm_count(TM_COMPARE, TM_NODES, procs->nprocesses);
+	if (output->unchanged)
+		tm_count(TM_COMPARE, TM_SKIPPED, 1);
+	tm_tick(TM_COMPARE);
+
+	return output->unchanged;
+}
+
+// Snapshots of pscircle-collect start with SNAPSHOT_MAGIC, "PSCS", and
+// the output of ps with a pid. Blocks until the first byte arrives, which
+// is read past stdio as the text stream reads the file descriptor.
+// Returns EOF if stdin is empty.
+int
+stdin_first_byte()
+{
+	unsigned char c;
+	ssize_t n;
+	do {
+		n = read(STDIN_FILENO, &c, 1);
+	} while (n < 0 && errno == EINTR);
+
+	return n == 1 ? c : EOF;
+}
+
+// Returns false at the end of the input
+bool
+next_frame(const procs_io_t *io)
+{
+	// Waits for the next frame on stdin
+	if (io->stream)
+		return !stream_at_end(io->stream);
+
+	if (io->snapshots && !snapshot_stream_next(io->snapshots)) {
+		if (errno == EINVAL)
+			fprintf(stderr, "Snapshot on stdin is corrupted or truncated\n");
+		return false;
+	}
+
+	if (io->replay && !delta_reader_next(io->replay)) {
+		if (errno == EINVAL)
+			fprintf(stderr, "%s is corrupted or truncated after frame %zu\n",
+					config.replay, io->replay->nframes);
+		return false;
+	}
+
+	return true;
+}
+
+void *
+collect_thread(void *arg)
+{
+	pipeline_t *pl = arg;
+
+	tm_thread_name("collect");
+
+	do {
+		procs_t *procs = queue_pop(&pl->free_procs);
+
+		if (!next_frame(pl->io))
+			break;
+
+		tm_start();
+
+		if (pl->control) {
+			cfg_t *cfg = &pl->shared;
+			control_apply(pl->control, &cfg, 1, true);
+		}
+
+		memset(procs, 0, sizeof(procs_t));
+		collect_frame(pl->ctx, procs, pl->io, pl->control);
+
+		queue_push(&pl->collected, procs);
+
+		// /proc is sampled over --interval (see linux_wait), snapshots
+		// and the files of the hosts are read at the same rate
+		if (pl->shared.replay || pl->shared.hosts)
+			psc_ctx_sleep(pl->ctx, pl->shared.interval);
+	} while (pl->shared.loop);
+
+	queue_push(&pl->collected, NULL);
+
+	return NULL;
+}
+
+void *
+write_thread(void *arg)
+{
+	pipeline_t *pl = arg;
+
+	tm_thread_name("write");
+
+	while (true) {
+		cairo_surface_t *surface = queue_pop(&pl->rendered);
+		if (!surface)
+			break;
+
+		tm_start();
+
+		painter_t *painter = &pl->outputs->painter;
+
+		painter_write_surface(painter, surface);
+
+		metrics_written(painter);
+
+		queue_push(&pl->written, surface);
+	}
+
+	return NULL;
+}
+
+void *
+output_thread(void *arg)
+{
+	output_worker_t *w = arg;
+
+	tm_thread_name("render");
+
+	while (true) {
+		procs_t *procs = queue_pop(&w->todo);
+		if (!procs)
+			break;
+
+		tm_start();
+
+		if (!pipeline_unchanged(w->output, procs)) {
+			pipeline_render(&w->output->ctx, &w->output->painter, procs);
+
+			painter_write(&w->output->painter);
+		}
+
+		queue_push(&w->done, procs);
+	}
+
+	return NULL;
+}
+
+// Starts a thread per output if there are several of them
+output_worker_t *
+start_output_workers(pipeline_output_t *outputs, size_t noutputs)
+{
+	if (noutputs < 2)
+		return NULL;
+
+	output_worker_t *workers = calloc(noutputs, sizeof(output_worker_t));
+	CHECK(workers);
+
+	for (size_t i = 0; i < noutputs; ++i) {
+		output_worker_t *w = workers + i;
+
+		w->output = outputs + i;
+		queue_init(&w->todo);
+		queue_init(&w->done);
+
+		CHECK(pthread_create(&w->thread, NULL, output_thread, w) == 0);
+	}
+
+	return workers;
+}
+
+void
+stop_output_workers(output_worker_t *workers, size_t noutputs)
+{
+	if (!workers)
+		return;
+
+	for (size_t i = 0; i < noutputs; ++i)
+		queue_push(&workers[i].todo, NULL);
+
+	for (size_t i = 0; i < noutputs; ++i) {
+		pthread_join(workers[i].thread, NULL);
+
+		queue_dinit(&workers[i].todo);
+		queue_dinit(&workers[i].done);
+	}
+
+	free(workers);
+}
+
+// Draws the processes on every output and writes them, on the output
+// threads if there are any. A frame is counted once in --metrics-file.
+// Returns false if no output has changed (see pipeline_unchanged).
+bool
+draw_outputs(pipeline_output_t *outputs, size_t noutputs,
+		output_worker_t *workers, procs_t *procs)
+{
+	bool drawn = false;
+
+	if (!workers) {
+		drawn = !pipeline_unchanged(outputs, procs);
+
+		if (drawn) {
+			pipeline_render(&outputs->ctx, &outputs->painter, procs);
+
+			painter_write(&outputs->painter);
+		}
+	} else {
+		for (size_t i = 0; i < noutputs; ++i)
+			queue_push(&workers[i].todo, procs);
+
+		// The processes are shared, so every output has to finish
+		// before they are freed
+		for (size_t i = 0; i < noutputs; ++i) {
+			queue_pop(&workers[i].done);
+
+			if (!outputs[i].unchanged)
+				drawn = true;
+		}
+	}
+
+	if (drawn)
+		metrics_written(&outputs->painter);
+	else
+		metrics_unchanged(&outputs->painter);
+
+	return drawn;
+}
+
+// Draws the only output and hands its surface over to the write thread.
+// Returns false if the frame is skipped.
+bool
+render_swap(pipeline_t *pl, procs_t *procs, size_t *nbuffers)
+{
+	pipeline_output_t *output = pl->outputs;
+
+	if (pipeline_unchanged(output, procs)) {
+		metrics_unchanged(&output->painter);
+		return false;
+	}
+
+	if (*nbuffers == 0)
+		queue_pop(&pl->written);
+	else
+		(*nbuffers)--;
+
+	// Waiting for the write thread is not a part of the stages
+	tm_start();
+
+	pipeline_render(&output->ctx, &output->painter, procs);
+
+	queue_push(&pl->rendered, painter_swap(&output->painter));
+
+	return true;
+}
+
+// Applies the options of the outputs received on the control socket.
+// Outputs are not drawn at this point, the previous frame is finished.
+void
+apply_output_options(pipeline_t *pl)
+{
+	cfg_t *cfgs[pl->noutputs];
+	for (size_t i = 0; i < pl->noutputs; ++i)
+		cfgs[i] = &pl->outputs[i].config;
+
+	control_apply(pl->control, cfgs, pl->noutputs, false);
+}
+
+// Renders on the calling thread
+void
+render_loop(pipeline_t *pl, bool async_write)
+{
+	tm_thread_name("render");
+
+	// Both buffers of the painter are free
+	size_t nbuffers = PIPELINE_DEPTH;
+
+	while (true) {
+		procs_t *procs = queue_pop(&pl->collected);
+		if (!procs)
+			break;
+
+		tm_start();
+
+		struct timespec start;
+		if (pl->control) {
+			clock_gettime(CLOCK_MONOTONIC, &start);
+			apply_output_options(pl);
+		}
+
+		bool drawn;
+		if (async_write)
+			drawn = render_swap(pl, procs, &nbuffers);
+		else
+			drawn = draw_outputs(pl->outputs, pl->noutputs, pl->workers, procs);
+
+		if (pl->control) {
+			struct timespec end;
+			clock_gettime(CLOCK_MONOTONIC, &end);
+
+			double seconds = (end.tv_sec - start.tv_sec) +
+				(end.tv_nsec - start.tv_nsec) * 1e-9;
+
+			control_rendered(pl->control, procs, seconds, !drawn);
+		}
+
+		procs_dinit(procs);
+		queue_push(&pl->free_procs, procs);
+	}
+
+	if (async_write)
+		queue_push(&pl->rendered, NULL);
+}
+
+void
+run_threaded(psc_ctx_t *ctx, pipeline_output_t *outputs, size_t noutputs,
+		output_worker_t *workers, const procs_io_t *io, control_t *control)
+{
+	pipeline_t pl = {
+		.ctx = ctx,
+		.outputs = outputs,
+		.noutputs = noutputs,
+		.workers = workers,
+		.io = io,
+		.control = control,
+		.shared = *ctx->config,
+	};
+
+	// The collector reads its options through ctx (e.g. --interval in
+	// linux_wait), outputs have their own contexts
+	const cfg_t *ctx_config = ctx->config;
+	ctx->config = &pl.shared;
+
+	queue_init(&pl.free_procs);
+	queue_init(&pl.collected);
+	queue_init(&pl.rendered);
+	queue_init(&pl.written);
+
+	procs_t *procs[PIPELINE_DEPTH];
+	for (size_t i = 0; i < PIPELINE_DEPTH; ++i) {
+		procs[i] = malloc(sizeof(procs_t));
+		CHECK(procs[i]);
+		queue_push(&pl.free_procs, procs[i]);
+	}
+
+	// X11 and shared memory outputs are cheap to write and have a single
+	// buffer, they are written by the render stage. Several outputs are
+	// written by their own threads.
+	bool async_write = !workers && painter_can_swap(&outputs->painter);
+
+	pthread_t collector, writer;
+	CHECK(pthread_create(&collector, NULL, collect_thread, &pl) == 0);
+
+	if (async_write)
+		CHECK(pthread_create(&writer, NULL, write_thread, &pl) == 0);
+
+	render_loop(&pl, async_write);
+
+	pthread_join(collector, NULL);
+
+	if (async_write)
+		pthread_join(writer, NULL);
+
+	for (size_t i = 0; i < PIPELINE_DEPTH; ++i)
+		free(procs[i]);
+
+	queue_dinit(&pl.free_procs);
+	queue_dinit(&pl.collected);
+	queue_dinit(&pl.rendered);
+	queue_dinit(&pl.written);
+
+	ctx->config = ctx_config;
+}
+
+// Positions the --replay reader at the --at time
+void
+seek_replay(delta_reader_t *reader)
+{
+	if (!delta_reader_index(reader)) {
+		fprintf(stderr, "%s has no frames\n", config.replay);
+		exit(EXIT_FAILURE);
+	}
+
+	int64_t time;
+	if (!delta_parse_time(config.at, reader->index.entries[0].time, &time)) {
+		fprintf(stderr, "Invalid --at time: %s\n", config.at);
+		exit(EXIT_FAILURE);
+	}
+
+	if (!delta_reader_seek(reader, time)) {
+		if (errno == ERANGE)
+			fprintf(stderr, "%s starts after %s\n", config.replay, config.at);
+		else
+			fprintf(stderr, "%s is corrupted\n", config.replay);
+		exit(EXIT_FAILURE);
+	}
+}
+
+void
+pipeline_run(psc_ctx_t *ctx, pipeline_output_t *outputs, size_t noutputs)
+{
+	assert(ctx);
+	assert(outputs);
+	assert(noutputs > 0);
+
+	procs_io_t io = {0};
+
+	in_stream_t stream;
+	snapshot_stream_t snapshots;
+	int first = config.read_stdin ? stdin_first_byte() : EOF;
+	if (first == 'P') {
+		ungetc(first, stdin);
+		snapshot_stream_init(&snapshots, stdin);
+		io.snapshots = &snapshots;
+	} else if (config.read_stdin) {
+		stream_init(&stream, stdin);
+		stream.frames = config.loop;
+		if (first != EOF)
+			stream_unget(&stream, first);
+		io.stream = &stream;
+	}
+
+	delta_reader_t reader;
+	if (config.replay) {
+		if (!delta_reader_open(&reader, config.replay)) {
+			fprintf(stderr, "Can not read %s: %s\n", config.replay, strerror(errno));
+			exit(EXIT_FAILURE);
+		}
+		io.replay = &reader;
+
+		if (config.at)
+			seek_replay(&reader);
+	}
+
+	hosts_t hosts;
+	hosts_init(&hosts);
+	if (config.hosts) {
+		char failed[PATH_MAX];
+		if (!hosts_add_list(&hosts, config.hosts, failed, sizeof(failed))) {
+			fprintf(stderr, "Can not read %s: %s\n", failed, strerror(errno));
+			exit(EXIT_FAILURE);
+		}
+
+		if (hosts.n == 0) {
+			fprintf(stderr, "--hosts=%s has no files\n", config.hosts);
+			exit(EXIT_FAILURE);
+		}
+
+		io.hosts = &hosts;
+	}
+
+	delta_writer_t writer;
+	FILE *record = NULL;
+	if (config.record) {
+		record = fopen(config.record, "wb");
+		if (!record) {
+			fprintf(stderr, "Can not open %s: %s\n", config.record, strerror(errno));
+			exit(EXIT_FAILURE);
+		}
+		delta_writer_init(&writer, record, PSC_KEYFRAME_INTERVAL);
+		io.record = &writer;
+	}
+
+	output_worker_t *workers = start_output_workers(outputs, noutputs);
+
+	if (config.loop) {
+		control_t control;
+		if (config.control && !control_init(&control, config.control, ctx)) {
+			fprintf(stderr, "Can not create %s: %s\n", config.control, strerror(errno));
+			exit(EXIT_FAILURE);
+		}
+
+		run_threaded(ctx, outputs, noutputs, workers, &io,
+				config.control ? &control : NULL);
+
+		if (config.control)
+			control_dinit(&control);
+	} else {
+		if (!next_frame(&io)) {
+			fprintf(stderr, "No frames to draw\n");
+			exit(EXIT_FAILURE);
+		}
+
+		procs_t *procs = calloc(1, sizeof(procs_t));
+		CHECK(procs);
+
+		tm_start();
+
+		pipeline_collect(ctx, procs, &io);
+
+		draw_outputs(outputs, noutputs, workers, procs);
+
+		procs_dinit(procs);
+		free(procs);
+	}
+
+	stop_output_workers(workers, noutputs);
+
+	if (io.stream)
+		stream_dinit(io.stream);
+
+	if (io.snapshots)
+		snapshot_stream_dinit(io.snapshots);
+
+	if (io.replay)
+		delta_reader_close(io.replay);
+
+	hosts_dinit(&hosts);
+
+	if (io.record) {
+		if (!delta_writer_finish(io.record))
+			fprintf(stderr, "Can not write %s: %s\n", config.record, strerror(errno));
+		delta_writer_dinit(io.record);
+		if (fclose(record) != 0)
+			fprintf(stderr, "Can not write %s: %s\n", config.record, strerror(errno));
+	}
+}
+
+size_t
+pipeline_jobs(size_t nitems, cfg_t *cfg)
+{
+	assert(cfg);
+	assert(config.jobs >= 0);
+
+	size_t njobs = config.jobs;
+	if (njobs == 0) {
+		long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+		njobs = ncpu > 0 ? ncpu : 1;
+	}
+
+	if (njobs > nitems)
+		njobs = nitems;
+
+	*cfg = config;
+	if (cfg->png_threads == 0)
+		cfg->png_threads = 1;
+
+	return njobs;
+}
+
+bool
+pipeline_frame_pattern(const char *pattern)
+{
+	assert(pattern);
+
+	size_t n = 0;
+
+	for (const char *p = pattern; *p; ++p) {
+		if (*p != '%')
+			continue;
+
+		if (*++p == '%')
+			continue;
+
+		while (isdigit((unsigned char) *p))
+			p++;
+
+		if (*p != 'd')
+			return false;
+
+		n++;
+	}
+
+	return n == 1;
+}
+
+bool
+pipeline_frame_range(const char *str, size_t nframes, size_t *first, size_t *last)
+{
+	assert(str);
+	assert(first);
+	assert(last);
+
+	if (nframes == 0 || !isdigit((unsigned char) *str))
+		return false;
+
+	char *e;
+	*first = strtoul(str, &e, 10);
+	*last = *first;
+
+	if (*e == '-') {
+		str = e + 1;
+		*last = nframes - 1;
+
+		if (isdigit((unsigned char) *str))
+			*last = strtoul(str, &e, 10);
+		else
+			e++;
+	}
+
+	if (*e != '\0')
+		return false;
+
+	if (*last >= nframes)
+		*last = nframes - 1;
+
+	return *first <= *last;
+}
+
+void *
+timelapse_worker(void *arg)
+{
+	worker_t *w = arg;
+
+	tm_thread_name("render");
+
+	size_t nbuffers = PIPELINE_DEPTH;
+	char path[PATH_MAX];
+
+	for (size_t frame = w->first; ; frame += w->nworkers) {
+		procs_t *procs = queue_pop(&w->collected);
+		if (!procs)
+			break;
+
+		if (w->stream) {
+			if (nbuffers == 0)
+				queue_pop(&w->written);
+			else
+				nbuffers--;
+		}
+
+		tm_start();
+
+		pipeline_render(w->ctx, &w->painter, procs);
+
+		procs_dinit(procs);
+		queue_push(&w->free_procs, procs);
+
+		if (w->stream) {
+			queue_push(&w->rendered, painter_swap(&w->painter));
+			continue;
+		}
+
+		// The pattern is checked by pipeline_frame_pattern
+		snprintf(path, sizeof(path), config.output, (int) frame);
+
+		painter_write_to(&w->painter, path);
+
+		metrics_written(&w->painter);
+	}
+
+	if (w->stream)
+		queue_push(&w->rendered, NULL);
+
+	return NULL;
+}
+
+// Writes the frames to stdout in the order of their numbers
+void *
+timelapse_writer(void *arg)
+{
+	timelapse_t *tl = arg;
+
+	// The stream header is written by the first frame of a painter
+	painter_t *painter = &tl->workers[0].painter;
+
+	tm_thread_name("write");
+
+	for (size_t i = 0; ; ++i) {
+		worker_t *w = tl->workers + i % tl->nworkers;
+
+		cairo_surface_t *surface = queue_pop(&w->rendered);
+		if (!surface)
+			break;
+
+		tm_start();
+
+		painter_write_surface(painter, surface);
+
+		metrics_written(painter);
+
+		queue_push(&w->written, surface);
+	}
+
+	return NULL;
+}
+
+void
+pipeline_timelapse()
+{
+	assert(config.replay);
+	assert(config.frames);
+	assert(config.output);
+
+	delta_reader_t reader;
+	if (!delta_reader_open(&reader, config.replay)) {
+		fprintf(stderr, "Can not read %s: %s\n", config.replay, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	if (!delta_reader_index(&reader)) {
+		fprintf(stderr, "%s has no frames\n", config.replay);
+		exit(EXIT_FAILURE);
+	}
+
+	size_t first, last;
+	if (!pipeline_frame_range(config.frames, reader.index.nentries, &first, &last)) {
+		fprintf(stderr, "%s has %zu frames, --frames=%s is out of range\n",
+				config.replay, reader.index.nentries, config.frames);
+		exit(EXIT_FAILURE);
+	}
+
+	if (!delta_reader_seek_frame(&reader, first)) {
+		fprintf(stderr, "%s is corrupted\n", config.replay);
+		exit(EXIT_FAILURE);
+	}
+
+	cfg_t cfg;
+	size_t nworkers = pipeline_jobs(last - first + 1, &cfg);
+
+	psc_ctx_t ctx;
+	psc_ctx_init(&ctx, &cfg);
+
+	timelapse_t tl = {
+		.workers = calloc(nworkers, sizeof(worker_t)),
+		.nworkers = nworkers,
+	};
+	CHECK(tl.workers);
+
+	bool stream = strcmp(config.output, "-") == 0;
+
+	for (size_t i = 0; i < nworkers; ++i) {
+		worker_t *w = tl.workers + i;
+
+		w->ctx = &ctx;
+		w->first = first + i;
+		w->nworkers = nworkers;
+		w->stream = stream;
+
+		queue_init(&w->free_procs);
+		queue_init(&w->collected);
+		queue_init(&w->rendered);
+		queue_init(&w->written);
+
+		for (size_t j = 0; j < PIPELINE_DEPTH; ++j)
+			queue_push(&w->free_procs, w->procs + j);
+
+		// Painters load the background image and the fonts, which is
+		// not done concurrently
+		painter_init(&ctx, &w->painter);
+	}
+
+	for (size_t i = 0; i < nworkers; ++i)
+		CHECK(pthread_create(&tl.workers[i].thread, NULL, timelapse_worker, tl.workers + i) == 0);
+
+	pthread_t writer;
+	if (stream)
+		CHECK(pthread_create(&writer, NULL, timelapse_writer, &tl) == 0);
+
+	tm_thread_name("collect");
+
+	procs_io_t io = {
+		.replay = &reader,
+	};
+
+	// Deltas are applied one after another, so frames are decoded here
+	// and handed out to the workers in turns
+	for (size_t i = first; i <= last; ++i) {
+		if (!next_frame(&io))
+			break;
+
+		worker_t *w = tl.workers + (i - first) % nworkers;
+		procs_t *procs = queue_pop(&w->free_procs);
+
+		tm_start();
+
+		memset(procs, 0, sizeof(procs_t));
+		pipeline_collect(&ctx, procs, &io);
+
+		queue_push(&w->collected, procs);
+	}
+
+	for (size_t i = 0; i < nworkers; ++i)
+		queue_push(&tl.workers[i].collected, NULL);
+
+	for (size_t i = 0; i < nworkers; ++i)
+		pthread_join(tl.workers[i].thread, NULL);
+
+	if (stream)
+		pthread_join(writer, NULL);
+
+	for (size_t i = 0; i < nworkers; ++i) {
+		worker_t *w = tl.workers + i;
+
+		painter_dinit(&w->painter);
+
+		queue_dinit(&w->free_procs);
+		queue_dinit(&w->collected);
+		queue_dinit(&w->rendered);
+		queue_dinit(&w->written);
+	}
+
+	free(tl.workers);
+
+	delta_reader_close(&reader);
+
+	psc_ctx_dinit(&ctx);
+}
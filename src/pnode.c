@@ -1,34 +1,33 @@
 #include <assert.h>
 
 #include "pnode.h"
-#include "cfg.h"
+#include "ctx.h"
 
 real_t
-pnode_mem_percentage(pnode_t *pnode)
+pnode_mem_percentage(const psc_ctx_t *ctx, const pnode_t *pnode)
 {
-	assert(config.max_mem >= config.min_mem);
+	assert(ctx->config->max_mem >= ctx->config->min_mem);
 
 	real_t m = pnode->mem;
-	if (m < config.min_mem)
+	if (m < ctx->config->min_mem)
 		return 0;
-	if (m > config.max_mem)
+	if (m > ctx->config->max_mem)
 		return 1;
 
-	return (m - config.min_mem) / (config.max_mem - config.min_mem);
+	return (m - ctx->config->min_mem) / (ctx->config->max_mem - ctx->config->min_mem);
 }
 
-
 real_t
-pnode_cpu_percentage(pnode_t *pnode)
+pnode_cpu_percentage(const psc_ctx_t *ctx, const pnode_t *pnode)
 {
-	assert(config.max_cpu >= config.min_cpu);
+	assert(ctx->config->max_cpu >= ctx->config->min_cpu);
 
 	real_t m = pnode->cpu;
-	if (m < config.min_cpu)
+	if (m < ctx->config->min_cpu)
 		return 0;
-	if (m > config.max_cpu)
+	if (m > ctx->config->max_cpu)
 		return 1;
 
-	return (m - config.min_cpu) / (config.max_cpu - config.min_cpu);
+	return (m - ctx->config->min_cpu) / (ctx->config->max_cpu - ctx->config->min_cpu);
 }
 
@@ -6,6 +6,7 @@
 #include <strings.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <fcntl.h>
 
 #include "proc_linux.h"
 
@@ -26,20 +27,23 @@ typedef struct {
 	rss_t rss;
 } proc_t;
 
+FILE *
+open_proc_file(linux_procs_t *ctx, const char *path);
+
 void
-read_cputime(ctime_t *cputime, ctime_t *idletime);
+read_cputime(linux_procs_t *ctx, ctime_t *cputime, ctime_t *idletime);
 
 ctime_t
-read_uptime();
+read_uptime(linux_procs_t *ctx);
 
 proc_t *
-read_proc(pid_t pid, proc_t *proc);
+read_proc(linux_procs_t *ctx, pid_t pid, proc_t *proc);
 
 pnode_t *
 proc_to_pnode(linux_procs_t *ctx, pnode_t *pnode, proc_t *proc);
 
 void
-linux_init(linux_procs_t *ctx)
+linux_init(linux_procs_t *ctx, psc_ctx_t *psc)
 {
 #ifndef NDEBUG
 	uint8_t zeros[sizeof(linux_procs_t)];
@@ -47,16 +51,27 @@ linux_init(linux_procs_t *ctx)
 	assert(memcmp(zeros, ctx, sizeof(linux_procs_t)) == 0);
 #endif
 
-	ctx->procdir = opendir("/proc");
-	CHECK(ctx->procdir);
+	assert(psc);
+
+	const char *root = psc->config->procfs_root;
+	ctx->psc = psc;
+
+	ctx->procdir = opendir(root);
+	if (!ctx->procdir) {
+		fprintf(stderr, "Can not open %s: %s\n", root, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	ctx->rootfd = dirfd(ctx->procdir);
+	CHECK(ctx->rootfd >= 0);
 
 	ctx->hertz = sysconf(_SC_CLK_TCK);
 
 	ctx->pagesize = getpagesize();
 
-	read_cputime(&ctx->cputime_st, &ctx->idletime_st);
+	read_cputime(ctx, &ctx->cputime_st, &ctx->idletime_st);
 
-	ctx->uptime = read_uptime();
+	ctx->uptime = read_uptime(ctx);
 }
 
 void
@@ -68,6 +83,26 @@ linux_dinit(linux_procs_t *ctx)
 	closedir(ctx->procdir);
 }
 
+bool
+linux_available(const char *root)
+{
+	assert(root);
+
+	int fd = open(root, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fd < 0)
+		return false;
+
+	const char *files[] = {"stat", "uptime", "loadavg", "meminfo"};
+
+	bool ok = true;
+	for (size_t i = 0; ok && i < sizeof(files) / sizeof(files[0]); ++i)
+		ok = faccessat(fd, files[i], R_OK, 0) == 0;
+
+	close(fd);
+
+	return ok;
+}
+
 pnode_t *
 linux_get_next_proc(linux_procs_t *ctx, pnode_t *pnode)
 {
@@ -78,7 +113,8 @@ linux_get_next_proc(linux_procs_t *ctx, pnode_t *pnode)
 	struct dirent *de;
 	proc_t p = {0};
 	while ((de = readdir(ctx->procdir)) != NULL) {
-		if (de->d_type != DT_DIR)
+		// Snapshots of /proc may live on file systems without d_type
+		if (de->d_type != DT_DIR && de->d_type != DT_UNKNOWN)
 			continue;
 
 		char *e = NULL;
@@ -88,7 +124,7 @@ linux_get_next_proc(linux_procs_t *ctx, pnode_t *pnode)
 
 		p.comm = pnode->name;
 
-		if (!read_proc(pid, &p))
+		if (!read_proc(ctx, pid, &p))
 			continue;
 
 		if (!proc_to_pnode(ctx, pnode, &p))
@@ -129,15 +165,22 @@ linux_wait(linux_procs_t *ctx, real_t delay)
 	assert(ctx);
 	assert(delay > 0);
 
-	unsigned sec = delay;
-	unsigned usec = (delay - sec) * 1e6;
+	// The wait can be cut short (see psc_ctx_wake), but not below the
+	// window the CPU usage can be measured over
+	real_t min = delay < PSC_MIN_CPU_WINDOW ? delay : PSC_MIN_CPU_WINDOW;
+
+	unsigned sec = min;
+	unsigned usec = (min - sec) * 1e6;
 
 	if (sec > 0)
 		sleep(sec);
 	if (usec < 1e6)
 		usleep(usec);
 
-	read_cputime(&ctx->cputime_en, &ctx->idletime_en);
+	if (delay > min)
+		psc_ctx_sleep(ctx->psc, delay - min);
+
+	read_cputime(ctx, &ctx->cputime_en, &ctx->idletime_en);
 }
 
 void
@@ -148,7 +191,7 @@ linux_update_proc(linux_procs_t *ctx, pnode_t *pnode)
 
 	proc_t p = {0};
 
-	if (!read_proc(pnode->pid, &p)) {
+	if (!read_proc(ctx, pnode->pid, &p)) {
 		pnode->cpu = 0;
 		return;
 	}
@@ -180,11 +223,13 @@ linux_cpu_utilization(linux_procs_t *ctx)
 }
 
 const char *
-linux_loadavg()
+linux_loadavg(linux_procs_t *ctx)
 {
-	static char buf[PSC_LABEL_BUFSIZE + 1] = {0};
+	assert(ctx);
 
-	FILE *f = fopen("/proc/loadavg", "r");
+	char *buf = ctx->loadavg;
+
+	FILE *f = open_proc_file(ctx, "loadavg");
 	CHECK(f);
 
 	fgets(buf, PSC_LABEL_BUFSIZE, f);
@@ -217,17 +262,17 @@ char *starts_with(char *str, const char *prefix)
 }
 
 void
-linux_meminfo(unsigned long *mtotal, unsigned long *mused, unsigned long *mfree)
+linux_meminfo(linux_procs_t *ctx,
+		unsigned long *mtotal, unsigned long *mused, unsigned long *mfree)
 {
+	assert(ctx);
 	assert(mtotal);
 	assert(mused);
 	assert(mfree);
 
-	FILE *f = fopen("/proc/meminfo", "r");
+	FILE *f = open_proc_file(ctx, "meminfo");
 	CHECK(f);
 
-	static char *line = NULL;
-	static size_t n = 0;
 	ssize_t nread = 0;
 
 	unsigned long mbuffers = 0;
@@ -235,7 +280,8 @@ linux_meminfo(unsigned long *mtotal, unsigned long *mused, unsigned long *mfree)
 
 	unsigned long fields = 0;
 
-	while ((nread = getline(&line, &n, f) != -1)) {
+	while ((nread = getline(&ctx->psc->line, &ctx->psc->linesize, f) != -1)) {
+		char *line = ctx->psc->line;
 		char *s;
 		if ((s = starts_with(line, "MemTotal:"))) {
 			sscanf(s, "%lu", mtotal);
@@ -272,13 +318,28 @@ linux_meminfo(unsigned long *mtotal, unsigned long *mused, unsigned long *mfree)
 	*mfree *= 1024;
 }
 
+FILE *
+open_proc_file(linux_procs_t *ctx, const char *path)
+{
+	int fd = openat(ctx->rootfd, path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return NULL;
+
+	FILE *f = fdopen(fd, "r");
+	if (!f)
+		close(fd);
+
+	return f;
+}
+
 void
-read_cputime(ctime_t *cputime, ctime_t *idletime)
+read_cputime(linux_procs_t *ctx, ctime_t *cputime, ctime_t *idletime)
 {
+	assert(ctx);
 	assert(cputime);
 	assert(idletime);
 
-	FILE *f = fopen("/proc/stat", "r");
+	FILE *f = open_proc_file(ctx, "stat");
 	CHECK(f);
 
 	*cputime = 0;
@@ -297,9 +358,11 @@ read_cputime(ctime_t *cputime, ctime_t *idletime)
 }
 
 ctime_t
-read_uptime()
+read_uptime(linux_procs_t *ctx)
 {
-	FILE *f = fopen("/proc/uptime", "r");
+	assert(ctx);
+
+	FILE *f = open_proc_file(ctx, "uptime");
 	CHECK(f);
 
 	uint64_t uptime = 0;
@@ -312,18 +375,17 @@ read_uptime()
 }
 
 proc_t *
-read_proc(pid_t pid, proc_t *proc)
+read_proc(linux_procs_t *ctx, pid_t pid, proc_t *proc)
 {
-	static char path[30];
-	snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+	char path[30];
+	snprintf(path, sizeof(path), "%d/stat", pid);
 
-	FILE *f = fopen(path, "r");
+	FILE *f = open_proc_file(ctx, path);
 	if (!f)
 		return NULL;
 
-	static char *buf = NULL;
-	static size_t n = 0;
-	ssize_t l = getline(&buf, &n, f);
+	ssize_t l = getline(&ctx->psc->line, &ctx->psc->linesize, f);
+	char *buf = ctx->psc->line;
 	fclose(f);
 
 	if (l <= 0)
@@ -1,33 +1,207 @@
 #include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <unistd.h>
 
 #include "proc_stream.h"
 
+#define CHECK(x) do { \
+	if (x) break; \
+	fprintf(stderr, "%s:%d error: %s\n", \
+			__FILE__, __LINE__, strerror(errno)); \
+	exit(EXIT_FAILURE); \
+} while (0)
+
+char *
+next_line(in_stream_t *stream, char **line_end);
+
+bool
+fill(in_stream_t *stream);
+
+static const double powers_of_10[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9,
+	1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18,
+};
+
+#define NPOWERS_OF_10 (sizeof(powers_of_10) / sizeof(powers_of_10[0]))
+
+static inline bool
+is_space(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline bool
+is_digit(char c)
+{
+	return (unsigned char) (c - '0') < 10;
+}
+
+static inline char *
+skip_spaces(char *s, char *end)
+{
+	while (s < end && is_space(*s))
+		s++;
+	return s;
+}
+
+static char *
+parse_uint(char *s, char *end, uint64_t *value)
+{
+	if (s == end || !is_digit(*s))
+		return NULL;
+
+	uint64_t v = 0;
+	while (s < end && is_digit(*s))
+		v = v * 10 + (*s++ - '0');
+
+	*value = v;
+	return s;
+}
+
+static char *
+parse_int(char *s, char *end, int *value)
+{
+	bool negative = s < end && *s == '-';
+	if (negative)
+		s++;
+
+	uint64_t v;
+	s = parse_uint(s, end, &v);
+	if (!s)
+		return NULL;
+
+	*value = negative ? -(int) v : (int) v;
+	return s;
+}
+
+// Handles the output of ps: [-]digits[.digits][e[+-]digits]
+static char *
+parse_real(char *s, char *end, real_t *value)
+{
+	bool negative = s < end && *s == '-';
+	if (negative)
+		s++;
+
+	uint64_t mantissa = 0;
+	int exponent = 0;
+	size_t ndigits = 0;
+
+	for (; s < end && is_digit(*s); ++s, ++ndigits) {
+		if (mantissa < UINT64_MAX / 10 - 10)
+			mantissa = mantissa * 10 + (*s - '0');
+		else
+			exponent++;
+	}
+
+	if (s < end && *s == '.') {
+		for (s++; s < end && is_digit(*s); ++s, ++ndigits) {
+			if (mantissa < UINT64_MAX / 10 - 10) {
+				mantissa = mantissa * 10 + (*s - '0');
+				exponent--;
+			}
+		}
+	}
+
+	if (ndigits == 0)
+		return NULL;
+
+	if (s < end && (*s == 'e' || *s == 'E')) {
+		int e;
+		char *t = parse_int(s + 1 + (s + 1 < end && s[1] == '+'), end, &e);
+		if (t) {
+			exponent += e;
+			s = t;
+		}
+	}
+
+	double v = mantissa;
+	while (exponent < 0) {
+		size_t k = -exponent < (int) NPOWERS_OF_10 ? (size_t) -exponent : NPOWERS_OF_10 - 1;
+		v /= powers_of_10[k];
+		exponent += k;
+	}
+	while (exponent > 0) {
+		size_t k = exponent < (int) NPOWERS_OF_10 ? (size_t) exponent : NPOWERS_OF_10 - 1;
+		v *= powers_of_10[k];
+		exponent -= k;
+	}
+
+	*value = negative ? -v : v;
+	return s;
+}
+
 void
-read_word_and_skip_to_lf(FILE *procs, char *buf, size_t len);
+stream_init(in_stream_t *stream, FILE *procs)
+{
+	assert(stream);
+	assert(procs);
+
+	memset(stream, 0, sizeof(in_stream_t));
+
+	stream->procs = procs;
+	stream->fd = fileno(procs);
+	stream->capacity = PSC_STREAM_BUFSIZE;
+	stream->buf = malloc(stream->capacity);
+	CHECK(stream->buf);
+}
+
+void
+stream_dinit(in_stream_t *stream)
+{
+	assert(stream);
+
+	free(stream->buf);
+	stream->buf = NULL;
+}
 
 pnode_t *
-stream_get_next_proc(FILE *procs, pnode_t *pnode)
+stream_get_next_proc(in_stream_t *stream, pnode_t *pnode)
 {
-	assert(procs);
+	assert(stream);
+	assert(stream->buf);
 	assert(pnode);
 
-	pnode_t p;
-	while (!feof(procs)) {
+	char *s, *end;
+	while ((s = next_line(stream, &end)) != NULL) {
+		int pid, ppid;
+		real_t cpu;
+		uint64_t mem;
 
-#ifdef PSC_USE_FLOAT
-		int rc = fscanf(procs, "%d %d %f %lu ", &p.pid, &p.ppid, &p.cpu, &p.mem);
-#else
-		int rc = fscanf(procs, "%d %d %lf %lu ", &p.pid, &p.ppid, &p.cpu, &p.mem);
-#endif
-		if (rc == EOF)
+		s = skip_spaces(s, end);
+		if (s == end && stream->frames)
 			return NULL;
 
-		read_word_and_skip_to_lf(procs, pnode->name, PSC_MAX_NAME_LENGHT);
+		if (!(s = parse_int(s, end, &pid)))
+			continue;
+
+		s = skip_spaces(s, end);
+		if (!(s = parse_int(s, end, &ppid)))
+			continue;
+
+		s = skip_spaces(s, end);
+		if (!(s = parse_real(s, end, &cpu)))
+			continue;
+
+		s = skip_spaces(s, end);
+		if (!(s = parse_uint(s, end, &mem)))
+			continue;
 
-		pnode->pid = p.pid;
-		pnode->ppid = p.ppid;
-		pnode->cpu = p.cpu;
-		pnode->mem = p.mem;
+		s = skip_spaces(s, end);
+
+		size_t l = 0;
+		while (s + l < end && l < PSC_MAX_NAME_LENGHT - 1 && !is_space(s[l]))
+			l++;
+
+		memcpy(pnode->name, s, l);
+		pnode->name[l] = '\0';
+
+		pnode->pid = pid;
+		pnode->ppid = ppid;
+		pnode->cpu = cpu;
+		pnode->mem = mem;
 
 		return pnode;
 	}
@@ -36,28 +210,108 @@ stream_get_next_proc(FILE *procs, pnode_t *pnode)
 }
 
 void
-read_word_and_skip_to_lf(FILE *procs, char *buf, size_t len)
+stream_unget(in_stream_t *stream, char c)
 {
-	assert(procs);
-	assert(buf);
-
-	int c = 0;
-	for (size_t i = 0; i < len - 1; ++i) {
-		c = fgetc(procs);
-		if (c == ' ' || c == '\n' || c == EOF) {
-			buf[i] = '\0';
-			if (c == ' ')
-				break;
-			return;
+	assert(stream);
+	assert(stream->buf);
+	assert(stream->begin == 0 && stream->end < stream->capacity);
+
+	memmove(stream->buf + 1, stream->buf, stream->end);
+	stream->buf[0] = c;
+	stream->end++;
+}
+
+bool
+stream_at_end(in_stream_t *stream)
+{
+	assert(stream);
+	assert(stream->buf);
+
+	while (true) {
+		while (stream->begin < stream->end) {
+			char c = stream->buf[stream->begin];
+			if (!is_space(c) && c != '\n')
+				return false;
+			stream->begin++;
 		}
-		buf[i] = c;
+
+		if (stream->eof || !fill(stream))
+			return true;
 	}
+}
 
-	buf[len - 1] = '\0';
+// Returns the next line (without '\n') or NULL at the end of the stream
+char *
+next_line(in_stream_t *stream, char **line_end)
+{
+	// Bytes of the line which are known not to contain '\n'
+	size_t scanned = 0;
+
+	while (true) {
+		char *b = stream->buf + stream->begin;
+		size_t n = stream->end - stream->begin;
+		char *lf = memchr(b + scanned, '\n', n - scanned);
+
+		if (lf) {
+			stream->begin += lf + 1 - b;
+			*line_end = lf;
+			return b;
+		}
+
+		scanned = n;
+
+		if (stream->eof || !fill(stream)) {
+			// The last line is not terminated
+			if (n == 0)
+				return NULL;
+
+			b = stream->buf + stream->begin;
+			*line_end = b + n;
+			stream->begin = stream->end;
+			return b;
+		}
+	}
+}
+
+// Reads what is available after the unread data, which is moved to the
+// beginning of the buffer first. A pipe is not waited on for a full block,
+// so a frame is read as soon as its last line arrives.
+bool
+fill(in_stream_t *stream)
+{
+	size_t unread = stream->end - stream->begin;
+
+	if (stream->begin > 0) {
+		memmove(stream->buf, stream->buf + stream->begin, unread);
+		stream->begin = 0;
+		stream->end = unread;
+	}
+
+	if (stream->end == stream->capacity) {
+		stream->capacity *= 2;
+		stream->buf = realloc(stream->buf, stream->capacity);
+		CHECK(stream->buf);
+	}
+
+	char *b = stream->buf + stream->end;
+	size_t size = stream->capacity - stream->end;
+
+	ssize_t n;
+	if (stream->fd < 0) {
+		// E.g. fmemopen, which never blocks
+		n = fread(b, 1, size, stream->procs);
+	} else {
+		do {
+			n = read(stream->fd, b, size);
+		} while (n < 0 && errno == EINTR);
+	}
+
+	if (n <= 0) {
+		stream->eof = true;
+		return false;
+	}
 
-	do {
-		c = fgetc(procs);
-	} while (c != '\n' && c != EOF);
+	stream->end += n;
 
-	return;
+	return true;
 }
@@ -8,7 +8,12 @@
 
 #include "procs.h"
 #include "cfg.h"
+#include "ctx.h"
 #include "utils.h"
+#include "timing.h"
+#include "delta.h"
+#include "snapshot.h"
+#include "hosts.h"
 
 #define CHECK(x) do { \
 	if (x) break; \
@@ -17,21 +22,55 @@
 	exit(EXIT_FAILURE); \
 } while (0)
 
+// Pid of the nodes of the hosts, which stand for their --root-pid
+#define HOST_PID -1
+
+void
+read_procs_stream(psc_ctx_t *ctx, procs_t *procs, in_stream_t *stream);
+
+void
+read_procs_linux(psc_ctx_t *ctx, procs_t *procs);
+
+void
+read_procs_replay(psc_ctx_t *ctx, procs_t *procs, struct delta_reader_t *reader);
+
 void
-read_procs_stream(procs_t *procs, FILE *fp);
+read_procs_snapshot(psc_ctx_t *ctx, procs_t *procs, const struct snapshot_t *snapshot);
 
 void
-read_procs_linux(procs_t *procs);
+read_procs_hosts(psc_ctx_t *ctx, procs_t *procs, const hosts_t *hosts);
 
 void
-link_process(procs_t *procs);
+read_host(psc_ctx_t *ctx, procs_t *procs, in_stream_t *stream, size_t i);
 
 pnode_t *
-get_new_process(procs_t *procs);
+procs_grow(procs_t *procs);
+
+void
+set_stats(psc_ctx_t *ctx, procs_t *procs, real_t cpu_value, real_t mem_value,
+		const char *cpu_label, const char *mem_label);
+
+void
+link_process(psc_ctx_t *ctx, procs_t *procs);
+
+void
+build_pid_index(procs_t *procs);
+
+void
+fold_levels(psc_ctx_t *ctx, procs_t *procs);
+
+void
+fold_children(procs_t *procs, pnode_t *p, pnode_t *fold);
+
+void
+fold_subtree(pnode_t *p, pnode_t *fold, size_t *nprocs, size_t *nstubs);
 
 void
 reserve_root_memory(procs_t *procs);
 
+void
+procs_remove_last(procs_t *procs);
+
 void
 count_as_stub(pnode_t *parent, pnode_t *child);
 
@@ -48,14 +87,29 @@ void
 add_stubs(procs_t *procs);
 
 pnode_t *
-find_by_pid(procs_t *procs, pid_t pid);
+find_process(procs_t *procs, uint32_t host, pid_t pid);
 
 void
-procs_update_stats(procs_t *procs);
+init_toplist_headers(psc_ctx_t *ctx, procs_t *procs);
 
 void
-procs_init(procs_t *procs, FILE *fp)
+procs_init(psc_ctx_t *ctx, procs_t *procs, const procs_io_t *io)
 {
+	assert(ctx);
+	assert(procs);
+
+	procs_read(ctx, procs, io);
+
+	procs_link(ctx, procs);
+
+	tm_count(TM_LINK, TM_NODES, procs->nprocesses);
+	tm_tick(TM_LINK);
+}
+
+void
+procs_read(psc_ctx_t *ctx, procs_t *procs, const procs_io_t *io)
+{
+	assert(ctx);
 	assert(procs);
 
 #ifndef NDEBUG
@@ -64,37 +118,107 @@ procs_init(procs_t *procs, FILE *fp)
 	assert(memcmp(zeros, procs, sizeof(procs_t)) == 0);
 #endif
 
-	reserve_root_memory(procs);
-
-	if (fp)
-		read_procs_stream(procs, fp);
+	// Every host has room for its node and PSC_MAX_PROCS_COUNT processes
+	// at first, more is made while the hosts are read
+	size_t capacity = PSC_MAX_PROCS_COUNT;
+	if (io && io->hosts)
+		capacity = 1 + io->hosts->n * (PSC_MAX_PROCS_COUNT + 1);
+
+	procs_alloc(procs, capacity);
+
+	init_toplist_headers(ctx, procs);
+
+	if (io && io->replay)
+		read_procs_replay(ctx, procs, io->replay);
+	else if (io && io->snapshot)
+		read_procs_snapshot(ctx, procs, io->snapshot);
+	else if (io && io->snapshots)
+		read_procs_snapshot(ctx, procs, &io->snapshots->snapshot);
+	else if (io && io->stream)
+		read_procs_stream(ctx, procs, io->stream);
+	else if (io && io->hosts)
+		read_procs_hosts(ctx, procs, io->hosts);
 	else
-		read_procs_linux(procs);
+		read_procs_linux(ctx, procs);
 
-	link_process(procs);
+	if (io && io->record && !delta_writer_add(io->record, procs)) {
+		fprintf(stderr, "Can not write %s: %s\n", ctx->config->record, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
 
-	sort_top_lists(procs);
+	tm_count(TM_COLLECT, TM_NODES, procs->nprocesses);
+	tm_tick(TM_COLLECT);
 }
 
 void
 procs_dinit(procs_t *procs)
 {
 	assert(procs);
+
+	free(procs->processes);
+	free(procs->pid_index);
+	free(procs->folds);
+
+	procs->processes = NULL;
+	procs->pid_index = NULL;
+	procs->folds = NULL;
+}
+
+void
+procs_alloc(procs_t *procs, size_t capacity)
+{
+	assert(procs);
+	assert(!procs->processes);
+	assert(capacity > 0);
+
+	procs->processes = calloc(capacity, sizeof(pnode_t));
+	CHECK(procs->processes);
+	procs->capacity = capacity;
+
+	reserve_root_memory(procs);
+}
+
+void
+procs_link(psc_ctx_t *ctx, procs_t *procs)
+{
+	assert(ctx);
+	assert(procs);
+
+	build_pid_index(procs);
+
+	link_process(ctx, procs);
+
+	fold_levels(ctx, procs);
+
+	sort_top_lists(procs);
 }
 
 void
-procs_update_mem_stats()
+init_toplist_headers(psc_ctx_t *ctx, procs_t *procs)
+{
+	procs->cpu_value = ctx->config->toplists.cpulist.value;
+	procs->mem_value = ctx->config->toplists.memlist.value;
+
+	if (ctx->config->toplists.cpulist.label)
+		strncpy(procs->cpu_label, ctx->config->toplists.cpulist.label, PSC_LABEL_BUFSIZE);
+
+	if (ctx->config->toplists.memlist.label)
+		strncpy(procs->mem_label, ctx->config->toplists.memlist.label, PSC_LABEL_BUFSIZE);
+}
+
+void
+procs_update_mem_stats(psc_ctx_t *ctx, procs_t *procs, linux_procs_t *lprocs)
 {
 	unsigned long mtotal;
 	unsigned long mused;
 	unsigned long mfree;
 
-	linux_meminfo(&mtotal, &mused, &mfree);
+	linux_meminfo(lprocs, &mtotal, &mused, &mfree);
 
-	if (config.toplists.memlist.value < 0)
-		config.toplists.memlist.value = (real_t) mused / mtotal;
+	if (ctx->config->toplists.memlist.value < 0)
+		procs->mem_value = (real_t) mused / mtotal;
 
-	if (config.toplists.memlist.label)
+	if (ctx->config->toplists.memlist.label)
 		return;
 
 	double m1 = mused;
@@ -105,117 +229,338 @@ procs_update_mem_stats()
 	const char *u2 = NULL;
 	bytes_to_human(&m2, &u2);
 
-	static char buf[PSC_LABEL_BUFSIZE + 1] = {0};
-	snprintf(buf, PSC_LABEL_BUFSIZE, "%1.1lf%s / %1.1lf%s", m1, u1, m2, u2);
-
-	config.toplists.memlist.label = buf;
+	snprintf(procs->mem_label, PSC_LABEL_BUFSIZE, "%1.1lf%s / %1.1lf%s", m1, u1, m2, u2);
 }
 
 void
-read_procs_stream(procs_t *procs, FILE *fp)
+read_procs_stream(psc_ctx_t *ctx, procs_t *procs, in_stream_t *stream)
 {
 	assert(procs);
+	assert(stream);
 
 	while (true) {
-		pnode_t *p = get_new_process(procs);
-		if (!p)
+		pnode_t *p = procs_add(procs);
+		if (!p) {
+			pnode_t skipped = {0};
+			while (stream_get_next_proc(stream, &skipped))
+				procs->nskipped++;
 			break;
+		}
 
-		if (!stream_get_next_proc(fp, p))
+		if (!stream_get_next_proc(stream, p)) {
+			procs_remove_last(procs);
 			break;
+		}
 
-		for (size_t u = 0; u < config.memory_unit; ++u)
+		for (size_t u = 0; u < ctx->config->memory_unit; ++u)
 			p->mem *= 1024;
 	}
 }
 
 void
-read_procs_linux(procs_t *procs)
+read_procs_hosts(psc_ctx_t *ctx, procs_t *procs, const hosts_t *hosts)
+{
+	assert(procs);
+	assert(hosts);
+
+	for (size_t h = 0; h < hosts->n; ++h) {
+		size_t i = procs->nprocesses;
+		pnode_t *host = procs_grow(procs);
+
+		host->pid = HOST_PID;
+		host->host = h + 1;
+		snprintf(host->name, PSC_MAX_NAME_LENGHT, "%s", hosts->labels[h]);
+
+		procs->nhosts++;
+
+		// A host which can not be read is drawn without processes
+		FILE *fp = fopen(hosts->paths[h], "r");
+		if (!fp) {
+			fprintf(stderr, "Can not read %s: %s\n", hosts->paths[h], strerror(errno));
+			continue;
+		}
+
+		in_stream_t stream;
+		stream_init(&stream, fp);
+
+		read_host(ctx, procs, &stream, i);
+
+		stream_dinit(&stream);
+		fclose(fp);
+	}
+}
+
+// Reads up to PSC_MAX_HOST_PROCS_COUNT processes of the host at index i.
+// Its node shows the total CPU and memory usage of the host.
+void
+read_host(psc_ctx_t *ctx, procs_t *procs, in_stream_t *stream, size_t i)
+{
+	for (size_t n = 0; ; ++n) {
+		pnode_t *p = n < PSC_MAX_HOST_PROCS_COUNT ? procs_grow(procs) : NULL;
+		if (!p) {
+			pnode_t skipped = {0};
+			while (stream_get_next_proc(stream, &skipped))
+				procs->nskipped++;
+			break;
+		}
+
+		if (!stream_get_next_proc(stream, p)) {
+			procs_remove_last(procs);
+			break;
+		}
+
+		for (size_t u = 0; u < ctx->config->memory_unit; ++u)
+			p->mem *= 1024;
+
+		// Processes are moved when procs_grow makes room
+		pnode_t *host = procs->processes + i;
+
+		p->host = host->host;
+
+		host->cpu += p->cpu;
+		host->mem += p->mem;
+	}
+}
+
+// Same as procs_add, but makes room for more processes instead of failing.
+// The processes are moved, so it's only used before they are linked.
+pnode_t *
+procs_grow(procs_t *procs)
+{
+	if (procs->nprocesses == procs->capacity) {
+		size_t capacity = procs->capacity * 2;
+
+		pnode_t *processes = realloc(procs->processes, capacity * sizeof(pnode_t));
+		CHECK(processes);
+
+		memset(processes + procs->capacity, 0,
+				(capacity - procs->capacity) * sizeof(pnode_t));
+
+		procs->processes = processes;
+		procs->capacity = capacity;
+	}
+
+	return procs->processes + procs->nprocesses++;
+}
+
+void
+read_procs_linux(psc_ctx_t *ctx, procs_t *procs)
 {
 	assert(procs);
 
 	linux_procs_t lprocs = {0};
 
-	linux_init(&lprocs);
+	linux_init(&lprocs, ctx);
 
 	while (true) {
-		pnode_t *p = get_new_process(procs);
-		if (!p)
+		pnode_t *p = procs_add(procs);
+		if (!p) {
+			pnode_t skipped = {0};
+			while (linux_get_next_proc(&lprocs, &skipped))
+				procs->nskipped++;
 			break;
+		}
 
-		if (!linux_get_next_proc(&lprocs, p))
+		if (!linux_get_next_proc(&lprocs, p)) {
+			procs_remove_last(procs);
 			break;
+		}
 	}
 
-	if (config.interval > 0) {
-		linux_wait(&lprocs, config.interval);
+	if (ctx->config->interval > 0) {
+		tm_nested_start();
+		linux_wait(&lprocs, ctx->config->interval);
+		tm_nested_tick(TM_WAIT);
 
 		for (size_t i = 0; i < procs->nprocesses; ++i)
 			linux_update_proc(&lprocs, procs->processes + i);
 
-		if (config.toplists.cpulist.value < 0)
-			config.toplists.cpulist.value = linux_cpu_utilization(&lprocs);
+		if (ctx->config->toplists.cpulist.value < 0)
+			procs->cpu_value = linux_cpu_utilization(&lprocs);
 	}
 
-	if (config.toplists.cpulist.value < 0)
-		config.toplists.cpulist.value = 0;
+	if (procs->cpu_value < 0)
+		procs->cpu_value = 0;
 
-	if (!config.toplists.cpulist.label)
-		config.toplists.cpulist.label = linux_loadavg();
+	if (!ctx->config->toplists.cpulist.label)
+		strncpy(procs->cpu_label, linux_loadavg(&lprocs), PSC_LABEL_BUFSIZE);
 
-	if (config.toplists.memlist.value < 0 || !config.toplists.memlist.label)
-		procs_update_mem_stats();
+	if (ctx->config->toplists.memlist.value < 0 || !ctx->config->toplists.memlist.label)
+		procs_update_mem_stats(ctx, procs, &lprocs);
 
 	linux_dinit(&lprocs);
 }
 
+void
+read_procs_replay(psc_ctx_t *ctx, procs_t *procs, struct delta_reader_t *reader)
+{
+	assert(procs);
+	assert(reader);
+
+	delta_reader_load(reader, procs);
+
+	const delta_state_t *state = &reader->state;
+
+	set_stats(ctx, procs, state->cpu_value, state->mem_value,
+			state->cpu_label, state->mem_label);
+}
+
+void
+read_procs_snapshot(psc_ctx_t *ctx, procs_t *procs, const snapshot_t *snapshot)
+{
+	assert(procs);
+	assert(snapshot);
+
+	snapshot_load(snapshot, procs);
+
+	const snapshot_header_t *h = snapshot->header;
+
+	set_stats(ctx, procs, h->cpu_value, h->mem_value,
+			snapshot->names + h->cpu_label, snapshot->names + h->mem_label);
+}
+
+// Values and labels of the toplists which are not set in the options
+void
+set_stats(psc_ctx_t *ctx, procs_t *procs, real_t cpu_value, real_t mem_value,
+		const char *cpu_label, const char *mem_label)
+{
+	if (ctx->config->toplists.cpulist.value < 0)
+		procs->cpu_value = cpu_value;
+
+	if (ctx->config->toplists.memlist.value < 0)
+		procs->mem_value = mem_value;
+
+	if (!ctx->config->toplists.cpulist.label)
+		snprintf(procs->cpu_label, sizeof(procs->cpu_label), "%s", cpu_label);
+
+	if (!ctx->config->toplists.memlist.label)
+		snprintf(procs->mem_label, sizeof(procs->mem_label), "%s", mem_label);
+}
+
 pnode_t *
-get_new_process(procs_t *procs)
+procs_add(procs_t *procs)
 {
 	assert(procs);
+	assert(procs->processes);
 
-	if (procs->nprocesses == PSC_MAX_PROCS_COUNT) {
+	if (procs->nprocesses == procs->capacity) {
 		fprintf(stderr,
-				"Maximum number of processes (%d) is reached, skipping the rest.\n",
-				PSC_MAX_PROCS_COUNT);
+				"Maximum number of processes (%zu) is reached, skipping the rest.\n",
+				procs->capacity);
 		fprintf(stderr, "To increase this value change PSC_MAX_PROCS_COUNT and recompile\n");
 		return NULL;
 	}
 
-	assert(procs->processes);
 	return procs->processes + procs->nprocesses++;
 }
 
+// Returns the slot of a process which could not be read
+void
+procs_remove_last(procs_t *procs)
+{
+	assert(procs->nprocesses > 1);
 
-pnode_t *
-find_by_pid(procs_t *procs, pid_t pid)
+	procs->nprocesses--;
+	memset(procs->processes + procs->nprocesses, 0, sizeof(pnode_t));
+}
+
+size_t
+pid_slot(procs_t *procs, uint32_t host, pid_t pid)
 {
-	for (size_t i = 0; i < procs->nprocesses; ++i) {
-		if (procs->processes[i].pid == pid)
-			return procs->processes + i;
+	// Multiplicative hashing, pid_index_size is a power of two. Hosts
+	// are mixed in, as the same pids repeat on every host.
+	uint32_t h = ((uint32_t) pid ^ host * 0x9e3779b9u) * 2654435769u;
+	return h & (procs->pid_index_size - 1);
+}
+
+// The first process with the given pid wins, as with a linear search
+void
+pid_index_insert(procs_t *procs, size_t i)
+{
+	const pnode_t *p = procs->processes + i;
+	size_t mask = procs->pid_index_size - 1;
+
+	for (size_t s = pid_slot(procs, p->host, p->pid); ; s = (s + 1) & mask) {
+		size_t j = procs->pid_index[s];
+
+		if (j == 0) {
+			procs->pid_index[s] = i + 1;
+			return;
+		}
+
+		const pnode_t *q = procs->processes + j - 1;
+		if (q->pid == p->pid && q->host == p->host)
+			return;
 	}
+}
+
+void
+build_pid_index(procs_t *procs)
+{
+	assert(procs);
+
+	size_t size = 16;
+	while (size < 2 * procs->nprocesses)
+		size *= 2;
+
+	free(procs->pid_index);
+	procs->pid_index = calloc(size, sizeof(size_t));
+	CHECK(procs->pid_index);
+	procs->pid_index_size = size;
 
-	return NULL;
+	for (size_t i = 0; i < procs->nprocesses; ++i)
+		pid_index_insert(procs, i);
+}
+
+pnode_t *
+find_process(procs_t *procs, uint32_t host, pid_t pid)
+{
+	size_t mask = procs->pid_index_size - 1;
+
+	for (size_t s = pid_slot(procs, host, pid); ; s = (s + 1) & mask) {
+		size_t j = procs->pid_index[s];
+
+		if (j == 0)
+			return NULL;
+
+		pnode_t *p = procs->processes + j - 1;
+		if (p->pid == pid && p->host == host)
+			return p;
+	}
 }
 
 void
-link_process(procs_t *procs)
+link_process(psc_ctx_t *ctx, procs_t *procs)
 {
 	assert(procs);
 	assert(!procs->root);
 
-	pnode_t *found = find_by_pid(procs, config.root_pid);
-	if (!found) {
+	pid_t root_pid = ctx->config->root_pid;
+
+	if (procs->nhosts > 0) {
+		// The hosts hang from the reserved root
 		procs->root = procs->processes;
-		procs->root->pid = config.root_pid;
 	} else {
-		procs->root = found;
+		pnode_t *found = find_process(procs, 0, root_pid);
+		if (!found) {
+			procs->root = procs->processes;
+			procs->root->pid = root_pid;
+			pid_index_insert(procs, 0);
+		} else {
+			procs->root = found;
+		}
 	}
 
 	// starts from 1 to skip reserved root
 	for (size_t i = 1; i < procs->nprocesses; ++i) {
 		pnode_t *p = procs->processes + i;
 
+		// Hosts are never folded into a stub
+		if (p->host > 0 && p->pid == HOST_PID) {
+			node_add((node_t *)procs->root, (node_t *)p);
+			continue;
+		}
+
 		update_cpu_toplist(procs, p);
 
 		update_mem_toplist(procs, p);
@@ -223,11 +568,22 @@ link_process(procs_t *procs)
 		if (p == procs->root)
 			continue;
 
-		pnode_t *parent = find_by_pid(procs, p->ppid);
+		pid_t ppid = p->ppid;
+
+		// The node of the host stands for its root process
+		if (p->host > 0) {
+			if (p->pid == root_pid)
+				continue;
+
+			if (ppid == root_pid)
+				ppid = HOST_PID;
+		}
+
+		pnode_t *parent = find_process(procs, p->host, ppid);
 		if (!parent)
 			continue;
 
-		if (node_nchildren(&parent->node) < config.max_children) {
+		if (node_nchildren(&parent->node) < ctx->config->max_children) {
 			node_add((node_t *)parent, (node_t *)p);
 		} else {
 			count_as_stub(parent, p);
@@ -240,7 +596,7 @@ link_process(procs_t *procs)
 void
 reserve_root_memory(procs_t *procs)
 {
-	pnode_t *r = get_new_process(procs);
+	pnode_t *r = procs_add(procs);
 	assert(r);
 	r->pid = -1;
 }
@@ -372,10 +728,127 @@ add_stubs(procs_t *procs)
 		snprintf(p->stub->name, PSC_MAX_NAME_LENGHT,
 				"<%zd omitted>", p->nstubs);
 
+		procs->nstubs += p->nstubs;
+
 		node_add((node_t *)p, (node_t *)p->stub);
 	}
 }
 
+// Folds the levels of the tree below the deepest one which fits in
+// --max-nodes (with the folds) into one node per parent. The levels are
+// found breadth-first; all the nodes of the tree are processes.
+void
+fold_levels(psc_ctx_t *ctx, procs_t *procs)
+{
+	size_t max = ctx->config->max_nodes;
+	if (max == 0)
+		return;
+
+	pnode_t **queue = malloc(procs->nprocesses * sizeof(pnode_t *));
+	CHECK(queue);
+
+	// Current and previous levels in the queue
+	size_t begin = 0, end = 0;
+	size_t prev_begin = 0, prev_end = 0;
+
+	for (node_t *n = procs->root->node.first; n != NULL; n = n->next)
+		queue[end++] = (pnode_t *) n;
+
+	size_t ndrawn = 0;
+	bool fold = false;
+
+	while (begin < end) {
+		ndrawn += end - begin;
+
+		size_t nparents = 0;
+		for (size_t i = begin; i < end; ++i) {
+			if (queue[i]->node.first)
+				nparents++;
+		}
+
+		if (nparents == 0)
+			break;
+
+		// Folding a level adds a node per parent, so a level which
+		// does not fit with its folds is folded into the level above
+		// (the first level is always shown)
+		if (ndrawn + nparents > max) {
+			if (prev_end > prev_begin) {
+				begin = prev_begin;
+				end = prev_end;
+			}
+			fold = true;
+			break;
+		}
+
+		size_t next = end;
+		for (size_t i = begin; i < end; ++i) {
+			for (node_t *n = queue[i]->node.first; n != NULL; n = n->next)
+				queue[next++] = (pnode_t *) n;
+		}
+
+		prev_begin = begin;
+		prev_end = end;
+		begin = end;
+		end = next;
+	}
+
+	if (fold) {
+		procs->folds = calloc(end - begin, sizeof(pnode_t));
+		CHECK(procs->folds);
+
+		for (size_t i = begin; i < end; ++i) {
+			if (queue[i]->node.first)
+				fold_children(procs, queue[i], procs->folds + procs->nfolds++);
+		}
+	}
+
+	free(queue);
+}
+
+// Replaces the children of p with the fold, which shows the highest usage
+// among them
+void
+fold_children(procs_t *procs, pnode_t *p, pnode_t *fold)
+{
+	size_t nprocs = 0;
+	size_t nstubs = 0;
+
+	fold_subtree(p, fold, &nprocs, &nstubs);
+
+	fold->pid = HOST_PID;
+	fold->host = p->host;
+	snprintf(fold->name, PSC_MAX_NAME_LENGHT, "<%zu omitted>", nprocs + nstubs);
+
+	// Processes of the stubs are already counted
+	procs->nstubs += nprocs;
+
+	p->node.first = NULL;
+	p->node.last = NULL;
+
+	node_add((node_t *)p, (node_t *)fold);
+}
+
+void
+fold_subtree(pnode_t *p, pnode_t *fold, size_t *nprocs, size_t *nstubs)
+{
+	for (node_t *n = p->node.first; n != NULL; n = n->next) {
+		pnode_t *c = (pnode_t *) n;
+
+		if (c == p->stub)
+			*nstubs += p->nstubs;
+		else
+			(*nprocs)++;
+
+		if (c->mem > fold->mem)
+			fold->mem = c->mem;
+		if (c->cpu > fold->cpu)
+			fold->cpu = c->cpu;
+
+		fold_subtree(c, fold, nprocs, nstubs);
+	}
+}
+
 void
 procs_child_by_pid_recurcive(pnode_t **found, pnode_t *p, pid_t pid)
 {
@@ -1,68 +1,118 @@
 #include <stdio.h>
 #include <stdlib.h>
-#include <errno.h>
 #include <string.h>
 #include <strings.h>
 
 #include "cfg.h"
-#include "procs.h"
-#include "timing.h"
+#include "ctx.h"
 #include "painter.h"
-#include "tree_visualizer.h"
-#include "toplist_visualizer.h"
-
-#define CHECK(x) do { \
-	if (x) break; \
-	fprintf(stderr, "%s:%d error: %s\n", \
-			__FILE__, __LINE__, strerror(errno)); \
-	exit(EXIT_FAILURE); \
-} while (0)
+#include "pipeline.h"
+#include "batch.h"
+#include "timing.h"
 
-int main(int argc, const char *argv[])
+void
+check_config()
 {
-	timing_t tm = {0};
-	tm_start(&tm);
+	if (config.replay && config.read_stdin) {
+		fprintf(stderr, "--replay can not be used together with --stdin\n");
+		exit(EXIT_FAILURE);
+	}
 
-	parse_cmdline(argc, argv);
+	if (config.at && !config.replay) {
+		fprintf(stderr, "--at requires --replay\n");
+		exit(EXIT_FAILURE);
+	}
 
-	procs_t *procs = calloc(1, sizeof(procs_t));
-	CHECK(procs);
+	if (!config.batch_input != !config.batch_output) {
+		fprintf(stderr, "--batch-input and --batch-output are used together\n");
+		exit(EXIT_FAILURE);
+	}
 
-	FILE *fp = NULL;
-	if (config.read_stdin)
-		fp = stdin;
+	if (config.batch_input && (config.read_stdin || config.replay ||
+				config.record || config.loop || config.outputs)) {
+		fprintf(stderr, "--batch-input can not be used together with --stdin, "
+				"--replay, --record, --loop or --outputs\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if (config.hosts && (config.read_stdin || config.replay || config.record ||
+				config.batch_input)) {
+		fprintf(stderr, "--hosts can not be used together with --stdin, "
+				"--replay, --record or --batch-input\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if (config.frames && config.outputs) {
+		fprintf(stderr, "--frames can not be used together with --outputs\n");
+		exit(EXIT_FAILURE);
+	}
 
-	procs_init(procs, fp);
+	if (config.frames) {
+		if (!config.replay || config.at || config.loop) {
+			fprintf(stderr, "--frames requires --replay and can not be used "
+					"together with --at or --loop\n");
+			exit(EXIT_FAILURE);
+		}
+
+		if (!config.output || (strcmp(config.output, "-") != 0 &&
+					!pipeline_frame_pattern(config.output))) {
+			fprintf(stderr, "--frames requires --output=- or an --output with "
+					"a frame number, e.g. frames/%%06d.png\n");
+			exit(EXIT_FAILURE);
+		}
+	}
 
-	tm_tick(&tm, "init");
+	if (config.control && !config.loop) {
+		fprintf(stderr, "--control requires --loop\n");
+		exit(EXIT_FAILURE);
+	}
 
-	node_reorder_by_leaves((node_t *)procs->root);
+	if (!config.loop)
+		return;
 
-	node_arrange((node_t *)procs->root);
+	// Frames on stdin are drawn as soon as they arrive
+	if (config.read_stdin)
+		return;
 
-	tm_tick(&tm, "arrange");
+	if (config.interval <= 0) {
+		fprintf(stderr, "--loop requires positive --interval\n");
+		exit(EXIT_FAILURE);
+	}
+}
 
-	painter_t *painter = calloc(1, sizeof(painter_t));
-	CHECK(painter);
+int main(int argc, const char *argv[])
+{
+	parse_cmdline(argc, argv);
 
-	painter_init(painter);
+	check_config();
 
-	draw_tree(painter, procs);
+	tm_init();
 
-	tm_tick(&tm, "draw tree");
+	int status = EXIT_SUCCESS;
 
-	if (config.toplists.cpulist.show || config.toplists.memlist.show) {
-		draw_toplists(painter, procs);
-		tm_tick(&tm, "draw lists");
-	}
+	if (config.batch_input) {
+		if (!batch_run())
+			status = EXIT_FAILURE;
+	} else if (config.frames) {
+		pipeline_timelapse();
+	} else {
+		psc_ctx_t ctx;
+		psc_ctx_init(&ctx, &config);
 
-	painter_write(painter);
+		size_t noutputs;
+		pipeline_output_t *outputs = pipeline_outputs_init(&noutputs);
 
-	tm_tick(&tm, "write");
+		pipeline_run(&ctx, outputs, noutputs);
+
+		pipeline_outputs_dinit(outputs, noutputs);
+
+		psc_ctx_dinit(&ctx);
+	}
 
-	painter_dinit(painter);
+	if (config.profile)
+		tm_report(stderr);
 
-	tm_total(&tm);
+	tm_dinit();
 
-	return 0;
+	return status;
 }
@@ -0,0 +1,61 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+
+#include "queue.h"
+
+#define CHECK(x) do { \
+	if (x) break; \
+	fprintf(stderr, "%s:%d error: %s\n", \
+			__FILE__, __LINE__, strerror(errno)); \
+	exit(EXIT_FAILURE); \
+} while (0)
+
+void
+queue_init(queue_t *q)
+{
+	memset(q, 0, sizeof(queue_t));
+	CHECK(pthread_mutex_init(&q->mutex, NULL) == 0);
+	CHECK(pthread_cond_init(&q->cond, NULL) == 0);
+}
+
+void
+queue_dinit(queue_t *q)
+{
+	pthread_mutex_destroy(&q->mutex);
+	pthread_cond_destroy(&q->cond);
+}
+
+void
+queue_push(queue_t *q, void *item)
+{
+	pthread_mutex_lock(&q->mutex);
+
+	while (q->count == PIPELINE_DEPTH)
+		pthread_cond_wait(&q->cond, &q->mutex);
+
+	q->items[(q->head + q->count) % PIPELINE_DEPTH] = item;
+	q->count++;
+
+	pthread_cond_broadcast(&q->cond);
+	pthread_mutex_unlock(&q->mutex);
+}
+
+void *
+queue_pop(queue_t *q)
+{
+	pthread_mutex_lock(&q->mutex);
+
+	while (q->count == 0)
+		pthread_cond_wait(&q->cond, &q->mutex);
+
+	void *item = q->items[q->head];
+	q->head = (q->head + 1) % PIPELINE_DEPTH;
+	q->count--;
+
+	pthread_cond_broadcast(&q->cond);
+	pthread_mutex_unlock(&q->mutex);
+
+	return item;
+}
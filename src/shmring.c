@@ -0,0 +1,242 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "shmring.h"
+
+#define SHMRING_ALIGN 4096
+
+#define LOAD(p) __atomic_load_n((p), __ATOMIC_RELAXED)
+#define STORE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELAXED)
+
+static size_t
+align_up(size_t n)
+{
+	return (n + SHMRING_ALIGN - 1) / SHMRING_ALIGN * SHMRING_ALIGN;
+}
+
+static bool
+map(shmring_t *ring, int fd, size_t size, int prot)
+{
+	void *p = mmap(NULL, size, prot, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (p == MAP_FAILED)
+		return false;
+
+	ring->data = p;
+	ring->header = p;
+	ring->size = size;
+	return true;
+}
+
+// Tells the readers of an earlier ring to reopen the name. Errors are
+// ignored, the object is unlinked anyway.
+static void
+mark_closed(const char *name)
+{
+	int fd = shm_open(name, O_RDWR, 0);
+	if (fd < 0)
+		return;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(shmring_header_t)) {
+		close(fd);
+		return;
+	}
+
+	shmring_t old;
+	if (!map(&old, fd, sizeof(shmring_header_t), PROT_READ | PROT_WRITE))
+		return;
+
+	uint32_t magic = SHMRING_MAGIC;
+	__atomic_compare_exchange_n(&old.header->magic, &magic, SHMRING_CLOSED,
+			false, __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+
+	shmring_close(&old);
+}
+
+bool
+shmring_create(shmring_t *ring, const char *name,
+		size_t width, size_t height, size_t nbuffers)
+{
+	assert(ring);
+	assert(name);
+	assert(nbuffers > 0);
+
+	memset(ring, 0, sizeof(shmring_t));
+	ring->writer = true;
+
+	size_t stride = width * 4;
+	size_t offset = align_up(sizeof(shmring_header_t));
+	size_t bufsize = align_up(stride * height);
+	size_t size = offset + bufsize * nbuffers;
+
+	// Readers of an earlier ring keep their mapping of it, which would
+	// fault if it was truncated in place
+	mark_closed(name);
+
+	if (shm_unlink(name) != 0 && errno != ENOENT)
+		return false;
+
+	int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+	if (fd < 0)
+		return false;
+
+	if (ftruncate(fd, size) != 0) {
+		close(fd);
+		return false;
+	}
+
+	if (!map(ring, fd, size, PROT_READ | PROT_WRITE))
+		return false;
+
+	shmring_header_t *h = ring->header;
+	memset(h, 0, sizeof(shmring_header_t));
+	h->version = SHMRING_VERSION;
+	h->nbuffers = nbuffers;
+	h->width = width;
+	h->height = height;
+	h->stride = stride;
+	h->buffer_offset = offset;
+	h->buffer_size = bufsize;
+
+	// Readers check the magic before anything else
+	__atomic_store_n(&h->magic, SHMRING_MAGIC, __ATOMIC_RELEASE);
+
+	return true;
+}
+
+bool
+shmring_open(shmring_t *ring, const char *name)
+{
+	assert(ring);
+	assert(name);
+
+	memset(ring, 0, sizeof(shmring_t));
+
+	int fd = shm_open(name, O_RDONLY, 0);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(shmring_header_t)) {
+		close(fd);
+		errno = EINVAL;
+		return false;
+	}
+
+	if (!map(ring, fd, st.st_size, PROT_READ))
+		return false;
+
+	shmring_header_t *h = ring->header;
+	bool ok = __atomic_load_n(&h->magic, __ATOMIC_ACQUIRE) == SHMRING_MAGIC &&
+		h->version == SHMRING_VERSION &&
+		h->nbuffers > 0 &&
+		h->buffer_offset + h->buffer_size * h->nbuffers <= ring->size;
+
+	if (!ok) {
+		shmring_close(ring);
+		errno = EINVAL;
+		return false;
+	}
+
+	return true;
+}
+
+void
+shmring_close(shmring_t *ring)
+{
+	assert(ring);
+
+	if (ring->data)
+		munmap(ring->data, ring->size);
+
+	memset(ring, 0, sizeof(shmring_t));
+}
+
+static uint8_t *
+buffer(const shmring_t *ring, uint64_t frame)
+{
+	const shmring_header_t *h = ring->header;
+	return ring->data + h->buffer_offset + h->buffer_size * (frame % h->nbuffers);
+}
+
+uint8_t *
+shmring_next(shmring_t *ring)
+{
+	assert(ring);
+	assert(ring->writer);
+
+	return buffer(ring, ring->header->frame + 1);
+}
+
+void
+shmring_publish(shmring_t *ring)
+{
+	assert(ring);
+	assert(ring->writer);
+
+	shmring_header_t *h = ring->header;
+	uint64_t frame = h->frame + 1;
+	uint32_t seq = h->seq;
+
+	STORE(&h->seq, seq + 1);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	STORE(&h->current, frame % h->nbuffers);
+	STORE(&h->frame, frame);
+
+	__atomic_store_n(&h->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+const uint8_t *
+shmring_latest(const shmring_t *ring, uint64_t *frame)
+{
+	assert(ring);
+	assert(frame);
+
+	shmring_header_t *h = ring->header;
+	uint32_t s1, s2;
+
+	do {
+		s1 = __atomic_load_n(&h->seq, __ATOMIC_ACQUIRE);
+		*frame = LOAD(&h->frame);
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		s2 = LOAD(&h->seq);
+	} while (s1 != s2 || (s1 & 1));
+
+	if (*frame == 0)
+		return NULL;
+
+	return buffer(ring, *frame);
+}
+
+bool
+shmring_valid(const shmring_t *ring, uint64_t frame)
+{
+	assert(ring);
+
+	// Orders the reads of the pixels before the check
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+	shmring_header_t *h = ring->header;
+	uint64_t latest = LOAD(&h->frame);
+
+	// The writer renders frame latest + 1 into the buffer of frame
+	// latest + 1 - nbuffers
+	return frame > 0 && latest + 1 - frame < h->nbuffers;
+}
+
+bool
+shmring_closed(const shmring_t *ring)
+{
+	assert(ring);
+
+	return __atomic_load_n(&ring->header->magic, __ATOMIC_ACQUIRE) != SHMRING_MAGIC;
+}
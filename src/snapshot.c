@@ -0,0 +1,309 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "snapshot.h"
+
+#define SNAPSHOT_ALIGN 8
+
+static size_t
+align_up(size_t n)
+{
+	return (n + SNAPSHOT_ALIGN - 1) / SNAPSHOT_ALIGN * SNAPSHOT_ALIGN;
+}
+
+static size_t
+names_size(const procs_t *procs)
+{
+	size_t size = strlen(procs->cpu_label) + 1 + strlen(procs->mem_label) + 1;
+
+	for (size_t i = 1; i < procs->nprocesses; ++i)
+		size += strnlen(procs->processes[i].name, PSC_MAX_NAME_LENGHT) + 1;
+
+	return size;
+}
+
+static bool
+write_string(FILE *fp, const char *s, size_t max)
+{
+	size_t l = strnlen(s, max);
+	return fwrite(s, 1, l, fp) == l && fputc('\0', fp) != EOF;
+}
+
+size_t
+snapshot_size(const procs_t *procs)
+{
+	assert(procs);
+	assert(procs->nprocesses > 0);
+
+	// The first process is reserved for the root (see procs_alloc)
+	size_t n = procs->nprocesses - 1;
+
+	return align_up(sizeof(snapshot_header_t) +
+			n * sizeof(snapshot_proc_t) + names_size(procs));
+}
+
+bool
+snapshot_write(FILE *fp, const procs_t *procs, int64_t time)
+{
+	assert(fp);
+	assert(procs);
+	assert(procs->nprocesses > 0);
+
+	size_t n = procs->nprocesses - 1;
+	size_t nsize = names_size(procs);
+	size_t size = snapshot_size(procs);
+
+	snapshot_header_t h = {
+		.magic      = SNAPSHOT_MAGIC,
+		.version    = SNAPSHOT_VERSION,
+		.size       = size,
+		.time       = time,
+		.nprocesses = n,
+		.names_size = nsize,
+		.cpu_value  = procs->cpu_value,
+		.mem_value  = procs->mem_value,
+	};
+
+	uint32_t offset = 0;
+
+	h.cpu_label = offset;
+	offset += strlen(procs->cpu_label) + 1;
+	h.mem_label = offset;
+	offset += strlen(procs->mem_label) + 1;
+
+	if (fwrite(&h, sizeof(h), 1, fp) != 1)
+		return false;
+
+	for (size_t i = 1; i <= n; ++i) {
+		const pnode_t *p = procs->processes + i;
+
+		snapshot_proc_t r = {
+			.pid  = p->pid,
+			.ppid = p->ppid,
+			.name = offset,
+			.cpu  = p->cpu,
+			.mem  = p->mem,
+		};
+
+		offset += strnlen(p->name, PSC_MAX_NAME_LENGHT) + 1;
+
+		if (fwrite(&r, sizeof(r), 1, fp) != 1)
+			return false;
+	}
+
+	if (!write_string(fp, procs->cpu_label, PSC_LABEL_BUFSIZE) ||
+			!write_string(fp, procs->mem_label, PSC_LABEL_BUFSIZE))
+		return false;
+
+	for (size_t i = 1; i <= n; ++i) {
+		if (!write_string(fp, procs->processes[i].name, PSC_MAX_NAME_LENGHT))
+			return false;
+	}
+
+	static const char padding[SNAPSHOT_ALIGN] = {0};
+	size_t npadding = size - sizeof(h) - n * sizeof(snapshot_proc_t) - nsize;
+
+	return fwrite(padding, 1, npadding, fp) == npadding;
+}
+
+bool
+snapshot_valid(const void *data, size_t size)
+{
+	assert(data);
+
+	if (size < sizeof(snapshot_header_t))
+		return false;
+
+	const snapshot_header_t *h = data;
+
+	if (h->magic != SNAPSHOT_MAGIC || h->version != SNAPSHOT_VERSION)
+		return false;
+
+	uint64_t nsize = h->names_size;
+	uint64_t used = sizeof(snapshot_header_t) +
+		(uint64_t) h->nprocesses * sizeof(snapshot_proc_t) + nsize;
+
+	if (h->size > size || used > h->size)
+		return false;
+
+	// Every name must be terminated within the string table
+	const char *names = (const char *) data + used - nsize;
+	if (nsize == 0 || names[nsize - 1] != '\0')
+		return false;
+
+	const snapshot_proc_t *procs = (const snapshot_proc_t *) (h + 1);
+	for (size_t i = 0; i < h->nprocesses; ++i) {
+		if (procs[i].name >= nsize)
+			return false;
+	}
+
+	return h->cpu_label < nsize && h->mem_label < nsize;
+}
+
+bool
+snapshot_map(snapshot_t *snapshot, const char *path)
+{
+	assert(snapshot);
+	assert(path);
+
+	memset(snapshot, 0, sizeof(snapshot_t));
+
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		close(fd);
+		errno = EINVAL;
+		return false;
+	}
+
+	void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (data == MAP_FAILED)
+		return false;
+
+	if (!snapshot_view(snapshot, data, st.st_size)) {
+		munmap(data, st.st_size);
+		errno = EINVAL;
+		return false;
+	}
+
+	snapshot->data = data;
+	snapshot->size = st.st_size;
+
+	return true;
+}
+
+bool
+snapshot_view(snapshot_t *snapshot, const void *data, size_t size)
+{
+	assert(snapshot);
+	assert(data);
+
+	memset(snapshot, 0, sizeof(snapshot_t));
+
+	if (!snapshot_valid(data, size))
+		return false;
+
+	snapshot->header = data;
+	snapshot->procs = (const snapshot_proc_t *) (snapshot->header + 1);
+	snapshot->names = (const char *) (snapshot->procs + snapshot->header->nprocesses);
+
+	return true;
+}
+
+void
+snapshot_unmap(snapshot_t *snapshot)
+{
+	assert(snapshot);
+
+	if (snapshot->data)
+		munmap(snapshot->data, snapshot->size);
+
+	memset(snapshot, 0, sizeof(snapshot_t));
+}
+
+void
+snapshot_load(const snapshot_t *snapshot, procs_t *procs)
+{
+	assert(snapshot);
+	assert(snapshot->header);
+	assert(procs);
+
+	for (size_t i = 0; i < snapshot->header->nprocesses; ++i) {
+		const snapshot_proc_t *r = snapshot->procs + i;
+
+		pnode_t *p = procs_add(procs);
+		if (!p) {
+			procs->nskipped += snapshot->header->nprocesses - i;
+			return;
+		}
+
+		p->pid = r->pid;
+		p->ppid = r->ppid;
+		p->cpu = r->cpu;
+		p->mem = r->mem;
+		strncpy(p->name, snapshot->names + r->name, PSC_MAX_NAME_LENGHT - 1);
+	}
+}
+
+void
+snapshot_stream_init(snapshot_stream_t *stream, FILE *fp)
+{
+	assert(stream);
+	assert(fp);
+
+	memset(stream, 0, sizeof(snapshot_stream_t));
+	stream->fp = fp;
+}
+
+void
+snapshot_stream_dinit(snapshot_stream_t *stream)
+{
+	assert(stream);
+
+	free(stream->buf);
+
+	memset(stream, 0, sizeof(snapshot_stream_t));
+}
+
+bool
+snapshot_stream_next(snapshot_stream_t *stream)
+{
+	assert(stream);
+	assert(stream->fp);
+
+	memset(&stream->snapshot, 0, sizeof(snapshot_t));
+
+	snapshot_header_t h;
+	size_t n = fread(&h, 1, sizeof(h), stream->fp);
+	if (n == 0 && feof(stream->fp))
+		return false;
+
+	if (n != sizeof(h) || h.magic != SNAPSHOT_MAGIC || h.version != SNAPSHOT_VERSION) {
+		errno = EINVAL;
+		return false;
+	}
+
+	// Bounds the allocation for a corrupted size
+	uint64_t max = sizeof(h) + SNAPSHOT_ALIGN + 2 * (PSC_LABEL_BUFSIZE + 1) +
+		(uint64_t) h.nprocesses * (sizeof(snapshot_proc_t) + PSC_MAX_NAME_LENGHT);
+
+	if (h.size < sizeof(h) || h.size > max || h.size % SNAPSHOT_ALIGN != 0) {
+		errno = EINVAL;
+		return false;
+	}
+
+	if (h.size > stream->capacity) {
+		uint64_t *buf = realloc(stream->buf, h.size);
+		if (!buf)
+			return false;
+
+		stream->buf = buf;
+		stream->capacity = h.size;
+	}
+
+	memcpy(stream->buf, &h, sizeof(h));
+
+	size_t rest = h.size - sizeof(h);
+	if (fread((uint8_t *) stream->buf + sizeof(h), 1, rest, stream->fp) != rest) {
+		errno = EINVAL;
+		return false;
+	}
+
+	if (!snapshot_view(&stream->snapshot, stream->buf, h.size)) {
+		errno = EINVAL;
+		return false;
+	}
+
+	return true;
+}
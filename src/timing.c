@@ -1,74 +1,464 @@
 #include <stdint.h>
+#include <stdlib.h>
 #include <assert.h>
 #include <string.h>
 #include <stdio.h>
+#include <errno.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/syscall.h>
 
 #include "timing.h"
-#include "config.h"
+#include "cfg.h"
 
-#define TIME_FMT "%13s: %.4lf / %.4lf seconds\n"
+#define TIME_HEADER_FMT "%11s %7s %24s %24s %8s %11s %9s %11s\n"
+#define TIME_FMT "%11s %7zu %8.2lf/%7.2lf/%7.2lf %8.2lf/%7.2lf/%7.2lf %8.0lf %11.0lf %9.1lf %11.0lf\n"
 
-double
-tm_cpudiff(clock_t a, clock_t b)
+typedef struct {
+	struct timespec wall;
+	struct timespec cpu;
+	double syscalls;
+} tm_clock_t;
+
+typedef struct {
+	size_t calls;
+	double wall[PSC_PROFILE_WINDOW];
+	double cpu[PSC_PROFILE_WINDOW];
+	double counters[TM_NCOUNTERS];
+} tm_stats_t;
+
+static const char *stage_names[TM_NSTAGES] = {
+	"collect",
+	"wait",
+	"link",
+	"reorder",
+	"arrange",
+	"compare",
+	"draw tree",
+	"draw lists",
+	"encode",
+	"write",
+};
+
+static tm_stats_t stats[TM_NSTAGES];
+
+static pthread_mutex_t stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static volatile sig_atomic_t report_requested = 0;
+
+static bool enabled = false;
+
+// Chrome trace event format (JSON array), guarded by stats_mutex
+static FILE *trace_fp = NULL;
+static size_t trace_nevents = 0;
+
+static __thread tm_clock_t thread_clock;
+
+// Start of the nested stage, and the time of the nested stages since the
+// previous tick
+static __thread tm_clock_t nested_clock;
+static __thread double nested_wall, nested_cpu, nested_syscalls;
+
+// -1 if not opened yet, -2 if not available
+static __thread int thread_io_fd = -1;
+
+static __thread long thread_id = 0;
+
+// Counters of the stages not ticked yet, for the trace events
+static __thread double thread_counters[TM_NSTAGES][TM_NCOUNTERS];
+
+static void
+request_report(int signum)
 {
-	double dt = (double) (a - b) / CLOCKS_PER_SEC;
-	if (dt < 0)
-		dt = 0;
-	return dt;
+	report_requested = 1;
 }
 
-double
-tm_walldiff(struct timespec *a, struct timespec *b)
+void
+tm_init()
 {
-	double tn = (double) (a->tv_nsec - b->tv_nsec) * 1e-9;
-	double ts = difftime(a->tv_sec, b->tv_sec);
-	double dt = ts + tn;
+	if (config.trace) {
+		trace_fp = fopen(config.trace, "w");
+		if (!trace_fp) {
+			fprintf(stderr, "Can not open %s: %s\n", config.trace, strerror(errno));
+			exit(EXIT_FAILURE);
+		}
+
+		// The closing bracket is optional, so that the trace of a killed
+		// process can still be loaded
+		fputs("[\n", trace_fp);
+	}
+
+	enabled = config.profile || trace_fp || config.metrics_file;
+
+	if (!config.profile)
+		return;
+
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = request_report;
+	sa.sa_flags = SA_RESTART;
+	sigaction(SIGUSR1, &sa, NULL);
+}
+
+void
+tm_dinit()
+{
+	if (!trace_fp)
+		return;
+
+	pthread_mutex_lock(&stats_mutex);
+
+	fputs("\n]\n", trace_fp);
+	fclose(trace_fp);
+	trace_fp = NULL;
+
+	pthread_mutex_unlock(&stats_mutex);
+}
+
+static long
+get_thread_id()
+{
+	if (!thread_id)
+		thread_id = syscall(SYS_gettid);
+
+	return thread_id;
+}
+
+static double
+to_us(struct timespec *t)
+{
+	return (double) t->tv_sec * 1e6 + (double) t->tv_nsec * 1e-3;
+}
+
+// Expects stats_mutex to be locked
+static void
+trace_begin_event()
+{
+	if (trace_nevents++ > 0)
+		fputs(",\n", trace_fp);
+}
+
+void
+tm_thread_name(const char *name)
+{
+	assert(name);
+
+	if (!trace_fp)
+		return;
+
+	pthread_mutex_lock(&stats_mutex);
+
+	trace_begin_event();
+	fprintf(trace_fp,
+			"{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%ld,"
+			"\"args\":{\"name\":\"%s\"}}",
+			(int) getpid(), get_thread_id(), name);
+
+	pthread_mutex_unlock(&stats_mutex);
+}
+
+// Expects stats_mutex to be locked
+static void
+trace_stage(tm_stage_t stage, tm_clock_t *from, tm_clock_t *to)
+{
+	int pid = getpid();
+	long tid = get_thread_id();
+	double *counters = thread_counters[stage];
+
+	trace_begin_event();
+	fprintf(trace_fp,
+			"{\"name\":\"%s\",\"cat\":\"stage\",\"ph\":\"X\",\"pid\":%d,\"tid\":%ld,"
+			"\"ts\":%.3lf,\"dur\":%.3lf,\"args\":{\"cpu_ms\":%.3lf,\"syscalls\":%.0lf",
+			stage_names[stage], pid, tid, to_us(&from->wall),
+			to_us(&to->wall) - to_us(&from->wall),
+			(to_us(&to->cpu) - to_us(&from->cpu)) * 1e-3,
+			to->syscalls > from->syscalls ? to->syscalls - from->syscalls - 1 : 0);
+
+	if (counters[TM_NODES] > 0)
+		fprintf(trace_fp, ",\"nodes\":%.0lf", counters[TM_NODES]);
+	if (counters[TM_PRIMITIVES] > 0)
+		fprintf(trace_fp, ",\"primitives\":%.0lf", counters[TM_PRIMITIVES]);
+	if (counters[TM_SKIPPED] > 0)
+		fprintf(trace_fp, ",\"skipped\":%.0lf", counters[TM_SKIPPED]);
+
+	fputs("}}", trace_fp);
+
+	if (stage == TM_COLLECT) {
+		trace_begin_event();
+		fprintf(trace_fp,
+				"{\"name\":\"processes\",\"ph\":\"C\",\"pid\":%d,\"ts\":%.3lf,"
+				"\"args\":{\"count\":%.0lf}}",
+				pid, to_us(&to->wall), counters[TM_NODES]);
+	}
+
+	if (counters[TM_CACHE_HITS] > 0) {
+		trace_begin_event();
+		fprintf(trace_fp,
+				"{\"name\":\"cache hits\",\"ph\":\"C\",\"pid\":%d,\"ts\":%.3lf,"
+				"\"args\":{\"%s\":%.0lf}}",
+				pid, to_us(&to->wall), stage_names[stage], counters[TM_CACHE_HITS]);
+	}
+
+	// A frame is complete, so that the file can be followed while it grows
+	if (stage == TM_WRITE)
+		fflush(trace_fp);
+
+	memset(counters, 0, sizeof(thread_counters[stage]));
+}
+
+static double
+tm_diff(struct timespec *a, struct timespec *b)
+{
+	double dt = (double) (a->tv_sec - b->tv_sec) +
+		(double) (a->tv_nsec - b->tv_nsec) * 1e-9;
+
 	if (dt < 0)
 		return 0;
 	return dt;
 }
 
+// Read and write syscalls of the calling thread, see proc(5)
+static double
+read_syscalls()
+{
+	if (thread_io_fd == -1) {
+		thread_io_fd = open("/proc/thread-self/io", O_RDONLY | O_CLOEXEC);
+		if (thread_io_fd < 0)
+			thread_io_fd = -2;
+	}
+
+	if (thread_io_fd < 0)
+		return 0;
+
+	char buf[512];
+	ssize_t n = pread(thread_io_fd, buf, sizeof(buf) - 1, 0);
+	if (n <= 0)
+		return 0;
+	buf[n] = '\0';
+
+	double total = 0;
+
+	const char *keys[] = {"syscr:", "syscw:"};
+	for (size_t i = 0; i < 2; ++i) {
+		const char *p = strstr(buf, keys[i]);
+		if (p)
+			total += strtod(p + strlen(keys[i]), NULL);
+	}
+
+	return total;
+}
+
+static void
+sample(tm_clock_t *clk)
+{
+	clock_gettime(CLOCK_MONOTONIC, &clk->wall);
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &clk->cpu);
+	clk->syscalls = read_syscalls();
+}
+
+void
+tm_start()
+{
+	if (!enabled)
+		return;
+
+	sample(&thread_clock);
+}
+
+// Expects stats_mutex to be locked. The excluded time is subtracted.
+static void
+record(tm_stage_t stage, tm_clock_t *from, tm_clock_t *to,
+		double wall, double cpu, double syscalls)
+{
+	tm_stats_t *s = &stats[stage];
+	size_t i = s->calls % PSC_PROFILE_WINDOW;
+
+	double w = tm_diff(&to->wall, &from->wall) - wall;
+	double c = tm_diff(&to->cpu, &from->cpu) - cpu;
+
+	s->wall[i] = w > 0 ? w : 0;
+	s->cpu[i] = c > 0 ? c : 0;
+	s->calls++;
+
+	// Excluding the read of /proc/thread-self/io itself
+	if (to->syscalls > from->syscalls + syscalls)
+		s->counters[TM_SYSCALLS] += to->syscalls - from->syscalls - syscalls - 1;
+
+	if (trace_fp)
+		trace_stage(stage, from, to);
+}
+
+void
+tm_tick(tm_stage_t stage)
+{
+	if (!enabled)
+		return;
+
+	assert(stage < TM_NSTAGES);
+
+	tm_clock_t now;
+	sample(&now);
+
+	pthread_mutex_lock(&stats_mutex);
+	record(stage, &thread_clock, &now, nested_wall, nested_cpu, nested_syscalls);
+	pthread_mutex_unlock(&stats_mutex);
+
+	nested_wall = nested_cpu = nested_syscalls = 0;
+
+	if (report_requested && config.profile) {
+		report_requested = 0;
+		tm_report(stderr);
+		sample(&now);
+	}
+
+	thread_clock = now;
+}
+
+void
+tm_nested_start()
+{
+	if (!enabled)
+		return;
+
+	sample(&nested_clock);
+}
+
 void
-tm_start(timing_t *tm)
+tm_nested_tick(tm_stage_t stage)
 {
-#if PSC_PRINT_TIME
-	tm->cputime = clock();
-	clock_gettime(CLOCK_REALTIME, &tm->walltime);
-	tm->ctotal = 0;
-	tm->wtotal = 0;
+	if (!enabled)
+		return;
+
+	assert(stage < TM_NSTAGES);
+
+	tm_clock_t now;
+	sample(&now);
 
-	fprintf(stderr, "%13s  %6s / %6s \n", " ", "cpu", "wall");
-#endif
+	pthread_mutex_lock(&stats_mutex);
+	record(stage, &nested_clock, &now, 0, 0, 0);
+	pthread_mutex_unlock(&stats_mutex);
+
+	nested_wall += tm_diff(&now.wall, &nested_clock.wall);
+	nested_cpu += tm_diff(&now.cpu, &nested_clock.cpu);
+	// With both reads of /proc/thread-self/io
+	nested_syscalls += now.syscalls - nested_clock.syscalls + 1;
 }
 
 void
-tm_tick(timing_t *tm, const char *message)
+tm_count(tm_stage_t stage, tm_counter_t counter, size_t n)
+{
+	if (!enabled)
+		return;
+
+	assert(stage < TM_NSTAGES);
+	assert(counter < TM_NCOUNTERS);
+
+	thread_counters[stage][counter] += n;
+
+	pthread_mutex_lock(&stats_mutex);
+	stats[stage].counters[counter] += n;
+	pthread_mutex_unlock(&stats_mutex);
+}
+
+bool
+tm_last(tm_stage_t stage, double *wall, double *cpu)
 {
-#if PSC_PRINT_TIME
-	assert(tm);
-	assert(message);
+	assert(stage < TM_NSTAGES);
+	assert(wall);
+	assert(cpu);
+
+	pthread_mutex_lock(&stats_mutex);
+
+	tm_stats_t *s = &stats[stage];
+	bool found = s->calls > 0;
+
+	if (found) {
+		size_t i = (s->calls - 1) % PSC_PROFILE_WINDOW;
+		*wall = s->wall[i];
+		*cpu = s->cpu[i];
+	}
+
+	pthread_mutex_unlock(&stats_mutex);
+
+	return found;
+}
 
-	clock_t ct2 = clock();
-	struct timespec wt2 = {0};
-	clock_gettime(CLOCK_REALTIME, &wt2);
+static int
+double_comp(const void *a, const void *b)
+{
+	double da = *(const double *) a;
+	double db = *(const double *) b;
 
-	double cdt = tm_cpudiff(ct2, tm->cputime);
-	double wdt = tm_walldiff(&wt2, &tm->walltime);
+	if (da < db)
+		return -1;
+	if (da > db)
+		return 1;
+	return 0;
+}
 
-	fprintf(stderr, TIME_FMT, message, cdt, wdt);
+// Sorts the window in place and returns min, median and p99 in ms
+static void
+percentiles(double *window, size_t n, double res[3])
+{
+	qsort(window, n, sizeof(double), double_comp);
 
-	tm->ctotal += cdt;
-	tm->wtotal += wdt;
+	size_t p99 = n * 99 / 100;
+	if (p99 >= n)
+		p99 = n - 1;
 
-	tm->cputime = clock();
-	clock_gettime(CLOCK_REALTIME, &tm->walltime);
-#endif
+	res[0] = window[0] * 1e3;
+	res[1] = window[n / 2] * 1e3;
+	res[2] = window[p99] * 1e3;
 }
 
 void
-tm_total(timing_t *tm)
+tm_report(FILE *fp)
 {
-#if PSC_PRINT_TIME
-	fprintf(stderr, TIME_FMT, "total", tm->ctotal, tm->wtotal);
-#endif
+	assert(fp);
+
+	static double window[PSC_PROFILE_WINDOW];
+
+	pthread_mutex_lock(&stats_mutex);
+
+	fprintf(fp, TIME_HEADER_FMT, "stage", "runs",
+			"wall ms min/median/p99", "cpu ms min/median/p99",
+			"nodes", "primitives", "syscalls", "cache hits");
+
+	for (size_t i = 0; i < TM_NSTAGES; ++i) {
+		tm_stats_t *s = &stats[i];
+		if (s->calls == 0)
+			continue;
+
+		size_t n = s->calls;
+		if (n > PSC_PROFILE_WINDOW)
+			n = PSC_PROFILE_WINDOW;
+
+		double wall[3], cpu[3];
+
+		memcpy(window, s->wall, n * sizeof(double));
+		percentiles(window, n, wall);
+
+		memcpy(window, s->cpu, n * sizeof(double));
+		percentiles(window, n, cpu);
+
+		fprintf(fp, TIME_FMT, stage_names[i], s->calls,
+				wall[0], wall[1], wall[2],
+				cpu[0], cpu[1], cpu[2],
+				s->counters[TM_NODES] / s->calls,
+				s->counters[TM_PRIMITIVES] / s->calls,
+				s->counters[TM_SYSCALLS] / s->calls,
+				s->counters[TM_CACHE_HITS] / s->calls);
+	}
+
+	const tm_stats_t *cmp = &stats[TM_COMPARE];
+	if (cmp->calls > 0)
+		fprintf(fp, "%.0lf of %zu frames were skipped as unchanged\n",
+				cmp->counters[TM_SKIPPED], cmp->calls);
+
+	pthread_mutex_unlock(&stats_mutex);
+
+	fflush(fp);
 }
@@ -3,12 +3,14 @@
 #include <math.h>
 #include <ppoint.h>
 
-#include "cfg.h"
 #include "node.h"
 #include "toplist_visualizer.h"
 #include "utils.h"
 
 typedef struct {
+	const psc_ctx_t *ctx;
+	// ctx->config
+	const cfg_t *config;
 	bool offset_headers;
 	painter_t *painter;
 	real_t pad;
@@ -19,13 +21,15 @@ real_t
 calc_max_pid_width(painter_t *painter, pnode_t **list);
 
 void
-draw_toplist(visualizer_t *vis, toplist_t *cfg, pnode_t **list, point_t pos);
+draw_toplist(visualizer_t *vis, const toplist_t *cfg, real_t value, const char *label,
+		pnode_t **list, point_t pos);
 
 void
-draw_toplists_header(visualizer_t *vis, toplist_t *cfg, point_t pos);
+draw_toplists_header(visualizer_t *vis, const toplist_t *cfg, real_t value,
+		const char *label, point_t pos);
 
 void
-draw_toplists_row(visualizer_t *vis, toplist_t *cfg, pnode_t *node, point_t pos, real_t pid_width);
+draw_toplists_row(visualizer_t *vis, const toplist_t *cfg, pnode_t *node, point_t pos, real_t pid_width);
 
 void
 draw_text(visualizer_t *vis, const char *text, point_t pos);
@@ -39,53 +43,69 @@ draw_pid(visualizer_t *vis, pid_t pid, point_t pos);
 void
 draw_pdot(visualizer_t *vis, pnode_t *node, point_t pos);
 
+char *
+row_value(char *buf, const toplist_t *cfg, const pnode_t *node);
+
+uint64_t
+hash_toplist(const psc_ctx_t *ctx, const toplist_t *cfg, real_t value,
+		const char *label, pnode_t **list, uint64_t h);
+
 void
-draw_toplists(painter_t *painter, procs_t *procs)
+draw_toplists(const psc_ctx_t *ctx, painter_t *painter, procs_t *procs)
 {
+	assert(ctx);
+
 	visualizer_t vis = {
+		.ctx     = ctx,
+		.config  = ctx->config,
 		.painter = painter,
-		.pad     = config.toplists.column_padding,
-		.barw    = config.toplists.bar.width,
-		.offset_headers =
-			config.toplists.cpulist.show_header || config.toplists.memlist.show_header,
 	};
 
-	painter_set_font_face(painter, config.toplists.font_face);
-	painter_set_font_size(painter, config.toplists.font_size);
+	const toplists_t *cfg = &vis.config->toplists;
+
+	vis.pad = cfg->column_padding;
+	vis.barw = cfg->bar.width;
+	vis.offset_headers = cfg->cpulist.show_header || cfg->memlist.show_header;
+
+	painter_set_font_face(painter, cfg->font_face);
+	painter_set_font_size(painter, cfg->font_size);
 
 	size_t nrows = PSC_TOPLIST_MAX_ROWS;
 	if (vis.offset_headers)
 		nrows++;
 
-	real_t rh = config.toplists.row_height;
+	real_t rh = cfg->row_height;
 	real_t h = rh * (nrows - 1);
 
 	point_t pos_cpu = {
-		.x = config.toplists.cpulist.center.x,
-		.y = config.toplists.cpulist.center.y + rh/2 - h/2
+		.x = cfg->cpulist.center.x,
+		.y = cfg->cpulist.center.y + rh/2 - h/2
 	};
 
-	draw_toplist(&vis, &config.toplists.cpulist, procs->cpu_toplist, pos_cpu);
+	draw_toplist(&vis, &cfg->cpulist, procs->cpu_value,
+			procs->cpu_label, procs->cpu_toplist, pos_cpu);
 
 	point_t pos_mem = {
-		.x = config.toplists.memlist.center.x,
-		.y = config.toplists.memlist.center.y + rh/2 - h/2,
+		.x = cfg->memlist.center.x,
+		.y = cfg->memlist.center.y + rh/2 - h/2,
 	};
 
-	draw_toplist(&vis, &config.toplists.memlist, procs->mem_toplist, pos_mem);
+	draw_toplist(&vis, &cfg->memlist, procs->mem_value,
+			procs->mem_label, procs->mem_toplist, pos_mem);
 }
 
 void
-draw_toplist(visualizer_t *vis, toplist_t *cfg, pnode_t **list, point_t pos)
+draw_toplist(visualizer_t *vis, const toplist_t *cfg, real_t value, const char *label,
+		pnode_t **list, point_t pos)
 {
 	if (!cfg->show)
 		return;
 
 	if (cfg->show_header)
-		draw_toplists_header(vis, cfg, pos);
+		draw_toplists_header(vis, cfg, value, label, pos);
 
 	if (vis->offset_headers)
-		pos.y += config.toplists.row_height;
+		pos.y += vis->config->toplists.row_height;
 
 	real_t pid_width = calc_max_pid_width(vis->painter, list);
 
@@ -95,12 +115,13 @@ draw_toplist(visualizer_t *vis, toplist_t *cfg, pnode_t **list, point_t pos)
 
 		draw_toplists_row(vis, cfg, list[i], pos, pid_width);
 
-		pos.y += config.toplists.row_height;
+		pos.y += vis->config->toplists.row_height;
 	}
 }
 
 void
-draw_toplists_header(visualizer_t *vis, toplist_t *cfg, point_t pos)
+draw_toplists_header(visualizer_t *vis, const toplist_t *cfg, real_t value,
+		const char *label, point_t pos)
 {
 	assert(vis);
 	assert(cfg);
@@ -119,32 +140,26 @@ draw_toplists_header(visualizer_t *vis, toplist_t *cfg, point_t pos)
 	p.x += ndim.x + vis->pad;
 	p.y -= ndim.y/2;
 
-	draw_bar(vis, cfg->value, p);
+	draw_bar(vis, value, p);
 
 	p.x += vis->barw + vis->pad;
 	p.y += ndim.y/2;
 
-	draw_text(vis, cfg->label, p);
+	draw_text(vis, label, p);
 }
 	
 char *
-cpu_string(real_t n)
+cpu_string(char *buf, real_t n)
 {
-	static char buf[PSC_LABEL_BUFSIZE] = {0};
 	snprintf(buf, PSC_LABEL_BUFSIZE, "%.1f%%", n);
 	return buf;
 }
 
 void
-draw_toplists_row(visualizer_t *vis, toplist_t *cfg, pnode_t *node, point_t pos, real_t pid_width) 
+draw_toplists_row(visualizer_t *vis, const toplist_t *cfg, pnode_t *node, point_t pos, real_t pid_width) 
 {
-	static char value[PSC_LABEL_BUFSIZE] = {0};
-	double m = node->mem;
-	const char *u;
-	bytes_to_human(&m, &u);
-
-	snprintf(value, PSC_LABEL_BUFSIZE, cfg->value_format,
-			cpu_string(node->cpu), m, u);
+	char value[PSC_LABEL_BUFSIZE];
+	row_value(value, cfg, node);
 
 	point_t vdim = painter_text_size(vis->painter, value);
 
@@ -167,11 +182,25 @@ draw_toplists_row(visualizer_t *vis, toplist_t *cfg, pnode_t *node, point_t pos,
 	draw_text(vis, node->name, pos);
 }
 
+char *
+row_value(char *buf, const toplist_t *cfg, const pnode_t *node)
+{
+	char cpu[PSC_LABEL_BUFSIZE];
+	double m = node->mem;
+	const char *u;
+	bytes_to_human(&m, &u);
+
+	snprintf(buf, PSC_LABEL_BUFSIZE, cfg->value_format,
+			cpu_string(cpu, node->cpu), m, u);
+
+	return buf;
+}
+
 void
 draw_pdot(visualizer_t *vis, pnode_t *node, point_t pos)
 {
-	real_t mem = pnode_mem_percentage(node);
-	real_t cpu = pnode_cpu_percentage(node);
+	real_t mem = pnode_mem_percentage(vis->ctx, node);
+	real_t cpu = pnode_cpu_percentage(vis->ctx, node);
 
 	line_t line = {
 		.a = pos,
@@ -179,8 +208,8 @@ draw_pdot(visualizer_t *vis, pnode_t *node, point_t pos)
 			.x = pos.x + vis->barw,
 			.y = pos.y
 		},
-		.width = config.link.width,
-		.color = color_between(config.link.color_min, config.link.color_max, mem)
+		.width = vis->config->link.width,
+		.color = color_between(vis->config->link.color_min, vis->config->link.color_max, mem)
 	};
 
 	painter_draw_line(vis->painter, line);
@@ -190,10 +219,10 @@ draw_pdot(visualizer_t *vis, pnode_t *node, point_t pos)
 			.x = pos.x + vis->barw/2,
 			.y = pos.y
 		},
-		.radius = config.dot.radius,
-		.border = config.dot.border,
-		.background = color_between(config.dot.bg_min, config.dot.bg_max, cpu),
-		.foreground = color_between(config.dot.fg_min, config.dot.fg_max, mem)
+		.radius = vis->config->dot.radius,
+		.border = vis->config->dot.border,
+		.background = color_between(vis->config->dot.bg_min, vis->config->dot.bg_max, cpu),
+		.foreground = color_between(vis->config->dot.fg_min, vis->config->dot.fg_max, mem)
 	};
 
 	painter_draw_circle(vis->painter, dot);
@@ -202,14 +231,14 @@ draw_pdot(visualizer_t *vis, pnode_t *node, point_t pos)
 void
 draw_pid(visualizer_t *vis, pid_t pid, point_t pos)
 {
-	static char buf[PSC_LABEL_BUFSIZE] = {0};
+	char buf[PSC_LABEL_BUFSIZE];
 	snprintf(buf, PSC_LABEL_BUFSIZE, "%d", pid);
 
 	text_t t = {
 		.refpoint = pos,
 		.angle    = 0,
 		.str      = buf,
-		.foreground = config.toplists.pid_font_color
+		.foreground = vis->config->toplists.pid_font_color
 	};
 
 	painter_draw_text(vis->painter, t);
@@ -222,7 +251,7 @@ draw_text(visualizer_t *vis, const char *text, point_t pos)
 		.refpoint = pos,
 		.angle    = 0,
 		.str      = text,
-		.foreground = config.toplists.font_color
+		.foreground = vis->config->toplists.font_color
 	};
 
 	painter_draw_text(vis->painter, t);
@@ -241,11 +270,11 @@ draw_bar(visualizer_t *vis, real_t value, point_t pos)
 	line_t bg = {
 		.a = pos,
 		.b = {
-			.x = pos.x + config.toplists.bar.width,
+			.x = pos.x + vis->config->toplists.bar.width,
 			.y = pos.y
 		},
-		.width = config.toplists.bar.height,
-		.color = config.toplists.bar.background
+		.width = vis->config->toplists.bar.height,
+		.color = vis->config->toplists.bar.background
 	};
 
 	painter_draw_line(vis->painter, bg);
@@ -253,11 +282,11 @@ draw_bar(visualizer_t *vis, real_t value, point_t pos)
 	line_t fg = {
 		.a = pos,
 		.b = {
-			.x = pos.x + value * config.toplists.bar.width,
+			.x = pos.x + value * vis->config->toplists.bar.width,
 			.y = pos.y
 		},
-		.width = config.toplists.bar.height,
-		.color = config.toplists.bar.color
+		.width = vis->config->toplists.bar.height,
+		.color = vis->config->toplists.bar.color
 	};
 
 	painter_draw_line(vis->painter, fg);
@@ -280,3 +309,68 @@ calc_max_pid_width(painter_t *painter, pnode_t **list)
 	return max_width;
 }
 
+
+uint64_t
+hash_toplists(const psc_ctx_t *ctx, const procs_t *procs, uint64_t h)
+{
+	assert(ctx);
+	assert(procs);
+
+	const toplists_t *cfg = &ctx->config->toplists;
+
+	h = hash_toplist(ctx, &cfg->cpulist, procs->cpu_value,
+			procs->cpu_label, (pnode_t **) procs->cpu_toplist, h);
+
+	h = hash_toplist(ctx, &cfg->memlist, procs->mem_value,
+			procs->mem_label, (pnode_t **) procs->mem_toplist, h);
+
+	return h;
+}
+
+uint64_t
+hash_toplist(const psc_ctx_t *ctx, const toplist_t *cfg, real_t value,
+		const char *label, pnode_t **list, uint64_t h)
+{
+	if (!cfg->show)
+		return h;
+
+	const cfg_t *config = ctx->config;
+
+	if (cfg->show_header) {
+		if (value < 0)
+			value = 0;
+		if (value > 1)
+			value = 1;
+
+		// Antialiased, the end of the bar moves in 1/255 of a pixel
+		int32_t bar = R(lround)(value * config->toplists.bar.width * 255);
+
+		h = hash_bytes(h, &bar, sizeof(bar));
+		h = hash_string(h, label);
+	}
+
+	for (size_t i = 0; i < PSC_TOPLIST_MAX_ROWS; ++i) {
+		if (!list[i])
+			break;
+
+		const pnode_t *node = list[i];
+
+		char value[PSC_LABEL_BUFSIZE];
+		h = hash_string(h, row_value(value, cfg, node));
+
+		real_t mem = pnode_mem_percentage(ctx, node);
+		real_t cpu = pnode_cpu_percentage(ctx, node);
+
+		uint32_t colors[] = {
+			color_pack(color_between(config->link.color_min, config->link.color_max, mem)),
+			color_pack(color_between(config->dot.bg_min, config->dot.bg_max, cpu)),
+			color_pack(color_between(config->dot.fg_min, config->dot.fg_max, mem)),
+		};
+
+		h = hash_bytes(h, colors, sizeof(colors));
+		h = hash_bytes(h, &node->pid, sizeof(node->pid));
+		h = hash_string(h, node->name);
+	}
+
+	return h;
+}
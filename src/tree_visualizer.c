@@ -3,15 +3,18 @@
 #include <math.h>
 #include <ppoint.h>
 
-#include "cfg.h"
 #include "node.h"
 #include "tree_visualizer.h"
+#include "utils.h"
 
 #ifndef M_PI
 #define M_PI R(3.14159265358979323846)
 #endif
 
 typedef struct {
+	const psc_ctx_t *ctx;
+	// ctx->config
+	const cfg_t *config;
 	real_t rotation;
 	real_t sector;
 	real_t lable_offset;
@@ -28,27 +31,37 @@ void
 calc_offsets(visualizer_t *vis);
 
 void
-init_tree_painter(painter_t *painter);
+init_tree_painter(visualizer_t *vis, painter_t *painter);
 
 void
 dinit_tree_painter(painter_t *painter);
 
 void
-draw_tree_recurcive(visualizer_t *vis, painter_t *painter, pnode_t *procs, int depth);
+draw_tree_recurcive(visualizer_t *vis, painter_t *painter, pnode_t *procs,
+		ppoint_t position, int depth);
 
 void
-draw_dot(painter_t *painter, pnode_t *pnode);
+draw_dot(visualizer_t *vis, painter_t *painter, pnode_t *pnode, ppoint_t position);
 
 void
-draw_link(visualizer_t *vis, painter_t *painter, pnode_t *parent, pnode_t *child);
+draw_link(visualizer_t *vis, painter_t *painter, ppoint_t parent,
+		pnode_t *child, ppoint_t position);
 
 void
-draw_label(visualizer_t *vis, painter_t *painter, pnode_t *child, real_t angle);
+draw_label(visualizer_t *vis, painter_t *painter, pnode_t *child,
+		ppoint_t position, real_t angle);
+
+uint64_t
+hash_tree_recursive(const psc_ctx_t *ctx, const pnode_t *parent, int depth, uint64_t h);
 
 void
-draw_tree(painter_t *painter, procs_t *procs)
+draw_tree(const psc_ctx_t *ctx, painter_t *painter, procs_t *procs)
 {
+	assert(ctx);
+
 	visualizer_t vis = {0};
+	vis.ctx = ctx;
+	vis.config = ctx->config;
 
 	calc_sector(&vis, procs);
 
@@ -56,9 +69,11 @@ draw_tree(painter_t *painter, procs_t *procs)
 
 	calc_offsets(&vis);
 
-	init_tree_painter(painter);
+	init_tree_painter(&vis, painter);
+
+	ppoint_t center = {0};
 
-	draw_tree_recurcive(&vis, painter, procs->root, 0);
+	draw_tree_recurcive(&vis, painter, procs->root, center, 0);
 
 	dinit_tree_painter(painter);
 }
@@ -68,29 +83,29 @@ calc_sector(visualizer_t *vis, procs_t *procs)
 {
 	assert(procs);
 
-	if (config.tree.sector) {
-		vis->sector = config.tree.sector;
+	if (vis->config->tree.sector) {
+		vis->sector = vis->config->tree.sector;
 		return;
 	}
 
-	real_t cat = config.dot.radius + config.dot.border;
-	real_t hyp = config.tree.radius_inc;
+	real_t cat = vis->config->dot.radius + vis->config->dot.border;
+	real_t hyp = vis->config->tree.radius_inc;
 	vis->sector = R(2.) * M_PI - R(atan)(cat / hyp);
 }
 
 void
 calc_rotation(visualizer_t *vis, procs_t *procs)
 {
-	if (config.tree.rotate) {
-		vis->rotation = -config.tree.rotation;
+	if (vis->config->tree.rotate) {
+		vis->rotation = -vis->config->tree.rotation;
 		return;
 	}
 
-	if (config.tree.anchor_proc_name) {
-		pnode_t *found = procs_child_by_name(procs, config.tree.anchor_proc_name);
+	if (vis->config->tree.anchor_proc_name) {
+		pnode_t *found = procs_child_by_name(procs, vis->config->tree.anchor_proc_name);
 
 		if (found) {
-			vis->rotation = -vis->sector * found->node.x + config.tree.anchor_proc_angle;
+			vis->rotation = -vis->sector * found->node.x + vis->config->tree.anchor_proc_angle;
 			return;
 		}
 	}
@@ -107,18 +122,18 @@ calc_rotation(visualizer_t *vis, procs_t *procs)
 void
 calc_offsets(visualizer_t *vis)
 {
-	vis->lable_offset = R(2.) * config.dot.radius + config.dot.border / 2;
-	vis->link_offset = config.dot.radius + config.dot.border / 2;
+	vis->lable_offset = R(2.) * vis->config->dot.radius + vis->config->dot.border / 2;
+	vis->link_offset = vis->config->dot.radius + vis->config->dot.border / 2;
 }
 
 void
-init_tree_painter(painter_t *painter)
+init_tree_painter(visualizer_t *vis, painter_t *painter)
 {
 	painter_save(painter);
 
-	painter_set_font_face(painter, config.tree.font_face);
-	painter_set_font_size(painter, config.tree.font_size);
-	painter_translate(painter, config.tree.center);
+	painter_set_font_face(painter, vis->config->tree.font_face);
+	painter_set_font_size(painter, vis->config->tree.font_size);
+	painter_translate(painter, vis->config->tree.center);
 }
 
 void
@@ -127,8 +142,11 @@ dinit_tree_painter(painter_t *painter)
 	painter_restore(painter);
 }
 
+// Positions are passed down rather than stored in the processes, which
+// are drawn by several outputs at once (see pipeline_run)
 void
-draw_tree_recurcive(visualizer_t *vis, painter_t *painter, pnode_t *parent, int depth)
+draw_tree_recurcive(visualizer_t *vis, painter_t *painter, pnode_t *parent,
+		ppoint_t position, int depth)
 {
 	assert(painter);
 	assert(parent);
@@ -136,38 +154,37 @@ draw_tree_recurcive(visualizer_t *vis, painter_t *painter, pnode_t *parent, int
 	for (node_t *n = parent->node.first; n != NULL; n = n->next) {
 		pnode_t *child = (pnode_t *) n;
 
-		real_t cr = config.tree.radius_inc * (depth + 1);
+		real_t cr = vis->config->tree.radius_inc * (depth + 1);
 		real_t ca = vis->sector * n->x + vis->rotation;
 		ppoint_t c = ppoint_from_radial(ca, cr);
-		child->position = c;
 
-		draw_tree_recurcive(vis, painter, child, depth + 1);
+		draw_tree_recurcive(vis, painter, child, c, depth + 1);
 
-		draw_dot(painter, child);
+		draw_dot(vis, painter, child, c);
 
 		if (depth > 0)
-			draw_link(vis, painter, parent, child);
+			draw_link(vis, painter, position, child, c);
 
-		draw_label(vis, painter, child, ca);
+		draw_label(vis, painter, child, c, ca);
 	}
 }
 
 void
-draw_dot(painter_t *painter, pnode_t *pnode)
+draw_dot(visualizer_t *vis, painter_t *painter, pnode_t *pnode, ppoint_t position)
 {
-	real_t mem = pnode_mem_percentage(pnode);
-	real_t cpu = pnode_cpu_percentage(pnode);
+	real_t mem = pnode_mem_percentage(vis->ctx, pnode);
+	real_t cpu = pnode_cpu_percentage(vis->ctx, pnode);
 
-	point_t center = ppoint_to_point(pnode->position);
+	point_t center = ppoint_to_point(position);
 
-	color_t bg = color_between(config.dot.bg_min, config.dot.bg_max, cpu);
+	color_t bg = color_between(vis->config->dot.bg_min, vis->config->dot.bg_max, cpu);
 
-	color_t fg = color_between(config.dot.fg_min, config.dot.fg_max, mem);
+	color_t fg = color_between(vis->config->dot.fg_min, vis->config->dot.fg_max, mem);
 
 	circle_t c = {
 		.center = center,
-		.radius = config.dot.radius,
-		.border = config.dot.border,
+		.radius = vis->config->dot.radius,
+		.border = vis->config->dot.border,
 		.background = bg,
 		.foreground = fg
 	};
@@ -176,22 +193,23 @@ draw_dot(painter_t *painter, pnode_t *pnode)
 }
 
 void
-draw_link(visualizer_t *vis, painter_t *painter, pnode_t *parent, pnode_t *child)
+draw_link(visualizer_t *vis, painter_t *painter, ppoint_t parent,
+		pnode_t *child, ppoint_t position)
 {
-	ppoint_t a = parent->position;
+	ppoint_t a = parent;
 	a.r += vis->link_offset;
 
-	ppoint_t b = child->position;
+	ppoint_t b = position;
 	b.r -= vis->link_offset;
 
-	real_t mem = pnode_mem_percentage(child);
-	color_t col = color_between(config.link.color_min, config.link.color_max, mem);
+	real_t mem = pnode_mem_percentage(vis->ctx, child);
+	color_t col = color_between(vis->config->link.color_min, vis->config->link.color_max, mem);
 
 	if (ppoint_codirectinal(a, b)) {
 		line_t line = {
 			.a = ppoint_to_point(a),
 			.b = ppoint_to_point(b),
-			.width = config.link.width,
+			.width = vis->config->link.width,
 			.color = col
 		};
 
@@ -199,10 +217,10 @@ draw_link(visualizer_t *vis, painter_t *painter, pnode_t *parent, pnode_t *child
 		return;
 	}
 
-	real_t conv = config.link.convexity * config.tree.radius_inc;
-	ppoint_t ac = parent->position;
+	real_t conv = vis->config->link.convexity * vis->config->tree.radius_inc;
+	ppoint_t ac = parent;
 	ac.r += conv;
-	ppoint_t bc = child->position;
+	ppoint_t bc = position;
 	bc.r -= conv;
 
 	curve_t curve = {
@@ -210,7 +228,7 @@ draw_link(visualizer_t *vis, painter_t *painter, pnode_t *parent, pnode_t *child
 		.b = ppoint_to_point(b),
 		.ac = ppoint_to_point(ac),
 		.bc = ppoint_to_point(bc),
-		.width = config.link.width,
+		.width = vis->config->link.width,
 		.color = col
 	};
 
@@ -218,11 +236,12 @@ draw_link(visualizer_t *vis, painter_t *painter, pnode_t *parent, pnode_t *child
 }
 
 void
-draw_label(visualizer_t *vis, painter_t *painter, pnode_t *child, real_t angle)
+draw_label(visualizer_t *vis, painter_t *painter, pnode_t *child,
+		ppoint_t position, real_t angle)
 {
 	point_t dim = painter_text_size(painter, child->name);
 
-	ppoint_t p = child->position;
+	ppoint_t p = position;
 
 	if (p.nx < 0) {
 		angle += M_PI;
@@ -240,10 +259,51 @@ draw_label(visualizer_t *vis, painter_t *painter, pnode_t *child, real_t angle)
 	text_t text = {
 		.refpoint = ppoint_to_point(p),
 		.angle = angle,
-		.foreground = config.tree.font_color,
+		.foreground = vis->config->tree.font_color,
 		.str = child->name
 	};
 
 	painter_draw_text(painter, text);
 }
 
+
+uint64_t
+hash_tree(const psc_ctx_t *ctx, const procs_t *procs, uint64_t h)
+{
+	assert(ctx);
+	assert(procs);
+	assert(procs->root);
+
+	return hash_tree_recursive(ctx, procs->root, 0, h);
+}
+
+// Nodes are hashed in the order they are drawn with their depth, which
+// tells the shape of the tree apart. The rotation and the labels follow
+// from the positions and the names.
+uint64_t
+hash_tree_recursive(const psc_ctx_t *ctx, const pnode_t *parent, int depth, uint64_t h)
+{
+	const cfg_t *cfg = ctx->config;
+
+	for (node_t *n = parent->node.first; n != NULL; n = n->next) {
+		pnode_t *child = (pnode_t *) n;
+
+		real_t mem = pnode_mem_percentage(ctx, child);
+		real_t cpu = pnode_cpu_percentage(ctx, child);
+
+		uint32_t colors[] = {
+			color_pack(color_between(cfg->dot.bg_min, cfg->dot.bg_max, cpu)),
+			color_pack(color_between(cfg->dot.fg_min, cfg->dot.fg_max, mem)),
+			color_pack(color_between(cfg->link.color_min, cfg->link.color_max, mem)),
+		};
+
+		h = hash_bytes(h, &depth, sizeof(depth));
+		h = hash_bytes(h, &n->x, sizeof(n->x));
+		h = hash_bytes(h, colors, sizeof(colors));
+		h = hash_string(h, child->name);
+
+		h = hash_tree_recursive(ctx, child, depth + 1, h);
+	}
+
+	return h;
+}
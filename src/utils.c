@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <string.h>
 #include <assert.h>
 
 #include "utils.h"
@@ -23,3 +24,26 @@ bytes_to_human(double *n, const char **u)
 		*n /= 1024;
 	}
 }
+
+uint64_t
+hash_bytes(uint64_t h, const void *data, size_t size)
+{
+	assert(data || size == 0);
+
+	const uint8_t *p = data;
+
+	for (size_t i = 0; i < size; ++i) {
+		h ^= p[i];
+		h *= 1099511628211ULL;
+	}
+
+	return h;
+}
+
+uint64_t
+hash_string(uint64_t h, const char *str)
+{
+	assert(str);
+
+	return hash_bytes(h, str, strlen(str) + 1);
+}
@@ -7,6 +7,7 @@ extern "C" {
 #include "point.h"
 #include "color.h"
 #include "argparser.h"
+#include "cfg.h"
 }
 
 #define EPS 1e-5
@@ -219,6 +220,53 @@ TEST(parse_long, valid) {
 	EXPECT_EQ(val, 10l);
 }
 
+TEST(parse_png_compression, valid) {
+	long val;
+	EXPECT_TRUE(parser_png_compression("0", &val));
+	EXPECT_EQ(val, 0l);
+	EXPECT_TRUE(parser_png_compression("9", &val));
+	EXPECT_EQ(val, 9l);
+}
+
+TEST(parse_png_compression, out_of_range) {
+	long val = 5;
+	EXPECT_FALSE(parser_png_compression("-1", &val));
+	EXPECT_FALSE(parser_png_compression("10", &val));
+	EXPECT_FALSE(parser_png_compression("1a", &val));
+	EXPECT_EQ(val, 5l);
+}
+
+TEST(parse_threads, valid) {
+	long val;
+	EXPECT_TRUE(parser_threads("0", &val));
+	EXPECT_EQ(val, 0l);
+	EXPECT_TRUE(parser_threads("8", &val));
+	EXPECT_EQ(val, 8l);
+}
+
+TEST(parse_threads, negative) {
+	long val = 2;
+	EXPECT_FALSE(parser_threads("-1", &val));
+	EXPECT_EQ(val, 2l);
+}
+
+TEST(parse_threads, jobs_and_png_threads) {
+	argparser_t *argp = new argparser_t();
+	argparser_init(argp);
+
+	cfg_t cfg = config;
+	cfg_args(argp, &cfg);
+
+	EXPECT_FALSE(argparser_set(argp, "--jobs=-1"));
+	EXPECT_FALSE(argparser_set(argp, "--png-threads=-1"));
+	EXPECT_EQ(cfg.jobs, config.jobs);
+
+	EXPECT_TRUE(argparser_set(argp, "--jobs=0"));
+	EXPECT_EQ(cfg.jobs, 0l);
+
+	delete argp;
+}
+
 TEST(parse_string, valid) {
 	char *val = NULL;
 	EXPECT_TRUE(parser_string("10", &val));
@@ -0,0 +1,128 @@
+#include <string>
+#include <cstring>
+
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "batch.h"
+#include "cfg.h"
+}
+
+using namespace std;
+using namespace ::testing;
+
+class batch_test: public Test
+{
+public:
+	batch_test() {};
+	virtual ~batch_test() {};
+
+	string dir;
+	string input;
+	string output;
+	cfg_t saved;
+
+	virtual void SetUp() {
+		dir = "/tmp/pscircle-batch-test-" + to_string(getpid());
+		input = dir + "/in";
+		output = dir + "/out";
+
+		ASSERT_EQ(mkdir(dir.c_str(), 0755), 0);
+		ASSERT_EQ(mkdir(input.c_str(), 0755), 0);
+
+		saved = config;
+		config.batch_input = input.c_str();
+		config.batch_output = output.c_str();
+		config.output_format = ENCODER_PPM;
+		config.output_width = 32;
+		config.output_height = 16;
+		config.root_pid = 0;
+		config.jobs = 3;
+	}
+
+	virtual void TearDown() {
+		config = saved;
+
+		string cmd = "rm -rf " + dir;
+		ASSERT_EQ(system(cmd.c_str()), 0);
+	}
+
+	void write(const string &name, const string &content) {
+		FILE *fp = fopen((input + "/" + name).c_str(), "w");
+		ASSERT_NE(fp, nullptr);
+		fputs(content.c_str(), fp);
+		fclose(fp);
+	}
+
+	bool exists(const string &name) {
+		struct stat st;
+		return stat((output + "/" + name).c_str(), &st) == 0;
+	}
+};
+
+TEST_F(batch_test, image_per_file) {
+	for (int i = 0; i < 5; ++i)
+		write("web0" + to_string(i) + ".example.com",
+				"1 0 0.0 4212 systemd\n2 1 5.0 8424 nginx\n");
+
+	EXPECT_TRUE(batch_run());
+
+	for (int i = 0; i < 5; ++i)
+		EXPECT_TRUE(exists("web0" + to_string(i) + ".example.com.ppm")) << i;
+}
+
+TEST_F(batch_test, skips_hidden_files_and_directories) {
+	write("db01", "1 0 0.0 4212 systemd\n");
+	write(".db02.tmp", "1 0 0.0 4212 systemd\n");
+	ASSERT_EQ(mkdir((input + "/old").c_str(), 0755), 0);
+
+	EXPECT_TRUE(batch_run());
+
+	EXPECT_TRUE(exists("db01.ppm"));
+	EXPECT_FALSE(exists(".db02.tmp.ppm"));
+	EXPECT_FALSE(exists("old.ppm"));
+}
+
+TEST_F(batch_test, empty_files_fail) {
+	write("db01", "1 0 0.0 4212 systemd\n");
+	write("db02", "");
+
+	EXPECT_FALSE(batch_run());
+
+	EXPECT_TRUE(exists("db01.ppm"));
+	EXPECT_FALSE(exists("db02.ppm"));
+}
+
+TEST_F(batch_test, metrics_written_by_workers) {
+	for (int i = 0; i < 24; ++i)
+		write("web" + to_string(i), "1 0 0.0 4212 systemd\n2 1 5.0 8424 nginx\n");
+
+	string metrics = dir + "/pscircle.prom";
+	config.metrics_file = metrics.c_str();
+
+	internal::CaptureStderr();
+	EXPECT_TRUE(batch_run());
+	string errors = internal::GetCapturedStderr();
+
+	// The workers do not replace each other's temporary file
+	EXPECT_EQ(errors, "");
+
+	struct stat st;
+	EXPECT_EQ(stat(metrics.c_str(), &st), 0);
+	EXPECT_NE(stat((metrics + ".tmp").c_str(), &st), 0);
+}
+
+TEST(batch_output_path, extension_of_format) {
+	char buf[32];
+
+	EXPECT_TRUE(batch_output_path(buf, sizeof(buf), "out", "web01", ENCODER_AUTO));
+	EXPECT_STREQ(buf, "out/web01.png");
+
+	EXPECT_TRUE(batch_output_path(buf, sizeof(buf), "out", "web01.txt", ENCODER_QOI));
+	EXPECT_STREQ(buf, "out/web01.txt.qoi");
+
+	EXPECT_FALSE(batch_output_path(buf, 8, "out", "web01", ENCODER_PNG));
+}
@@ -50,6 +50,46 @@ TEST(parse_cmdline, read_stdin) {
 	parse<bool>("--stdin=true", config.read_stdin, true);
 }
 
+TEST(parse_cmdline, loop) {
+	parse<bool>("--loop=true", config.loop, true);
+}
+
+TEST(parse_cmdline, profile) {
+	parse<bool>("--profile=true", config.profile, true);
+}
+
+TEST(parse_cmdline, trace) {
+	parse("--trace=/tmp/trace.json", config.trace, "/tmp/trace.json");
+}
+
+TEST(parse_cmdline, metrics_file) {
+	parse("--metrics-file=/tmp/pscircle.prom", config.metrics_file, "/tmp/pscircle.prom");
+}
+
+TEST(parse_cmdline, procfs_root) {
+	parse("--procfs-root=/tmp/proc", config.procfs_root, "/tmp/proc");
+}
+
+TEST(parse_cmdline, record) {
+	parse("--record=/tmp/a.pscs", config.record, "/tmp/a.pscs");
+}
+
+TEST(parse_cmdline, replay) {
+	parse("--replay=/tmp/a.pscs", config.replay, "/tmp/a.pscs");
+}
+
+TEST(parse_cmdline, at) {
+	parse("--at=03:12", config.at, "03:12");
+}
+
+TEST(parse_cmdline, frames) {
+	parse("--frames=10-20", config.frames, "10-20");
+}
+
+TEST(parse_cmdline, jobs) {
+	parse<long>("--jobs=3", config.jobs, 3);
+}
+
 TEST(parse_cmdline, interval) {
 	parse<real_t>("--interval=31", config.interval, 31);
 }
@@ -64,6 +104,23 @@ TEST(parse_cmdline, output_display) {
 }
 #endif
 
+TEST(parse_cmdline, output_format) {
+	parse<encoder_format_t>("--output-format=qoi", config.output_format, ENCODER_QOI);
+}
+
+TEST(parse_cmdline, png_compression) {
+	parse<long>("--png-compression=1", config.png_compression, 1);
+}
+
+TEST(parse_cmdline, png_filter) {
+	parse<encoder_filter_t>("--png-filter=none,up", config.png_filter,
+			(encoder_filter_t) (ENCODER_FILTER_NONE | ENCODER_FILTER_UP));
+}
+
+TEST(parse_cmdline, png_threads) {
+	parse<long>("--png-threads=3", config.png_threads, 3);
+}
+
 TEST(parse_cmdline, output_width) {
 	parse<size_t>("--output-width=123", config.output_width, 123);
 }
@@ -0,0 +1,255 @@
+#include <string>
+#include <thread>
+#include <cstring>
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "control.h"
+#include "snapshot.h"
+}
+
+using namespace std;
+using namespace ::testing;
+
+class control_test: public Test
+{
+public:
+	control_test() {};
+	virtual ~control_test() {};
+
+	string path;
+	cfg_t cfg;
+	psc_ctx_t ctx;
+	control_t control;
+	char reply[256];
+
+	virtual void SetUp() {
+		path = "/tmp/pscircle-control-test-" + to_string(getpid());
+
+		cfg = config;
+		psc_ctx_init(&ctx, &cfg);
+
+		ASSERT_TRUE(control_init(&control, path.c_str(), &ctx));
+	}
+
+	virtual void TearDown() {
+		control_dinit(&control);
+		psc_ctx_dinit(&ctx);
+		remove((path + ".snapshot").c_str());
+	}
+
+	string execute(const char *command) {
+		char buf[256];
+		snprintf(buf, sizeof(buf), "%s", command);
+		control_execute(&control, buf, reply, sizeof(reply));
+		return reply;
+	}
+};
+
+TEST_F(control_test, option__output__applied_to_outputs) {
+	EXPECT_EQ(execute("--tree-font-size=20"), "ok");
+	EXPECT_EQ(execute("--interval=5"), "ok");
+
+	cfg_t a = config, b = config;
+	cfg_t *outputs[] = {&a, &b};
+
+	control_apply(&control, outputs, 2, false);
+
+	EXPECT_EQ(a.tree.font_size, 20);
+	EXPECT_EQ(b.tree.font_size, 20);
+	EXPECT_EQ(a.interval, config.interval);
+
+	// Applied once
+	a.tree.font_size = 10;
+	control_apply(&control, outputs, 2, false);
+	EXPECT_EQ(a.tree.font_size, 10);
+}
+
+TEST_F(control_test, option__shared__applied_to_input) {
+	EXPECT_EQ(execute("--interval=5"), "ok");
+	EXPECT_EQ(execute("--max-children=7"), "ok");
+	EXPECT_EQ(execute("--tree-font-size=20"), "ok");
+
+	cfg_t shared = config;
+	cfg_t *cfgs[] = {&shared};
+
+	control_apply(&control, cfgs, 1, true);
+
+	EXPECT_EQ(shared.interval, 5);
+	EXPECT_EQ(shared.max_children, 7u);
+	EXPECT_EQ(shared.tree.font_size, config.tree.font_size);
+}
+
+TEST_F(control_test, option__invalid__rejected) {
+	EXPECT_EQ(execute("--tree-font-size=big").rfind("error:", 0), 0u);
+	EXPECT_EQ(execute("--no-such-option=1").rfind("error:", 0), 0u);
+	EXPECT_EQ(execute("--interval").rfind("error:", 0), 0u);
+	EXPECT_EQ(execute("--interval=0").rfind("error:", 0), 0u);
+
+	cfg_t c = config;
+	cfg_t *cfgs[] = {&c};
+	control_apply(&control, cfgs, 1, true);
+	control_apply(&control, cfgs, 1, false);
+
+	EXPECT_EQ(memcmp(&c, &config, sizeof(cfg_t)), 0);
+}
+
+TEST_F(control_test, option__ranges_crossed__rejected) {
+	EXPECT_EQ(execute("--cpu-max-value=-1"),
+			"error: --cpu-min-value is above --cpu-max-value");
+	EXPECT_EQ(execute("--memory-min-value=900M"),
+			"error: --memory-min-value is above --memory-max-value");
+
+	// Checked with the options set before
+	EXPECT_EQ(execute("--cpu-min-value=20"), "error: --cpu-min-value is above --cpu-max-value");
+	EXPECT_EQ(execute("--cpu-max-value=30"), "ok");
+	EXPECT_EQ(execute("--cpu-min-value=20"), "ok");
+	EXPECT_EQ(execute("--cpu-max-value=10"), "error: --cpu-min-value is above --cpu-max-value");
+
+	cfg_t c = config;
+	cfg_t *cfgs[] = {&c};
+	control_apply(&control, cfgs, 1, false);
+
+	EXPECT_EQ(c.min_cpu, 20);
+	EXPECT_EQ(c.max_cpu, 30);
+	EXPECT_EQ(c.max_mem, config.max_mem);
+}
+
+TEST_F(control_test, apply__ranges_crossed__output_kept) {
+	EXPECT_EQ(execute("--cpu-min-value=10"), "ok");
+	EXPECT_EQ(execute("--tree-font-size=20"), "ok");
+
+	// An output with its own maximum
+	cfg_t a = config, b = config;
+	b.max_cpu = 5;
+	cfg_t *outputs[] = {&a, &b};
+
+	control_apply(&control, outputs, 2, false);
+
+	EXPECT_EQ(a.min_cpu, 10);
+	EXPECT_EQ(a.tree.font_size, 20);
+	EXPECT_EQ(b.min_cpu, config.min_cpu);
+	EXPECT_EQ(b.tree.font_size, config.tree.font_size);
+}
+
+TEST_F(control_test, option__set_on_start__rejected) {
+	EXPECT_EQ(execute("--output-width=100"),
+			"error: --output-width can not be changed while pscircle is running");
+	EXPECT_EQ(execute("--replay=a.psc").rfind("error:", 0), 0u);
+	EXPECT_EQ(execute("--control=b").rfind("error:", 0), 0u);
+}
+
+TEST_F(control_test, command__unknown__rejected) {
+	EXPECT_EQ(execute("render"), "error: unknown command: render");
+	EXPECT_EQ(execute("dump-snapshot ").rfind("error:", 0), 0u);
+}
+
+TEST_F(control_test, render_now__wakes_collection) {
+	EXPECT_FALSE(psc_ctx_sleep(&ctx, 0.01));
+
+	EXPECT_EQ(execute("render-now"), "ok");
+
+	EXPECT_TRUE(psc_ctx_sleep(&ctx, 60));
+	EXPECT_FALSE(psc_ctx_sleep(&ctx, 0.01));
+}
+
+TEST_F(control_test, stats__frames_counted) {
+	procs_t procs = {0};
+	procs.nprocesses = 11;
+
+	control_rendered(&control, &procs, 0.004, false);
+	control_rendered(&control, &procs, 0.002, false);
+	control_rendered(&control, &procs, 0.001, true);
+
+	EXPECT_EQ(execute("--tree-font-size=20"), "ok");
+
+	string s = execute("stats");
+	EXPECT_EQ(s.rfind("ok frames=3 skipped=1 processes=10 render_ms=2.00 options=1 uptime_s=", 0), 0u) << s;
+}
+
+TEST_F(control_test, dump_snapshot__written_on_next_frame) {
+	procs_t procs = {0};
+	procs_alloc(&procs, 4);
+	pnode_t *p = procs_add(&procs);
+	p->pid = 1;
+	strcpy(p->name, "init");
+
+	string file = path + ".snapshot";
+	string command = "dump-snapshot " + file;
+
+	string result;
+	thread client([&] { result = execute(command.c_str()); });
+
+	// Woken to collect a frame at once
+	ASSERT_TRUE(psc_ctx_sleep(&ctx, 60));
+
+	control_collected(&control, &procs);
+
+	client.join();
+
+	EXPECT_EQ(result, "ok");
+
+	snapshot_t snapshot;
+	ASSERT_TRUE(snapshot_map(&snapshot, file.c_str()));
+	// Without the reserved root
+	EXPECT_EQ(snapshot.header->nprocesses, 1u);
+	snapshot_unmap(&snapshot);
+
+	procs_dinit(&procs);
+}
+
+TEST_F(control_test, socket__commands_replied_per_line) {
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	ASSERT_GE(fd, 0);
+
+	struct sockaddr_un addr = {};
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path.c_str());
+
+	ASSERT_EQ(connect(fd, (struct sockaddr *) &addr, sizeof(addr)), 0);
+
+	// The last command has no newline
+	const char *commands = "--tree-font-size=20\n\nstats\r\n--output=x.png";
+	ASSERT_EQ(write(fd, commands, strlen(commands)), (ssize_t) strlen(commands));
+	shutdown(fd, SHUT_WR);
+
+	string replies;
+	char buf[256];
+	ssize_t n;
+	while ((n = read(fd, buf, sizeof(buf))) > 0)
+		replies.append(buf, n);
+
+	close(fd);
+
+	size_t first = replies.find('\n');
+	size_t second = replies.find('\n', first + 1);
+
+	ASSERT_NE(second, string::npos) << replies;
+	EXPECT_EQ(replies.substr(0, first), "ok");
+	EXPECT_EQ(replies.substr(first + 1, 15), "ok frames=0 ski");
+	EXPECT_EQ(replies.substr(second + 1, 6), "error:");
+	EXPECT_EQ(replies.back(), '\n');
+}
+
+TEST(control, init__not_a_socket__kept) {
+	string path = "/tmp/pscircle-control-file-" + to_string(getpid());
+
+	FILE *f = fopen(path.c_str(), "w");
+	ASSERT_NE(f, nullptr);
+	fclose(f);
+
+	psc_ctx_t ctx;
+	psc_ctx_init(&ctx, &config);
+
+	control_t control;
+	EXPECT_FALSE(control_init(&control, path.c_str(), &ctx));
+	EXPECT_EQ(access(path.c_str(), F_OK), 0);
+
+	psc_ctx_dinit(&ctx);
+	remove(path.c_str());
+}
@@ -0,0 +1,275 @@
+#include <string>
+#include <vector>
+#include <map>
+#include <cstring>
+
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "delta.h"
+#include "cfg.h"
+}
+
+using namespace std;
+using namespace ::testing;
+
+struct proc {
+	int ppid;
+	float cpu;
+	uint64_t mem;
+	string name;
+};
+
+class delta_test: public Test
+{
+public:
+	delta_test() {};
+	virtual ~delta_test() {};
+
+	FILE *fp;
+	delta_writer_t writer;
+	vector<map<int, proc>> frames;
+	string data;
+
+	virtual void SetUp() {
+		fp = tmpfile();
+		delta_writer_init(&writer, fp, 4);
+	}
+
+	virtual void TearDown() {
+		delta_writer_dinit(&writer);
+		fclose(fp);
+	}
+
+	void add(const map<int, proc> &frame, const char *label = "label") {
+		procs_t procs = {};
+		procs_alloc(&procs, frame.size() + 1);
+
+		// Not sorted, as read from /proc
+		for (auto it = frame.rbegin(); it != frame.rend(); ++it) {
+			pnode_t *p = procs_add(&procs);
+			p->pid = it->first;
+			p->ppid = it->second.ppid;
+			p->cpu = it->second.cpu;
+			p->mem = it->second.mem;
+			strncpy(p->name, it->second.name.c_str(), PSC_MAX_NAME_LENGHT - 1);
+		}
+
+		strcpy(procs.cpu_label, label);
+		procs.cpu_value = frame.size();
+
+		ASSERT_TRUE(delta_writer_add(&writer, &procs));
+		procs_dinit(&procs);
+
+		frames.push_back(frame);
+	}
+
+	void read() {
+		data.resize(ftell(fp));
+		rewind(fp);
+		ASSERT_EQ(fread(&data[0], 1, data.size(), fp), data.size());
+	}
+
+	void expect_frame(const delta_reader_t *reader, const map<int, proc> &frame) {
+		const delta_state_t *s = &reader->state;
+		ASSERT_EQ(s->nprocs, frame.size());
+		EXPECT_EQ(s->cpu_value, frame.size());
+
+		size_t i = 0;
+		for (auto &kv : frame) {
+			const delta_proc_t *d = s->procs + i++;
+			EXPECT_EQ(d->pid, kv.first);
+			EXPECT_EQ(d->ppid, kv.second.ppid);
+			EXPECT_EQ(d->cpu, kv.second.cpu);
+			EXPECT_EQ(d->mem, kv.second.mem);
+			EXPECT_EQ(string(d->name), kv.second.name);
+		}
+	}
+};
+
+TEST_F(delta_test, roundtrip) {
+	map<int, proc> f;
+	for (int pid = 1; pid <= 100; ++pid)
+		f[pid] = {pid / 2, 0, (uint64_t) pid << 20, "p" + to_string(pid)};
+
+	srand(1);
+	for (int i = 0; i < 10; ++i) {
+		add(f, i < 5 ? "a" : "b");
+
+		// exits, spawns, reparenting, cpu and memory changes, exec
+		f.erase(f.begin()->first + rand() % 50);
+		f[1000 + i] = {1, 1.5f * i, 4096, "new"};
+		f[200 + i] = {-5, 0.1f, 1, ""};
+		f[50].ppid = 1;
+		f[10].cpu = i / 3.f;
+		f[20].mem -= 12345;
+		f[30].name = "exec" + to_string(i);
+	}
+
+	read();
+
+	delta_reader_t reader;
+	delta_reader_init(&reader, data.data(), data.size());
+
+	for (size_t i = 0; i < frames.size(); ++i) {
+		ASSERT_TRUE(delta_reader_next(&reader)) << i;
+		expect_frame(&reader, frames[i]);
+		EXPECT_STREQ(reader.state.cpu_label, i < 5 ? "a" : "b");
+	}
+
+	EXPECT_FALSE(delta_reader_next(&reader));
+	EXPECT_EQ(errno, 0);
+	delta_reader_close(&reader);
+}
+
+TEST_F(delta_test, deltas_are_smaller_than_keyframes) {
+	map<int, proc> f;
+	for (int pid = 1; pid <= 1000; ++pid)
+		f[pid] = {1, 0, 1 << 20, "process"};
+
+	add(f);
+	long keyframe = ftell(fp);
+
+	f[5].cpu = 3;
+	add(f);
+	long delta = ftell(fp) - keyframe;
+
+	EXPECT_GT(keyframe, 1000 * (long) sizeof(snapshot_proc_t));
+	EXPECT_LE(delta, (long) (sizeof(delta_header_t) + sizeof(delta_trailer_t)) + 16);
+}
+
+TEST_F(delta_test, duplicate_pids__first_one_is_kept) {
+	procs_t procs = {};
+	procs_alloc(&procs, 4);
+
+	for (int i = 0; i < 3; ++i) {
+		pnode_t *p = procs_add(&procs);
+		p->pid = i == 2 ? 1 : i + 1;
+		p->ppid = i;
+	}
+
+	ASSERT_TRUE(delta_writer_add(&writer, &procs));
+	procs_dinit(&procs);
+
+	read();
+
+	delta_reader_t reader;
+	delta_reader_init(&reader, data.data(), data.size());
+	ASSERT_TRUE(delta_reader_next(&reader));
+	ASSERT_EQ(reader.state.nprocs, 2u);
+	EXPECT_EQ(reader.state.procs[0].ppid, 0);
+	delta_reader_close(&reader);
+}
+
+TEST_F(delta_test, corrupted) {
+	map<int, proc> f = {{1, {0, 0, 1, "init"}}};
+	add(f);
+	f[2] = {1, 0, 1, "bash"};
+	add(f);
+
+	read();
+
+	// Truncated delta
+	delta_reader_t reader;
+	delta_reader_init(&reader, data.data(), data.size() - sizeof(delta_trailer_t) - 8);
+	ASSERT_TRUE(delta_reader_next(&reader));
+	EXPECT_FALSE(delta_reader_next(&reader));
+	EXPECT_EQ(errno, EINVAL);
+	delta_reader_close(&reader);
+
+	// Delta without a keyframe
+	size_t keyframe = ((const snapshot_header_t *) data.data())->size;
+	delta_reader_init(&reader, data.data() + keyframe, data.size() - keyframe);
+	EXPECT_FALSE(delta_reader_next(&reader));
+	EXPECT_EQ(errno, EINVAL);
+	delta_reader_close(&reader);
+
+	// Garbage in the payload must not crash the reader
+	for (size_t i = keyframe + sizeof(delta_trailer_t) + sizeof(delta_header_t);
+			i < data.size() - sizeof(delta_trailer_t); ++i) {
+		string bad = data;
+		bad[i] = 0xff;
+		delta_reader_init(&reader, bad.data(), bad.size());
+		ASSERT_TRUE(delta_reader_next(&reader));
+		delta_reader_next(&reader);
+		delta_reader_close(&reader);
+	}
+}
+
+TEST_F(delta_test, seek) {
+	map<int, proc> f = {{1, {0, 0, 1, "init"}}};
+	for (int i = 0; i < 10; ++i) {
+		f[1].cpu = i;
+		add(f);
+	}
+
+	// Not finished, as if the capture was killed
+	read();
+	string killed = data;
+
+	fseek(fp, 0, SEEK_END);
+	ASSERT_TRUE(delta_writer_finish(&writer));
+	read();
+
+	for (const string &d : {data, killed, killed.substr(0, killed.size() - sizeof(delta_trailer_t) - 4)}) {
+		delta_reader_t reader;
+		delta_reader_init(&reader, d.data(), d.size());
+
+		ASSERT_TRUE(delta_reader_index(&reader));
+		ASSERT_EQ(reader.index.nentries, d.size() < killed.size() ? 9u : 10u);
+
+		const delta_index_entry_t *e = reader.index.entries;
+		for (size_t i = 0; i < reader.index.nentries; ++i) {
+			EXPECT_EQ(e[i].flags, i % 4 == 0 ? DELTA_KEYFRAME : 0u) << i;
+
+			// The last frame captured at that time
+			size_t expected = i;
+			while (expected + 1 < reader.index.nentries && e[expected + 1].time == e[i].time)
+				expected++;
+
+			ASSERT_TRUE(delta_reader_seek(&reader, e[i].time + 1)) << i;
+			ASSERT_TRUE(delta_reader_next(&reader)) << i;
+			EXPECT_EQ(reader.state.procs[0].cpu, expected) << i;
+			EXPECT_EQ(reader.state.time, e[expected].time) << i;
+		}
+
+		EXPECT_FALSE(delta_reader_seek(&reader, e[0].time - 1));
+		EXPECT_EQ(errno, ERANGE);
+
+		delta_reader_close(&reader);
+	}
+}
+
+TEST(delta_parse_time, formats) {
+	int64_t t;
+
+	EXPECT_TRUE(delta_parse_time("1700000000.5", 0, &t));
+	EXPECT_EQ(t, 1700000000500000000);
+
+	struct tm tm = {};
+	tm.tm_year = 2024 - 1900;
+	tm.tm_mon = 2;
+	tm.tm_mday = 1;
+	tm.tm_hour = 3;
+	tm.tm_min = 12;
+	tm.tm_isdst = -1;
+	int64_t expected = (int64_t) mktime(&tm) * 1000000000;
+
+	EXPECT_TRUE(delta_parse_time("2024-03-01 03:12", 0, &t));
+	EXPECT_EQ(t, expected);
+	EXPECT_TRUE(delta_parse_time("2024-03-01T03:12:30", 0, &t));
+	EXPECT_EQ(t, expected + 30000000000);
+
+	// The first 03:12 after the start of the recording
+	EXPECT_TRUE(delta_parse_time("03:12", expected - 3600000000000, &t));
+	EXPECT_EQ(t, expected);
+	EXPECT_TRUE(delta_parse_time("03:12", expected + 1000000000, &t));
+	EXPECT_GT(t, expected + 23 * 3600000000000);
+	EXPECT_LT(t, expected + 25 * 3600000000000);
+
+	EXPECT_FALSE(delta_parse_time("", 0, &t));
+	EXPECT_FALSE(delta_parse_time("25:00", 0, &t));
+	EXPECT_FALSE(delta_parse_time("03:12 pm", 0, &t));
+	EXPECT_FALSE(delta_parse_time("2024-13-01 03:12", 0, &t));
+	EXPECT_FALSE(delta_parse_time("yesterday", 0, &t));
+}
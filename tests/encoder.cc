@@ -0,0 +1,226 @@
+#include <vector>
+#include <string>
+#include <cstring>
+
+#include <png.h>
+
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "encoder.h"
+}
+
+using namespace std;
+using namespace ::testing;
+
+class encoder_test: public Test
+{
+public:
+	encoder_test() {};
+	virtual ~encoder_test() {};
+
+	vector<uint32_t> pixels;
+	image_t img;
+	encoder_opts_t opts;
+
+	virtual void SetUp() {
+		create(4, 3, 0xff102030);
+
+		opts.format = ENCODER_PNG;
+		opts.png_compression = 6;
+		opts.png_filter = ENCODER_FILTER_ALL;
+		opts.png_threads = 1;
+	}
+
+	void create(size_t w, size_t h, uint32_t fill) {
+		pixels.assign(w * h, fill);
+		img.data = (const uint8_t *) pixels.data();
+		img.width = w;
+		img.height = h;
+		img.stride = w * 4;
+	}
+
+	string encode(encoder_format_t format) {
+		opts.format = format;
+
+		FILE *fp = tmpfile();
+		EXPECT_TRUE(encoder_write(fp, &img, &opts));
+
+		string s;
+		s.resize(ftell(fp));
+		rewind(fp);
+		EXPECT_EQ(fread(&s[0], 1, s.size(), fp), s.size());
+		fclose(fp);
+
+		return s;
+	}
+
+	vector<uint8_t> decode_png(const string &s) {
+		png_image pimg;
+		memset(&pimg, 0, sizeof(pimg));
+		pimg.version = PNG_IMAGE_VERSION;
+
+		EXPECT_TRUE(png_image_begin_read_from_memory(&pimg, s.data(), s.size()));
+		EXPECT_EQ(pimg.width, img.width);
+		EXPECT_EQ(pimg.height, img.height);
+
+		pimg.format = PNG_FORMAT_RGBA;
+		vector<uint8_t> out(PNG_IMAGE_SIZE(pimg));
+		EXPECT_TRUE(png_image_finish_read(&pimg, NULL, out.data(), 0, NULL));
+
+		return out;
+	}
+};
+
+TEST_F(encoder_test, format_from_path) {
+	EXPECT_EQ(encoder_format_from_path("a.qoi"), ENCODER_QOI);
+	EXPECT_EQ(encoder_format_from_path("a.PPM"), ENCODER_PPM);
+	EXPECT_EQ(encoder_format_from_path("a.pam"), ENCODER_PAM);
+	EXPECT_EQ(encoder_format_from_path("a.bmp"), ENCODER_BMP);
+	EXPECT_EQ(encoder_format_from_path("a.png"), ENCODER_PNG);
+	EXPECT_EQ(encoder_format_from_path("a.jpg"), ENCODER_PNG);
+	EXPECT_EQ(encoder_format_from_path("dir.qoi/a"), ENCODER_PNG);
+}
+
+TEST_F(encoder_test, format_from_str) {
+	encoder_format_t f;
+	EXPECT_TRUE(encoder_format_from_str("qoi", &f));
+	EXPECT_EQ(f, ENCODER_QOI);
+	EXPECT_FALSE(encoder_format_from_str("gif", &f));
+}
+
+TEST_F(encoder_test, format_name) {
+	EXPECT_STREQ(encoder_format_name(ENCODER_AUTO), "png");
+	EXPECT_STREQ(encoder_format_name(ENCODER_QOI), "qoi");
+	EXPECT_STREQ(encoder_format_name(ENCODER_RGB24), "rgb24");
+	EXPECT_EQ(encoder_format_from_path("a.bgra"), ENCODER_BGRA);
+}
+
+TEST_F(encoder_test, filter_from_str) {
+	encoder_filter_t f;
+	EXPECT_TRUE(encoder_png_filter_from_str("sub,up", &f));
+	EXPECT_EQ(f, ENCODER_FILTER_SUB | ENCODER_FILTER_UP);
+	EXPECT_TRUE(encoder_png_filter_from_str("paeth", &f));
+	EXPECT_EQ(f, ENCODER_FILTER_PAETH);
+	EXPECT_FALSE(encoder_png_filter_from_str("foo", &f));
+	EXPECT_FALSE(encoder_png_filter_from_str("", &f));
+}
+
+TEST_F(encoder_test, ppm) {
+	string s = encode(ENCODER_PPM);
+	string hdr = "P6\n4 3\n255\n";
+
+	ASSERT_EQ(s.size(), hdr.size() + 4 * 3 * 3);
+	EXPECT_EQ(s.substr(0, hdr.size()), hdr);
+	EXPECT_EQ(s.substr(hdr.size(), 3), "\x10\x20\x30");
+}
+
+TEST_F(encoder_test, pam_unpremultiplies) {
+	create(1, 1, 0x80081018);
+
+	string s = encode(ENCODER_PAM);
+
+	ASSERT_GE(s.size(), 4u);
+	string px = s.substr(s.size() - 4);
+	EXPECT_EQ((uint8_t) px[0], 0x10);
+	EXPECT_EQ((uint8_t) px[1], 0x20);
+	EXPECT_EQ((uint8_t) px[2], 0x30);
+	EXPECT_EQ((uint8_t) px[3], 0x80);
+}
+
+TEST_F(encoder_test, bmp) {
+	string s = encode(ENCODER_BMP);
+
+	ASSERT_EQ(s.size(), 54u + 4 * 3 * 4);
+	EXPECT_EQ(s.substr(0, 2), "BM");
+	EXPECT_EQ((uint8_t) s[54], 0x30);
+	EXPECT_EQ((uint8_t) s[55], 0x20);
+	EXPECT_EQ((uint8_t) s[56], 0x10);
+}
+
+TEST_F(encoder_test, qoi_run) {
+	string s = encode(ENCODER_QOI);
+
+	// header, RGB op, a run of 11 pixels, end marker
+	ASSERT_EQ(s.size(), 14u + 4 + 1 + 8);
+	EXPECT_EQ(s.substr(0, 4), "qoif");
+	EXPECT_EQ(s[12], 3);
+	EXPECT_EQ((uint8_t) s[14], 0xfe);
+	EXPECT_EQ((uint8_t) s[18], 0xc0 | 10);
+	EXPECT_EQ(s.substr(s.size() - 8), string("\0\0\0\0\0\0\0\1", 8));
+}
+
+TEST_F(encoder_test, png_roundtrip) {
+	for (size_t i = 0; i < pixels.size(); ++i)
+		pixels[i] = 0xff000000 | (i * 0x050301);
+
+	for (int level : {0, 1, 9}) {
+		opts.png_compression = level;
+		opts.png_filter = level ? ENCODER_FILTER_ALL : ENCODER_FILTER_NONE;
+
+		vector<uint8_t> out = decode_png(encode(ENCODER_PNG));
+
+		for (size_t i = 0; i < pixels.size(); ++i) {
+			EXPECT_EQ(out[4 * i + 0], (pixels[i] >> 16) & 0xff);
+			EXPECT_EQ(out[4 * i + 1], (pixels[i] >> 8) & 0xff);
+			EXPECT_EQ(out[4 * i + 2], pixels[i] & 0xff);
+			EXPECT_EQ(out[4 * i + 3], 0xff);
+		}
+	}
+}
+
+TEST_F(encoder_test, png_parallel_roundtrip) {
+	create(37, 41, 0);
+	for (size_t i = 0; i < pixels.size(); ++i)
+		pixels[i] = (i % 7 ? 0xff000000 : 0x80000000) | (i * 0x010203 & 0x7f7f7f);
+
+	vector<uint8_t> expected;
+	opts.png_threads = 1;
+	expected = decode_png(encode(ENCODER_PNG));
+
+	for (int threads : {0, 2, 5, 64}) {
+		for (encoder_filter_t f : {ENCODER_FILTER_NONE, ENCODER_FILTER_PAETH, ENCODER_FILTER_ALL}) {
+			opts.png_threads = threads;
+			opts.png_filter = f;
+
+			vector<uint8_t> out = decode_png(encode(ENCODER_PNG));
+			EXPECT_EQ(out, expected);
+		}
+	}
+}
+
+TEST_F(encoder_test, png_alpha) {
+	pixels[0] = 0x00000000;
+
+	vector<uint8_t> out = decode_png(encode(ENCODER_PNG));
+
+	EXPECT_EQ(out[3], 0);
+	EXPECT_EQ(out[4], 0x10);
+	EXPECT_EQ(out[7], 0xff);
+}
+
+TEST_F(encoder_test, raw_formats) {
+	create(2, 1, 0x80081018);
+
+	string bgra = encode(ENCODER_BGRA);
+	ASSERT_EQ(bgra.size(), 2u * 4);
+	EXPECT_EQ(bgra.substr(0, 4), "\x18\x10\x08\x80");
+
+	string rgb = encode(ENCODER_RGB24);
+	ASSERT_EQ(rgb.size(), 2u * 3);
+	EXPECT_EQ(rgb.substr(0, 3), "\x10\x20\x30");
+}
+
+TEST_F(encoder_test, stream_header) {
+	FILE *fp = tmpfile();
+	ASSERT_TRUE(encoder_write_stream_header(fp, &img, ENCODER_RGB24));
+
+	string s(16, '\0');
+	rewind(fp);
+	ASSERT_EQ(fread(&s[0], 1, s.size(), fp), s.size());
+	fclose(fp);
+
+	EXPECT_EQ(s, string("PSCF\4\0\0\0\3\0\0\0RGB3", 16));
+	EXPECT_TRUE(encoder_is_raw(ENCODER_BGRA));
+	EXPECT_FALSE(encoder_is_raw(ENCODER_QOI));
+}
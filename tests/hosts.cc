@@ -0,0 +1,96 @@
+#include <string>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "hosts.h"
+}
+
+using namespace std;
+using namespace ::testing;
+
+class hosts_test: public Test
+{
+public:
+	hosts_test() {};
+	virtual ~hosts_test() {};
+
+	string dir;
+	hosts_t hosts;
+
+	virtual void SetUp() {
+		dir = "/tmp/pscircle-hosts-test-" + to_string(getpid());
+		ASSERT_EQ(mkdir(dir.c_str(), 0755), 0);
+
+		hosts_init(&hosts);
+	}
+
+	virtual void TearDown() {
+		hosts_dinit(&hosts);
+
+		string cmd = "rm -rf " + dir;
+		ASSERT_EQ(system(cmd.c_str()), 0);
+	}
+
+	void touch(const string &name) {
+		FILE *f = fopen((dir + "/" + name).c_str(), "w");
+		ASSERT_NE(f, nullptr);
+		fclose(f);
+	}
+};
+
+TEST_F(hosts_test, add__directory__files_sorted_by_name) {
+	touch("web02");
+	touch("db01");
+	touch("web01");
+	touch(".web03.tmp");
+	ASSERT_EQ(mkdir((dir + "/old").c_str(), 0755), 0);
+
+	ASSERT_TRUE(hosts_add(&hosts, dir.c_str()));
+
+	ASSERT_EQ(hosts.n, 3u);
+	EXPECT_STREQ(hosts.labels[0], "db01");
+	EXPECT_STREQ(hosts.labels[1], "web01");
+	EXPECT_STREQ(hosts.labels[2], "web02");
+	EXPECT_EQ(hosts.paths[1], dir + "/web01");
+}
+
+TEST_F(hosts_test, add__file__labelled_by_name) {
+	touch("db01");
+
+	ASSERT_TRUE(hosts_add(&hosts, (dir + "/db01").c_str()));
+
+	ASSERT_EQ(hosts.n, 1u);
+	EXPECT_STREQ(hosts.labels[0], "db01");
+	EXPECT_EQ(hosts.paths[0], dir + "/db01");
+}
+
+TEST_F(hosts_test, add_list__missing_path__reported) {
+	touch("db01");
+
+	string list = dir + "/db01," + dir + "/db02";
+	char failed[256] = "";
+
+	EXPECT_FALSE(hosts_add_list(&hosts, list.c_str(), failed, sizeof(failed)));
+	EXPECT_EQ(failed, dir + "/db02");
+
+	EXPECT_FALSE(hosts_add_list(&hosts, "", failed, sizeof(failed)));
+}
+
+TEST_F(hosts_test, add_list__files_and_directories) {
+	touch("db01");
+	ASSERT_EQ(mkdir((dir + "/web").c_str(), 0755), 0);
+	touch("web/web01");
+	touch("web/web02");
+
+	string list = dir + "/db01," + dir + "/web";
+	char failed[256] = "";
+
+	ASSERT_TRUE(hosts_add_list(&hosts, list.c_str(), failed, sizeof(failed)));
+
+	ASSERT_EQ(hosts.n, 3u);
+	EXPECT_STREQ(hosts.labels[0], "db01");
+	EXPECT_STREQ(hosts.labels[2], "web02");
+}
@@ -0,0 +1,132 @@
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "libpscircle.h"
+#include "snapshot.h"
+#include "procs.h"
+}
+
+using namespace std;
+using namespace ::testing;
+
+class libpscircle_test: public Test
+{
+public:
+	libpscircle_test() {};
+	virtual ~libpscircle_test() {};
+
+	psc_t *psc = NULL;
+	vector<uint32_t> pixels;
+
+	const string ps =
+		"1     0  0.0  4212 systemd\n"
+		"2     1  5.0  8424 Web Content\n"
+		"3     1 50.0  1024 make\n";
+
+	virtual void SetUp() {
+		ASSERT_EQ(psc_create(&psc), PSC_OK);
+		ASSERT_EQ(psc_set_option(psc, "--root-pid=0"), PSC_OK);
+
+		pixels.assign(64 * 48, 0);
+	}
+
+	virtual void TearDown() {
+		psc_destroy(psc);
+	}
+
+	psc_status_t render() {
+		return psc_render(psc, (uint8_t *) pixels.data(), 64, 48, 64 * 4);
+	}
+};
+
+TEST_F(libpscircle_test, feed_layout_render) {
+	EXPECT_EQ(psc_feed(psc, ps.data(), ps.size()), PSC_OK);
+	EXPECT_EQ(psc_layout(psc), PSC_OK);
+	EXPECT_EQ(render(), PSC_OK);
+
+	// The painter and its caches are reused for the next frames
+	EXPECT_EQ(psc_feed(psc, ps.data(), ps.size()), PSC_OK);
+	EXPECT_EQ(psc_layout(psc), PSC_OK);
+	EXPECT_EQ(render(), PSC_OK);
+}
+
+TEST_F(libpscircle_test, feed_snapshot) {
+	procs_t procs = {};
+	procs_alloc(&procs, 4);
+
+	pnode_t *p = procs_add(&procs);
+	p->pid = 1;
+	p->ppid = 0;
+	p->mem = 4096;
+	snprintf(p->name, sizeof(p->name), "init");
+
+	FILE *fp = tmpfile();
+	ASSERT_TRUE(snapshot_write(fp, &procs, 0));
+	procs_dinit(&procs);
+
+	vector<uint64_t> data(ftell(fp) / sizeof(uint64_t));
+	rewind(fp);
+	ASSERT_EQ(fread(data.data(), sizeof(uint64_t), data.size(), fp), data.size());
+	fclose(fp);
+
+	EXPECT_EQ(psc_feed(psc, data.data(), data.size() * sizeof(uint64_t)), PSC_OK);
+	EXPECT_EQ(psc_layout(psc), PSC_OK);
+	EXPECT_EQ(render(), PSC_OK);
+
+	// Truncated snapshots are rejected
+	EXPECT_EQ(psc_feed(psc, data.data(), 16), PSC_EINVAL);
+}
+
+TEST_F(libpscircle_test, out_of_order_calls) {
+	EXPECT_EQ(psc_layout(psc), PSC_ESTATE);
+	EXPECT_EQ(render(), PSC_ESTATE);
+
+	ASSERT_EQ(psc_feed(psc, ps.data(), ps.size()), PSC_OK);
+	EXPECT_EQ(render(), PSC_ESTATE);
+
+	EXPECT_EQ(psc_feed(psc, "\n", 1), PSC_ENODATA);
+	EXPECT_EQ(psc_layout(psc), PSC_ESTATE);
+	EXPECT_EQ(psc_feed(psc, NULL, 0), PSC_ENODATA);
+}
+
+TEST_F(libpscircle_test, invalid_arguments) {
+	EXPECT_EQ(psc_create(NULL), PSC_EINVAL);
+
+	EXPECT_EQ(psc_set_option(psc, "--no-such-option=1"), PSC_EINVAL);
+	EXPECT_EQ(psc_set_option(psc, "--max-children=x"), PSC_EINVAL);
+	EXPECT_EQ(psc_set_option(psc, "--max-children"), PSC_EINVAL);
+	EXPECT_EQ(psc_set_option(psc, "--help"), PSC_EINVAL);
+
+	ASSERT_EQ(psc_feed(psc, ps.data(), ps.size()), PSC_OK);
+	ASSERT_EQ(psc_layout(psc), PSC_OK);
+
+	uint8_t *data = (uint8_t *) pixels.data();
+	EXPECT_EQ(psc_render(psc, data, 64, 48, 63 * 4), PSC_EINVAL);
+	EXPECT_EQ(psc_render(psc, data, 64, 48, 64 * 4 + 1), PSC_EINVAL);
+	EXPECT_EQ(psc_render(psc, data, 0, 48, 64 * 4), PSC_EINVAL);
+	EXPECT_EQ(psc_render(psc, NULL, 64, 48, 64 * 4), PSC_EINVAL);
+}
+
+TEST_F(libpscircle_test, unreadable_procfs) {
+	ASSERT_EQ(psc_set_option(psc, "--procfs-root=/nonexistent"), PSC_OK);
+
+	EXPECT_EQ(psc_collect(psc), PSC_EIO);
+	EXPECT_STREQ(psc_strerror(PSC_EIO), "Input can not be read");
+}
+
+TEST_F(libpscircle_test, contexts_are_independent) {
+	psc_t *other = NULL;
+	ASSERT_EQ(psc_create(&other), PSC_OK);
+	ASSERT_EQ(psc_set_option(other, "--procfs-root=/nonexistent"), PSC_OK);
+
+	EXPECT_EQ(psc_collect(other), PSC_EIO);
+
+	ASSERT_EQ(psc_feed(psc, ps.data(), ps.size()), PSC_OK);
+	EXPECT_EQ(psc_layout(psc), PSC_OK);
+	EXPECT_EQ(render(), PSC_OK);
+
+	psc_destroy(other);
+}
@@ -0,0 +1,262 @@
+#include <string>
+#include <vector>
+#include <cstring>
+#include <thread>
+
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "pipeline.h"
+#include "timing.h"
+#include "cfg.h"
+}
+
+using namespace std;
+using namespace ::testing;
+
+// Draws one frame of /proc with --trace and --metrics-file set. The
+// state of timing.c is global, so that the files are written once.
+class metrics_test: public Test
+{
+public:
+	metrics_test() {};
+	virtual ~metrics_test() {};
+
+	static string dir;
+	static vector<string> trace;
+	static vector<string> metrics;
+
+	static void SetUpTestCase() {
+		dir = "/tmp/pscircle-trace-test-" + to_string(getpid());
+		ASSERT_EQ(mkdir(dir.c_str(), 0755), 0);
+
+		string trace_path = dir + "/trace.json";
+		string metrics_path = dir + "/pscircle.prom";
+		string output = dir + "/frame.ppm";
+
+		cfg_t saved = config;
+		config.trace = trace_path.c_str();
+		config.metrics_file = metrics_path.c_str();
+		// Several ticks of /proc/stat
+		config.interval = 0.1;
+		config.output = output.c_str();
+		config.output_format = ENCODER_PPM;
+		config.output_width = 8;
+		config.output_height = 4;
+
+		tm_init();
+
+		thread frame([] {
+			tm_thread_name("frame");
+
+			psc_ctx_t ctx;
+			psc_ctx_init(&ctx, &config);
+
+			size_t n = 0;
+			pipeline_output_t *o = pipeline_outputs_init(&n);
+			pipeline_run(&ctx, o, n);
+
+			pipeline_outputs_dinit(o, n);
+			psc_ctx_dinit(&ctx);
+		});
+		frame.join();
+
+		tm_dinit();
+
+		config = saved;
+
+		trace = read_lines(trace_path);
+		metrics = read_lines(metrics_path);
+	}
+
+	static void TearDownTestCase() {
+		string cmd = "rm -rf " + dir;
+		ASSERT_EQ(system(cmd.c_str()), 0);
+	}
+
+	static vector<string> read_lines(const string &path) {
+		vector<string> lines;
+
+		FILE *fp = fopen(path.c_str(), "r");
+		if (!fp)
+			return lines;
+
+		char line[1024];
+		while (fgets(line, sizeof(line), fp)) {
+			string l = line;
+			if (!l.empty() && l.back() == '\n')
+				l.pop_back();
+			lines.push_back(l);
+		}
+
+		fclose(fp);
+		return lines;
+	}
+
+	// A trace event, one per line: {"key":value,...},
+	struct event_t {
+		string line;
+
+		bool has(const string &key) const {
+			return line.find("\"" + key + "\":") != string::npos;
+		}
+
+		// The first occurrence, keys of args follow the event's own
+		string str(const string &key) const {
+			size_t i = line.find("\"" + key + "\":\"");
+			if (i == string::npos)
+				return "";
+			i += key.size() + 4;
+			return line.substr(i, line.find('"', i) - i);
+		}
+
+		double num(const string &key) const {
+			size_t i = line.find("\"" + key + "\":");
+			if (i == string::npos)
+				return -1;
+			return strtod(line.c_str() + i + key.size() + 3, NULL);
+		}
+	};
+
+	static vector<event_t> events(const string &ph) {
+		vector<event_t> r;
+		for (const string &l : trace) {
+			event_t e = {l};
+			if (e.str("ph") == ph)
+				r.push_back(e);
+		}
+		return r;
+	}
+
+	static const event_t *stage(const vector<event_t> &es, const string &name) {
+		for (const event_t &e : es) {
+			if (e.str("name") == name)
+				return &e;
+		}
+		return nullptr;
+	}
+
+	static bool has_line(const string &line) {
+		for (const string &l : metrics) {
+			if (l == line)
+				return true;
+		}
+		return false;
+	}
+
+	static bool has_prefix(const string &prefix) {
+		for (const string &l : metrics) {
+			if (l.rfind(prefix, 0) == 0)
+				return true;
+		}
+		return false;
+	}
+};
+
+string metrics_test::dir;
+vector<string> metrics_test::trace;
+vector<string> metrics_test::metrics;
+
+TEST_F(metrics_test, trace__json_array) {
+	ASSERT_GE(trace.size(), 3u);
+	EXPECT_EQ(trace.front(), "[");
+	EXPECT_EQ(trace.back(), "]");
+
+	// Events are separated by commas, the last one is not followed by one
+	for (size_t i = 1; i + 1 < trace.size(); ++i) {
+		const string &l = trace[i];
+		ASSERT_EQ(l.front(), '{') << l;
+		EXPECT_EQ(l.back(), i + 2 < trace.size() ? ',' : '}') << l;
+	}
+}
+
+TEST_F(metrics_test, trace__stage_events) {
+	vector<event_t> stages = events("X");
+
+	const char *names[] = {"collect", "wait", "link", "arrange", "draw tree", "write"};
+	for (const char *name : names)
+		EXPECT_NE(stage(stages, name), nullptr) << name;
+
+	for (const event_t &e : stages) {
+		EXPECT_EQ(e.str("cat"), "stage") << e.line;
+		EXPECT_EQ(e.num("pid"), getpid()) << e.line;
+		EXPECT_TRUE(e.has("tid")) << e.line;
+		EXPECT_GT(e.num("ts"), 0) << e.line;
+		EXPECT_GE(e.num("dur"), 0) << e.line;
+		EXPECT_GE(e.num("cpu_ms"), 0) << e.line;
+		EXPECT_TRUE(e.has("syscalls")) << e.line;
+	}
+}
+
+TEST_F(metrics_test, trace__thread_name) {
+	vector<event_t> metadata = events("M");
+	vector<event_t> stages = events("X");
+
+	const event_t *name = stage(metadata, "thread_name");
+	ASSERT_NE(name, nullptr);
+	EXPECT_NE(name->line.find("\"args\":{\"name\":\"frame\"}"), string::npos) << name->line;
+
+	const event_t *collect = stage(stages, "collect");
+	ASSERT_NE(collect, nullptr);
+	EXPECT_EQ(name->num("tid"), collect->num("tid"));
+}
+
+TEST_F(metrics_test, trace__wait_nested_in_collect) {
+	vector<event_t> stages = events("X");
+
+	const event_t *collect = stage(stages, "collect");
+	const event_t *wait = stage(stages, "wait");
+	ASSERT_NE(collect, nullptr);
+	ASSERT_NE(wait, nullptr);
+
+	EXPECT_EQ(wait->num("tid"), collect->num("tid"));
+	EXPECT_GE(wait->num("ts"), collect->num("ts"));
+	EXPECT_LE(wait->num("ts") + wait->num("dur"), collect->num("ts") + collect->num("dur"));
+
+	// --interval is spent waiting
+	EXPECT_GE(wait->num("dur"), 0.1 * 1e6 * 0.9);
+}
+
+TEST_F(metrics_test, metrics__prometheus_text) {
+	ASSERT_FALSE(metrics.empty());
+
+	EXPECT_TRUE(has_line("# HELP pscircle_frames_total Number of frames drawn."));
+	EXPECT_TRUE(has_line("# TYPE pscircle_frames_total counter"));
+	EXPECT_TRUE(has_line("pscircle_frames_total 1"));
+
+	EXPECT_TRUE(has_line("# TYPE pscircle_processes gauge"));
+	EXPECT_TRUE(has_line("# TYPE pscircle_stage_duration_seconds gauge"));
+	EXPECT_TRUE(has_line("# TYPE pscircle_stage_cpu_seconds gauge"));
+	EXPECT_TRUE(has_prefix("pscircle_stage_duration_seconds{stage=\"collect\"} "));
+	EXPECT_TRUE(has_prefix("pscircle_stage_duration_seconds{stage=\"wait\"} "));
+	EXPECT_TRUE(has_prefix("pscircle_stage_cpu_seconds{stage=\"draw_tree\"} "));
+
+	const char *names[] = {
+		"unchanged_frames_total", "last_frame_timestamp_seconds", "processes",
+		"omitted_processes", "skipped_processes", "output_bytes",
+		"text_cache_hits_total", "text_cache_lookups_total", "resident_memory_bytes",
+	};
+	for (const char *name : names) {
+		string metric = string("pscircle_") + name;
+		EXPECT_TRUE(has_prefix("# HELP " + metric + " ")) << name;
+		EXPECT_TRUE(has_prefix("# TYPE " + metric + " ")) << name;
+		EXPECT_TRUE(has_prefix(metric + " ")) << name;
+	}
+
+	// Every sample is preceded by the TYPE line of its metric
+	for (size_t i = 0; i < metrics.size(); ++i) {
+		const string &l = metrics[i];
+		if (l[0] == '#')
+			continue;
+
+		string name = l.substr(0, l.find_first_of("{ "));
+		bool typed = false;
+		for (size_t j = 0; j < i; ++j)
+			typed = typed || metrics[j] == "# TYPE " + name + " gauge" ||
+				metrics[j] == "# TYPE " + name + " counter";
+		EXPECT_TRUE(typed) << l;
+	}
+}
@@ -0,0 +1,514 @@
+#include <string>
+#include <cstring>
+#include <thread>
+#include <atomic>
+
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "pipeline.h"
+#include "queue.h"
+#include "delta.h"
+#include "cfg.h"
+}
+
+using namespace std;
+using namespace ::testing;
+
+TEST(queue, fifo_order) {
+	queue_t q;
+	queue_init(&q);
+
+	int items[2 * PIPELINE_DEPTH];
+	for (size_t round = 0; round < 2; ++round) {
+		for (size_t i = 0; i < PIPELINE_DEPTH; ++i)
+			queue_push(&q, &items[round * PIPELINE_DEPTH + i]);
+
+		for (size_t i = 0; i < PIPELINE_DEPTH; ++i)
+			EXPECT_EQ(queue_pop(&q), &items[round * PIPELINE_DEPTH + i]);
+	}
+
+	queue_dinit(&q);
+}
+
+TEST(queue, push_blocks_at_capacity) {
+	queue_t q;
+	queue_init(&q);
+
+	int items[PIPELINE_DEPTH + 1];
+	for (size_t i = 0; i < PIPELINE_DEPTH; ++i)
+		queue_push(&q, &items[i]);
+
+	atomic<bool> pushed(false);
+	thread producer([&] {
+		queue_push(&q, &items[PIPELINE_DEPTH]);
+		pushed = true;
+	});
+
+	usleep(50000);
+	EXPECT_FALSE(pushed);
+
+	EXPECT_EQ(queue_pop(&q), &items[0]);
+	producer.join();
+	EXPECT_TRUE(pushed);
+
+	for (size_t i = 1; i <= PIPELINE_DEPTH; ++i)
+		EXPECT_EQ(queue_pop(&q), &items[i]);
+
+	queue_dinit(&q);
+}
+
+TEST(queue, pop_blocks_until_end_of_stream) {
+	queue_t q;
+	queue_init(&q);
+
+	int item;
+	atomic<size_t> popped(0);
+	thread consumer([&] {
+		while (queue_pop(&q) != NULL)
+			popped++;
+	});
+
+	usleep(20000);
+	EXPECT_EQ(popped, 0u);
+
+	for (int i = 0; i < 5; ++i)
+		queue_push(&q, &item);
+
+	// NULL ends the stream, after the items before it
+	queue_push(&q, NULL);
+	consumer.join();
+	EXPECT_EQ(popped, 5u);
+
+	queue_dinit(&q);
+}
+
+TEST(pipeline_frame_pattern, one_integer_conversion) {
+	EXPECT_TRUE(pipeline_frame_pattern("frames/%06d.png"));
+	EXPECT_TRUE(pipeline_frame_pattern("%d.qoi"));
+	EXPECT_TRUE(pipeline_frame_pattern("100%%/%d.png"));
+
+	EXPECT_FALSE(pipeline_frame_pattern("frame.png"));
+	EXPECT_FALSE(pipeline_frame_pattern("%d-%d.png"));
+	EXPECT_FALSE(pipeline_frame_pattern("%s.png"));
+	EXPECT_FALSE(pipeline_frame_pattern("%-6d.png"));
+	EXPECT_FALSE(pipeline_frame_pattern("%d%"));
+}
+
+TEST(pipeline_frame_range, forms) {
+	size_t first, last;
+
+	EXPECT_TRUE(pipeline_frame_range("10-20", 100, &first, &last));
+	EXPECT_EQ(first, 10u);
+	EXPECT_EQ(last, 20u);
+
+	EXPECT_TRUE(pipeline_frame_range("10-", 100, &first, &last));
+	EXPECT_EQ(first, 10u);
+	EXPECT_EQ(last, 99u);
+
+	EXPECT_TRUE(pipeline_frame_range("7", 100, &first, &last));
+	EXPECT_EQ(first, 7u);
+	EXPECT_EQ(last, 7u);
+
+	EXPECT_TRUE(pipeline_frame_range("90-200", 100, &first, &last));
+	EXPECT_EQ(last, 99u);
+
+	EXPECT_FALSE(pipeline_frame_range("100-", 100, &first, &last));
+	EXPECT_FALSE(pipeline_frame_range("20-10", 100, &first, &last));
+	EXPECT_FALSE(pipeline_frame_range("-10", 100, &first, &last));
+	EXPECT_FALSE(pipeline_frame_range("1-2x", 100, &first, &last));
+	EXPECT_FALSE(pipeline_frame_range("0-", 0, &first, &last));
+}
+
+TEST(pipeline_jobs, clamped_to_items) {
+	cfg_t saved = config;
+	cfg_t cfg;
+
+	config.jobs = 4;
+	config.png_threads = 0;
+	EXPECT_EQ(pipeline_jobs(100, &cfg), 4u);
+	EXPECT_EQ(pipeline_jobs(2, &cfg), 2u);
+	EXPECT_EQ(cfg.png_threads, 1);
+
+	config.jobs = 0;
+	config.png_threads = 3;
+	EXPECT_GE(pipeline_jobs(100, &cfg), 1u);
+	EXPECT_EQ(pipeline_jobs(1, &cfg), 1u);
+	EXPECT_EQ(cfg.png_threads, 3);
+
+	config = saved;
+}
+
+TEST(pipeline_parse_outputs, options_of_each_output) {
+	cfg_t *configs = NULL;
+	size_t n = 0;
+
+	cfg_t base = config;
+	base.output_width = 100;
+
+	ASSERT_TRUE(pipeline_parse_outputs(
+				"output=a.png,output-height=50;output=-,tree-center=10:20",
+				&base, &configs, &n));
+	ASSERT_EQ(n, 2u);
+
+	EXPECT_STREQ(configs[0].output, "a.png");
+	EXPECT_EQ(configs[0].output_width, 100u);
+	EXPECT_EQ(configs[0].output_height, 50u);
+
+	EXPECT_STREQ(configs[1].output, "-");
+	EXPECT_EQ(configs[1].output_height, base.output_height);
+	EXPECT_EQ(configs[1].tree.center.x, 10);
+	EXPECT_EQ(configs[1].tree.center.y, 20);
+
+	free(configs);
+
+	// Empty output is the X11 root window
+	ASSERT_TRUE(pipeline_parse_outputs("output=", &base, &configs, &n));
+	EXPECT_EQ(configs[0].output, nullptr);
+	free(configs);
+}
+
+TEST(pipeline_parse_outputs, invalid) {
+	cfg_t *configs = NULL;
+	size_t n = 0;
+
+	EXPECT_FALSE(pipeline_parse_outputs("", &config, &configs, &n));
+	EXPECT_FALSE(pipeline_parse_outputs("output=a.png;", &config, &configs, &n));
+	EXPECT_FALSE(pipeline_parse_outputs("output=a.png,", &config, &configs, &n));
+	EXPECT_FALSE(pipeline_parse_outputs("output", &config, &configs, &n));
+	EXPECT_FALSE(pipeline_parse_outputs("no-such-option=1", &config, &configs, &n));
+	EXPECT_FALSE(pipeline_parse_outputs("output-width=x", &config, &configs, &n));
+	EXPECT_FALSE(pipeline_parse_outputs("output=-;output=-", &config, &configs, &n));
+
+	// The processes are shared by all the outputs
+	EXPECT_FALSE(pipeline_parse_outputs("output=a.png,root-pid=1", &config, &configs, &n));
+	EXPECT_FALSE(pipeline_parse_outputs("interval=1", &config, &configs, &n));
+	EXPECT_FALSE(pipeline_output_option("stdin"));
+	EXPECT_TRUE(pipeline_output_option("cpulist-center"));
+}
+
+static void
+write_recording(const string &path, int nframes)
+{
+	FILE *fp = fopen(path.c_str(), "wb");
+	ASSERT_NE(fp, nullptr);
+
+	delta_writer_t writer;
+	delta_writer_init(&writer, fp, 3);
+
+	for (int f = 0; f < nframes; ++f) {
+		procs_t procs = {};
+		procs_alloc(&procs, 4);
+
+		for (int pid = 1; pid <= 3; ++pid) {
+			pnode_t *p = procs_add(&procs);
+			p->pid = pid;
+			p->ppid = pid - 1;
+			p->cpu = f;
+			p->mem = 1 << 20;
+			strcpy(p->name, "proc");
+		}
+
+		ASSERT_TRUE(delta_writer_add(&writer, &procs));
+		procs_dinit(&procs);
+	}
+
+	ASSERT_TRUE(delta_writer_finish(&writer));
+	delta_writer_dinit(&writer);
+	fclose(fp);
+}
+
+TEST(pipeline_timelapse, numbered_files) {
+	string dir = "/tmp/pscircle-pipeline-test-" + to_string(getpid());
+	ASSERT_EQ(mkdir(dir.c_str(), 0755), 0);
+
+	string recording = dir + "/rec.pscs";
+	write_recording(recording, 8);
+
+	string output = dir + "/%02d.ppm";
+
+	cfg_t saved = config;
+	config.replay = recording.c_str();
+	config.frames = "2-5";
+	config.jobs = 3;
+	config.output = output.c_str();
+	config.output_width = 32;
+	config.output_height = 16;
+
+	pipeline_timelapse();
+
+	// Workers use their own copy of the options
+	EXPECT_EQ(config.png_threads, saved.png_threads);
+
+	config = saved;
+
+	struct stat st;
+	for (int f = 0; f < 8; ++f) {
+		string path = dir + "/0" + to_string(f) + ".ppm";
+		EXPECT_EQ(stat(path.c_str(), &st) == 0, f >= 2 && f <= 5) << f;
+		remove(path.c_str());
+	}
+
+	remove(recording.c_str());
+	rmdir(dir.c_str());
+}
+
+// Parses the value of a metric without labels, -1 if it is missing
+static double
+read_metric(const string &path, const string &name)
+{
+	FILE *fp = fopen(path.c_str(), "r");
+	if (!fp)
+		return -1;
+
+	double value = -1;
+	char line[256];
+	while (fgets(line, sizeof(line), fp)) {
+		string l = line;
+		if (l.rfind(name + " ", 0) == 0)
+			value = strtod(line + name.size() + 1, NULL);
+	}
+
+	fclose(fp);
+	return value;
+}
+
+TEST(pipeline_timelapse, metrics_written_by_workers) {
+	string dir = "/tmp/pscircle-metrics-test-" + to_string(getpid());
+	ASSERT_EQ(mkdir(dir.c_str(), 0755), 0);
+
+	string recording = dir + "/rec.pscs";
+	write_recording(recording, 24);
+
+	string output = dir + "/%02d.ppm";
+	string metrics = dir + "/pscircle.prom";
+
+	cfg_t saved = config;
+	config.replay = recording.c_str();
+	config.frames = "0-23";
+	config.jobs = 4;
+	config.output = output.c_str();
+	config.output_width = 8;
+	config.output_height = 8;
+	config.metrics_file = metrics.c_str();
+
+	internal::CaptureStderr();
+	pipeline_timelapse();
+	string errors = internal::GetCapturedStderr();
+
+	config = saved;
+
+	// The workers do not replace each other's temporary file
+	EXPECT_EQ(errors, "");
+
+	// The last file written counts every frame
+	EXPECT_EQ(read_metric(metrics, "pscircle_frames_total"), 24);
+	EXPECT_NE(access((metrics + ".tmp").c_str(), F_OK), 0);
+
+	string cmd = "rm -rf " + dir;
+	ASSERT_EQ(system(cmd.c_str()), 0);
+}
+
+TEST(pipeline_run, stdin_frames_collected_rendered_written) {
+	// More frames than PIPELINE_DEPTH, so that the buffers are reused
+	const int nframes = 3 * PIPELINE_DEPTH + 1;
+
+	FILE *in = tmpfile();
+	ASSERT_NE(in, nullptr);
+	for (int f = 0; f < nframes; ++f)
+		fprintf(in, "1 0 %d.0 4212 systemd\n2 1 5.0 8424 nginx\n\n", f);
+	rewind(in);
+
+	int saved_stdin = dup(STDIN_FILENO);
+	ASSERT_EQ(dup2(fileno(in), STDIN_FILENO), STDIN_FILENO);
+
+	cfg_t saved = config;
+	config.read_stdin = true;
+	config.loop = true;
+	config.root_pid = 1;
+	config.output = "-";
+	config.output_format = ENCODER_PPM;
+	config.output_width = 8;
+	config.output_height = 4;
+
+	psc_ctx_t ctx;
+	psc_ctx_init(&ctx, &config);
+
+	size_t n = 0;
+	pipeline_output_t *o = pipeline_outputs_init(&n);
+
+	internal::CaptureStdout();
+	pipeline_run(&ctx, o, n);
+	string frames = internal::GetCapturedStdout();
+
+	pipeline_outputs_dinit(o, n);
+	psc_ctx_dinit(&ctx);
+
+	config = saved;
+
+	dup2(saved_stdin, STDIN_FILENO);
+	close(saved_stdin);
+	fclose(in);
+
+	// Every frame is written to stdout, in order of the input
+	const string header = "P6\n8 4\n255\n";
+	const size_t size = header.size() + 8 * 4 * 3;
+
+	ASSERT_EQ(frames.size(), nframes * size);
+	for (int f = 0; f < nframes; ++f)
+		EXPECT_EQ(frames.substr(f * size, header.size()), header) << f;
+}
+
+TEST(pipeline_run, several_outputs) {
+	string dir = "/tmp/pscircle-outputs-test-" + to_string(getpid());
+	ASSERT_EQ(mkdir(dir.c_str(), 0755), 0);
+
+	string recording = dir + "/rec.pscs";
+	write_recording(recording, 1);
+
+	string a = dir + "/a.ppm";
+	string b = dir + "/b.ppm";
+	string outputs =
+		"output=" + a + ",output-width=32,output-height=16;"
+		"output=" + b + ",output-width=20,output-height=10";
+
+	cfg_t saved = config;
+	config.replay = recording.c_str();
+	config.outputs = outputs.c_str();
+
+	psc_ctx_t ctx;
+	psc_ctx_init(&ctx, &config);
+
+	size_t n = 0;
+	pipeline_output_t *o = pipeline_outputs_init(&n);
+	ASSERT_EQ(n, 2u);
+
+	pipeline_run(&ctx, o, n);
+
+	pipeline_outputs_dinit(o, n);
+	psc_ctx_dinit(&ctx);
+
+	config = saved;
+
+	const string paths[] = {a, b};
+	const char *headers[] = {"P6\n32 16\n", "P6\n20 10\n"};
+
+	for (int i = 0; i < 2; ++i) {
+		FILE *fp = fopen(paths[i].c_str(), "rb");
+		ASSERT_NE(fp, nullptr) << paths[i];
+
+		char header[16] = {0};
+		EXPECT_EQ(fread(header, 1, strlen(headers[i]), fp), strlen(headers[i]));
+		fclose(fp);
+
+		EXPECT_STREQ(header, headers[i]);
+		remove(paths[i].c_str());
+	}
+
+	remove(recording.c_str());
+	rmdir(dir.c_str());
+}
+
+class pipeline_unchanged_test: public Test
+{
+public:
+	pipeline_unchanged_test() {};
+	virtual ~pipeline_unchanged_test() {};
+
+	pipeline_output_t output;
+
+	virtual void SetUp() {
+		output = {};
+		output.config = config;
+		output.config.loop = true;
+		output.config.skip_unchanged = true;
+		output.config.output = "frame.png";
+		psc_ctx_init(&output.ctx, &output.config);
+	}
+
+	virtual void TearDown() {
+		psc_ctx_dinit(&output.ctx);
+	}
+
+	// Checks whether a frame of init and two children would be skipped
+	bool unchanged(real_t cpu, const char *name = "worker", const char *label = "1.00") {
+		procs_t procs = {};
+		procs_alloc(&procs, 4);
+
+		for (int pid = 1; pid <= 3; ++pid) {
+			pnode_t *p = procs_add(&procs);
+			p->pid = pid;
+			p->ppid = pid == 1 ? 0 : 1;
+			p->cpu = pid == 3 ? cpu : 0;
+			p->mem = 1 << 20;
+			strcpy(p->name, pid == 1 ? "init" : name);
+		}
+
+		procs_link(&output.ctx, &procs);
+		strcpy(procs.cpu_label, label);
+
+		bool r = pipeline_unchanged(&output, &procs);
+
+		procs_dinit(&procs);
+
+		return r;
+	}
+};
+
+TEST_F(pipeline_unchanged_test, same_frame__skipped) {
+	EXPECT_FALSE(unchanged(1));
+	EXPECT_TRUE(unchanged(1));
+	EXPECT_TRUE(unchanged(1));
+}
+
+TEST_F(pipeline_unchanged_test, invisible_change__skipped) {
+	EXPECT_FALSE(unchanged(2));
+
+	// Same colors of the dot and "2.0%" in the toplist
+	EXPECT_TRUE(unchanged(2.01));
+}
+
+TEST_F(pipeline_unchanged_test, visible_change__drawn) {
+	EXPECT_FALSE(unchanged(1));
+	EXPECT_FALSE(unchanged(5));
+	EXPECT_FALSE(unchanged(5, "server"));
+	EXPECT_FALSE(unchanged(5, "server", "1.25"));
+	EXPECT_TRUE(unchanged(5, "server", "1.25"));
+}
+
+TEST_F(pipeline_unchanged_test, toplist_hidden__label_ignored) {
+	output.config.toplists.cpulist.show = false;
+	output.config.toplists.memlist.show = false;
+
+	EXPECT_FALSE(unchanged(1, "worker", "1.00"));
+	EXPECT_TRUE(unchanged(1, "worker", "1.25"));
+}
+
+TEST_F(pipeline_unchanged_test, option_change__drawn) {
+	EXPECT_FALSE(unchanged(1));
+
+	output.config.tree.font_size += 1;
+
+	EXPECT_FALSE(unchanged(1));
+	EXPECT_TRUE(unchanged(1));
+}
+
+TEST_F(pipeline_unchanged_test, disabled__drawn) {
+	output.config.skip_unchanged = false;
+	EXPECT_FALSE(unchanged(1));
+	EXPECT_FALSE(unchanged(1));
+
+	// Frames on stdout are counted by their consumers
+	output.config.skip_unchanged = true;
+	output.config.output = "-";
+	EXPECT_FALSE(unchanged(1));
+	EXPECT_FALSE(unchanged(1));
+
+	output.config.output = "frame.png";
+	output.config.loop = false;
+	EXPECT_FALSE(unchanged(1));
+	EXPECT_FALSE(unchanged(1));
+}
@@ -1,8 +1,16 @@
+#include <string>
+#include <thread>
+#include <atomic>
+#include <cstring>
+#include <unistd.h>
+#include <sys/stat.h>
+
 #include "gtest/gtest.h"
 
 extern "C" {
 #include "procs.h"
 #include "cfg.h"
+#include "hosts.h"
 }
 
 #define EPS PSC_EPS
@@ -19,6 +27,7 @@ public:
 	FILE *fp;
 
 	procs_t *procs;
+	psc_ctx_t ctx;
 
 	virtual void SetUp() {
 		ASSERT_EQ(PSC_TOPLIST_MAX_ROWS, 5);
@@ -26,6 +35,9 @@ public:
 		config.max_children = 90;
 		config.root_pid = 0;
 		config.memory_unit = 1;
+		config.max_nodes = 0;
+
+		psc_ctx_init(&ctx, &config);
 
 		fp = tmpfile();
 
@@ -35,6 +47,7 @@ public:
 	virtual void TearDown(){
 		fclose(fp);
 		procs_dinit(procs);
+		psc_ctx_dinit(&ctx);
 
 		delete procs;
 	}
@@ -43,7 +56,11 @@ public:
 		fputs(s, fp);
 		rewind(fp);
 
-		procs_init(procs, fp);
+		in_stream_t stream;
+		stream_init(&stream, fp);
+		procs_io_t io = {&stream};
+		procs_init(&ctx, procs, &io);
+		stream_dinit(&stream);
 	}
 };
 
@@ -153,6 +170,51 @@ TEST_F(procs_test, read__name_is_too_long) {
 	EXPECT_EQ(string(p->name), n);
 }
 
+TEST_F(procs_test, read__no_trailing_lf) {
+	create(
+"1     0  3.14  4212 systemd\n"
+"2     1  0.5e1  12 bash"
+	);
+
+	auto c = procs_child_by_pid(procs, 2);
+	ASSERT_NE(c, nullptr);
+	EXPECT_STREQ(c->name, "bash");
+	EXPECT_NEAR(c->cpu, 5, EPS);
+	EXPECT_EQ(c->mem, 12u * 1024);
+}
+
+TEST_F(procs_test, read__blank_and_invalid_lines_skipped) {
+	create(
+"\n"
+"  1     0  3.14  4212 systemd\r\n"
+"garbage\n"
+"\t2\t1\t0.0\t12\tbash\n"
+"3     1  x  12 bad\n"
+	);
+
+	EXPECT_NE(procs_child_by_pid(procs, 1), nullptr);
+	auto c = procs_child_by_pid(procs, 2);
+	ASSERT_NE(c, nullptr);
+	EXPECT_STREQ(c->name, "bash");
+	EXPECT_EQ(procs_child_by_pid(procs, 3), nullptr);
+}
+
+TEST_F(procs_test, read__lines_longer_than_buffer) {
+	string s = "1     0  3.14  4212 systemd\n2 1 1.0 1 ";
+	s += string(3 * PSC_STREAM_BUFSIZE, 'a');
+	s += "\n3 1 2.0 2 last\n";
+
+	create(s.c_str());
+
+	auto c = procs_child_by_pid(procs, 2);
+	ASSERT_NE(c, nullptr);
+	EXPECT_EQ(string(c->name), string(PSC_MAX_NAME_LENGHT - 1, 'a'));
+
+	c = procs_child_by_pid(procs, 3);
+	ASSERT_NE(c, nullptr);
+	EXPECT_STREQ(c->name, "last");
+}
+
 TEST_F(procs_test, links__root_pid_found) {
 	config.root_pid = 1;
 
@@ -413,3 +475,398 @@ TEST_F(procs_test, find_by_pid__unknown_process__returns_nullptr) {
 	auto c = procs_child_by_pid(procs, 10);
 	EXPECT_EQ(c, nullptr);
 }
+
+TEST_F(procs_test, links__many_processes__parents_found_by_pid) {
+	const size_t n = 3 * PSC_MAX_PROCS_COUNT;
+
+	procs_alloc(procs, n + 1);
+
+	for (size_t i = 0; i < n; ++i) {
+		pnode_t *p = procs_add(procs);
+		ASSERT_NE(p, nullptr);
+		// Scattered pids, each process is a child of the previous one
+		p->pid = 1 + i * 4099;
+		p->ppid = i ? 1 + (i - 1) * 4099 : 0;
+		snprintf(p->name, sizeof(p->name), "p%zu", i);
+	}
+
+	EXPECT_EQ(procs_add(procs), nullptr);
+
+	procs_link(&ctx, procs);
+
+	auto c = procs_child_by_pid(procs, 1 + (n - 1) * 4099);
+	ASSERT_NE(c, nullptr);
+	EXPECT_EQ(c->ppid, 1 + ((int) n - 2) * 4099);
+	EXPECT_EQ(((pnode_t *) c->node._parent)->pid, c->ppid);
+}
+
+TEST_F(procs_test, procfs_root__fixture_is_read) {
+	char dir[] = "/tmp/pscircle-test-XXXXXX";
+	ASSERT_NE(mkdtemp(dir), nullptr);
+
+	string root = dir;
+	auto write = [&](const string &name, const string &content) {
+		FILE *f = fopen((root + "/" + name).c_str(), "w");
+		ASSERT_NE(f, nullptr);
+		fputs(content.c_str(), f);
+		fclose(f);
+	};
+
+	const string tail = " 0 0 20 0 1 0 0 0 %ld 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0\n";
+	long pagesize = sysconf(_SC_PAGESIZE);
+
+	write("stat", "cpu  100 0 100 800 0 0 0 0 0 0\n");
+	write("uptime", "1000.00 3000.00\n");
+	write("loadavg", "1.00 0.75 0.50 1/2 2\n");
+	write("meminfo",
+		"MemTotal: 4000 kB\nMemFree: 1000 kB\nBuffers: 500 kB\nCached: 500 kB\n");
+
+	const char *stats[] = {
+		"1 (init) S 0 1 1 0 -1 0 0 0 0 0 0 0",
+		"2 (Web Content) S 1 1 1 0 -1 0 0 0 0 0 0 0",
+	};
+
+	for (int pid = 1; pid <= 2; ++pid) {
+		string d = to_string(pid);
+		ASSERT_EQ(mkdir((root + "/" + d).c_str(), 0755), 0);
+		char buf[256];
+		snprintf(buf, sizeof(buf), (stats[pid - 1] + tail).c_str(), 10L * pid);
+		write(d + "/stat", buf);
+	}
+
+	config.interval = 0;
+	config.procfs_root = dir;
+
+	procs_init(&ctx, procs, NULL);
+
+	config.interval = PSC_INTERVAL;
+	config.procfs_root = PSC_PROCFS_ROOT;
+
+	auto c = procs_child_by_pid(procs, 2);
+	ASSERT_NE(c, nullptr);
+	EXPECT_STREQ(c->name, "Web Content");
+	EXPECT_EQ(c->ppid, 1);
+	EXPECT_EQ(c->mem, (uint64_t) 20 * pagesize);
+	EXPECT_STREQ(procs->cpu_label, "1.00 0.75 0.50 1/2");
+	EXPECT_NEAR(procs->mem_value, 0.5, EPS);
+
+	for (int pid = 1; pid <= 2; ++pid) {
+		remove((root + "/" + to_string(pid) + "/stat").c_str());
+		rmdir((root + "/" + to_string(pid)).c_str());
+	}
+	for (const char *f : {"stat", "uptime", "loadavg", "meminfo"})
+		remove((root + "/" + f).c_str());
+	rmdir(dir);
+}
+
+TEST_F(procs_test, read__frames_separated_by_empty_lines) {
+	int fds[2];
+	ASSERT_EQ(pipe(fds), 0);
+
+	atomic<bool> read_first(false);
+	bool first_read_before_second = false;
+
+	// The second frame is written once the first one has been read, or
+	// after 5 s if reading waits for more input
+	thread writer([&] {
+		const char *first =
+"1     0  1.0  1 p1\n"
+"2     1  1.0  1 p2\n"
+"\n";
+		const char *second =
+"\n"
+"1     0  1.0  1 p1\n"
+"3     1  1.0  1 p3\n";
+
+		ASSERT_EQ(write(fds[1], first, strlen(first)), (ssize_t) strlen(first));
+
+		for (int i = 0; i < 500 && !read_first; ++i)
+			usleep(10000);
+		first_read_before_second = read_first;
+
+		ASSERT_EQ(write(fds[1], second, strlen(second)), (ssize_t) strlen(second));
+		close(fds[1]);
+	});
+
+	FILE *in = fdopen(fds[0], "r");
+	ASSERT_NE(in, nullptr);
+
+	in_stream_t stream;
+	stream_init(&stream, in);
+	stream.frames = true;
+	procs_io_t io = {&stream};
+
+	ASSERT_FALSE(stream_at_end(&stream));
+	procs_init(&ctx, procs, &io);
+	read_first = true;
+	EXPECT_NE(procs_child_by_pid(procs, 2), nullptr);
+	EXPECT_EQ(procs_child_by_pid(procs, 3), nullptr);
+
+	procs_t *next = new procs_t();
+
+	ASSERT_FALSE(stream_at_end(&stream));
+	procs_init(&ctx, next, &io);
+	EXPECT_EQ(procs_child_by_pid(next, 2), nullptr);
+	EXPECT_NE(procs_child_by_pid(next, 3), nullptr);
+
+	EXPECT_TRUE(stream_at_end(&stream));
+
+	writer.join();
+	EXPECT_TRUE(first_read_before_second);
+
+	procs_dinit(next);
+	delete next;
+	stream_dinit(&stream);
+	fclose(in);
+}
+
+TEST_F(procs_test, read__first_byte_put_back) {
+	fputs("1     0  1.0  1 p1\n", fp);
+	rewind(fp);
+
+	int c = getc(fp);
+
+	in_stream_t stream;
+	stream_init(&stream, fp);
+	// Skips the rest of the block read by stdio
+	ASSERT_EQ(lseek(fileno(fp), 1, SEEK_SET), 1);
+	stream_unget(&stream, c);
+
+	procs_io_t io = {&stream};
+	procs_init(&ctx, procs, &io);
+	EXPECT_NE(procs_child_by_pid(procs, 1), nullptr);
+
+	stream_dinit(&stream);
+}
+
+TEST_F(procs_test, read__contexts_are_independent) {
+	fputs(
+"1     0  1.0  1 p1\n"
+"2     1  1.0  1 p2\n"
+"\n"
+"1     0  1.0  1 p1\n"
+"2     1  1.0  1 p2\n",
+	fp);
+	rewind(fp);
+
+	cfg_t other_config = config;
+	other_config.memory_unit = 1;
+	other_config.root_pid = 2;
+
+	psc_ctx_t other;
+	psc_ctx_init(&other, &other_config);
+
+	config.memory_unit = 0;
+
+	in_stream_t stream;
+	stream_init(&stream, fp);
+	stream.frames = true;
+	procs_io_t io = {&stream};
+
+	procs_init(&ctx, procs, &io);
+
+	procs_t *next = new procs_t();
+	procs_init(&other, next, &io);
+
+	EXPECT_EQ(procs->root->pid, 0);
+	EXPECT_EQ(procs_child_by_pid(procs, 2)->mem, 1u);
+
+	EXPECT_EQ(next->root->pid, 2);
+	EXPECT_EQ(procs_child_by_pid(next, 2)->mem, 1024u);
+
+	procs_dinit(next);
+	delete next;
+	stream_dinit(&stream);
+	psc_ctx_dinit(&other);
+}
+
+class forest_test: public procs_test
+{
+public:
+	string dir;
+	hosts_t hosts;
+
+	virtual void SetUp() {
+		procs_test::SetUp();
+
+		dir = "/tmp/pscircle-forest-test-" + to_string(getpid());
+		ASSERT_EQ(mkdir(dir.c_str(), 0755), 0);
+
+		hosts_init(&hosts);
+	}
+
+	virtual void TearDown() {
+		hosts_dinit(&hosts);
+
+		string cmd = "rm -rf " + dir;
+		ASSERT_EQ(system(cmd.c_str()), 0);
+
+		procs_test::TearDown();
+	}
+
+	void write(const string &name, const char *content) {
+		FILE *f = fopen((dir + "/" + name).c_str(), "w");
+		ASSERT_NE(f, nullptr);
+		fputs(content, f);
+		fclose(f);
+	}
+
+	void create_forest() {
+		ASSERT_TRUE(hosts_add(&hosts, dir.c_str()));
+
+		procs_io_t io = {};
+		io.hosts = &hosts;
+		procs_init(&ctx, procs, &io);
+	}
+
+	pnode_t *child(pnode_t *p, size_t i) {
+		node_t *n = p->node.first;
+		while (n && i-- > 0)
+			n = n->next;
+		return (pnode_t *) n;
+	}
+};
+
+TEST_F(forest_test, hosts_hang_from_root) {
+	write("web02",
+"1     0  1.0  10 systemd\n"
+"2     1  2.0  20 nginx\n");
+	write("web01",
+"1     0  1.0  10 systemd\n"
+"2     1  3.0  30 postgres\n"
+"3     2  4.0  40 worker\n");
+
+	create_forest();
+
+	EXPECT_EQ(procs->nhosts, 2u);
+	ASSERT_EQ(node_nchildren(&procs->root->node), 2u);
+
+	// Hosts are in the order of the names of their files
+	pnode_t *web01 = child(procs->root, 0);
+	pnode_t *web02 = child(procs->root, 1);
+	EXPECT_STREQ(web01->name, "web01");
+	EXPECT_STREQ(web02->name, "web02");
+
+	// The node of a host shows its total usage
+	EXPECT_NEAR(web01->cpu, 8.0, EPS);
+	EXPECT_EQ(web01->mem, 80u * 1024);
+
+	// Pids are looked up within the host
+	pnode_t *postgres = child(child(web01, 0), 0);
+	ASSERT_NE(postgres, nullptr);
+	EXPECT_STREQ(postgres->name, "postgres");
+	EXPECT_STREQ(child(postgres, 0)->name, "worker");
+
+	pnode_t *nginx = child(child(web02, 0), 0);
+	ASSERT_NE(nginx, nullptr);
+	EXPECT_STREQ(nginx->name, "nginx");
+	EXPECT_EQ(nginx->node.first, nullptr);
+}
+
+TEST_F(forest_test, host_stands_for_root_pid) {
+	config.root_pid = 1;
+
+	write("db01",
+"1     0  1.0  10 systemd\n"
+"2     1  2.0  20 postgres\n"
+"3     0  0.0   0 kthreadd\n");
+
+	create_forest();
+
+	pnode_t *db01 = child(procs->root, 0);
+	ASSERT_NE(db01, nullptr);
+	ASSERT_EQ(node_nchildren(&db01->node), 1u);
+	EXPECT_STREQ(child(db01, 0)->name, "postgres");
+}
+
+TEST_F(forest_test, hosts_over_max_procs_count__read) {
+	// Each host has more processes than PSC_MAX_PROCS_COUNT in all
+	const size_t n = 4 * PSC_MAX_PROCS_COUNT;
+	ASSERT_LE(n, (size_t) PSC_MAX_HOST_PROCS_COUNT);
+
+	string content;
+	for (size_t i = 1; i <= n; ++i)
+		content += to_string(i) + " " + to_string(i / 2) + " 0.5 1 p\n";
+
+	write("web01", content.c_str());
+	write("web02", content.c_str());
+
+	create_forest();
+
+	EXPECT_EQ(procs->nskipped, 0u);
+	EXPECT_EQ(procs->nprocesses, 1 + 2 * (n + 1));
+
+	// Totals are kept while the processes are moved to make room
+	pnode_t *web02 = child(procs->root, 1);
+	ASSERT_NE(web02, nullptr);
+	EXPECT_NEAR(web02->cpu, 0.5 * n, EPS);
+	EXPECT_EQ(web02->mem, n * 1024);
+}
+
+TEST_F(forest_test, unreadable_files_are_empty_hosts) {
+	write("db01", "1 0 1.0 10 systemd\n");
+	write("db02", "1 0 1.0 10 systemd\n");
+
+	ASSERT_TRUE(hosts_add(&hosts, dir.c_str()));
+	ASSERT_EQ(unlink((dir + "/db01").c_str()), 0);
+
+	procs_io_t io = {};
+	io.hosts = &hosts;
+	procs_init(&ctx, procs, &io);
+
+	EXPECT_EQ(procs->nhosts, 2u);
+
+	pnode_t *db01 = child(procs->root, 0);
+	ASSERT_NE(db01, nullptr);
+	EXPECT_STREQ(db01->name, "db01");
+	EXPECT_EQ(db01->node.first, nullptr);
+
+	EXPECT_EQ(node_nchildren(&child(procs->root, 1)->node), 1u);
+}
+
+TEST_F(procs_test, fold__deepest_levels) {
+	config.max_nodes = 6;
+
+	// Levels: 2 nodes, 3 nodes, 4 nodes
+	create(
+"1     0  1.0  10 a\n"
+"2     0  1.0  10 b\n"
+"3     1  1.0  10 c\n"
+"4     1  1.0  10 d\n"
+"5     2  1.0  10 e\n"
+"6     3  9.0  10 f\n"
+"7     3  1.0  10 g\n"
+"8     4  1.0  10 h\n"
+"9     5  1.0  10 i\n"
+	);
+
+	// 2 + 3 nodes and 3 folds do not fit, so the second level is folded
+	auto a = procs_child_by_pid(procs, 1);
+	ASSERT_NE(a, nullptr);
+	ASSERT_EQ(node_nchildren(&a->node), 1u);
+
+	auto fold = (pnode_t *) a->node.first;
+	EXPECT_STREQ(fold->name, "<5 omitted>");
+	EXPECT_NEAR(fold->cpu, 9.0, EPS);
+
+	auto b = procs_child_by_pid(procs, 2);
+	ASSERT_NE(b, nullptr);
+	EXPECT_STREQ(((pnode_t *) b->node.first)->name, "<2 omitted>");
+
+	EXPECT_EQ(procs->nfolds, 2u);
+	EXPECT_EQ(procs->nstubs, 7u);
+	EXPECT_EQ(procs_child_by_pid(procs, 3), nullptr);
+}
+
+TEST_F(procs_test, fold__tree_fits) {
+	config.max_nodes = 5;
+
+	create(
+"1     0  1.0  10 a\n"
+"2     1  1.0  10 b\n"
+"3     2  1.0  10 c\n"
+	);
+
+	EXPECT_EQ(procs->nfolds, 0u);
+	EXPECT_NE(procs_child_by_pid(procs, 3), nullptr);
+}
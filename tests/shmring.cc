@@ -0,0 +1,145 @@
+#include <string>
+#include <cstring>
+
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "shmring.h"
+}
+
+using namespace std;
+using namespace ::testing;
+
+class shmring_test: public Test
+{
+public:
+	shmring_test() {};
+	virtual ~shmring_test() {};
+
+	string name;
+	shmring_t writer;
+	shmring_t reader;
+
+	virtual void SetUp() {
+		name = "/pscircle-test-" + to_string(getpid());
+		ASSERT_TRUE(shmring_create(&writer, name.c_str(), 5, 3, 3));
+		ASSERT_TRUE(shmring_open(&reader, name.c_str()));
+	}
+
+	virtual void TearDown() {
+		shmring_close(&reader);
+		shmring_close(&writer);
+		shm_unlink(name.c_str());
+	}
+
+	void render(uint8_t value) {
+		uint8_t *buf = shmring_next(&writer);
+		memset(buf, value, writer.header->stride * writer.header->height);
+		shmring_publish(&writer);
+	}
+};
+
+TEST_F(shmring_test, header) {
+	const shmring_header_t *h = reader.header;
+
+	EXPECT_EQ(h->magic, (uint32_t) SHMRING_MAGIC);
+	EXPECT_EQ(h->width, 5u);
+	EXPECT_EQ(h->height, 3u);
+	EXPECT_EQ(h->stride, 20u);
+	EXPECT_EQ(h->nbuffers, 3u);
+}
+
+TEST_F(shmring_test, no_frames) {
+	uint64_t frame;
+	EXPECT_EQ(shmring_latest(&reader, &frame), nullptr);
+	EXPECT_EQ(frame, 0u);
+}
+
+TEST_F(shmring_test, read_latest) {
+	uint64_t frame;
+
+	for (uint8_t i = 1; i <= 7; ++i) {
+		render(i);
+
+		const uint8_t *px = shmring_latest(&reader, &frame);
+		ASSERT_NE(px, nullptr);
+		EXPECT_EQ(frame, i);
+		EXPECT_EQ(px[0], i);
+		EXPECT_EQ(px[3 * 20 - 1], i);
+		EXPECT_TRUE(shmring_valid(&reader, frame));
+	}
+}
+
+TEST_F(shmring_test, overwritten) {
+	uint64_t frame;
+
+	render(1);
+	shmring_latest(&reader, &frame);
+
+	// Once frame 3 is published, the writer starts rendering frame 4 into
+	// the buffer of frame 1
+	render(2);
+	EXPECT_TRUE(shmring_valid(&reader, frame));
+	render(3);
+	EXPECT_FALSE(shmring_valid(&reader, frame));
+}
+
+TEST_F(shmring_test, recreated__old_readers_keep_their_ring) {
+	render(1);
+
+	shmring_t next;
+	ASSERT_TRUE(shmring_create(&next, name.c_str(), 2, 1, 2));
+
+	// The smaller object is not mapped by the old reader
+	uint64_t frame;
+	const uint8_t *px = shmring_latest(&reader, &frame);
+	ASSERT_NE(px, nullptr);
+	EXPECT_EQ(frame, 1u);
+	EXPECT_EQ(px[3 * 20 - 1], 1);
+	EXPECT_EQ(reader.header->width, 5u);
+
+	shmring_t r;
+	ASSERT_TRUE(shmring_open(&r, name.c_str()));
+	EXPECT_EQ(r.header->width, 2u);
+	EXPECT_FALSE(shmring_closed(&r));
+	EXPECT_EQ(shmring_latest(&r, &frame), nullptr);
+
+	shmring_close(&r);
+	shmring_close(&next);
+}
+
+TEST_F(shmring_test, recreated__old_ring_closed) {
+	EXPECT_FALSE(shmring_closed(&reader));
+
+	shmring_t next;
+	ASSERT_TRUE(shmring_create(&next, name.c_str(), 5, 3, 3));
+
+	// The old reader reopens the name and follows the new ring
+	EXPECT_TRUE(shmring_closed(&reader));
+	EXPECT_EQ(reader.header->magic, (uint32_t) SHMRING_CLOSED);
+	EXPECT_FALSE(shmring_closed(&next));
+
+	shmring_close(&reader);
+	ASSERT_TRUE(shmring_open(&reader, name.c_str()));
+	EXPECT_FALSE(shmring_closed(&reader));
+
+	uint8_t *buf = shmring_next(&next);
+	memset(buf, 7, next.header->stride * next.header->height);
+	shmring_publish(&next);
+
+	uint64_t frame;
+	const uint8_t *px = shmring_latest(&reader, &frame);
+	ASSERT_NE(px, nullptr);
+	EXPECT_EQ(frame, 1u);
+	EXPECT_EQ(px[0], 7);
+
+	shmring_close(&next);
+}
+
+TEST_F(shmring_test, open_invalid) {
+	shmring_t r;
+	EXPECT_FALSE(shmring_open(&r, "/pscircle-test-does-not-exist"));
+}
@@ -0,0 +1,269 @@
+#include <string>
+#include <vector>
+#include <cstring>
+
+#include <unistd.h>
+
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "snapshot.h"
+#include "delta.h"
+#include "cfg.h"
+}
+
+using namespace std;
+using namespace ::testing;
+
+class snapshot_test: public Test
+{
+public:
+	snapshot_test() {};
+	virtual ~snapshot_test() {};
+
+	string path;
+	procs_t *procs;
+	procs_t *loaded;
+
+	virtual void SetUp() {
+		path = "/tmp/pscircle-snapshot-test-" + to_string(getpid());
+
+		procs = new procs_t();
+		loaded = new procs_t();
+
+		procs_alloc(procs, 8);
+		add(1, 0, 1.5, 1024, "init");
+		add(2, 1, 0, 2048, "Web Content");
+		add(3, 1, 99, 1 << 30, "a_very_long_process_name");
+
+		procs->cpu_value = 0.25;
+		procs->mem_value = 0.75;
+		strcpy(procs->cpu_label, "1.00 0.75 0.50 1/2");
+		strcpy(procs->mem_label, "1.0G / 4.0G");
+	}
+
+	virtual void TearDown() {
+		procs_dinit(procs);
+		procs_dinit(loaded);
+		delete procs;
+		delete loaded;
+		remove(path.c_str());
+	}
+
+	void add(int pid, int ppid, real_t cpu, uint64_t mem, const char *name) {
+		pnode_t *p = procs_add(procs);
+		p->pid = pid;
+		p->ppid = ppid;
+		p->cpu = cpu;
+		p->mem = mem;
+		strncpy(p->name, name, PSC_MAX_NAME_LENGHT - 1);
+	}
+
+	void write() {
+		FILE *fp = fopen(path.c_str(), "wb");
+		ASSERT_NE(fp, nullptr);
+		ASSERT_TRUE(snapshot_write(fp, procs, 1));
+		fclose(fp);
+	}
+
+	string read() {
+		FILE *fp = fopen(path.c_str(), "rb");
+		string s;
+		char buf[256];
+		size_t n;
+		while ((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+			s.append(buf, n);
+		fclose(fp);
+		return s;
+	}
+};
+
+TEST_F(snapshot_test, roundtrip) {
+	write();
+
+	snapshot_t s;
+	ASSERT_TRUE(snapshot_map(&s, path.c_str()));
+
+	EXPECT_EQ(s.header->nprocesses, 3u);
+	EXPECT_EQ(s.header->size % 8, 0u);
+	EXPECT_EQ(s.header->size, s.size);
+	EXPECT_DOUBLE_EQ(s.header->cpu_value, 0.25);
+	EXPECT_STREQ(s.names + s.header->mem_label, "1.0G / 4.0G");
+
+	procs_alloc(loaded, 8);
+	snapshot_load(&s, loaded);
+	snapshot_unmap(&s);
+
+	ASSERT_EQ(loaded->nprocesses, procs->nprocesses);
+
+	for (size_t i = 1; i < procs->nprocesses; ++i) {
+		pnode_t *a = procs->processes + i;
+		pnode_t *b = loaded->processes + i;
+		EXPECT_EQ(a->pid, b->pid);
+		EXPECT_EQ(a->ppid, b->ppid);
+		EXPECT_FLOAT_EQ(a->cpu, b->cpu);
+		EXPECT_EQ(a->mem, b->mem);
+		EXPECT_STREQ(a->name, b->name);
+	}
+}
+
+TEST_F(snapshot_test, load__capacity_reached__rest_skipped) {
+	write();
+
+	snapshot_t s;
+	ASSERT_TRUE(snapshot_map(&s, path.c_str()));
+
+	procs_alloc(loaded, 3);
+	snapshot_load(&s, loaded);
+	snapshot_unmap(&s);
+
+	EXPECT_EQ(loaded->nprocesses, 3u);
+	EXPECT_EQ(loaded->nskipped, 1u);
+}
+
+TEST_F(snapshot_test, invalid) {
+	write();
+	string s = read();
+
+	EXPECT_TRUE(snapshot_valid(s.data(), s.size()));
+	EXPECT_FALSE(snapshot_valid(s.data(), s.size() - 8));
+
+	string bad = s;
+	bad[0] = 'X';
+	EXPECT_FALSE(snapshot_valid(bad.data(), bad.size()));
+
+	// Name offset out of the string table
+	bad = s;
+	snapshot_proc_t r;
+	memcpy(&r, &bad[sizeof(snapshot_header_t)], sizeof(r));
+	r.name = 1000;
+	memcpy(&bad[sizeof(snapshot_header_t)], &r, sizeof(r));
+	EXPECT_FALSE(snapshot_valid(bad.data(), bad.size()));
+}
+
+TEST_F(snapshot_test, replay) {
+	write();
+
+	delta_reader_t reader;
+	ASSERT_TRUE(delta_reader_open(&reader, path.c_str()));
+	ASSERT_TRUE(delta_reader_next(&reader));
+
+	procs_io_t io = {};
+	io.replay = &reader;
+	config.root_pid = 0;
+
+	psc_ctx_t ctx;
+	psc_ctx_init(&ctx, &config);
+	procs_init(&ctx, loaded, &io);
+	psc_ctx_dinit(&ctx);
+
+	EXPECT_FALSE(delta_reader_next(&reader));
+	EXPECT_EQ(errno, 0);
+	delta_reader_close(&reader);
+
+	auto c = procs_child_by_pid(loaded, 2);
+	ASSERT_NE(c, nullptr);
+	EXPECT_STREQ(c->name, "Web Content");
+	EXPECT_STREQ(loaded->cpu_label, "1.00 0.75 0.50 1/2");
+}
+
+TEST_F(snapshot_test, stream) {
+	FILE *fp = tmpfile();
+	ASSERT_NE(fp, nullptr);
+	ASSERT_TRUE(snapshot_write(fp, procs, 1));
+	procs->processes[2].mem = 4096;
+	ASSERT_TRUE(snapshot_write(fp, procs, 2));
+	rewind(fp);
+
+	snapshot_stream_t stream;
+	snapshot_stream_init(&stream, fp);
+
+	ASSERT_TRUE(snapshot_stream_next(&stream));
+	EXPECT_EQ(stream.snapshot.header->time, 1);
+	EXPECT_EQ(stream.snapshot.procs[1].mem, 2048u);
+
+	ASSERT_TRUE(snapshot_stream_next(&stream));
+	EXPECT_EQ(stream.snapshot.header->time, 2);
+	EXPECT_EQ(stream.snapshot.procs[1].mem, 4096u);
+
+	errno = 0;
+	EXPECT_FALSE(snapshot_stream_next(&stream));
+	EXPECT_EQ(errno, 0);
+
+	snapshot_stream_dinit(&stream);
+	fclose(fp);
+}
+
+TEST_F(snapshot_test, stream__truncated) {
+	write();
+	string s = read();
+
+	FILE *fp = tmpfile();
+	ASSERT_NE(fp, nullptr);
+	fwrite(s.data(), 1, s.size() - 8, fp);
+	rewind(fp);
+
+	snapshot_stream_t stream;
+	snapshot_stream_init(&stream, fp);
+
+	errno = 0;
+	EXPECT_FALSE(snapshot_stream_next(&stream));
+	EXPECT_EQ(errno, EINVAL);
+	EXPECT_EQ(stream.snapshot.header, nullptr);
+
+	snapshot_stream_dinit(&stream);
+	fclose(fp);
+}
+
+TEST_F(snapshot_test, stream__corrupted_size) {
+	write();
+	string s = read();
+
+	snapshot_header_t h;
+	memcpy(&h, s.data(), sizeof(h));
+	h.size = 1ull << 40;
+	memcpy(&s[0], &h, sizeof(h));
+
+	FILE *fp = tmpfile();
+	ASSERT_NE(fp, nullptr);
+	fwrite(s.data(), 1, s.size(), fp);
+	rewind(fp);
+
+	snapshot_stream_t stream;
+	snapshot_stream_init(&stream, fp);
+
+	errno = 0;
+	EXPECT_FALSE(snapshot_stream_next(&stream));
+	EXPECT_EQ(errno, EINVAL);
+
+	snapshot_stream_dinit(&stream);
+	fclose(fp);
+}
+
+TEST_F(snapshot_test, stream__procs_init) {
+	FILE *fp = tmpfile();
+	ASSERT_NE(fp, nullptr);
+	ASSERT_TRUE(snapshot_write(fp, procs, 1));
+	rewind(fp);
+
+	snapshot_stream_t stream;
+	snapshot_stream_init(&stream, fp);
+	ASSERT_TRUE(snapshot_stream_next(&stream));
+
+	procs_io_t io = {};
+	io.snapshots = &stream;
+	config.root_pid = 0;
+
+	psc_ctx_t ctx;
+	psc_ctx_init(&ctx, &config);
+	procs_init(&ctx, loaded, &io);
+	psc_ctx_dinit(&ctx);
+
+	snapshot_stream_dinit(&stream);
+	fclose(fp);
+
+	auto c = procs_child_by_pid(loaded, 2);
+	ASSERT_NE(c, nullptr);
+	EXPECT_STREQ(c->name, "Web Content");
+	EXPECT_STREQ(loaded->mem_label, "1.0G / 4.0G");
+}
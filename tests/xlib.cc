@@ -0,0 +1,103 @@
+#include <cstdlib>
+
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "cfg.h"
+#include "painter.h"
+#include <X11/Xatom.h>
+#include <X11/Xutil.h>
+}
+
+using namespace ::testing;
+
+// Needs an X server, e.g.: xvfb-run -s '-screen 0 640x480x24' ./xlib
+class xlib_test: public Test
+{
+public:
+	xlib_test() {};
+	virtual ~xlib_test() {};
+
+	Display *display = NULL;
+	painter_t painter = {};
+
+	virtual void SetUp() {
+		display = XOpenDisplay(NULL);
+		if (!display)
+			GTEST_SKIP() << "X11 display is not available";
+
+		config.output = NULL;
+		config.output_display = NULL;
+		config.output_width = 64;
+		config.output_height = 48;
+		config.background_image = NULL;
+	}
+
+	virtual void TearDown() {
+		if (display)
+			XCloseDisplay(display);
+	}
+
+	Pixmap root_pixmap(const char *name) {
+		Atom atom = XInternAtom(display, name, True);
+		if (atom == None)
+			return 0;
+
+		Atom type;
+		int format;
+		unsigned long n, after;
+		unsigned char *data = NULL;
+		Pixmap p = 0;
+
+		XGetWindowProperty(display, DefaultRootWindow(display), atom, 0, 1,
+				False, XA_PIXMAP, &type, &format, &n, &after, &data);
+		if (data && n == 1)
+			p = *(Pixmap *) data;
+		if (data)
+			XFree(data);
+
+		return p;
+	}
+
+	unsigned long pixel(Pixmap p) {
+		XImage *img = XGetImage(display, p, 0, 0, 1, 1, AllPlanes, ZPixmap);
+		EXPECT_NE(img, nullptr);
+		unsigned long px = XGetPixel(img, 0, 0);
+		XDestroyImage(img);
+		return px;
+	}
+};
+
+TEST_F(xlib_test, root_pixmap) {
+	psc_ctx_t ctx;
+	psc_ctx_init(&ctx, &config);
+
+	painter_init(&ctx, &painter);
+	painter_write(&painter);
+
+	Pixmap a = root_pixmap("_XROOTPMAP_ID");
+	ASSERT_NE(a, 0u);
+	EXPECT_EQ(a, root_pixmap("ESETROOT_PMAP_ID"));
+
+	color_t bg = config.background;
+	unsigned long expected =
+		(unsigned long) (bg.r * 255 + 0.5) << 16 |
+		(unsigned long) (bg.g * 255 + 0.5) << 8 |
+		(unsigned long) (bg.b * 255 + 0.5);
+	EXPECT_EQ(pixel(a) & 0xffffff, expected);
+
+	painter_clear(&painter);
+	painter_write(&painter);
+
+	Pixmap b = root_pixmap("_XROOTPMAP_ID");
+	if (painter._image)
+		EXPECT_NE(a, b);
+	EXPECT_EQ(pixel(b) & 0xffffff, expected);
+
+	painter_dinit(&painter);
+	psc_ctx_dinit(&ctx);
+
+	// The last frame stays on the root window
+	EXPECT_EQ(root_pixmap("_XROOTPMAP_ID"), b);
+	EXPECT_EQ(pixel(b) & 0xffffff, expected);
+}